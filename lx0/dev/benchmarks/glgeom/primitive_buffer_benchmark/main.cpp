@@ -38,23 +38,7 @@
 #include <lx0/util/blendload.hpp>
 #include <glgeom/extension/primitive_buffer.hpp>
 #include <glgeom/extension/mappers.hpp>
-
-int g_innerCount = 4;
-
-static void
-multi_test(std::string name, std::function<void()> e, std::function<void()> f, std::function<void()> g)
-{
-    lx0::Timer timer;
-    for (int i = 0; i < g_innerCount; ++i)
-    {
-        e();
-        timer.start();
-        f();
-        timer.stop();
-        g();
-    }
-    lx_message("%-40s :: %5ums", name, timer.totalMs());
-}
+#include <lx0/util/misc/benchmark.hpp>
 
 struct triangle3f_b
 {
@@ -151,64 +135,50 @@ test3 (glgeom::primitive_buffer& primitive)
 int 
 main (int argc, char** argv)
 {
-#ifdef NDEBUG
-    g_innerCount = 8;
-#else
-    g_innerCount = 2;
-
-    if (lx0::lx_in_debugger())
-        g_innerCount = 1;
-#endif
- 
+    int regressions = 0;
+
     lx0::EnginePtr spEngine = lx0::Engine::acquire();
     spEngine->initialize();   
     {
         glgeom::primitive_buffer primitive = load_data();  
         glgeom::primitive_buffer original = primitive;
         
-        for (int i = 0; i < 4; ++i)
-        {
-            lx_message("=== Iteration %1% ===", i);
-
-            multi_test("compute_face_normals",
-                [&]() { primitive = original; },
-                [&]() { glgeom::compute_face_normals(primitive); }, 
-                [](){}
-            );
-            multi_test("compute_vertex_normals",
-                [&]() { primitive = original; },
-                [&]() { glgeom::compute_face_normals(primitive); }, 
-                [](){}
-            );
-            multi_test("compute_adjacency_vertex_to_faces", 
-                [&]() { primitive = original; },
-                [&]() { glgeom::compute_adjacency_vertex_to_faces(primitive); }, 
-                [&]() { glgeom::verify_adjacency_vertex_to_faces(primitive, true); } 
-            );
-
-            multi_test("create_vertex_normals_mesh",
-                [&]() { primitive = original; },
-                [&]() { create_vertex_normals_mesh(primitive); }, 
-                [](){}
-            );
-            multi_test("create_face_normals_mesh",
-                [&]() { primitive = original; },
-                [&]() { create_vertex_normals_mesh(primitive); }, 
-                [](){}
-            );
-
-            multi_test("compute_tangent_vectors",
-                [&]() { 
-                    primitive = original; 
-                    glgeom::compute_uv_mapping(primitive, 0, [](const glgeom::point3f& p, const glgeom::vector3f& n) -> glgeom::point2f {
-                         return glgeom::scale( glgeom::mapper_planar_xy(p), glgeom::vector2f(10, 10));
-                    });
-                },
-                [&]() { test3(primitive); }, 
-                [](){}
-            );
-        }
+        // Each case modifies the mesh, so it is restored (untimed) before every repetition
+        auto restore = [&]() { primitive = original; };
+        auto none = [](){};
+
+        lx0::BenchmarkRunner runner("primitive_buffer_benchmark");
+        runner.parseArguments(argc, argv);
+
+        runner.add("compute_face_normals", restore,
+            [&]() { glgeom::compute_face_normals(primitive); }, 
+            none
+        );
+        runner.add("compute_vertex_normals", restore,
+            [&]() { glgeom::compute_vertex_normals(primitive); }, 
+            none
+        );
+        runner.add("compute_adjacency_vertex_to_faces", restore,
+            [&]() { glgeom::compute_adjacency_vertex_to_faces(primitive); }, 
+            [&]() { glgeom::verify_adjacency_vertex_to_faces(primitive, true); } 
+        );
+        runner.add("create_vertex_normals_mesh", restore,
+            [&]() { create_vertex_normals_mesh(primitive); }, 
+            none
+        );
+        runner.add("compute_tangent_vectors",
+            [&]() { 
+                primitive = original; 
+                glgeom::compute_uv_mapping(primitive, 0, [](const glgeom::point3f& p, const glgeom::vector3f& n) -> glgeom::point2f {
+                     return glgeom::scale( glgeom::mapper_planar_xy(p), glgeom::vector2f(10, 10));
+                });
+            },
+            [&]() { test3(primitive); }, 
+            none
+        );
+
+        regressions = runner.run();
     }
     spEngine->shutdown();
-    return 0;
+    return regressions;
 }
@@ -0,0 +1,120 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+
+    Copyright (c) 2012 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a 
+    copy of this software and associated documentation files (the "Software"), 
+    to deal in the Software without restriction, including without limitation 
+    the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+    and/or sell copies of the Software, and to permit persons to whom the 
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+//===========================================================================//
+//   H E A D E R S   &   D E C L A R A T I O N S 
+//===========================================================================//
+
+// Standard headers
+#include <vector>
+#include <iostream>
+
+#include <lx0/lxengine.hpp>
+#include <lx0/util/blendload.hpp>
+#include <lx0/util/misc/benchmark.hpp>
+#include <glgeom/extension/primitive_buffer.hpp>
+
+//
+// Compares the cost of the logging paths:
+//
+// - a message filtered out by the runtime log level
+// - the previous behavior: format on the calling thread, then log
+// - the deferred path used by lx_log: copy the arguments, format on the logging thread
+// - an lx_check_error failure (the exception constructors log several lines)
+// - loading a .blend model with logging enabled and disabled
+//
+
+static int g_count = 200 * 1000;
+
+static void
+check_error (int i)
+{
+    lx_check_error(i < 0, "Value %d is not negative", i);
+}
+
+static void
+load_blend (void)
+{
+    glgeom::primitive_buffer primitive;
+    glm::mat4 scaleMat = glm::scale(glm::mat4(), glm::vec3(1, 1, 1));
+    lx0::primitive_buffer_from_blendfile(primitive, "common/models/landscapes/mountain_valley_b-000.blend", scaleMat);
+}
+
+int 
+main (int argc, char** argv)
+{
+#ifndef NDEBUG
+    g_count /= 10;
+#endif
+
+    int regressions = 0;
+
+    lx0::EnginePtr spEngine = lx0::Engine::acquire();
+    spEngine->initialize();   
+    {
+        // Deferred messages are written out after each repetition, outside of the timed region
+        auto flush = []() { lx0::lx_log_flush(); };
+        auto none  = []() {};
+
+        lx0::BenchmarkRunner runner("log_overhead");
+        runner.parseArguments(argc, argv);
+
+        runner.add("lx_log, filtered by level", none, []() {
+            lx0::lx_log_level(lx0::eLogWarn);
+            for (int i = 0; i < g_count; ++i)
+                lx_log("Message %d of %d: %s", i, g_count, "filtered");
+            lx0::lx_log_level(lx0::eLogDebug);
+        }, flush);
+        runner.add("_lx_format + _lx_log_imp (eager)", none, []() {
+            for (int i = 0; i < g_count; ++i)
+                lx0::_lx_log_imp(__FILE__, __LINE__, _lx_format("Message %d of %d: %s", i, g_count, "eager"));
+        }, flush);
+        runner.add("lx_log (deferred)", none, []() {
+            for (int i = 0; i < g_count; ++i)
+                lx_log("Message %d of %d: %s", i, g_count, "deferred");
+        }, flush);
+        runner.add("lx_check_error thrown and caught", none, []() {
+            for (int i = 0; i < g_count / 100; ++i)
+            {
+                try { check_error(i); } catch (lx0::error_exception&) {}
+            }
+        }, flush);
+
+        runner.add("Load .blend, log level 'debug'", none, []() { load_blend(); }, flush);
+        runner.add("Load .blend, log level 'warn'", none, []() {
+            lx0::lx_log_level(lx0::eLogWarn);
+            load_blend();
+            lx0::lx_log_level(lx0::eLogDebug);
+        }, flush);
+
+        regressions = runner.run();
+    }
+    
+    spEngine->shutdown();
+    return regressions;
+}
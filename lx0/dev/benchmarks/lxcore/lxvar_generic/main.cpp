@@ -36,25 +36,11 @@
 
 #include <lx0/lxengine.hpp>
 #include <lx0/util/blendload.hpp>
+#include <lx0/util/misc/benchmark.hpp>
 #include <glgeom/extension/primitive_buffer.hpp>
 
-int g_innerCount = 4;
 float g_sum = 0.0f;
 
-static void
-multi_test(std::string name, std::function<void()> f, std::function<void()> g)
-{
-    lx0::Timer timer;
-    for (int i = 0; i < g_innerCount; ++i)
-    {
-        timer.start();
-        f();
-        timer.stop();
-        g();
-    }
-    lx_message("  %-32s :: %5ums", name, timer.totalMs());
-}
-
 static void 
 test1 (glgeom::primitive_buffer& primitive)
 {       
@@ -114,34 +100,23 @@ load_data()
 int 
 main (int argc, char** argv)
 {
-#ifdef NDEBUG
-    g_innerCount = 8;
-#else
-    g_innerCount = 2;
-
-    if (lx0::lx_in_debugger())
-        g_innerCount = 1;
-#endif
- 
+    int regressions = 0;
+
     lx0::EnginePtr spEngine = lx0::Engine::acquire();
     spEngine->initialize();   
     {
         glgeom::primitive_buffer primitive = load_data();    
         
-        for (int i = 0; i < 4; ++i)
-        {
-            lx_message("=== Iteration %1% ===", i);
-            multi_test("Sum via lxvar", 
-                [&]() { test1(primitive); }, 
-                []() { lx_log("Sum = %f", g_sum); } 
-            );
-            multi_test("Sum via std::vector",
-                [&]() { test2(primitive); }, 
-                []() { lx_log("Sum = %f", g_sum); } 
-            );
-        }
+        lx0::BenchmarkRunner runner("lxvar_generic");
+        runner.parseArguments(argc, argv);
+        runner.add("Sum via lxvar",         [&]() { test1(primitive); });
+        runner.add("Sum via std::vector",   [&]() { test2(primitive); });
+        regressions = runner.run();
+
+        // Keep the sums observable so the loops are not optimized away
+        lx_log("Sum = %f", g_sum);
     }
     
     spEngine->shutdown();
-    return 0;
+    return regressions;
 }
@@ -0,0 +1,76 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+
+    Copyright (c) 2012 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a 
+    copy of this software and associated documentation files (the "Software"), 
+    to deal in the Software without restriction, including without limitation 
+    the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+    and/or sell copies of the Software, and to permit persons to whom the 
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+
+//===========================================================================//
+//   H E A D E R S   &   D E C L A R A T I O N S 
+//===========================================================================//
+
+// Standard headers
+#include <cstdlib>
+#include <iostream>
+
+#include <lx0/lxengine.hpp>
+#include <lx0/util/misc/benchmark.hpp>
+
+//
+// Compares two sets of results written by a benchmark with --json, e.g. the
+// results of the current build against a baseline checked in from a prior
+// run:
+//
+//   benchmark_compare current.json baseline.json [threshold percent]
+//
+// The exit code is the number of regressions, so the tool can gate a script.
+//
+
+int 
+main (int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: benchmark_compare <current.json> <baseline.json> [threshold percent]" << std::endl;
+        return -1;
+    }
+
+    lx0::lx_init();
+
+    const double threshold = (argc > 3) ? atof(argv[3]) : 10.0;
+    for (int i = 1; i <= 2; ++i)
+    {
+        if (!lx0::file_exists(argv[i]))
+        {
+            std::cerr << "Could not open '" << argv[i] << "'" << std::endl;
+            return -1;
+        }
+    }
+
+    lx0::lxvar current  = lx0::lxvar_from_file(argv[1]);
+    lx0::lxvar baseline = lx0::lxvar_from_file(argv[2]);
+    
+    return lx0::BenchmarkRunner::compare(current, baseline, threshold);
+}
@@ -92,6 +92,8 @@ namespace lx0
     {
         _LX_FORWARD_DECL_PTRS(Element);
         _LX_FORWARD_DECL_PTRS(Transaction);
+        _LX_FORWARD_DECL_PTRS(ElementSnapshot);
+        _LX_FORWARD_DECL_PTRS(DocumentSnapshot);
         _LX_FORWARD_DECL_PTRS(Document);
         _LX_FORWARD_DECL_PTRS(Space);
         _LX_FORWARD_DECL_PTRS(Engine);
@@ -105,6 +107,7 @@ namespace lx0
 
         class DocumentComponent;
         class ElementComponent;
+        class ElementHandle;
         class ViewComponent;
         class ViewImp;
     }
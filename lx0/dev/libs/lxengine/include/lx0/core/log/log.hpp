@@ -30,6 +30,9 @@
 
 #pragma once
 
+#include <new>
+#include <string>
+#include <type_traits>
 #include <boost/format.hpp>
 
 #include <lx0/core/slot/slot.hpp>
@@ -138,14 +141,69 @@ namespace lx0
                 fatal_exception (const char* file, int line, const char* format, T0 a0, T1 a1, T2 a2, T3 ae, T4 a4) : detail::_exception_base(file, line) { detail(format, a0, a1, a2, a3, a4); }
             };
 
+            /*!
+                \ingroup lx0_core_log
+
+                Messages below the current level (see lx_log_level()) are
+                discarded before the message is formatted.
+             */
+            enum LogLevel
+            {
+                eLogDebug,
+                eLogLog,
+                eLogMessage,
+                eLogWarn,
+                eLogNone,
+            };
+
+            /*!
+                \ingroup lx0_core_log
+
+                The format the background logging thread writes.  eLogSinkBinary
+                writes the raw records for later decoding and is the cheapest 
+                to write:
+
+                <pre>
+                file header:    "LXLOG001"
+                per record:     uint8 level, uint32 thread id, int64 ticks, uint32 line,
+                                uint16 file length, file, uint32 text length, text
+                </pre>
+             */
+            enum LogSink
+            {
+                eLogSinkHtml,
+                eLogSinkText,
+                eLogSinkBinary,
+            };
+
             //===========================================================================//
             // defines
             //===========================================================================//
 
-            #define lx_message(FMT,...)             lx0::_lx_message_imp(__FILE__,__LINE__,_lx_format(FMT,__VA_ARGS__))
-            #define lx_debug(FMT,...)               lx0::_lx_debug_imp(__FILE__,__LINE__,_lx_format(FMT,__VA_ARGS__))
-            #define lx_log(FMT,...)                 lx0::_lx_log_imp(__FILE__,__LINE__,_lx_format(FMT,__VA_ARGS__))
-            #define lx_warn(FMT,...)                lx0::_lx_warn_imp(__FILE__,__LINE__,_lx_format(FMT,__VA_ARGS__))
+            //
+            // Messages below LX_LOG_MIN_LEVEL are compiled out entirely: the 
+            // condition is a compile-time constant, so neither the call nor the
+            // argument expressions remain in the generated code.  Define it to,
+            // e.g., 3 (eLogWarn) in the project settings for a shipping build.
+            //
+            #ifndef LX_LOG_MIN_LEVEL
+            #   ifdef _DEBUG
+            #       define LX_LOG_MIN_LEVEL 0
+            #   else
+            #       define LX_LOG_MIN_LEVEL 1
+            #   endif
+            #endif
+
+            //
+            // lx_debug and lx_log store their arguments and are formatted on the
+            // logging thread; the format must therefore be a string literal.
+            // lx_message and lx_warn also echo to the console, so they are 
+            // formatted immediately.
+            //
+            #define lx_message(FMT,...)             do { if (LX_LOG_MIN_LEVEL <= 2 && lx0::_lx_log_enabled(lx0::eLogMessage)) lx0::_lx_message_imp(__FILE__,__LINE__,_lx_format(FMT,__VA_ARGS__)); } while (0)
+            #define lx_debug(FMT,...)               do { if (LX_LOG_MIN_LEVEL <= 0 && lx0::_lx_log_enabled(lx0::eLogDebug))   lx0::_lx_log_deferred(lx0::eLogDebug,__FILE__,__LINE__,"" FMT,__VA_ARGS__); } while (0)
+            #define lx_log(FMT,...)                 do { if (LX_LOG_MIN_LEVEL <= 1 && lx0::_lx_log_enabled(lx0::eLogLog))     lx0::_lx_log_deferred(lx0::eLogLog,__FILE__,__LINE__,"" FMT,__VA_ARGS__); } while (0)
+            #define lx_warn(FMT,...)                do { if (LX_LOG_MIN_LEVEL <= 3 && lx0::_lx_log_enabled(lx0::eLogWarn))    lx0::_lx_warn_imp(__FILE__,__LINE__,_lx_format(FMT,__VA_ARGS__)); } while (0)
             #define lx_error_exception(FMT,...)     lx0::error_exception(__FILE__, __LINE__,FMT,__VA_ARGS__)
             #define lx_fatal_exception(FMT,...)     lx0::fatal_exception(__FILE__, __LINE__,FMT,__VA_ARGS__)
                         
@@ -200,6 +258,190 @@ namespace lx0
             inline void _lx_warn_imp    (const char* file, int line) {}
 
             void        _lx_write_to_log(const char* css, const char* prefix, const char* s);
+
+            void        lx_log_level    (LogLevel level);
+            LogLevel    lx_log_level    (void);
+            void        lx_log_sink     (LogSink sink, const char* filename);
+            void        lx_log_push_sink(LogSink sink, const char* filename);
+            void        lx_log_pop_sink (void);
+            void        lx_log_flush    (void);
+
+            extern volatile int _lx_log_threshold;
+            inline bool _lx_log_enabled (LogLevel level) { return int(level) >= _lx_log_threshold; }
+
+            //===========================================================================//
+            // deferred formatting
+            //===========================================================================//
+
+            namespace detail
+            {
+                //! Arguments of a log message, formatted later on the logging thread
+                class LogArgs
+                {
+                public:
+                    virtual             ~LogArgs    (void) {}
+                    virtual std::string format      (void) const = 0;
+                };
+
+                struct _lx_none 
+                {
+                    _lx_none() {}
+                    template <typename T> _lx_none (const T&) {}
+                };
+
+                inline void _lx_feed (boost::format& f, const _lx_none&) {}
+                template <typename T> 
+                inline void _lx_feed (boost::format& f, const T& a) { f % a; }
+
+                //
+                // How an argument is stored until it is formatted.  Only types 
+                // that are safe to copy to and destroy on another thread are 
+                // deferred; char pointers are copied since the string may not 
+                // outlive the call.  Of the other pointers only void pointers,
+                // which are printed as an address, are deferred: boost::format
+                // may read through any other pointer (e.g. an unsigned char* 
+                // is printed as a string).  Any other type (e.g. an lxvar, 
+                // whose reference count is not thread-safe) causes the whole 
+                // message to be formatted immediately.
+                //
+                template <typename T> struct _lx_capture 
+                { 
+                    enum { deferrable = std::is_arithmetic<T>::value || std::is_enum<T>::value 
+                                     || (std::is_pointer<T>::value && std::is_void<typename std::remove_pointer<T>::type>::value) };
+                    typedef typename std::conditional<deferrable, T, _lx_none>::type type;
+                };
+                template <> struct _lx_capture<const char*>  { enum { deferrable = 1 }; typedef std::string type; };
+                template <> struct _lx_capture<char*>        { enum { deferrable = 1 }; typedef std::string type; };
+                template <> struct _lx_capture<std::string>  { enum { deferrable = 1 }; typedef std::string type; };
+                template <> struct _lx_capture<_lx_none>     { enum { deferrable = 1 }; typedef _lx_none type; };
+
+                template <typename T0 = _lx_none, typename T1 = _lx_none, typename T2 = _lx_none, typename T3 = _lx_none,
+                          typename T4 = _lx_none, typename T5 = _lx_none, typename T6 = _lx_none, typename T7 = _lx_none>
+                class LogArgsN : public LogArgs
+                {
+                public:
+                    enum { deferrable = _lx_capture<T0>::deferrable && _lx_capture<T1>::deferrable && _lx_capture<T2>::deferrable && _lx_capture<T3>::deferrable
+                                     && _lx_capture<T4>::deferrable && _lx_capture<T5>::deferrable && _lx_capture<T6>::deferrable && _lx_capture<T7>::deferrable };
+
+                    LogArgsN (const char* format, const T0& x0 = T0(), const T1& x1 = T1(), const T2& x2 = T2(), const T3& x3 = T3(), 
+                                                  const T4& x4 = T4(), const T5& x5 = T5(), const T6& x6 = T6(), const T7& x7 = T7())
+                        : mFormat (format), a0 (x0), a1 (x1), a2 (x2), a3 (x3), a4 (x4), a5 (x5), a6 (x6), a7 (x7) {}
+
+                    virtual std::string format (void) const
+                    {
+                        boost::format f(mFormat);
+                        f.exceptions(boost::io::no_error_bits);
+                        _lx_feed(f, a0); _lx_feed(f, a1); _lx_feed(f, a2); _lx_feed(f, a3);
+                        _lx_feed(f, a4); _lx_feed(f, a5); _lx_feed(f, a6); _lx_feed(f, a7);
+                        return boost::str(f);
+                    }
+
+                protected:
+                    const char*                     mFormat;        //!< Always a string literal
+                    typename _lx_capture<T0>::type  a0;
+                    typename _lx_capture<T1>::type  a1;
+                    typename _lx_capture<T2>::type  a2;
+                    typename _lx_capture<T3>::type  a3;
+                    typename _lx_capture<T4>::type  a4;
+                    typename _lx_capture<T5>::type  a5;
+                    typename _lx_capture<T6>::type  a6;
+                    typename _lx_capture<T7>::type  a7;
+                };
+
+                //! A slot in the log queue claimed by _lx_log_reserve() and published by _lx_log_commit()
+                struct LogReservation
+                {
+                    void*   pRecord;
+                    void*   pStorage;       //!< Space in the record for the LogArgs
+                    size_t  capacity;
+                };
+
+                void    _lx_log_reserve     (int level, const char* file, int line, LogReservation& r);
+                void    _lx_log_commit      (LogReservation& r, LogArgs* pArgs, const char* literal);
+                void    _lx_log_text        (int level, const char* file, int line, const std::string& s);
+
+                template <typename A>
+                void _lx_log_defer (int level, const char* file, int line, A& args)
+                {
+                    LogReservation r;
+                    _lx_log_reserve(level, file, line, r);
+                        
+                    // The slot must be published even if copying the arguments fails
+                    LogArgs* pArgs = nullptr;
+                    try
+                    {
+                        if (sizeof(A) <= r.capacity)
+                            pArgs = new (r.pStorage) A(std::move(args));
+                        else
+                            pArgs = new A(std::move(args));
+                    }
+                    catch (...) {}
+                    _lx_log_commit(r, pArgs, nullptr);
+                }
+            }
+
+            inline void _lx_log_deferred (int level, const char* file, int line, const char* format)
+            { 
+                detail::LogReservation r; 
+                detail::_lx_log_reserve(level, file, line, r); 
+                detail::_lx_log_commit(r, nullptr, format);
+            }
+            template <typename T0>
+            void _lx_log_deferred (int level, const char* file, int line, const char* format, T0 a0)
+            {
+                typedef detail::LogArgsN<T0> Args;
+                if (Args::deferrable) { Args args(format, a0); detail::_lx_log_defer(level, file, line, args); }
+                else detail::_lx_log_text(level, file, line, _lx_format(format, a0));
+            }
+            template <typename T0, typename T1>
+            void _lx_log_deferred (int level, const char* file, int line, const char* format, T0 a0, T1 a1)
+            {
+                typedef detail::LogArgsN<T0,T1> Args;
+                if (Args::deferrable) { Args args(format, a0, a1); detail::_lx_log_defer(level, file, line, args); }
+                else detail::_lx_log_text(level, file, line, _lx_format(format, a0, a1));
+            }
+            template <typename T0, typename T1, typename T2>
+            void _lx_log_deferred (int level, const char* file, int line, const char* format, T0 a0, T1 a1, T2 a2)
+            {
+                typedef detail::LogArgsN<T0,T1,T2> Args;
+                if (Args::deferrable) { Args args(format, a0, a1, a2); detail::_lx_log_defer(level, file, line, args); }
+                else detail::_lx_log_text(level, file, line, _lx_format(format, a0, a1, a2));
+            }
+            template <typename T0, typename T1, typename T2, typename T3>
+            void _lx_log_deferred (int level, const char* file, int line, const char* format, T0 a0, T1 a1, T2 a2, T3 a3)
+            {
+                typedef detail::LogArgsN<T0,T1,T2,T3> Args;
+                if (Args::deferrable) { Args args(format, a0, a1, a2, a3); detail::_lx_log_defer(level, file, line, args); }
+                else detail::_lx_log_text(level, file, line, _lx_format(format, a0, a1, a2, a3));
+            }
+            template <typename T0, typename T1, typename T2, typename T3, typename T4>
+            void _lx_log_deferred (int level, const char* file, int line, const char* format, T0 a0, T1 a1, T2 a2, T3 a3, T4 a4)
+            {
+                typedef detail::LogArgsN<T0,T1,T2,T3,T4> Args;
+                if (Args::deferrable) { Args args(format, a0, a1, a2, a3, a4); detail::_lx_log_defer(level, file, line, args); }
+                else detail::_lx_log_text(level, file, line, _lx_format(format, a0, a1, a2, a3, a4));
+            }
+            template <typename T0, typename T1, typename T2, typename T3, typename T4, typename T5>
+            void _lx_log_deferred (int level, const char* file, int line, const char* format, T0 a0, T1 a1, T2 a2, T3 a3, T4 a4, T5 a5)
+            {
+                typedef detail::LogArgsN<T0,T1,T2,T3,T4,T5> Args;
+                if (Args::deferrable) { Args args(format, a0, a1, a2, a3, a4, a5); detail::_lx_log_defer(level, file, line, args); }
+                else detail::_lx_log_text(level, file, line, _lx_format(format, a0, a1, a2, a3, a4, a5));
+            }
+            template <typename T0, typename T1, typename T2, typename T3, typename T4, typename T5, typename T6>
+            void _lx_log_deferred (int level, const char* file, int line, const char* format, T0 a0, T1 a1, T2 a2, T3 a3, T4 a4, T5 a5, T6 a6)
+            {
+                typedef detail::LogArgsN<T0,T1,T2,T3,T4,T5,T6> Args;
+                if (Args::deferrable) { Args args(format, a0, a1, a2, a3, a4, a5, a6); detail::_lx_log_defer(level, file, line, args); }
+                else detail::_lx_log_text(level, file, line, _lx_format(format, a0, a1, a2, a3, a4, a5, a6));
+            }
+            template <typename T0, typename T1, typename T2, typename T3, typename T4, typename T5, typename T6, typename T7>
+            void _lx_log_deferred (int level, const char* file, int line, const char* format, T0 a0, T1 a1, T2 a2, T3 a3, T4 a4, T5 a5, T6 a6, T7 a7)
+            {
+                typedef detail::LogArgsN<T0,T1,T2,T3,T4,T5,T6,T7> Args;
+                if (Args::deferrable) { Args args(format, a0, a1, a2, a3, a4, a5, a6, a7); detail::_lx_log_defer(level, file, line, args); }
+                else detail::_lx_log_text(level, file, line, _lx_format(format, a0, a1, a2, a3, a4, a5, a6, a7));
+            }
         }
     }
     using namespace lx0::core::log_ns;
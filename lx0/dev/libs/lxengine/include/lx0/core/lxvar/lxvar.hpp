@@ -30,6 +30,7 @@
 #pragma once
 
 #include <lx0/_detail/forward_decls.hpp>
+#include <lx0/core/memory/memory.hpp>
 #include <vector>
 #include <memory>
 #include <map>
@@ -287,7 +288,7 @@ namespace lx0
                 //!
                 /*!
                  */
-                class lxvalue
+                class lxvalue : public lx0::core::memory_ns::TrackedObject<lx0::core::memory_ns::eMemoryLxvar>
                 {
                 public:
                                         lxvalue() : mRefCount (0) {}
@@ -0,0 +1,194 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+    * MIT License (http://www.opensource.org/licenses/mit-license.php)
+
+    Copyright (c) 2010-2012 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a
+    copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+
+#pragma once
+
+//===========================================================================//
+//   H E A D E R S
+//===========================================================================//
+
+#include <cstddef>
+#include <new>
+#include <limits>
+
+#include <lx0/_detail/forward_decls.hpp>
+
+//
+// Allocation tracking is cheap enough (a few atomic adds per allocation) to
+// leave on in release builds.  Define LX_MEMORY_TRACKING to 0 to compile it
+// out entirely.
+//
+// Only allocations made through the tagged allocators, TrackedObject, or
+// lx_memory_allocate() are counted.  Define LX_MEMORY_TRACKING_GLOBAL to also
+// replace the global operator new/delete, in which case every allocation is
+// counted against the tag of the innermost MemoryScope on the calling thread.
+//
+#ifndef LX_MEMORY_TRACKING
+#   define LX_MEMORY_TRACKING 1
+#endif
+
+namespace lx0 
+{ 
+    namespace core 
+    {
+        namespace memory_ns
+        {
+            //===========================================================================//
+            //! Subsystem an allocation is counted against
+            /*!
+                "lxvar" and "dom" are always counted: their storage goes 
+                through TrackedObject and TaggedAllocator.  "mesh" is only set 
+                by a MemoryScope around .blend loading, and the glgeom 
+                containers use std::allocator, so it stays at zero unless 
+                LX_MEMORY_TRACKING_GLOBAL is defined.
+             */
+            enum MemoryTag
+            {
+                eMemoryGeneral,
+                eMemoryLxvar,
+                eMemoryDom,
+                eMemoryMesh,
+                eMemoryTagCount
+            };
+
+            //===========================================================================//
+            //! Counters for a single MemoryTag
+            /*!
+             */
+            struct MemoryStats
+            {
+                lx0::uint64     live;           //!< Bytes currently allocated
+                lx0::uint64     peak;           //!< Highest value of live since startup
+                lx0::uint64     total;          //!< Bytes allocated since startup
+                lx0::uint64     allocations;    //!< Number of allocations since startup
+                lx0::uint64     frees;          //!< Number of deallocations since startup
+            };
+
+            const char* lx_memory_tag_name  (MemoryTag tag);
+            void        lx_memory_stats     (MemoryTag tag, MemoryStats& stats);
+            MemoryTag   lx_memory_tag       (void);
+
+            void*       lx_memory_allocate  (size_t bytes, MemoryTag tag);
+            void        lx_memory_deallocate(void* p, size_t bytes, MemoryTag tag);
+
+            namespace detail
+            {
+#if LX_MEMORY_TRACKING
+                void    _lx_memory_alloc    (MemoryTag tag, size_t bytes);
+                void    _lx_memory_free     (MemoryTag tag, size_t bytes);
+#else
+                inline void _lx_memory_alloc (MemoryTag, size_t) {}
+                inline void _lx_memory_free  (MemoryTag, size_t) {}
+#endif
+            }
+
+            //===========================================================================//
+            //! Sets the tag of the calling thread for the lifetime of the object
+            /*!
+                Scopes nest: the previous tag is restored on destruction.  The tag
+                is used by LX_MEMORY_TRACKING_GLOBAL and may be queried via
+                lx_memory_tag() by code that tags its own allocations.
+             */
+            class MemoryScope
+            {
+            public:
+                                MemoryScope     (MemoryTag tag);
+                                ~MemoryScope    (void);
+            protected:
+                MemoryTag       mPrevious;
+            };
+
+            //===========================================================================//
+            //! Standard allocator that counts its allocations against Tag
+            /*!
+                Stateless, so containers using it are the same size as with 
+                std::allocator and may be freely swapped.
+
+                Example:
+                \code
+                std::vector<int, TaggedAllocator<int, eMemoryMesh>> indices;
+                \endcode
+             */
+            template <typename T, MemoryTag Tag>
+            class TaggedAllocator
+            {
+            public:
+                typedef T               value_type;
+                typedef T*              pointer;
+                typedef const T*        const_pointer;
+                typedef T&              reference;
+                typedef const T&        const_reference;
+                typedef size_t          size_type;
+                typedef ptrdiff_t       difference_type;
+
+                template <typename U> 
+                struct rebind { typedef TaggedAllocator<U, Tag> other; };
+
+                                TaggedAllocator (void) {}
+                                TaggedAllocator (const TaggedAllocator&) {}
+                template <typename U>
+                                TaggedAllocator (const TaggedAllocator<U, Tag>&) {}
+
+                pointer         address     (reference r) const         { return &r; }
+                const_pointer   address     (const_reference r) const   { return &r; }
+                size_type       max_size    (void) const                { return (std::numeric_limits<size_type>::max)() / sizeof(T); }
+
+                pointer         allocate    (size_type n, const void* = 0)  { return static_cast<pointer>( lx_memory_allocate(n * sizeof(T), Tag) ); }
+                void            deallocate  (pointer p, size_type n)        { lx_memory_deallocate(p, n * sizeof(T), Tag); }
+
+                void            construct   (pointer p, const T& t)     { new (p) T(t); }
+                void            destroy     (pointer p)                 { p->~T(); }
+
+                template <typename U>
+                bool            operator==  (const TaggedAllocator<U, Tag>&) const { return true; }
+                template <typename U>
+                bool            operator!=  (const TaggedAllocator<U, Tag>&) const { return false; }
+            };
+
+            //===========================================================================//
+            //! Base class that counts heap-allocated instances against Tag
+            /*!
+                The size passed to operator delete is that of the most derived 
+                type, so the base requires a virtual destructor somewhere in the
+                hierarchy if derived objects are deleted via a base pointer.
+             */
+            template <MemoryTag Tag>
+            class TrackedObject
+            {
+            public:
+                static void*    operator new    (size_t bytes)                  { return lx_memory_allocate(bytes, Tag); }
+                static void     operator delete (void* p, size_t bytes)         { lx_memory_deallocate(p, bytes, Tag); }
+                static void*    operator new    (size_t, void* p)               { return p; }
+                static void     operator delete (void*, void*)                  {}
+            };
+        }
+    }
+    using namespace lx0::core::memory_ns;
+}
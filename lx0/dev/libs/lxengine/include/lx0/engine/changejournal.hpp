@@ -0,0 +1,119 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+    * MIT License (http://www.opensource.org/licenses/mit-license.php)
+
+    Copyright (c) 2010-2012 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a
+    copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+#pragma once
+
+//===========================================================================//
+//   H E A D E R S
+//===========================================================================//
+
+// Standard headers
+#include <deque>
+#include <string>
+#include <vector>
+
+// Lx headers
+#include <lx0/_detail/forward_decls.hpp>
+
+namespace lx0
+{
+    namespace engine_ns
+    {
+        //===========================================================================//
+        //! A single recorded modification to an Element in a Document
+        /*!
+            \ingroup lx0_engine_dom
+         */
+        class ChangeEntry
+        {
+        public:
+            enum Field
+            {
+                eTagName,
+                eAttribute,     //!< name holds the attribute name
+                eValue,
+                eChildren,      //!< A child was added or removed from the Element
+                eAdded,         //!< The Element was added to the Document
+                eRemoved,       //!< The Element was removed from the Document
+            };
+
+            lx0::uint64     stamp;          //!< Unique, increasing change stamp (see Element::treeVersion())
+            lx0::uint32     frame;          //!< Document::version() at the time of the change
+            ElementWPtr     wpElement;
+            Field           field;
+            std::string     name;
+        };
+
+        //===========================================================================//
+        //! Per-Document log of Element modifications for polling consumers
+        /*!
+            \ingroup lx0_engine_dom
+
+            The journal is an alternative to receiving synchronous callbacks via
+            ElementComponent::onAttributeChange(), onValueChange(), etc.  A consumer
+            (e.g. a renderer rebuilding its render list) keeps a cursor and, once
+            per frame, reads all changes since that cursor.
+
+            The journal is disabled by default so that Documents with no polling
+            consumers do not pay for the bookkeeping.  Entries are trimmed during
+            Document::update() once the journal exceeds its capacity; a consumer
+            that falls that far behind is told to do a full rebuild.
+
+            For coarse-grained checks, the Element change stamps can be used
+            directly: if Element::treeVersion() is not greater than the stamp at
+            which the consumer last processed the sub-tree, nothing in that
+            sub-tree has changed and it can be skipped entirely.
+         */
+        class ChangeJournal
+        {
+        public:
+                            ChangeJournal   (void);
+
+            bool            enabled         (void) const            { return mbEnabled; }
+            void            enable          (bool bEnabled);
+
+            size_t          capacity        (void) const            { return mCapacity; }
+            void            capacity        (size_t entries)        { mCapacity = entries; }
+
+            lx0::uint64     head            (void) const;
+            bool            read            (lx0::uint64& cursor, std::vector<ChangeEntry>& changes) const;
+
+            void            record          (Element* pElem, ChangeEntry::Field field, lx0::uint64 stamp, lx0::uint32 frame, const char* name = nullptr);
+            void            trim            (void);
+            void            clear           (void);
+
+        protected:
+            bool                        mbEnabled;
+            size_t                      mCapacity;
+            lx0::uint64                 mTrimmedStamp;      //!< Stamp of the newest entry discarded by trim()
+            std::deque<ChangeEntry>     mEntries;
+        };
+    }
+    using namespace lx0::engine_ns;
+}
@@ -0,0 +1,104 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+    * MIT License (http://www.opensource.org/licenses/mit-license.php)
+
+    Copyright (c) 2010-2012 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a
+    copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+
+#pragma once
+
+//===========================================================================//
+//   H E A D E R S
+//===========================================================================//
+
+// Standard headers
+#include <memory>
+#include <vector>
+#include <type_traits>
+#include <boost/thread.hpp>
+
+// Lx headers
+#include <lx0/engine/element.hpp>
+
+namespace lx0 { namespace engine_ns { namespace detail { 
+
+    //===========================================================================//
+    //! Slot-addressed storage for the Elements created by a Document
+    /*!
+        Elements are constructed in place in fixed-size chunks of slots rather
+        than each being a separate heap allocation.  Chunks are never moved or
+        released while the pool is alive, so Element addresses are stable and
+        Elements created together (e.g. while loading a Document) are adjacent 
+        in memory.  Released slots are reused most-recently-freed first.
+
+        Each slot records the generation of the Element currently occupying it.
+        Generations are drawn from a single process-wide counter, so an 
+        ElementHandle never matches a slot other than the one it was issued 
+        for - not even a slot in another Document's pool - and a handle to a 
+        destroyed Element reliably resolves to nullptr.
+
+        The ElementPtr returned by create() holds a reference to the pool, so
+        the pool outlives its Document if Elements are still referenced 
+        elsewhere.  Elements may be released on any thread.
+     */
+    class ElementPool : public std::enable_shared_from_this<ElementPool>
+    {
+    public:
+                        ElementPool     (void);
+                        ~ElementPool    (void);
+
+        ElementPtr      create          (void);
+        Element*        resolve         (ElementHandle handle) const;
+
+        size_t          size            (void) const;       //!< Number of live Elements
+        size_t          capacity        (void) const;       //!< Number of allocated slots
+
+    protected:
+        enum { kChunkSize = 256 };
+
+        typedef std::aligned_storage<sizeof(Element), std::alignment_of<Element>::value>::type Storage;
+
+        struct Deleter
+        {
+            std::shared_ptr<ElementPool> spPool;
+            lx0::uint32                  index;
+
+            void operator() (Element* pElem);
+        };
+
+        Element*        _slot           (lx0::uint32 index) const;
+        void            _invalidate     (lx0::uint32 index);
+        void            _release        (lx0::uint32 index);
+
+        mutable boost::mutex        mMutex;
+        std::vector<Storage*>       mChunks;
+        std::vector<lx0::uint32>    mGenerations;       // 0 if the slot is free
+        std::vector<lx0::uint32>    mFreeList;
+
+        static volatile boost::uint32_t s_generation;
+    };
+
+}}}
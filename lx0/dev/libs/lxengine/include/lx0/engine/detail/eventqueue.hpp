@@ -62,6 +62,7 @@ namespace lx0 { namespace engine_ns { namespace detail {
     public:
         int         run             (unsigned int realTime, unsigned int frameTime);
         void        enqueue         (int time, Event& evt);   
+        size_t      size            (void);
 
     protected:
         boost::mutex                        mMutex;
@@ -0,0 +1,93 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+    * MIT License (http://www.opensource.org/licenses/mit-license.php)
+
+    Copyright (c) 2010-2012 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a
+    copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+
+#pragma once
+
+//===========================================================================//
+//   H E A D E R S
+//===========================================================================//
+
+// Standard headers
+#include <string>
+#include <vector>
+#include <functional>
+
+// Lx headers
+#include <lx0/_detail/forward_decls.hpp>
+
+namespace lx0 { namespace engine_ns { namespace detail { 
+
+    //===========================================================================//
+    //! Loads a set of independent external resources in parallel
+    /*!
+        Used by the document loader: the resources a document references (XML
+        files, src= meshes, etc.) are discovered up front, added to a batch,
+        and then loaded concurrently.
+
+        Each resource has a load function, which is run on a worker thread and
+        must not touch the Document or the Engine, and an optional complete 
+        function, which is run on the calling thread once every load in the 
+        batch has finished.  The complete functions run in the order the 
+        resources were added, so the resulting DOM does not depend on the 
+        order in which the loads happened to finish.
+
+        The loads run on the Engine worker threads if the main loop is 
+        running; otherwise a temporary set of threads is used.  Progress and 
+        the latency of each resource are logged as the loads complete and 
+        are available via resources() after run().
+     */
+    class ResourceBatch
+    {
+    public:
+        struct Resource
+        {
+            std::string             name;
+            std::function<void()>   load;
+            std::function<void()>   complete;
+
+            bool                    bFailed;
+            std::string             error;
+            lx0::uint32             durationMs;     //!< Time spent loading the resource
+            lx0::uint32             latencyMs;      //!< Time from the start of the batch until the resource was loaded
+        };
+
+        void        add         (std::string name, std::function<void()> load, std::function<void()> complete = std::function<void()>());
+        void        run         (void);
+
+        size_t                          size        (void) const    { return mResources.size(); }
+        const std::vector<Resource>&    resources   (void) const    { return mResources; }
+
+    protected:
+        void        _load       (size_t index, lx0::uint32 startMs);
+
+        std::vector<Resource>   mResources;
+    };
+
+}}}
@@ -0,0 +1,130 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+    * MIT License (http://www.opensource.org/licenses/mit-license.php)
+
+    Copyright (c) 2010-2012 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a
+    copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+
+
+#pragma once
+
+//===========================================================================//
+//   H E A D E R S
+//===========================================================================//
+
+// Standard headers
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+
+// Lx headers
+#include <lx0/_detail/forward_decls.hpp>
+
+namespace lx0 { namespace engine_ns { namespace detail { 
+
+    //===========================================================================//
+    //! Streaming (event-based) XML reader used by the document loader
+    /*!
+        The reader does not build a DOM: the document is reported to a Handler
+        as a sequence of start element, text, comment, and end element events
+        as it is parsed, so the loader can create the lx0 Elements directly.
+
+        Only the subset of XML used by LxEngine documents is supported:
+        elements, attributes, text, CDATA sections, comments, and the 
+        predefined and numeric character references.  The XML declaration,
+        processing instructions, and DOCTYPE are skipped.  Text is condensed
+        the same way TinyXML does by default (leading and trailing whitespace
+        is removed and runs of whitespace become a single space); CDATA and
+        comments are reported as-is.
+
+        Tag and attribute names are interned: the Handler receives references
+        to strings owned by the reader, which remain valid for the lifetime 
+        of the reader.  A name is therefore allocated once per distinct name
+        rather than once per occurrence, and a single reader can be reused
+        for several files.
+
+        Format errors are reported by throwing an lx_error_exception that 
+        includes the filename and line.
+     */
+    class XmlReader
+    {
+    public:
+        struct Attribute
+        {
+            const std::string*  pName;
+            std::string         value;      //!< Value with character references decoded
+        };
+
+        class Handler
+        {
+        public:
+            virtual         ~Handler        (void) {}
+
+            virtual void    startElement    (const std::string& name, const std::vector<Attribute>& attributes, int line) {}
+            virtual void    endElement      (const std::string& name) {}
+            virtual void    text            (const std::string& text, int line) {}      //!< May be called multiple times per Element
+            virtual void    comment         (const std::string& text, int line) {}
+        };
+
+        void                parse           (const char* pBegin, const char* pEnd, Handler& handler, const std::string& filename);
+
+        const std::string&  intern          (const char* p, size_t length);
+        size_t              internedCount   (void) const    { return mNames.size(); }
+
+    protected:
+        void                _error          (const std::string& message);
+        bool                _startsWith     (const char* s) const;
+        void                _advance        (const char* p);
+        const char*         _find           (const char* s, const char* context);
+        void                _skipSpace      (void);
+        const std::string&  _readName       (void);
+        void                _readStartTag   (void);
+        void                _readEndTag     (void);
+        void                _readCharData   (void);
+        void                _readReference  (std::string& out);
+        void                _flushText      (void);
+
+        std::unordered_multimap<size_t, const std::string*> mNames;
+        std::deque<std::string>         mNameStorage;       // Deque so references to the names remain stable
+
+        // Per-parse state
+        const char*                     mp;
+        const char*                     mpEnd;
+        int                             mLine;
+        int                             mTextLine;
+        Handler*                        mpHandler;
+        const std::string*              mpFilename;
+        std::vector<const std::string*> mOpen;              // Stack of currently open elements
+        bool                            mbRootClosed;
+
+        // Buffers reused between events to avoid reallocation
+        std::vector<Attribute>          mAttributes;
+        std::string                     mText;
+        std::string                     mComment;
+    };
+
+}}}
@@ -41,6 +41,7 @@
 // Lx headers
 #include <lx0/_detail/forward_decls.hpp>
 #include <lx0/engine/dom_base.hpp>
+#include <lx0/engine/changejournal.hpp>
 #include <lx0/core/slot/slot.hpp>
 #include <lx0/core/lxvar/lxvar.hpp>
 
@@ -48,6 +49,7 @@ namespace lx0
 { 
     namespace engine_ns
     { 
+    namespace detail { class ElementPool; }
 
     //===========================================================================//
     //!
@@ -101,6 +103,12 @@ namespace lx0
                                 ~Document();
 
         TransactionPtr          transaction     (void);
+        DocumentSnapshotPtr     snapshot        (void);
+        DocumentSnapshotPtr     snapshot        (ElementPtr spSubtree);
+        lx0::uint32             version         (void) const        { return mVersion; }
+
+        ChangeJournal&          changeJournal   (void)              { return mJournal; }
+        const ChangeJournal&    changeJournal   (void) const        { return mJournal; }
 
         ViewPtr                 createView      (std::string type, std::string name);
         ViewPtr                 createView      (std::string type, std::string name, lx0::ViewComponent* pRenderer);
@@ -115,6 +123,7 @@ namespace lx0
 
         ElementPtr              createElement           (void)                  { return createElement(""); }
         ElementPtr              createElement           (std::string type);
+        Element*                resolve                 (ElementHandle handle) const;
         ElementPtr              getElementById          (std::string id);
         std::vector<ElementPtr> getElementsByTagName    (std::string name);
         std::vector<ElementPtr> getElements             (void);
@@ -143,6 +152,13 @@ namespace lx0
         slot<void(KeyEvent&)>   slotKeyDown;            // Key down on any of the Document's views
 
         bool                    _containsElement    (ElementPtr spElementPtr);
+        void                    _notifyElementsAdded (const std::vector<ElementPtr>& elements);
+        void                    _incrementVersion   (void)          { mVersion++; }
+        void                    _recordChange       (Element* pElem, ChangeEntry::Field field, lx0::uint64 stamp, const char* name = nullptr)
+        {
+            if (mJournal.enabled())
+                mJournal.record(pElem, field, stamp, mVersion, name);
+        }
 
     protected:
         typedef std::map<std::string, std::shared_ptr<Component>> ComponentList;
@@ -150,8 +166,11 @@ namespace lx0
 
         bool                        _walkElements       (std::function<bool (ElementPtr)> f);
 
+        std::shared_ptr<detail::ElementPool> mspElementPool;
         lx0::uint32                     m_documentId;
-        TrWList                         m_openTransactions;     //!< Not currently implemented
+        lx0::uint32                     mVersion;
+        ChangeJournal                   mJournal;
+        TrWList                         m_openTransactions;
         ElementPtr                      m_spRoot;
         std::map<std::string, ViewPtr>  mViews;
         std::vector<lx0::ControllerPtr> mControllers;
@@ -37,18 +37,50 @@
 #include <map>
 #include <deque>
 #include <memory>
+#include <functional>
 #include <string>
 #include <set>
+#include <vector>
 
 // Lx headers
 #include <lx0/_detail/forward_decls.hpp>
 #include <lx0/engine/dom_base.hpp>
+#include <lx0/engine/changejournal.hpp>
 #include <lx0/core/lxvar/lxvar.hpp>
+#include <lx0/core/memory/memory.hpp>
 #include <lx0/core/slot/slot.hpp>
 
 
 namespace lx0 { namespace engine_ns { 
 
+    namespace detail { class ElementPool; }
+
+    //===========================================================================//
+    //! Weak, non-owning reference to an Element that does not touch a reference count
+    /*!
+        \ingroup lx0_engine_dom
+
+        A handle is the slot index of the Element in its Document's ElementPool
+        and the generation of the Element that occupied that slot when the 
+        handle was issued.  Resolve a handle via Document::resolve(); a handle
+        to an Element that has since been destroyed resolves to nullptr.
+
+        Elements not created by a Document (e.g. via new Element) have a null
+        handle.
+     */
+    class ElementHandle
+    {
+    public:
+        ElementHandle() : index (0), generation (0) {}
+
+        bool            valid       (void) const                    { return generation != 0; }
+        bool            operator==  (const ElementHandle& h) const  { return index == h.index && generation == h.generation; }
+        bool            operator!=  (const ElementHandle& h) const  { return !(*this == h); }
+
+        lx0::uint32     index;
+        lx0::uint32     generation;
+    };
+
 
     //===========================================================================//
     //! Interface for attaching objects to the Element to respond to events.
@@ -74,7 +106,7 @@ namespace lx0 { namespace engine_ns {
         virtual void        onValueChange       (ElementPtr spElem) {}
         virtual void        onAdded             (void) {}
         virtual void        onRemoved           (void) {}
-        virtual void        onUpdate            (ElementPtr spElem) { }
+        virtual void        onUpdate            (Element* pElem) { }
     };
 
     //===========================================================================//
@@ -108,11 +140,12 @@ namespace lx0 { namespace engine_ns {
         virtual         ~Element        (void);
 
         std::string     tagName         (void) const            { return mTagName; }    //!< Get DOM tagName of the Element
-        void            tagName         (const char* s)         { mTagName = s; }       //!< Set DOM tagName of the Element
+        void            tagName         (const char* s)         { mTagName = s; _touchData(ChangeEntry::eTagName); } //!< Set DOM tagName of the Element
         void            tagName         (const std::string& s)  { tagName(s.c_str()); } //!< Set DOM tagName of the Element
 
         lxvar           attr            (std::string name) const;
         void            attr            (std::string name, lxvar value);
+        void            removeAttr      (std::string name);
         lxvar           getAttribute    (std::string name) const    { return attr(name); }
 
         ElementCPtr     parent          (void) const;
@@ -123,9 +156,10 @@ namespace lx0 { namespace engine_ns {
         void            removeChild     (ElementPtr spElem);
         void            removeAll       (void);
 
-        lxvar&          value               (void) const    { return mValue; }
-        lxvar&          value               (void)          { return mValue; }
+        lxvar&          value               (void) const    { _resolveValue(); return mValue; }
+        lxvar&          value               (void)          { _resolveValue(); return mValue; }
         void            value               (lxvar v);
+        void            deferValue          (std::function<lxvar ()> f);
         void            notifyValueChanged  (void);
         void            notifyValueChanged  (const char* path);
 
@@ -133,8 +167,8 @@ namespace lx0 { namespace engine_ns {
         void            prepend         (ElementPtr spElem);
         void            append          (ElementPtr spElem);
 
-        ElementPtr      _clone          (void) const;
         ElementPtr      cloneDeep       (void) const;
+        ElementPtr      cloneDeep       (Document* pDocument) const;
 
         void            notifyAdded     (Document* pDocument);
         void            notifyRemoved   (Document* pDocument);
@@ -159,15 +193,34 @@ namespace lx0 { namespace engine_ns {
 
         void            recomputeFlags  (void);
 
+        ElementHandle   handle          (void) const    { return mHandle; }
+
+        lx0::uint64     dataVersion     (void) const    { return mDataVersion; }    //!< Change stamp of the last modification to the Element's own data
+        lx0::uint64     treeVersion     (void) const    { return mTreeVersion; }    //!< Change stamp of the last modification to the Element or any descendant
+
+        static lx0::uint64 changeStamp  (void)          { return s_changeStamp; }   //!< Most recent change stamp issued
+
     protected:
+        friend class Document;
+        friend class Transaction;
+        friend class detail::ElementPool;
+
         typedef std::map<std::string,Function>  FunctionMap;
         typedef std::map<std::string,lx0::slot<void (ElementPtr, std::vector<lxvar>&)>> CallbackMap;
-        typedef std::map<std::string, lxvar>    AttrMap;
-        typedef std::deque<ElementPtr>          ElemList;
+        typedef std::map<std::string, lxvar, std::less<std::string>, TaggedAllocator<std::pair<const std::string, lxvar>, eMemoryDom>> AttrMap;
+        typedef std::deque<ElementPtr, TaggedAllocator<ElementPtr, eMemoryDom>>                                                ElemList;
 
         static          FunctionMap             s_funcMap;
+        static          lx0::uint64             s_changeStamp;
 
         void            _setHostDocument    (Document* pDocument);
+        void            _touchData          (ChangeEntry::Field field, const char* name = nullptr);
+        void            _touchTree          (void);
+        void            _stampTree          (lx0::uint64 stamp);
+        void            _collectTree        (std::vector<ElementPtr>& elements);
+        ElementSnapshotCPtr _snapshot       (void) const;
+        void            _resolveValue       (void) const    { if (mDeferredValue) _resolveDeferred(); }
+        void            _resolveDeferred    (void) const;
 
         enum Flags
         {
@@ -178,10 +231,18 @@ namespace lx0 { namespace engine_ns {
         lx0::uint32     mFlags;
         std::string     mTagName;
         AttrMap         mAttributes;
-        ElementPtr      mspParent;
+        Element*        mpParent;       // Non-owning; cleared when removed from the parent or the parent is destroyed
         ElemList        mChildren;
         mutable lxvar   mValue; 
+        mutable std::function<lxvar ()> mDeferredValue; // Computes mValue on first access (see deferValue())
         CallbackMap     mCallbackMap;
+
+        ElementHandle           mHandle;
+        detail::ElementPool*    mpPool;     // Non-owning; the pool is kept alive by the ElementPtr deleter
+
+        lx0::uint64                 mDataVersion;
+        lx0::uint64                 mTreeVersion;
+        mutable ElementSnapshotCPtr mspSnapshot;    // Last snapshot node built; shared if unchanged
     };
 
 }
@@ -38,6 +38,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
 
 #include <boost/thread.hpp>
 
@@ -45,7 +46,9 @@
 #include <lx0/_detail/forward_decls.hpp>
 #include <lx0/core/init/version.hpp>
 #include <lx0/engine/dom_base.hpp>
+#include <lx0/util/misc/perfcounters.hpp>
 #include <lx0/engine/profilemonitor.hpp>
+#include <lx0/engine/metrics.hpp>
 #include <lx0/engine/detail/eventqueue.hpp>
 #include <lx0/core/lxvar/lxvar.hpp>
 #include <lx0/core/log/log.hpp>
@@ -76,6 +79,8 @@ namespace lx0
                 //===========================================================================//
                 //!
                 /*!
+                    The counts are updated atomically, so objects may be created
+                    and destroyed on any thread.
                  */
                 class ObjectCount
                 {
@@ -84,14 +89,19 @@ namespace lx0
                             ObjectCount (size_t current);
 
                     void    inc      (void);
-                    void    dec      (void);
+                    bool    dec      (void);
             
                     size_t  current  (void) const { return mCurrent; }
                     size_t  total    (void) const { return mTotal; }
 
+                    static int                  registerType    (const char* name);
+                    static int                  typeCount       (void);
+                    static const char*          typeName        (int id);
+                    static ObjectCount&         type            (int id);
+
                 protected:
-                    size_t mCurrent;
-                    size_t mTotal;
+                    volatile boost::uint32_t mCurrent;
+                    volatile boost::uint32_t mTotal;
                 };
 
                 //===========================================================================//
@@ -118,6 +128,7 @@ namespace lx0
                             ~WorkerThread();
 
                     void    addTask (std::function<void()>);
+                    size_t  queueLength (void);
                     
 
                 protected:
@@ -134,6 +145,40 @@ namespace lx0
                 struct Profile;
             }
 
+            //===========================================================================//
+            //! Statically registered ObjectCount for one type of object
+            /*!
+                \ingroup lx0_engine_dom
+
+                Declare one tracker per type at namespace scope and call inc()
+                and dec() from the constructor and destructor:
+
+                <pre>
+                static lx0::ObjectTracker s_documentCount("Document");
+                </pre>
+
+                The name is resolved to an id once, during static initialization,
+                and the counts are process-wide, so tracking an object costs
+                two atomic increments and does not need the Engine.  Leaks are 
+                reported by the Engine destructor, relative to the counts when 
+                that Engine was created.
+             */
+            class ObjectTracker
+            {
+            public:
+                                            ObjectTracker   (const char* name);
+
+                void                        inc             (void)          { mpCount->inc(); }
+                bool                        dec             (void)          { return mpCount->dec(); }
+
+                int                         id              (void) const    { return mId; }
+                const detail::ObjectCount&  count           (void) const    { return *mpCount; }
+
+            protected:
+                int                         mId;
+                detail::ObjectCount*        mpCount;
+            };
+
             //===========================================================================//
 
             typedef std::shared_ptr<std::function<int()>>   EventHandle;
@@ -191,6 +236,7 @@ namespace lx0
 
                 DocumentPtr         createDocument      (void);
                 DocumentPtr         loadDocument        (std::string filename);
+                std::vector<DocumentPtr> loadDocuments  (const std::vector<std::string>& filenames);
                 void                closeDocument       (DocumentPtr& spDocument);
                 const std::vector<DocumentPtr>& documents (void) { return mDocuments; }
 
@@ -201,6 +247,7 @@ namespace lx0
                 void                sendTask            (std::function<void()> f);
                 void                sendTask            (unsigned int delay, std::function<void()> f);
                 void                sendWorkerTask      (std::function<void()> f);
+                bool                hasWorkerThreads    (void) const                { return !mWorkerThreads.empty(); }
 
                 int	                run                 (void);
 
@@ -240,9 +287,12 @@ namespace lx0
                 ///@{
                 void                incObjectCount          (std::string name);
                 void                decObjectCount          (std::string name);
-                const detail::ObjectCount& objectCount      (std::string name) { return mObjectCounts[name]; }
+                const detail::ObjectCount& objectCount      (std::string name);
                 void                registerProfileCounter  (const char* name, int* pId);
                 void                addProfileRelationship  (const char* parentName, const char* childName);
+                ProfileMonitor&     profileMonitor          (void)                  { return mProfileMonitor; }
+                MetricsRegistry&    metrics                 (void)                  { return mMetrics; }
+                const MetricsSnapshot& metricsSnapshot      (void) const            { return mMetricsSnapshot; }
                 ///@}
 
 
@@ -259,10 +309,12 @@ namespace lx0
 
                 void                        _registerBuiltInPlugins     (void);
 
-                DocumentPtr                 _loadDocument               (bool bCreate, std::string filename);
-                ElementPtr                  _loadDocumentRoot           (DocumentPtr spDocument, std::string filename);
+                DocumentPtr                 _createDocument             (void);
+                void                        _loadDocumentRoots          (const std::vector<DocumentPtr>& documents, const std::vector<std::string>& filenames, std::vector<ElementPtr>& roots);
         
                 void                        _handlePlatformMessages     (bool& bDone, bool& bIdle);
+                void                        _resolveMetrics             (void);
+                void                        _updateMetrics              (lx0::int64 frameTicks);
 
                 lxvar                               mSystemInfo;
                 lxvar                               mGlobals;
@@ -299,7 +351,32 @@ namespace lx0
                 
                 ProfileMonitor                              mProfileMonitor;                
                 struct detail::Profile*                     mpProfile;
-                std::map<std::string, detail::ObjectCount>  mObjectCounts;
+
+                MetricsRegistry                             mMetrics;
+                MetricsSnapshot                             mMetricsSnapshot;
+                MetricsExporter*                            mpMetricsExporter;
+
+                // The Engine's own metrics, resolved by _resolveMetrics() rather than by name each frame
+                struct ObjectMetrics
+                {
+                    MetricGauge*    pCurrent;
+                    MetricGauge*    pTotal;
+                };
+                struct MemoryMetrics
+                {
+                    MetricGauge*    pLive;
+                    MetricGauge*    pPeak;
+                    MetricGauge*    pAllocs;
+                    lx0::uint64     allocations;    // Allocation count at the prior frame
+                };
+                MetricHistogram*                            mpFrameTimeMetric;
+                MetricGauge*                                mpFrameMetric;
+                MetricGauge*                                mpEventQueueMetric;
+                std::vector<MetricGauge*>                   mWorkerQueueMetrics;
+                std::vector<ObjectMetrics>                  mObjectMetrics;         // Indexed by ObjectCount type id
+                std::vector<MemoryMetrics>                  mMemoryMetrics;         // Indexed by MemoryTag
+
+                std::vector<std::pair<size_t, size_t>>      mObjectCountsAtStart;   // Current and total per ObjectCount type when the Engine was created
             };
         
     }
@@ -36,6 +36,7 @@
 namespace lx0 { namespace engine_ns {
 
     lx0::engine_ns::Mesh*     load_blend (std::string name);
+    lx0::engine_ns::Mesh*     load_blend (std::string name, const std::string& cacheDirectory);
     lx0::engine_ns::Mesh*     load_lxson (lx0::lxvar& v);
 
     //===========================================================================//
@@ -0,0 +1,236 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+    * MIT License (http://www.opensource.org/licenses/mit-license.php)
+
+    Copyright (c) 2010-2012 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a
+    copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+
+#pragma once
+
+//===========================================================================//
+//   H E A D E R S
+//===========================================================================//
+
+// Standard headers
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <fstream>
+
+#include <boost/thread.hpp>
+#include <boost/cstdint.hpp>
+
+// Lx headers
+#include <lx0/_detail/forward_decls.hpp>
+
+namespace lx0
+{
+    namespace engine_ns
+    {
+        //===========================================================================//
+        //! Monotonically increasing count of events (e.g. tasks executed)
+        /*!
+            \ingroup lx0_engine_dom
+
+            Safe to increment from any thread.  The count wraps at 2^32.
+         */
+        class MetricCounter
+        {
+        public:
+                            MetricCounter   (void) : mValue (0) {}
+
+            void            inc             (void);
+            void            add             (lx0::uint32 n);
+            lx0::uint32     value           (void) const    { return mValue; }
+
+        protected:
+            volatile boost::uint32_t  mValue;
+        };
+
+        //===========================================================================//
+        //! Instantaneous value (e.g. the current length of a queue)
+        /*!
+            \ingroup lx0_engine_dom
+         */
+        class MetricGauge
+        {
+        public:
+                            MetricGauge     (void) : mValue (0) {}
+
+            void            set             (int value);
+            int             value           (void) const    { return int(mValue); }
+
+        protected:
+            volatile boost::uint32_t  mValue;
+        };
+
+        //===========================================================================//
+        //! Distribution of recorded values (e.g. frame times in microseconds)
+        /*!
+            \ingroup lx0_engine_dom
+
+            Values are counted in log-linear buckets in the manner of an HDR
+            histogram: values below 64 are counted exactly and larger values
+            fall into one of 32 buckets per power of two, so every statistic
+            is accurate to roughly 3% over the full 64-bit range.  Recording
+            is a single atomic increment and is safe from any thread; the 
+            statistics are computed only when the histogram is read.
+         */
+        class MetricHistogram
+        {
+        public:
+            enum
+            {
+                kSubBucketBits  = 6,
+                kLinearBuckets  = 1 << kSubBucketBits,
+                kHalfBuckets    = kLinearBuckets / 2,
+                kBucketCount    = kLinearBuckets + (64 - kSubBucketBits) * kHalfBuckets,
+            };
+
+            struct Summary
+            {
+                Summary() { ::memset(this, 0, sizeof(*this)); }
+
+                lx0::uint64     count;
+                lx0::uint64     min;
+                lx0::uint64     max;
+                double          mean;
+                lx0::uint64     p50;
+                lx0::uint64     p90;
+                lx0::uint64     p99;
+            };
+
+                            MetricHistogram (void);
+
+            void            record          (lx0::uint64 value);
+            void            summarize       (Summary& summary) const;
+            void            reset           (void);
+
+            static int          bucketIndex     (lx0::uint64 value);
+            static lx0::uint64  bucketLowest    (int index);
+            static lx0::uint64  bucketHighest   (int index);
+
+        protected:
+            volatile boost::uint32_t  mCounts[kBucketCount];
+        };
+
+        //===========================================================================//
+        //! Copy of the values of every metric in a MetricsRegistry at one point in time
+        /*!
+            \ingroup lx0_engine_dom
+         */
+        class MetricsSnapshot
+        {
+        public:
+            struct Entry
+            {
+                std::string                 name;
+                char                        type;           //!< 'c' counter, 'g' gauge, or 'h' histogram
+                lx0::int64                  value;          //!< Value of a counter or gauge
+                MetricHistogram::Summary    histogram;
+            };
+
+                                MetricsSnapshot (void) : frame (0), timestampUs (0) {}
+
+            const Entry*        find            (const std::string& name) const;
+
+            lx0::uint32         frame;
+            lx0::uint64         timestampUs;    //!< Microseconds since the Unix epoch
+            std::vector<Entry>  entries;        //!< Sorted by name
+        };
+
+        //===========================================================================//
+        //! Named set of live counters, gauges, and histograms
+        /*!
+            \ingroup lx0_engine_dom
+
+            Metrics are created on first use and live as long as the registry, 
+            so a subsystem should look up its metric once and keep the reference
+            rather than looking it up by name on every update.
+
+            The Engine owns a registry (Engine::metrics()), fills in its own
+            metrics (frame times, queue lengths, object counts), and takes a 
+            snapshot once per frame.  If the "metrics_export" global is set, each
+            snapshot is also written out by a MetricsExporter.
+         */
+        class MetricsRegistry
+        {
+        public:
+            MetricCounter&      counter         (const char* name);
+            MetricGauge&        gauge           (const char* name);
+            MetricHistogram&    histogram       (const char* name);
+
+            void                snapshot        (lx0::uint32 frame, MetricsSnapshot& snapshot) const;
+
+        protected:
+            mutable boost::mutex                                        mMutex;
+            std::map<std::string, std::shared_ptr<MetricCounter>>      mCounters;
+            std::map<std::string, std::shared_ptr<MetricGauge>>        mGauges;
+            std::map<std::string, std::shared_ptr<MetricHistogram>>    mHistograms;
+        };
+
+        //===========================================================================//
+        //! Writes MetricsSnapshots in a line protocol for external dashboards
+        /*!
+            \ingroup lx0_engine_dom
+
+            Each metric is written as one line in the InfluxDB line protocol,
+            for example:
+
+            <pre>
+            lxengine,metric=engine.event_queue value=3i 1325376000000000000
+            lxengine,metric=engine.frame_time_us count=60i,min=16384i,...,p99=17408i 1325376000000000000
+            </pre>
+
+            The target is either a filename, to which the lines are appended, 
+            or "udp://host:port", in which case each snapshot is sent as a 
+            datagram (e.g. to a local Telegraf or InfluxDB UDP listener).
+         */
+        class MetricsExporter
+        {
+        public:
+                        MetricsExporter     (void);
+                        ~MetricsExporter    (void);
+
+            void        open                (const std::string& target);
+            void        close               (void);
+            bool        isOpen              (void) const;
+
+            void        write               (const MetricsSnapshot& snapshot);
+
+            static std::string format       (const MetricsSnapshot& snapshot);
+
+        protected:
+            struct Socket;
+
+            std::ofstream   mFile;
+            Socket*         mpSocket;
+        };
+    }
+    using namespace lx0::engine_ns;
+}
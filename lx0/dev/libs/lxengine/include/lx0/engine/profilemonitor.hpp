@@ -52,6 +52,119 @@ namespace lx0
                 lx0::int64      inclusiveStart;
                 lx0::int64      exclusiveStart;
                 ProfileCounter* pPrevious;
+                int             id;
+
+                bool                        bEvents;        //!< Hardware counters were read on the outermost enter
+                lx0::PerfCounters::Values   eventsStart;
+                lx0::PerfCounters::Values   events;         //!< Inclusive hardware event counts
+
+                volatile lx0::uint32 sequence;      //!< Odd while calls/inclusive/exclusive are being modified
+            };
+
+            //===========================================================================//
+            //! Consistent copy of a ProfileCounter's totals
+            /*!
+                Returned by ProfileMonitor::sample(), which may be called from
+                any thread while the counters are live.
+             */
+            class ProfileSample
+            {
+            public:
+                ProfileSample() : calls (0), inclusive (0), exclusive (0) { ::memset(&events, 0, sizeof(events)); }
+
+                lx0::uint32                 calls;
+                lx0::int64                  inclusive;
+                lx0::int64                  exclusive;
+                lx0::PerfCounters::Values   events;     //!< Zero unless hardware counters are enabled
+            };
+
+            //===========================================================================//
+            //! A single timestamped enter or leave of a ProfileSection
+            /*!
+             */
+            class TraceEvent
+            {
+            public:
+                lx0::int64      ticks;
+                int             id;
+                char            phase;          //!< 'B' on enter, 'E' on leave (as in the Chrome trace format)
+            };
+
+            //===========================================================================//
+            //! Per-thread ring buffer of TraceEvents
+            /*!
+                events and count are written only by the owning thread.  Once 
+                full, the oldest events are overwritten.  Events before start 
+                are discarded: ProfileMonitor::enableTrace() moves start rather
+                than resetting count, which another thread may be writing.
+             */
+            class TraceBuffer
+            {
+            public:
+                std::vector<TraceEvent> events;
+                volatile lx0::uint64    count;          //!< Total number of events ever written
+                volatile lx0::uint64    start;          //!< Index of the first event of the current trace
+            };
+
+            //===========================================================================//
+            //! A counter's time within a single frame, at a single position in the call tree
+            /*!
+             */
+            class FrameNode
+            {
+            public:
+                int             id;             //!< Counter id; 0 for the root node spanning the whole frame
+                int             parent;         //!< Index of the parent node; -1 for the root
+                int             firstChild;
+                int             lastChild;
+                int             nextSibling;
+                lx0::uint32     calls;
+                lx0::int64      inclusive;
+                lx0::int64      start;          //!< Ticks at the most recent enter
+            };
+
+            //===========================================================================//
+            //! Profile tree of the frame thread for a single frame
+            /*!
+                Nesting is recorded as it happens, so the tree reflects which 
+                sections were actually entered within which others - no calls
+                to addRelation() are needed.
+             */
+            class FrameProfile
+            {
+            public:
+                lx0::uint32             frame;
+                lx0::int64              startTicks;
+                lx0::int64              duration;   //!< In ticks
+                std::vector<FrameNode>  nodes;      //!< nodes[0] is the root
+            };
+
+            //===========================================================================//
+            //! The counter table of a single thread
+            /*!
+                The table is split into fixed-size chunks that are allocated by 
+                the owning thread the first time it enters a counter in that 
+                chunk.  Chunks are never moved or freed while the monitor is 
+                alive, so other threads can read them without locking.
+             */
+            class ProfileThread
+            {
+            public:
+                enum 
+                { 
+                    kChunkSize  = 256,
+                    kMaxChunks  = 256,
+                    kMaxCounters = kChunkSize * kMaxChunks,
+                };
+
+                ProfileThread (lx0::uint32 id);
+                ~ProfileThread ();
+
+                lx0::uint32                 threadId;
+                ProfileCounter* volatile    chunks[kMaxChunks];
+                TraceBuffer*                pTrace;
+                lx0::PerfCounters*          pPerf;      //!< Created on the owning thread when hardware counters are first used
+                ProfileThread*              pNext;
             };
 
             //===========================================================================//
@@ -62,6 +175,7 @@ namespace lx0
             {
             public:
                 ProfileMonitor();
+                ~ProfileMonitor();
 
                 void            registerCounter     (const char* name, int* id);
                 void            addRelation         (const char* parentName, const char* childName);
@@ -71,16 +185,76 @@ namespace lx0
 
                 void            logCounters         (void);
 
+                ///@name Live reading
+                ///@{
+                ProfileSample   sample              (int counterId) const;
+                void            sample              (int counterId, std::vector<std::pair<lx0::uint32, ProfileSample>>& perThread) const;
+                ///@}
+
+                void            nameThread          (const char* name);
+
+                ///@name Event tracing
+                ///@{
+                bool            traceEnabled        (void) const    { return mbTrace; }
+                void            enableTrace         (bool bEnable);
+                void            traceCapacity       (size_t events) { mTraceCapacity = events; }
+                void            writeTrace          (const char* filename);
+                ///@}
+
+                ///@name Hardware counters
+                ///@{
+                bool            hardwareEnabled     (void) const    { return mbHardware; }
+                void            enableHardware      (bool bEnable);
+                ///@}
+
+                ///@name Per-frame capture
+                ///@{
+                void                enableFrames    (size_t window, double hitchMs);
+                void                beginFrame      (lx0::uint32 frame);
+                void                endFrame        (void);
+                size_t              frameCount      (void) const;
+                const FrameProfile& frame           (size_t i) const;
+                const std::deque<FrameProfile>& hitches (void) const    { return mHitches; }
+                std::string         formatFrame     (const FrameProfile& frame) const;
+                ///@}
+
             protected:
-                typedef std::map<lx0::uint32, ProfileCounter*> ThreadMap;
+                ProfileThread*  _acquireThread      (void);
+                ProfileCounter* _allocateChunk      (ProfileThread* pThread, int chunk);
+                bool            _read               (const ProfileThread* pThread, int counterId, ProfileSample& sample) const;
+
+                void            _traceEvent         (int id, char phase, lx0::int64 ticks);
+                void            _readHardware       (ProfileThread* pThread, lx0::PerfCounters::Values& values);
+
+                void            _frameEnter         (int id, lx0::int64 ticks);
+                void            _frameLeave         (int id, lx0::int64 ticks);
+                void            _closeFrame         (lx0::int64 ticks);
 
                 boost::mutex                mMutex;
-                ThreadMap                   mThreadMap;  
+                lx0::uint32                 mSerial;            // Distinguishes this monitor from any prior one in the thread-local state
+                lx0::int64                  mStartTicks;        // Used to compute the allocation rates in logCounters()
+                ProfileThread* volatile     mpThreads;          // Lock-free, prepend-only list of all thread tables
                 std::vector<std::string>    mNameMap;
                 std::map<std::string,int>   mNameMap2;
                 int                         mSize;
 
                 std::vector<std::pair<std::string,std::string>> mRelations;
+
+                volatile bool                       mbTrace;
+                size_t                              mTraceCapacity;
+                volatile bool                       mbHardware;
+                std::map<lx0::uint32, std::string>  mThreadNames;
+
+                enum { kMaxHitches = 16 };
+
+                ProfileThread*                      mpFrameThread;      // Table of the thread calling beginFrame(); only its sections are captured
+                std::vector<FrameProfile>           mFrames;            // Ring of the last N frames plus the frame being recorded
+                size_t                              mFrameCount;        // Number of completed frames
+                FrameProfile*                       mpCurrentFrame;
+                int                                 mFrameNode;         // Index of the innermost open node in the current frame
+                lx0::int64                          mHitchTicks;
+                std::deque<FrameProfile>            mHitches;
+                std::set<std::pair<int,int>>        mNesting;           // (parent, child) counter ids observed in captured frames
             };
 
             //===========================================================================//
@@ -0,0 +1,132 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+    * MIT License (http://www.opensource.org/licenses/mit-license.php)
+
+    Copyright (c) 2010-2012 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a
+    copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+#pragma once
+
+//===========================================================================//
+//   H E A D E R S
+//===========================================================================//
+
+// Standard headers
+#include <memory>
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+
+// Lx headers
+#include <lx0/_detail/forward_decls.hpp>
+#include <lx0/core/lxvar/lxvar.hpp>
+
+namespace lx0
+{
+    namespace engine_ns
+    {
+        //===========================================================================//
+        //! Immutable, read-only copy of an Element and its sub-tree
+        /*!
+            \ingroup lx0_engine_dom
+
+            An ElementSnapshot is produced by Document::snapshot() and is never
+            modified after creation.  It is therefore safe to read from any thread
+            while the main thread continues to modify the live Document.
+
+            Snapshots are copy-on-write: an Element caches the last snapshot node
+            built for it and, if neither the Element nor any of its descendants has
+            changed since, the cached node is shared by the new snapshot.  Likewise,
+            the attribute and value data of a node is shared between snapshots
+            until the Element's own data is modified.  Taking a snapshot of a
+            mostly static Document is therefore cheap.
+
+            Only modifications made through the Element API (attr(), value(),
+            notifyValueChanged(), append(), etc.) or a Transaction are tracked.
+            Modifying the value in-place via the lxvar& returned by Element::value()
+            without calling notifyValueChanged() will not be seen by later snapshots.
+
+            @remark The lxvar reference count is not thread-safe.  Readers on other
+            threads should access attributes and values by const reference rather
+            than copying the lxvar.
+         */
+        class ElementSnapshot
+        {
+        public:
+            const std::string&  tagName     (void) const    { return mspData->tagName; }
+            const lxvar*        attr        (const std::string& name) const;
+            const lxvar&        value       (void) const    { return mspData->value; }
+
+            int                 childCount  (void) const    { return int(mChildren.size()); }
+            ElementSnapshotCPtr child       (int i) const   { return mChildren[i]; }
+
+            lx0::uint64         dataVersion (void) const    { return mspData->version; }
+            lx0::uint64         treeVersion (void) const    { return mTreeVersion; }
+
+            bool                walk        (std::function<bool (const ElementSnapshot&)> f) const;
+
+        protected:
+            friend class Element;
+
+            struct Data
+            {
+                lx0::uint64                     version;
+                std::string                     tagName;
+                std::map<std::string, lxvar>    attributes;
+                lxvar                           value;
+            };
+            typedef std::shared_ptr<const Data> DataCPtr;
+
+            DataCPtr                            mspData;
+            std::vector<ElementSnapshotCPtr>    mChildren;
+            lx0::uint64                         mTreeVersion;
+        };
+
+        //===========================================================================//
+        //! Immutable, read-only copy of a Document (or a sub-tree of a Document)
+        /*!
+            \ingroup lx0_engine_dom
+
+            Create on the main thread via Document::snapshot() and then hand off
+            to a worker thread (e.g. via Engine::sendWorkerTask()).
+         */
+        class DocumentSnapshot
+        {
+        public:
+                                DocumentSnapshot (lx0::uint32 version, ElementSnapshotCPtr spRoot);
+
+            lx0::uint32         version         (void) const    { return mVersion; }
+            ElementSnapshotCPtr root            (void) const    { return mspRoot; }
+
+            bool                walk            (std::function<bool (const ElementSnapshot&)> f) const { return mspRoot->walk(f); }
+
+        protected:
+            lx0::uint32         mVersion;
+            ElementSnapshotCPtr mspRoot;
+        };
+    }
+    using namespace lx0::engine_ns;
+}
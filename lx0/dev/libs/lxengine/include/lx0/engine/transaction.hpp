@@ -40,9 +40,28 @@ namespace lx0
 { 
     namespace engine_ns
     { 
+        //===========================================================================//
+        //! A batch of Document modifications that is applied atomically on submit()
+        /*!
+            \ingroup lx0_engine_dom
+
+            write() returns a detached, writable copy of an Element's data (tag name, 
+            attributes, and value).  The copy may be freely modified; the changes
+            are copied back into the Document Element only when submit() is called.
+
+            Validation is optimistic: if an Element opened for write has been 
+            modified by any other means between write() and submit(), the submit
+            fails and no operations are applied.
+
+            Create via Document::transaction().  Transactions must be used on the
+            thread that owns the Document; use Document::snapshot() to read the
+            Document from other threads.
+         */
         class Transaction
         {
         public:
+                        Transaction (Document* pDocument);
+
             void        add     (ElementPtr spParent, ElementPtr spChild);
             ElementPtr  write   (ElementCPtr spElement);
 
@@ -52,6 +71,7 @@ namespace lx0
         protected:
             typedef std::vector<std::function<bool()>>  Operations;
 
+            Document*  m_pDocument;
             Operations m_validations;
             Operations m_operations;
         };
@@ -58,10 +58,12 @@
 #include <lx0/core/init/version.hpp>
 #include <lx0/core/init/init.hpp>
 #include <lx0/core/log/log.hpp>
+#include <lx0/core/memory/memory.hpp>
 #include <lx0/core/slot/slot.hpp>
 #include <lx0/core/lxvar/lxvar.hpp>
 
 #include <lx0/util/misc/util.hpp>
+#include <lx0/util/misc/perfcounters.hpp>
 
 #include <lx0/engine/engine.hpp>
 #include <lx0/engine/document.hpp>
@@ -69,6 +71,7 @@
 #include <lx0/engine/view.hpp>
 #include <lx0/engine/controller.hpp>
 #include <lx0/engine/transaction.hpp>
+#include <lx0/engine/snapshot.hpp>
 
 #include <lx0/elements/core.hpp>
 
@@ -28,8 +28,11 @@
 
 #pragma once
 
-#include <iostream>
-#include <fstream>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
 
 namespace lx0 
 { 
@@ -42,6 +45,7 @@ namespace lx0
         namespace blendreader_ns 
         {
             struct Structure;
+            struct MappedFile;
 
             //=======================================================================//
             //! Information from the .blend header section
@@ -69,7 +73,7 @@ namespace lx0
                 unsigned __int32 sdnaIndex;
                 unsigned __int32 count;
     
-                int                        filePos;
+                size_t                     filePos;     //!< Offset of the block data within the file
                 std::shared_ptr<Structure> spStruct;
             };
 
@@ -101,6 +105,44 @@ namespace lx0
 
             typedef std::shared_ptr<Structure> StructurePtr;
 
+            void swap_bytes (void* p, size_t size);
+
+            //=======================================================================//
+            //! Pre-resolved location of a field within a Structure
+            /*!
+                \ingroup lx0_subsystem_blendreader
+
+                Acquire via BlendReader::Object::accessor() once per Structure, then 
+                apply to each element of a block.  This avoids the field name lookup
+                of BlendReader::Object::field() in per-element loops.
+             */
+            template <typename T>
+            class FieldAccessor
+            {
+            public:
+                FieldAccessor (void) 
+                    : mOffset (0), mDim (0), mbSwap (false) {}
+                FieldAccessor (size_t offset, size_t dim, bool bSwap) 
+                    : mOffset (offset), mDim (dim), mbSwap (bSwap) {}
+
+                size_t  offset      (void) const { return mOffset; }
+                size_t  dim         (void) const { return mDim; }
+
+                T operator() (const char* pElement, int index = 0) const
+                {
+                    T value;
+                    ::memcpy(&value, pElement + mOffset + index * sizeof(T), sizeof(T));
+                    if (mbSwap)
+                        swap_bytes(&value, sizeof(T));
+                    return value;
+                }
+
+            protected:
+                size_t  mOffset;
+                size_t  mDim;
+                bool    mbSwap;
+            };
+
             //=======================================================================//
             //! Cross-referencing structure to locate data in the .blend file
             /*!
@@ -125,6 +167,12 @@ namespace lx0
             /*!
                 \ingroup lx0_subsystem_blendreader
 
+                The file is memory-mapped by open() and never copied: an Object 
+                points directly into the mapping and holds a reference to it, so
+                an Object remains valid even after the BlendReader is destroyed.
+                
+                Values are byte-swapped on read only if the file was saved with a
+                different endianness than the host.
              */
             class BlendReader
             {
@@ -134,48 +182,73 @@ namespace lx0
                 public:
                     friend class BlendReader;
 
+                                        Object       (void);
+
                     template <typename T>
                     T                   field        (std::string ref, int index = 0);
                     lx0::uint64         address      (std::string ref, int index = 0);
+
+                    template <typename T>
+                    FieldAccessor<T>    accessor     (std::string ref) const;
             
                     void                next         (void);
 
+                    const char*         data         (void) const { return pCurrent; }
+                    const std::string&  typeName     (void) const;
+                    size_t              offset       (std::string ref) const;
+                    size_t              count        (void) const;
+                    size_t              stride       (void) const;
+                    bool                swapped      (void) const { return bSwap; }
+
                 protected:
-                    std::pair<char*,size_t> fieldImp     (std::string ref, int index, size_t expectedSize);
+                    const Structure::Field*       _field   (const std::string& ref, size_t expectedSize) const;
+                    std::pair<const char*,size_t> fieldImp (std::string ref, int index, size_t expectedSize);
 
-                    StructurePtr        spStruct;
-                    BlockPtr            spBlock;
-                    std::vector<char>   chunk;
-                    char*               pCurrent;
+                    StructurePtr                spStruct;
+                    BlockPtr                    spBlock;
+                    std::shared_ptr<MappedFile> spFile;
+                    const char*                 pBegin;
+                    const char*                 pEnd;
+                    const char*                 pCurrent;
+                    bool                        bSwap;
                 };
 
                 typedef std::shared_ptr<Object> ObjectPtr;
 
                 bool                    open                (std::string filename);
-                ObjectPtr               readObject          (unsigned __int64 address);
+                Object                  object              (lx0::uint64 address);
+                ObjectPtr               readObject          (lx0::uint64 address);
 
                 StructurePtr            getStructureByName  (std::string name);
                 std::vector<BlockPtr>   getBlocksByType     (std::string type);
 
             protected:
-                struct IO
-                {
-                    unsigned __int64 (*read_address) (std::ifstream& file);
-                };
-
                 void          _readBlocks    (void);
                 void          _indexBlocks   (void);
 
-                IO            mIO;
-                std::ifstream mFile;
-                Header        mHeader;
-                DNA           mDNA;
+                std::shared_ptr<MappedFile> mspFile;
+                bool                        mbSwap;
+                Header                      mHeader;
+                DNA                         mDNA;
             };
 
             template <typename T>
             T BlendReader::Object::field (std::string ref, int index)
             {
-                return *reinterpret_cast<T*>( fieldImp(ref, index, sizeof(T)).first );
+                // The mapping is not guaranteed to be aligned for T, so copy 
+                // rather than dereference in place
+                T value;
+                ::memcpy(&value, fieldImp(ref, index, sizeof(T)).first, sizeof(T));
+                if (bSwap)
+                    swap_bytes(&value, sizeof(T));
+                return value;
+            }
+
+            template <typename T>
+            FieldAccessor<T> BlendReader::Object::accessor (std::string ref) const
+            {
+                const Structure::Field* pField = _field(ref, sizeof(T));
+                return FieldAccessor<T>(pField->offset, pField->dim, bSwap);
             }
         }
     }
@@ -29,6 +29,9 @@
 
 #pragma once
 
+#include <string>
+#include <vector>
+#include <memory>
 #include <glgeom/extension/primitive_buffer.hpp>
     
 namespace lx0 
@@ -37,7 +40,16 @@ namespace lx0
     { 
         namespace blendload_ns 
         {
+            //! A mesh instance from a .blend file
+            struct blend_mesh
+            {
+                std::string                                 name;           //!< Name of the Blender Object (or Mesh, if not referenced by an Object)
+                glm::mat4                                   transform;      //!< Object world transform
+                std::shared_ptr<glgeom::primitive_buffer>   primitive;      //!< Shared between Objects instancing the same Mesh
+            };
+
             void                primitive_buffer_from_blendfile  (glgeom::primitive_buffer& primitive, const char* filename, const glm::mat4& pretransform = glm::mat4());
+            void                primitive_buffers_from_blendfile (std::vector<blend_mesh>& meshes, const char* filename, const glm::mat4& pretransform = glm::mat4());
         }
     }
     using namespace lx0::util::blendload_ns;
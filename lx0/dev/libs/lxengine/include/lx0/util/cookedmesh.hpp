@@ -0,0 +1,58 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+    * MIT License (http://www.opensource.org/licenses/mit-license.php)
+
+    Copyright (c) 2011 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a 
+    copy of this software and associated documentation files (the "Software"), 
+    to deal in the Software without restriction, including without limitation 
+    the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+    and/or sell copies of the Software, and to permit persons to whom the 
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+#pragma once
+
+#include <string>
+#include <functional>
+#include <glgeom/extension/primitive_buffer.hpp>
+    
+namespace lx0 
+{ 
+    namespace util 
+    { 
+        namespace cookedmesh_ns 
+        {
+            //! Callback that converts the source file into a primitive buffer on a cache miss
+            typedef std::function<void (glgeom::primitive_buffer&)> cook_function;
+
+            lx0::uint64         cooked_mesh_key     (const char* source, const glm::mat4& pretransform);
+            std::string         cooked_mesh_path    (const std::string& cacheDirectory, const char* source, lx0::uint64 key);
+
+            bool                cooked_mesh_read    (glgeom::primitive_buffer& primitive, const std::string& filename, lx0::uint64 key);
+            void                cooked_mesh_write   (const glgeom::primitive_buffer& primitive, const std::string& filename, lx0::uint64 key);
+
+            std::string         cooked_mesh_directory (void);
+
+            void                primitive_buffer_from_cache     (glgeom::primitive_buffer& primitive, const std::string& cacheDirectory, const char* source, const glm::mat4& pretransform, cook_function cook);
+            void                primitive_buffer_from_blendfile_cached (glgeom::primitive_buffer& primitive, const std::string& cacheDirectory, const char* filename, const glm::mat4& pretransform = glm::mat4());
+        }
+    }
+    using namespace lx0::util::cookedmesh_ns;
+}
@@ -0,0 +1,128 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+    * MIT License (http://www.opensource.org/licenses/mit-license.php)
+
+    Copyright (c) 2010-2012 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a
+    copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+
+#pragma once
+
+//===========================================================================//
+//   H E A D E R S
+//===========================================================================//
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#include <lx0/_detail/forward_decls.hpp>
+#include <lx0/core/lxvar/lxvar.hpp>
+#include <lx0/util/misc/perfcounters.hpp>
+
+namespace lx0 { namespace util { namespace misc {
+
+    //===========================================================================//
+    //! Shared driver for the programs under benchmarks/
+    /*!
+        Each case is run for a number of untimed warmup repetitions and then 
+        timed repetitions.  An optional setup and teardown function runs 
+        before and after every repetition, outside of the timed region (e.g.
+        to restore the input data that the case modifies).
+
+        The command line options are:
+
+        \code
+        --warmup N          Untimed repetitions before timing (default 1)
+        --repetitions N     Timed repetitions (default 10; 3 in debug builds)
+        --filter TEXT       Only run the cases whose name contains TEXT
+        --json FILE         Write the results as JSON
+        --baseline FILE     Compare against results previously written with --json
+        --threshold PCT     Regression threshold in percent (default 10)
+        \endcode
+
+        run() returns the number of regressions found against the baseline,
+        so it can be returned directly from main() to fail a scripted run.
+        The same comparison is available standalone via benchmark_compare.
+     */
+    class BenchmarkRunner
+    {
+    public:
+        struct Result
+        {
+            std::string         name;
+            int                 repetitions;
+            double              minMs;
+            double              maxMs;
+            double              meanMs;
+            double              medianMs;
+            double              p95Ms;
+            double              stddevMs;
+            bool                bEvents;        //!< Whether events holds hardware counts
+            PerfCounters::Values events;        //!< Mean hardware counts per repetition
+        };
+
+                        BenchmarkRunner (const char* suite);
+
+        void            parseArguments  (int argc, char** argv);
+
+        void            warmup          (int count)         { mWarmup = count; }
+        void            repetitions     (int count)         { mRepetitions = count; }
+        void            threshold       (double percent)    { mThreshold = percent; }
+
+        void            add             (std::string name, std::function<void()> run);
+        void            add             (std::string name, std::function<void()> setup, std::function<void()> run, std::function<void()> teardown);
+
+        int             run             (void);
+
+        const std::vector<Result>& results (void) const     { return mResults; }
+
+        static void     summarize       (std::vector<double>& samplesMs, Result& result);
+        static void     writeJson       (const char* filename, const std::string& suite, const std::vector<Result>& results);
+        static int      compare         (lxvar current, lxvar baseline, double thresholdPercent);
+
+    protected:
+        struct Case
+        {
+            std::string             name;
+            std::function<void()>   setup;
+            std::function<void()>   run;
+            std::function<void()>   teardown;
+        };
+
+        Result          _runCase        (Case& c);
+
+        std::string         mSuite;
+        int                 mWarmup;
+        int                 mRepetitions;
+        double              mThreshold;
+        std::string         mFilter;
+        std::string         mJsonFile;
+        std::string         mBaselineFile;
+        std::vector<Case>   mCases;
+        std::vector<Result> mResults;
+    };
+
+}}}
@@ -0,0 +1,154 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+    * MIT License (http://www.opensource.org/licenses/mit-license.php)
+
+    Copyright (c) 2010-2012 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a
+    copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+
+
+#pragma once
+
+//===========================================================================//
+//   H E A D E R S
+//===========================================================================//
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include <lx0/_detail/forward_decls.hpp>
+#include <lx0/core/log/log.hpp>
+#include <glgeom/glgeom.hpp>
+
+namespace lx0 { namespace util { namespace misc {
+
+    //===========================================================================//
+    //! Bounds-checked reader over the contents of a cooked file
+    /*!
+        Every read throws an lx_error_exception if it would go past the end of
+        the data.  The pointers returned by take() point into the file mapping
+        and are valid only during the cooked_file_read() callback.
+
+        Streams are stored as contiguous arrays of floats (3 per point, vector,
+        or color, 2 per texture coordinate), so each one can be copied or 
+        uploaded as a block.  Strings are padded to 4 bytes and integer 
+        arrays are stored as uint32.
+     */
+    class CookedFileReader
+    {
+    public:
+                        CookedFileReader (const char* pBegin, size_t size) : mp (pBegin), mpEnd (pBegin + size) {}
+
+        const char*     take            (size_t bytes);
+        bool            atEnd           (void) const    { return mp == mpEnd; }
+
+        template <typename T>
+        void            read            (T& value)      { ::memcpy(&value, take(sizeof(T)), sizeof(T)); }
+
+        void            readString      (std::string& s, size_t length);
+        void            readStream      (std::vector<glgeom::point3f>& stream, size_t count);
+        void            readStream      (std::vector<glgeom::vector3f>& stream, size_t count);
+        void            readStream      (std::vector<glgeom::color3f>& stream, size_t count);
+        void            readStream      (std::vector<glgeom::point2f>& stream, size_t count);
+        
+        template <typename T>
+        void            readUint32Array (std::vector<T>& values, size_t count);
+
+    protected:
+        const float*    _floats         (size_t count)  { return reinterpret_cast<const float*>( take(count * sizeof(float)) ); }
+
+        const char*     mp;
+        const char*     mpEnd;
+    };
+
+    //===========================================================================//
+    //! Builds a cooked file in memory and then writes it to disk
+    /*!
+        The common header (magic, format version, endian tag, and key) is 
+        written on construction; the format-specific data is then appended.
+        The layout written by each method matches the corresponding 
+        CookedFileReader method.
+     */
+    class CookedFileWriter
+    {
+    public:
+                        CookedFileWriter (lx0::uint32 magic, lx0::uint32 version, lx0::uint64 key);
+
+        void            append          (const void* pData, size_t bytes);
+
+        template <typename T>
+        void            write           (const T& value)    { append(&value, sizeof(T)); }
+
+        void            writeString     (const std::string& s);
+        void            writeStream     (const std::vector<glgeom::point3f>& stream);
+        void            writeStream     (const std::vector<glgeom::vector3f>& stream);
+        void            writeStream     (const std::vector<glgeom::color3f>& stream);
+        void            writeStream     (const std::vector<glgeom::point2f>& stream);
+        
+        template <typename T>
+        void            writeUint32Array (const std::vector<T>& values);
+
+        bool            save            (const std::string& filename) const;
+
+    protected:
+        std::vector<char>   mBuffer;
+        std::vector<float>  mFloats;
+    };
+
+    //===========================================================================//
+
+    std::string     cooked_file_path    (const std::string& cacheDirectory, const std::string& source, lx0::uint64 key, const char* extension);
+    bool            cooked_file_read    (const std::string& filename, lx0::uint32 magic, lx0::uint32 version, lx0::uint64 key, std::function<void (CookedFileReader&)> parse);
+
+    //===========================================================================//
+
+    //! Reads an array stored as uint32 values (e.g. indices) into values of type T
+    template <typename T>
+    void 
+    CookedFileReader::readUint32Array (std::vector<T>& values, size_t count)
+    {
+        const char* p = take(count * sizeof(lx0::uint32));
+        values.resize(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            lx0::uint32 value;
+            ::memcpy(&value, p + i * sizeof(value), sizeof(value));
+            values[i] = T(value);
+            if (lx0::uint32(values[i]) != value)
+                throw lx_error_exception("Cooked value %1% does not fit the destination type", value);
+        }
+    }
+
+    template <typename T>
+    void
+    CookedFileWriter::writeUint32Array (const std::vector<T>& values)
+    {
+        for (auto it = values.begin(); it != values.end(); ++it)
+            write( lx0::uint32(*it) );
+    }
+
+}}}
@@ -0,0 +1,113 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+    * MIT License (http://www.opensource.org/licenses/mit-license.php)
+
+    Copyright (c) 2010-2012 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a
+    copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+
+#pragma once
+
+//===========================================================================//
+//   H E A D E R S
+//===========================================================================//
+
+#include <lx0/_detail/forward_decls.hpp>
+
+namespace lx0 { namespace util { namespace misc {
+
+    //===========================================================================//
+    //! Hardware performance counters of the calling thread
+    /*!
+        Counts retired instructions, CPU cycles, last-level cache misses and
+        branch mispredictions via perf_event_open.  Only implemented on 
+        Linux; elsewhere - or if the kernel does not permit access, e.g. 
+        /proc/sys/kernel/perf_event_paranoid is too high - available() 
+        returns false and all counts read as zero.
+
+        The counters measure the thread that constructed the object, so a 
+        PerfCounters should be used only on that thread.  Usage mirrors 
+        Timer: the counts between each start() and stop() are accumulated.
+
+        Reading the counters is a system call, so the overhead per start/stop
+        pair is on the order of a microsecond.
+     */
+    class PerfCounters
+    {
+    public:
+        enum Event
+        {
+            eInstructions,
+            eCycles,
+            eCacheMisses,
+            eBranchMisses,
+            eEventCount
+        };
+
+        struct Values
+        {
+            lx0::uint64     count[eEventCount];
+        };
+
+                        PerfCounters    (void);
+                        ~PerfCounters   (void);
+
+        bool            available       (void) const        { return mFd[0] >= 0; }
+        bool            available       (Event e) const     { return mFd[e] >= 0; }
+
+        void            read            (Values& values) const;
+
+        void            start           (void);
+        void            stop            (void);
+        void            reset           (void);
+        lx0::uint64     total           (Event e) const     { return mTotal.count[e]; }
+
+        static const char* eventName    (Event e);
+
+    protected:
+                        PerfCounters    (const PerfCounters&);
+        void            operator=       (const PerfCounters&);
+
+        int             mFd[eEventCount];   // -1 if the event could not be opened; mFd[0] is the group leader
+        lx0::uint64     mId[eEventCount];   // Kernel id of each event, used to match the values read from the group
+        Values          mStart;
+        Values          mTotal;
+    };
+
+    //===========================================================================//
+    //! Accumulates the counts for the lifetime of the object
+    /*!
+     */
+    class PerfSection
+    {
+    public:
+        inline PerfSection (PerfCounters& counters) : mCounters(counters) { mCounters.start(); }
+        inline ~PerfSection ()                                            { mCounters.stop(); }
+
+    protected:
+        PerfCounters&   mCounters;
+    };
+
+}}}
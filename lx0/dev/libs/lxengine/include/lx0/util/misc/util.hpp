@@ -51,6 +51,8 @@ namespace lx0 { namespace util { namespace misc {
     std::string             lx_ctime                (void);
     std::string             lx_timestring           (void);
     bool                    lx_little_endian        (void);    
+    lx0::uint64             lx_fnv1a                (const void* pData, size_t size, lx0::uint64 hash = 14695981039346656037ULL);
+    std::string             lx_json_escape          (const std::string& s);
 
     unsigned int            lx_milliseconds         (void);
     lx0::int64              lx_ticks                (void);
@@ -32,15 +32,9 @@
 #include <functional>
 
 #include <lx0/core/init/init.hpp>
+#include <lx0/core/log/log.hpp>
 #include <lx0/core/slot/slot.hpp>
 
-namespace lx0 { namespace core { namespace log_ns {
-    extern std::ofstream s_log;
-    extern int s_log_count;
-}}}
-
-using namespace lx0::core::log_ns;
-
 namespace lx0 { namespace core { namespace init_ns {
 
     static bool s_lx_init_called = false;
@@ -70,70 +64,10 @@ namespace lx0 { namespace core { namespace init_ns {
         {
             // On a fatal error, this should be renamed to include the time & date so it
             // is not overwritten by the next run.
-            s_log.open("lxengine_log.html");
-            s_log 
-                << "<html>" << std::endl
-                << "<head>"
-                << "  <title>LxEngine log</title>"
-                << "  <style>"
-                << "  body { font-family: sans-serif; font-size: 9pt; }" << std:: endl
-                << "  li { white-space: pre; font-family: monospace; }" << std::endl
-                << "  .multiline { white-space: pre; font-family: monospace; margin-left: 48px; padding: 4px; padding-bottom: 8px }" << std::endl
-                << "  .prefix { font-size: 85%; font-variant: small-caps; float: left; width: 48px; padding-left: 26px; }" << std::endl
-                << "  .debug { color: gray; font-size: 70%; } " << std::endl
-                << "  .log { color: black; } " << std::endl
-                << "  .warn { color: #f19527; } " << std::endl
-                << "  .error { color: red; font-weight: bold; } " << std::endl
-                << "  .fatal { color: red; background-color: yellow; font-weight: bold; } " << std::endl
-                << "  </style>"
-                << "</head>"
-                << "<body>"
-                << "<h1>Log</h1>"
-                << "<ul style='padding-left: 12px;'>" 
-                << std::endl;
+            lx_log_sink(eLogSinkHtml, "lxengine_log.html");
 
             s_lx_init_called = true;
         }
     }
 
 }}}
-
-
-    namespace lx0 
-{ 
-    namespace core 
-    {
-        namespace log_ns
-        {
-    void _lx_write_to_log (const char* css, const char* prefix, const char* s)
-    {
-        // Quick and ugly HTML escaping
-        bool multiline = false;
-        size_t len = strlen(s);
-        std::string t;
-        t.reserve(len);
-        for (size_t i = 0; i < len; ++i)
-        {
-            switch (s[i])
-            {
-            case '<':   t += "&lt;";    break;
-            case '>':   t += "&gt;";    break;
-            case '\n':  t += "<br />";  multiline = true; break;
-            default:
-                t += s[i];
-            }
-        }
-        if (multiline)
-            s_log << "<li class='" << css << "'><span class='prefix'>" << prefix << "</span></li>" 
-                << "<div class='multiline " << css << "'>"<< t << "</div>"  
-                << std::endl; 
-        else
-            s_log << "<li class='" << css << "'><span class='prefix'>" << prefix << "</span>"<< t << "</li>" << std::endl;
-
-        if (s_log_count++ == 100)
-        {
-            s_log_count = 0;
-            s_log.flush();
-        }
-    }
-        }}}
\ No newline at end of file
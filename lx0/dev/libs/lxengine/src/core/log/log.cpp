@@ -33,31 +33,499 @@
 #include <iostream>
 #include <cstdio> 
 #include <cstdarg>
+#include <cstring>
 #include <exception>
 #include <string>
 #include <fstream>
+#include <memory>
+#include <vector>
 
-#include <boost/filesystem.hpp>
-#include <boost/algorithm/string.hpp>
+#include <boost/thread.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/interprocess/detail/atomic.hpp>
 
 #include <lx0/core/init/init.hpp>
 #include <lx0/core/log/log.hpp>
 #include <lx0/core/slot/slot.hpp>
 #include <lx0/util/misc/util.hpp>
 
+//
+// The queue relies on the x86/x64 memory model: only the compiler needs to be
+// prevented from reordering the record writes past the sequence update.
+//
+#ifdef _MSC_VER
+#   include <intrin.h>
+#   pragma intrinsic(_ReadWriteBarrier)
+#   define _lx_compiler_barrier()   _ReadWriteBarrier()
+#else
+#   define _lx_compiler_barrier()   __asm__ __volatile__ ("" ::: "memory")
+#endif
+
 namespace lx0 { namespace core { namespace log_ns {
 
-    std::ofstream s_log;
-    int s_log_count = 0;
+    volatile int _lx_log_threshold = eLogDebug;
 
-    static struct _autoclose
+    namespace detail
     {
-        ~_autoclose() 
-        { 
-            s_log << "</ul></body></html>" << std::endl;
-            s_log.close();
+        struct LogRecord
+        {
+            enum { kInlineArgs = 128 };
+
+            volatile boost::uint32_t    sequence;
+            boost::uint32_t             position;
+            int                         level;
+            const char*                 file;
+            int                         line;
+            lx0::uint32                 threadId;
+            lx0::int64                  ticks;
+
+            //
+            // The message is one of: preformatted text, a string literal with
+            // no arguments, or arguments to be formatted by the logging thread
+            // (stored inline if small enough).
+            //
+            std::string                 text;
+            const char*                 literal;
+            LogArgs*                    pArgs;
+            union
+            {
+                lx0::int64              _align;
+                char                    bytes[kInlineArgs];
+            } storage;
+        };
+
+        //===========================================================================//
+        //! Bounded multi-producer, single-consumer queue of log records
+        /*!
+            Producers claim a slot with a single compare-and-swap and never
+            block on a lock.  Each slot carries a sequence number that tells
+            the producers and the consumer whether the slot is free, claimed,
+            or filled, so the consumer never reads a record that is still
+            being written.  If the queue is full, producers yield until the
+            logging thread catches up rather than dropping records.
+         */
+        class LogQueue
+        {
+        public:
+            enum { kCapacity = 4096 };
+
+            LogQueue()
+                : mEnqueuePos (0)
+                , mDequeuePos (0)
+            {
+                for (boost::uint32_t i = 0; i < kCapacity; ++i)
+                    mRecords[i].sequence = i;
+            }
+
+            //! Claims the next slot; the caller fills in the message and then calls commit()
+            LogRecord* reserve (int level, const char* file, int line)
+            {
+                LogRecord* pRecord;
+                boost::uint32_t pos;
+                for (;;)
+                {
+                    pos = mEnqueuePos;
+                    pRecord = &mRecords[pos % kCapacity];
+                    
+                    const int diff = int(pRecord->sequence - pos);
+                    if (diff == 0)
+                    {
+                        if (boost::interprocess::detail::atomic_cas32(&mEnqueuePos, pos + 1, pos) == pos)
+                            break;
+                    }
+                    else if (diff < 0)
+                        boost::this_thread::yield();
+                }
+
+                pRecord->position = pos;
+                pRecord->level    = level;
+                pRecord->file     = file;
+                pRecord->line     = line;
+                pRecord->threadId = lx0::lx_current_thread_id();
+                pRecord->ticks    = lx0::lx_ticks();
+                pRecord->literal  = nullptr;
+                pRecord->pArgs    = nullptr;
+                return pRecord;
+            }
+
+            void commit (LogRecord* pRecord)
+            {
+                _lx_compiler_barrier();
+                pRecord->sequence = pRecord->position + 1;
+            }
+
+            //! Called only from the logging thread
+            LogRecord* front (void)
+            {
+                LogRecord* pRecord = &mRecords[mDequeuePos % kCapacity];
+                if (int(pRecord->sequence - (mDequeuePos + 1)) < 0)
+                    return nullptr;
+                return pRecord;
+            }
+
+            //! Called only from the logging thread
+            void pop (void)
+            {
+                LogRecord* pRecord = &mRecords[mDequeuePos % kCapacity];
+                _lx_compiler_barrier();
+                pRecord->sequence = mDequeuePos + kCapacity;
+                mDequeuePos++;
+            }
+
+            boost::uint32_t enqueued (void) const { return mEnqueuePos; }
+            boost::uint32_t dequeued (void) const { return mDequeuePos; }
+
+        protected:
+            LogRecord                   mRecords[kCapacity];
+            volatile boost::uint32_t    mEnqueuePos;
+            volatile boost::uint32_t    mDequeuePos;
+        };
+
+        //===========================================================================//
+        //! Drains the LogQueue to the sink on a background thread
+        /*!
+            The logging thread does all the work that used to be done by the
+            thread calling lx_log(): stripping the file path, the debugger 
+            output, HTML escaping, and the file I/O.  The thread is started
+            by lx_init(); if nothing has started it, records are written by
+            lx_log_flush() or at exit.
+         */
+        class LogBackend
+        {
+        public:
+            LogBackend()
+                : mpThread  (nullptr)
+                , mbStop    (false)
+                , mSink     (eLogSinkHtml)
+                , mspFile   (new std::ofstream)
+                , mCount    (0)
+            {
+            }
+
+            void    start   (void);
+            void    stop    (void);
+            void    flush   (void);
+            void    open    (LogSink sink, const char* filename);
+            void    push    (LogSink sink, const char* filename);
+            void    pop     (void);
+
+            void    push    (int level, const char* file, int line, const std::string& text);
+            LogRecord* reserve (int level, const char* file, int line)  { return mQueue.reserve(level, file, line); }
+            void    commit  (LogRecord* pRecord);
+
+            std::ofstream&  _file   (void)  { return *mspFile; }
+
+        protected:
+            typedef std::shared_ptr<std::ofstream> FilePtr;
+
+            void    _run    (void);
+            bool    _drain  (void);
+            void    _write  (LogRecord& record);
+            void    _open   (LogSink sink, const char* filename);
+            void    _close  (void);
+
+            LogQueue                    mQueue;
+            boost::thread*              mpThread;
+            boost::mutex                mThreadMutex;
+            boost::mutex                mWakeMutex;
+            boost::condition_variable   mWake;
+            volatile bool               mbStop;
+
+            boost::mutex                mSinkMutex;     //!< Held by the logging thread while writing
+            LogSink                     mSink;
+            FilePtr                     mspFile;
+            std::vector<std::pair<LogSink, FilePtr>> mSaved;    //!< Sinks set aside by push()
+            int                         mCount;
+        };
+
+        void 
+        LogBackend::start (void)
+        {
+            boost::lock_guard<boost::mutex> lock(mThreadMutex);
+            if (!mpThread)
+            {
+                mbStop = false;
+                mpThread = new boost::thread([this]() { _run(); });
+            }
+        }
+
+        void
+        LogBackend::stop (void)
+        {
+            boost::lock_guard<boost::mutex> lock(mThreadMutex);
+            if (mpThread)
+            {
+                mbStop = true;
+                mWake.notify_one();
+                mpThread->join();
+                delete mpThread;
+                mpThread = nullptr;
+            }
+            _drain();
+            _close();
+        }
+
+        void
+        LogBackend::push (int level, const char* file, int line, const std::string& text)
+        {
+            LogRecord* pRecord = mQueue.reserve(level, file, line);
+            pRecord->text = text;
+            commit(pRecord);
+        }
+
+        void
+        LogBackend::commit (LogRecord* pRecord)
+        {
+            const int level = pRecord->level;
+            mQueue.commit(pRecord);
+            
+            // Before lx_init() and after exit, there is no thread to hand off to
+            if (!mpThread)
+                _drain();
+            else if (level >= eLogWarn)
+                mWake.notify_one();     // Only warnings are worth waking the logging thread early
+        }
+
+        //! Blocks until all records queued before the call have been written
+        void
+        LogBackend::flush (void)
+        {
+            const boost::uint32_t target = mQueue.enqueued();
+            if (mpThread)
+            {
+                mWake.notify_one();
+                while (int(mQueue.dequeued() - target) < 0)
+                    boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+            }
+            else
+                _drain();
+
+            boost::lock_guard<boost::mutex> lock(mSinkMutex);
+            if (mspFile->is_open())
+                mspFile->flush();
+        }
+
+        void
+        LogBackend::_run (void)
+        {
+            while (!mbStop)
+            {
+                if (!_drain())
+                {
+                    boost::unique_lock<boost::mutex> lock(mWakeMutex);
+                    mWake.timed_wait(lock, boost::posix_time::milliseconds(5));
+                }
+            }
+        }
+
+        //! Writes every complete record in the queue; returns false if there were none
+        bool
+        LogBackend::_drain (void)
+        {
+            boost::lock_guard<boost::mutex> lock(mSinkMutex);
+
+            bool bAny = false;
+            while (LogRecord* pRecord = mQueue.front())
+            {
+                _write(*pRecord);
+                mQueue.pop();
+                bAny = true;
+            }
+
+            // Flush whenever the thread catches up so the log is current if the process dies
+            if (bAny && mspFile->is_open())
+                mspFile->flush();
+            return bAny;
+        }
+
+        static void 
+        _debugger_message (const char* prefix, const char* file, int line, const std::string& s)
+        {
+            const char* filename = file;
+            for (const char* p = file; *p; ++p)
+            {
+                if (*p == '/' || *p == '\\')
+                    filename = p + 1;
+            }
+
+            auto fmt = boost::format("%16s:%4d %5s:    %s\n") % filename % line % prefix % s;
+            lx0::lx_debugger_message(boost::str(fmt));
+        }
+
+        void
+        LogBackend::_write (LogRecord& record)
+        {
+            static const char* css[]      = { "debug", "log", "message", "warn" };
+            static const char* prefix[]   = { "DBG", "LOG", "MSG", "WARN" };
+            static const char* debugger[] = { "DEBUG", "LOG", nullptr, "WARN" };
+
+            //
+            // Format deferred messages now that the record is off the calling thread
+            //
+            if (record.pArgs)
+            {
+                try
+                {
+                    record.text = record.pArgs->format();
+                }
+                catch (std::exception& e)
+                {
+                    record.text = std::string("<log format error: ") + e.what() + ">";
+                }
+
+                if ((void*)record.pArgs == (void*)record.storage.bytes)
+                    record.pArgs->~LogArgs();
+                else
+                    delete record.pArgs;
+                record.pArgs = nullptr;
+            }
+            else if (record.literal)
+                record.text = record.literal;
+
+            if (debugger[record.level])
+                _debugger_message(debugger[record.level], record.file, record.line, record.text);
+
+            if (!mspFile->is_open())
+                return;
+
+            switch (mSink)
+            {
+            case eLogSinkHtml:
+                _lx_write_to_log(css[record.level], prefix[record.level], record.text.c_str());
+                break;
+
+            case eLogSinkText:
+                *mspFile << prefix[record.level] << "\t" << record.threadId << "\t" << record.file << ":" << record.line << "\t" << record.text << "\n";
+                break;
+
+            case eLogSinkBinary:
+                {
+                    const lx0::uint8  level    = lx0::uint8(record.level);
+                    const lx0::uint32 line     = lx0::uint32(record.line);
+                    const lx0::uint16 fileLen  = lx0::uint16(strlen(record.file));
+                    const lx0::uint32 textLen  = lx0::uint32(record.text.size());
+
+                    mspFile->write((const char*)&level, sizeof(level));
+                    mspFile->write((const char*)&record.threadId, sizeof(record.threadId));
+                    mspFile->write((const char*)&record.ticks, sizeof(record.ticks));
+                    mspFile->write((const char*)&line, sizeof(line));
+                    mspFile->write((const char*)&fileLen, sizeof(fileLen));
+                    mspFile->write(record.file, fileLen);
+                    mspFile->write((const char*)&textLen, sizeof(textLen));
+                    mspFile->write(record.text.data(), textLen);
+                }
+                break;
+            }
+        }
+
+        /*!
+            Switches the sink: all records queued so far are written to the
+            current sink, which is then closed and replaced.
+         */
+        void
+        LogBackend::open (LogSink sink, const char* filename)
+        {
+            start();
+            flush();
+
+            boost::lock_guard<boost::mutex> lock(mSinkMutex);
+            _close();
+            _open(sink, filename);
+        }
+
+        /*!
+            Switches to a new sink but, unlike open(), leaves the current sink
+            open so that pop() can return to it.
+         */
+        void
+        LogBackend::push (LogSink sink, const char* filename)
+        {
+            start();
+            flush();
+
+            boost::lock_guard<boost::mutex> lock(mSinkMutex);
+            mSaved.push_back( std::make_pair(mSink, mspFile) );
+            mspFile.reset(new std::ofstream);
+            _open(sink, filename);
+        }
+
+        //! Closes the current sink and returns to the one set aside by push()
+        void
+        LogBackend::pop (void)
+        {
+            flush();
+
+            boost::lock_guard<boost::mutex> lock(mSinkMutex);
+            if (mSaved.empty())
+                return;
+
+            _close();
+            mSink   = mSaved.back().first;
+            mspFile = mSaved.back().second;
+            mSaved.pop_back();
+        }
+
+        void
+        LogBackend::_open (LogSink sink, const char* filename)
+        {
+            mSink = sink;
+            mspFile->open(filename, (sink == eLogSinkBinary) ? (std::ios::out | std::ios::binary) : std::ios::out);
+
+            switch (sink)
+            {
+            case eLogSinkHtml:
+                *mspFile
+                    << "<html>" << std::endl
+                    << "<head>"
+                    << "  <title>LxEngine log</title>"
+                    << "  <style>"
+                    << "  body { font-family: sans-serif; font-size: 9pt; }" << std:: endl
+                    << "  li { white-space: pre; font-family: monospace; }" << std::endl
+                    << "  .multiline { white-space: pre; font-family: monospace; margin-left: 48px; padding: 4px; padding-bottom: 8px }" << std::endl
+                    << "  .prefix { font-size: 85%; font-variant: small-caps; float: left; width: 48px; padding-left: 26px; }" << std::endl
+                    << "  .debug { color: gray; font-size: 70%; } " << std::endl
+                    << "  .log { color: black; } " << std::endl
+                    << "  .warn { color: #f19527; } " << std::endl
+                    << "  .error { color: red; font-weight: bold; } " << std::endl
+                    << "  .fatal { color: red; background-color: yellow; font-weight: bold; } " << std::endl
+                    << "  </style>"
+                    << "</head>"
+                    << "<body>"
+                    << "<h1>Log</h1>"
+                    << "<ul style='padding-left: 12px;'>" 
+                    << std::endl;
+                break;
+
+            case eLogSinkBinary:
+                mspFile->write("LXLOG001", 8);
+                break;
+
+            default:
+                break;
+            }
+        }
+
+        void
+        LogBackend::_close (void)
+        {
+            if (mspFile->is_open())
+            {
+                if (mSink == eLogSinkHtml)
+                    *mspFile << "</ul></body></html>" << std::endl;
+                mspFile->close();
+            }
         }
-    } __autoclose;
+
+        static LogBackend s_backend;
+
+        static struct _autoclose
+        {
+            ~_autoclose() 
+            { 
+                s_backend.stop();
+            }
+        } __autoclose;
+    }
 
     // Internal function to ensure initialization has occured.
     /*
@@ -84,7 +552,7 @@ namespace lx0 { namespace core { namespace log_ns {
 
     detail::_exception_base::_exception_base (const char* file, int line)
     {
-        lx_log("lx0::error_exception (%p) created ", this);
+        lx_log("lx0::error_exception (%p) created ", (void*)this);
         mWhat.reserve(512);
         location(file, line);
     }
@@ -92,16 +560,21 @@ namespace lx0 { namespace core { namespace log_ns {
     void 
     detail::_exception_base::location (const char* file, int line)
     {
-        lx_log("lx0::error_exception (%p) location: %s : %d", this, file, line);
-        mWhat += boost::str(boost::format("\n>> %1%:%2%\n") % file % line);
+        lx_log("lx0::error_exception (%p) location: %s : %d", (void*)this, file, line);
+        mWhat += "\n>> ";
+        mWhat += file;
+        mWhat += ":";
+        mWhat += boost::lexical_cast<std::string>(line);
+        mWhat += "\n";
 
     }
 
     detail::_exception_base&
     detail::_exception_base::detail (const char* msg)
     {
-        lx0::lx_debugger_message(boost::str(boost::format("lx0:error_exception (%p) details:\n%s\n") % this % msg));
-        lx_log("lx0::error_exception (%p) detail: %s", this, msg);
+        if (lx0::lx_in_debugger())
+            lx0::lx_debugger_message(boost::str(boost::format("lx0:error_exception (%p) details:\n%s\n") % this % msg));
+        lx_log("lx0::error_exception (%p) detail: %s", (void*)this, msg);
         mWhat += msg;
         mWhat += "\n";
 
@@ -128,41 +601,136 @@ namespace lx0 { namespace core { namespace log_ns {
         detail("%1%", s);         
     }
 
-    void _lx_message_imp (const char* file, int line, const std::string& s)
+    /*!
+        Sets the minimum level of the messages that are logged.  Messages below
+        the level are discarded before they are formatted.
+     */
+    void
+    lx_log_level (LogLevel level)
     {
-        _lx_write_to_log("message", "MSG", s.c_str());
-        std::cout << s << std::endl;
+        _lx_log_threshold = int(level);
     }
 
-    static void 
-    _debugger_message (const char* prefix, const char* file, int line, const std::string& s)
+    LogLevel
+    lx_log_level (void)
     {
-        boost::filesystem::path filePath(file);
-        std::string filename = filePath.filename().string();
-        if (filename.front() == '\"' && filename.back() == '\"')
-            filename = filename.substr(1, filename.length() - 2);
+        return LogLevel(_lx_log_threshold);
+    }
 
-        auto fmt = boost::format("%16s:%4d %5s:    %s\n") % filename % line % prefix % s;
-        lx0::lx_debugger_message(boost::str(fmt));;
+    /*!
+        Sets the file the background logging thread writes to.  lx_init() 
+        opens "lxengine_log.html" as the default sink.
+     */
+    void
+    lx_log_sink (LogSink sink, const char* filename)
+    {
+        detail::s_backend.open(sink, filename);
+    }
+
+    /*!
+        Temporarily redirects the log to a new sink.  The current sink is 
+        left open, without losing what it has already written, and is 
+        resumed by lx_log_pop_sink().
+     */
+    void
+    lx_log_push_sink (LogSink sink, const char* filename)
+    {
+        detail::s_backend.push(sink, filename);
+    }
+
+    //! Closes the sink opened by lx_log_push_sink() and resumes the previous one
+    void
+    lx_log_pop_sink (void)
+    {
+        detail::s_backend.pop();
+    }
+
+    //! Blocks until all messages logged so far have been written to the sink
+    void
+    lx_log_flush (void)
+    {
+        detail::s_backend.flush();
+    }
+
+    void
+    detail::_lx_log_reserve (int level, const char* file, int line, LogReservation& r)
+    {
+        LogRecord* pRecord = s_backend.reserve(level, file, line);
+        r.pRecord  = pRecord;
+        r.pStorage = pRecord->storage.bytes;
+        r.capacity = sizeof(pRecord->storage.bytes);
+    }
+
+    void
+    detail::_lx_log_commit (LogReservation& r, LogArgs* pArgs, const char* literal)
+    {
+        LogRecord* pRecord = reinterpret_cast<LogRecord*>(r.pRecord);
+        pRecord->pArgs   = pArgs;
+        pRecord->literal = literal;
+        if (!pArgs && !literal)
+            pRecord->text = "<log arguments could not be copied>";
+        
+        s_backend.commit(pRecord);
+    }
+
+    //! Used by the deferred logging macros when an argument cannot be deferred
+    void
+    detail::_lx_log_text (int level, const char* file, int line, const std::string& s)
+    {
+        s_backend.push(level, file, line, s);
+    }
+
+    void _lx_message_imp (const char* file, int line, const std::string& s)
+    {
+        detail::s_backend.push(eLogMessage, file, line, s);
+        std::cout << s << std::endl;
     }
 
     void _lx_debug_imp   (const char* file, int line, const std::string& s)
     {
-        _lx_write_to_log("debug", "DBG", s.c_str());
-        _debugger_message("DEBUG", file, line, s);
+        detail::s_backend.push(eLogDebug, file, line, s);
     }
 
     void _lx_log_imp     (const char* file, int line, const std::string& s)
     {
-        _lx_write_to_log("log", "LOG", s.c_str());
-        _debugger_message("LOG", file, line, s);
+        detail::s_backend.push(eLogLog, file, line, s);
     }
 
     void _lx_warn_imp    (const char* file, int line, const std::string& s)
     {
-        _lx_write_to_log("warn", "WARN", s.c_str());
-        _debugger_message("WARN", file, line, s);
+        detail::s_backend.push(eLogWarn, file, line, s);
         std::cerr << "WARNING: " << s << std::endl;
     }
 
+    /*!
+        Writes a record to the HTML sink.  Called only from the logging thread.
+     */
+    void _lx_write_to_log (const char* css, const char* prefix, const char* s)
+    {
+        std::ofstream& log = detail::s_backend._file();
+
+        // Quick and ugly HTML escaping
+        bool multiline = false;
+        size_t len = strlen(s);
+        std::string t;
+        t.reserve(len);
+        for (size_t i = 0; i < len; ++i)
+        {
+            switch (s[i])
+            {
+            case '<':   t += "&lt;";    break;
+            case '>':   t += "&gt;";    break;
+            case '\n':  t += "<br />";  multiline = true; break;
+            default:
+                t += s[i];
+            }
+        }
+        if (multiline)
+            log << "<li class='" << css << "'><span class='prefix'>" << prefix << "</span></li>" 
+                << "<div class='multiline " << css << "'>"<< t << "</div>"  
+                << "\n"; 
+        else
+            log << "<li class='" << css << "'><span class='prefix'>" << prefix << "</span>"<< t << "</li>" << "\n";
+    }
+
 }}}
@@ -0,0 +1,265 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+    * MIT License (http://www.opensource.org/licenses/mit-license.php)
+
+    Copyright (c) 2010-2012 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a
+    copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+
+//===========================================================================//
+//   H E A D E R S
+//===========================================================================//
+
+#include <cstdlib>
+#include <new>
+
+#include <lx0/core/memory/memory.hpp>
+
+#ifdef _WIN32
+#   include <windows.h>
+#endif
+
+namespace lx0 { namespace core { namespace memory_ns {
+
+    namespace
+    {
+        //
+        // 64-bit counters so that live and total bytes do not wrap in long 
+        // sessions.  The Interlocked functions are used rather than the 
+        // intrinsics so that 32-bit builds work as well.
+        //
+#ifdef _WIN32
+        typedef volatile LONGLONG   Atomic64;
+
+        inline lx0::int64 _atomicAdd (Atomic64* p, lx0::int64 value)                        { return InterlockedExchangeAdd64(p, value) + value; }
+        inline lx0::int64 _atomicCas (Atomic64* p, lx0::int64 value, lx0::int64 compare)    { return InterlockedCompareExchange64(p, value, compare); }
+#else
+        typedef volatile long long  Atomic64;
+
+        inline lx0::int64 _atomicAdd (Atomic64* p, lx0::int64 value)                        { return __sync_add_and_fetch(p, value); }
+        inline lx0::int64 _atomicCas (Atomic64* p, lx0::int64 value, lx0::int64 compare)    { return __sync_val_compare_and_swap(p, compare, value); }
+#endif
+
+        //
+        // Padded to a cache line so that threads allocating under different
+        // tags do not contend on the same line.
+        //
+        struct TagCounters
+        {
+            Atomic64    live;
+            Atomic64    peak;
+            Atomic64    total;
+            Atomic64    allocations;
+            Atomic64    frees;
+            char        _pad[64 - 5 * sizeof(Atomic64)];
+        };
+
+        // Zero-initialized static storage: usable before any constructors run
+        TagCounters s_counters[eMemoryTagCount];
+
+        __declspec(thread) int _memoryTag = eMemoryGeneral;
+
+        const char* s_tagNames[eMemoryTagCount] = 
+        {
+            "general",
+            "lxvar",
+            "dom",
+            "mesh",
+        };
+    }
+
+    //===========================================================================//
+
+    namespace detail
+    {
+#if LX_MEMORY_TRACKING
+        void
+        _lx_memory_alloc (MemoryTag tag, size_t bytes)
+        {
+            TagCounters& c = s_counters[tag];
+            _atomicAdd(&c.allocations, 1);
+            _atomicAdd(&c.total, lx0::int64(bytes));
+            
+            const lx0::int64 live = _atomicAdd(&c.live, lx0::int64(bytes));
+            lx0::int64 peak = c.peak;
+            while (live > peak)
+            {
+                const lx0::int64 prior = _atomicCas(&c.peak, live, peak);
+                if (prior == peak)
+                    break;
+                peak = prior;
+            }
+        }
+
+        void
+        _lx_memory_free (MemoryTag tag, size_t bytes)
+        {
+            TagCounters& c = s_counters[tag];
+            _atomicAdd(&c.frees, 1);
+            _atomicAdd(&c.live, -lx0::int64(bytes));
+        }
+#endif
+    }
+
+    using namespace detail;
+
+    //===========================================================================//
+
+#if LX_MEMORY_TRACKING && defined(LX_MEMORY_TRACKING_GLOBAL)
+    namespace
+    {
+        //
+        // Each block is prefixed with its size and tag so that the matching
+        // delete can be counted against the tag it was allocated under, even
+        // if it is freed from another scope or thread.
+        //
+        union BlockHeader
+        {
+            struct
+            {
+                size_t      bytes;
+                int         tag;
+            };
+            double          _align[2];
+        };
+
+        void* 
+        _trackedMalloc (size_t bytes, MemoryTag tag)
+        {
+            BlockHeader* pHeader = static_cast<BlockHeader*>( ::malloc(sizeof(BlockHeader) + bytes) );
+            if (!pHeader)
+                return nullptr;
+            pHeader->bytes = bytes;
+            pHeader->tag = tag;
+            _lx_memory_alloc(tag, bytes);
+            return pHeader + 1;
+        }
+
+        void
+        _trackedFree (void* p)
+        {
+            if (p)
+            {
+                BlockHeader* pHeader = static_cast<BlockHeader*>(p) - 1;
+                _lx_memory_free(MemoryTag(pHeader->tag), pHeader->bytes);
+                ::free(pHeader);
+            }
+        }
+
+        void*
+        _trackedNew (size_t bytes)
+        {
+            void* p = _trackedMalloc(bytes ? bytes : 1, MemoryTag(_memoryTag));
+            if (!p)
+                throw std::bad_alloc();
+            return p;
+        }
+    }
+#endif
+
+    //===========================================================================//
+
+    const char*
+    lx_memory_tag_name (MemoryTag tag)
+    {
+        return s_tagNames[tag];
+    }
+
+    void
+    lx_memory_stats (MemoryTag tag, MemoryStats& stats)
+    {
+        TagCounters& c = s_counters[tag];
+        stats.live        = lx0::uint64( _atomicAdd(&c.live, 0) );
+        stats.peak        = lx0::uint64( _atomicAdd(&c.peak, 0) );
+        stats.total       = lx0::uint64( _atomicAdd(&c.total, 0) );
+        stats.allocations = lx0::uint64( _atomicAdd(&c.allocations, 0) );
+        stats.frees       = lx0::uint64( _atomicAdd(&c.frees, 0) );
+    }
+
+    //! Returns the tag of the innermost MemoryScope on the calling thread
+    MemoryTag
+    lx_memory_tag (void)
+    {
+        return MemoryTag(_memoryTag);
+    }
+
+    void*
+    lx_memory_allocate (size_t bytes, MemoryTag tag)
+    {
+#if LX_MEMORY_TRACKING && defined(LX_MEMORY_TRACKING_GLOBAL)
+        void* p = _trackedMalloc(bytes ? bytes : 1, tag);
+        if (!p)
+            throw std::bad_alloc();
+        return p;
+#else
+        void* p = ::operator new(bytes);
+        _lx_memory_alloc(tag, bytes);
+        return p;
+#endif
+    }
+
+    void
+    lx_memory_deallocate (void* p, size_t bytes, MemoryTag tag)
+    {
+#if LX_MEMORY_TRACKING && defined(LX_MEMORY_TRACKING_GLOBAL)
+        _trackedFree(p);
+#else
+        if (p)
+            _lx_memory_free(tag, bytes);
+        ::operator delete(p);
+#endif
+    }
+
+    //===========================================================================//
+
+    MemoryScope::MemoryScope (MemoryTag tag)
+        : mPrevious (MemoryTag(_memoryTag))
+    {
+        _memoryTag = tag;
+    }
+
+    MemoryScope::~MemoryScope (void)
+    {
+        _memoryTag = mPrevious;
+    }
+
+}}}
+
+//===========================================================================//
+//   G L O B A L   O P E R A T O R S
+//===========================================================================//
+
+#if LX_MEMORY_TRACKING && defined(LX_MEMORY_TRACKING_GLOBAL)
+
+void* operator new      (size_t bytes)                          { return lx0::core::memory_ns::_trackedNew(bytes); }
+void* operator new[]    (size_t bytes)                          { return lx0::core::memory_ns::_trackedNew(bytes); }
+void* operator new      (size_t bytes, const std::nothrow_t&)   { return lx0::core::memory_ns::_trackedMalloc(bytes ? bytes : 1, lx0::core::memory_ns::lx_memory_tag()); }
+void* operator new[]    (size_t bytes, const std::nothrow_t&)   { return lx0::core::memory_ns::_trackedMalloc(bytes ? bytes : 1, lx0::core::memory_ns::lx_memory_tag()); }
+void  operator delete   (void* p)                               { lx0::core::memory_ns::_trackedFree(p); }
+void  operator delete[] (void* p)                               { lx0::core::memory_ns::_trackedFree(p); }
+void  operator delete   (void* p, const std::nothrow_t&)        { lx0::core::memory_ns::_trackedFree(p); }
+void  operator delete[] (void* p, const std::nothrow_t&)        { lx0::core::memory_ns::_trackedFree(p); }
+
+#endif
@@ -39,19 +39,31 @@ using namespace lx0;
 
 namespace lec = lx0::elements::core_ns;
 
+/*!
+    All the included documents are discovered first and then loaded together
+    so that the files, and the resources they reference, load in parallel.
+ */
 void lec::processIncludeDocument (DocumentPtr spDocument)
 {
     EnginePtr spEngine = Engine::acquire();
 
     auto includes = spDocument->getElementsByTagName("IncludeDocument");
+    if (includes.empty())
+        return;
+
+    std::vector<std::string> filenames;
     for (auto it = includes.begin(); it != includes.end(); ++it)
+        filenames.push_back( (*it)->attr("src").as<std::string>() );
+
+    auto documents = spEngine->loadDocuments(filenames);
+
+    for (size_t i = 0; i < includes.size(); ++i)
     {
-        std::string filename = (*it)->attr("src").as<std::string>();
-        auto spParent = (*it)->parent();
+        auto spParent = includes[i]->parent();
+        auto& spDoc2 = documents[i];
 
-        auto spDoc2 = spEngine->loadDocument(filename);
         spDoc2->iterateElements2([&](ElementPtr spElem) {
-            spParent->append( spElem->cloneDeep() );
+            spParent->append( spElem->cloneDeep(spDocument.get()) );
         });
         spEngine->closeDocument(spDoc2);
     }
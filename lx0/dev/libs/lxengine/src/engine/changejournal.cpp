@@ -0,0 +1,137 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+    * MIT License (http://www.opensource.org/licenses/mit-license.php)
+
+    Copyright (c) 2010-2012 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a
+    copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+//===========================================================================//
+//   H E A D E R S
+//===========================================================================//
+
+#include <algorithm>
+
+#include <lx0/engine/changejournal.hpp>
+#include <lx0/engine/element.hpp>
+
+namespace lx0 { namespace engine_ns {
+
+    ChangeJournal::ChangeJournal (void)
+        : mbEnabled     (false)
+        , mCapacity     (64 * 1024)
+        , mTrimmedStamp (0)
+    {
+    }
+
+    void
+    ChangeJournal::enable (bool bEnabled)
+    {
+        if (mbEnabled != bEnabled)
+        {
+            mbEnabled = bEnabled;
+            clear();
+        }
+    }
+
+    //! Returns the stamp of the most recent entry; use as the initial cursor
+    lx0::uint64
+    ChangeJournal::head (void) const
+    {
+        return mEntries.empty() ? mTrimmedStamp : mEntries.back().stamp;
+    }
+
+    /*!
+        Appends all entries newer than cursor to changes and advances cursor to
+        the head of the journal.
+
+        Returns false if entries newer than cursor have already been trimmed.
+        In that case, the changes list is incomplete and the consumer should
+        rebuild from the full Document (or a snapshot) instead.
+     */
+    bool
+    ChangeJournal::read (lx0::uint64& cursor, std::vector<ChangeEntry>& changes) const
+    {
+        bool bComplete = (cursor >= mTrimmedStamp);
+
+        auto it = std::upper_bound(mEntries.begin(), mEntries.end(), cursor, [](lx0::uint64 stamp, const ChangeEntry& e) {
+            return stamp < e.stamp;
+        });
+        changes.insert(changes.end(), it, mEntries.end());
+
+        cursor = head();
+        return bComplete;
+    }
+
+    void
+    ChangeJournal::record (Element* pElem, ChangeEntry::Field field, lx0::uint64 stamp, lx0::uint32 frame, const char* name)
+    {
+        ElementWPtr wpElem = pElem->shared_from_this();
+
+        //
+        // Coalesce repeated modifications of the same field within a frame
+        // (e.g. a value updated every time a physics step runs).
+        //
+        if (!mEntries.empty())
+        {
+            ChangeEntry& last = mEntries.back();
+            if (last.field == field
+                && last.frame == frame
+                && !last.wpElement.owner_before(wpElem) && !wpElem.owner_before(last.wpElement)
+                && (name ? last.name == name : last.name.empty()))
+            {
+                last.stamp = stamp;
+                return;
+            }
+        }
+
+        mEntries.push_back(ChangeEntry());
+        ChangeEntry& entry = mEntries.back();
+        entry.stamp     = stamp;
+        entry.frame     = frame;
+        entry.wpElement = wpElem;
+        entry.field     = field;
+        if (name)
+            entry.name = name;
+    }
+
+    void
+    ChangeJournal::trim (void)
+    {
+        while (mEntries.size() > mCapacity)
+        {
+            mTrimmedStamp = mEntries.front().stamp;
+            mEntries.pop_front();
+        }
+    }
+
+    void
+    ChangeJournal::clear (void)
+    {
+        if (!mEntries.empty())
+            mTrimmedStamp = mEntries.back().stamp;
+        mEntries.clear();
+    }
+
+}}
@@ -0,0 +1,181 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+    * MIT License (http://www.opensource.org/licenses/mit-license.php)
+
+    Copyright (c) 2010-2012 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a
+    copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+
+//===========================================================================//
+//   H E A D E R S
+//===========================================================================//
+
+#include <new>
+#include <boost/interprocess/detail/atomic.hpp>
+
+#include <lx0/lxengine.hpp>
+#include <lx0/engine/detail/elementpool.hpp>
+
+namespace lx0 { namespace engine_ns { namespace detail { 
+
+    volatile boost::uint32_t ElementPool::s_generation = 0;
+
+    //---------------------------------------------------------------------------//
+
+    ElementPool::ElementPool (void)
+    {
+    }
+
+    /*!
+        Every Element holds a reference to its pool, so by the time the pool 
+        is destroyed all slots have already been released.
+     */
+    ElementPool::~ElementPool (void)
+    {
+        lx_assert(mFreeList.size() == mGenerations.size(), "ElementPool destroyed with live Elements");
+
+        for (auto it = mChunks.begin(); it != mChunks.end(); ++it)
+            lx_memory_deallocate(*it, sizeof(Storage) * kChunkSize, eMemoryDom);
+    }
+
+    //---------------------------------------------------------------------------//
+
+    ElementPtr
+    ElementPool::create (void)
+    {
+        lx0::uint32 index;
+        lx0::uint32 generation;
+        Element*    pElem;
+        {
+            boost::lock_guard<boost::mutex> lock(mMutex);
+
+            if (mFreeList.empty())
+            {
+                const lx0::uint32 base = lx0::uint32(mGenerations.size());
+                mChunks.push_back( static_cast<Storage*>(lx_memory_allocate(sizeof(Storage) * kChunkSize, eMemoryDom)) );
+                mGenerations.resize(base + kChunkSize, 0);
+                
+                // Push in reverse so that slots are handed out in address order
+                mFreeList.reserve(mGenerations.size());
+                for (lx0::uint32 i = kChunkSize; i > 0; --i)
+                    mFreeList.push_back(base + i - 1);
+            }
+            index = mFreeList.back();
+            mFreeList.pop_back();
+
+            // Generation 0 marks a free slot, so skip it on wrap-around
+            do {
+                generation = boost::interprocess::detail::atomic_inc32(&s_generation) + 1;
+            } while (generation == 0);
+
+            mGenerations[index] = generation;
+            pElem = _slot(index);
+        }
+
+        new (pElem) Element;
+        pElem->mHandle.index = index;
+        pElem->mHandle.generation = generation;
+        pElem->mpPool = this;
+
+        Deleter deleter;
+        deleter.spPool = shared_from_this();
+        deleter.index = index;
+        return ElementPtr(pElem, deleter);
+    }
+
+    //---------------------------------------------------------------------------//
+    /*!
+        Returns the Element referred to by the handle or nullptr if that 
+        Element has been destroyed (or was not created by this pool).
+
+        The returned pointer is non-owning: it is valid only as long as some 
+        other reference (e.g. the Element's parent) keeps the Element alive.
+     */
+    Element*
+    ElementPool::resolve (ElementHandle handle) const
+    {
+        boost::lock_guard<boost::mutex> lock(mMutex);
+
+        if (handle.index < mGenerations.size() 
+            && handle.generation != 0
+            && mGenerations[handle.index] == handle.generation)
+            return _slot(handle.index);
+        else
+            return nullptr;
+    }
+
+    //---------------------------------------------------------------------------//
+
+    size_t
+    ElementPool::size (void) const
+    {
+        boost::lock_guard<boost::mutex> lock(mMutex);
+        return mGenerations.size() - mFreeList.size();
+    }
+
+    size_t
+    ElementPool::capacity (void) const
+    {
+        boost::lock_guard<boost::mutex> lock(mMutex);
+        return mGenerations.size();
+    }
+
+    //---------------------------------------------------------------------------//
+
+    Element*
+    ElementPool::_slot (lx0::uint32 index) const
+    {
+        return reinterpret_cast<Element*>( &mChunks[index / kChunkSize][index % kChunkSize] );
+    }
+
+    void
+    ElementPool::_invalidate (lx0::uint32 index)
+    {
+        boost::lock_guard<boost::mutex> lock(mMutex);
+        mGenerations[index] = 0;
+    }
+
+    void
+    ElementPool::_release (lx0::uint32 index)
+    {
+        boost::lock_guard<boost::mutex> lock(mMutex);
+        mFreeList.push_back(index);
+    }
+
+    /*!
+        Destroys the Element in place and returns its slot to the pool.  The
+        handle is invalidated before the destructor runs, so it never resolves
+        to a partially destroyed Element, and the slot is not reused until the
+        destructor has completed.
+     */
+    void
+    ElementPool::Deleter::operator() (Element* pElem)
+    {
+        spPool->_invalidate(index);
+        pElem->~Element();
+        spPool->_release(index);
+    }
+
+}}}
@@ -190,6 +190,14 @@ namespace lx0 { namespace engine_ns { namespace detail {
     }
 
 
+    //! Number of pending events, including delayed events
+    size_t
+    EventQueue::size (void)
+    {
+        boost::lock_guard<boost::mutex> lock(mMutex);
+        return mRealtimeQueue.size() + mRealtimeDelayed.size() + mFrametimeQueue.size() + mFrametimeDelayed.size();
+    }
+
     void
     EventQueue::enqueue (int time, Event& evt)
     {
@@ -0,0 +1,208 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+    * MIT License (http://www.opensource.org/licenses/mit-license.php)
+
+    Copyright (c) 2010-2012 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a
+    copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+
+//===========================================================================//
+//   H E A D E R S
+//===========================================================================//
+
+#include <deque>
+#include <algorithm>
+#include <boost/thread.hpp>
+#include <boost/interprocess/detail/atomic.hpp>
+
+#include <lx0/lxengine.hpp>
+#include <lx0/engine/detail/resourcebatch.hpp>
+#include <lx0/util/misc/util.hpp>
+
+namespace lx0 { namespace engine_ns { namespace detail { 
+
+    namespace
+    {
+        //
+        // The completion state is reference counted so that it remains valid 
+        // until the last worker thread has finished touching it, even after
+        // the calling thread has returned from run().
+        //
+        struct Completion
+        {
+            boost::mutex                mMutex;
+            boost::condition_variable   mCondition;
+            std::deque<size_t>          mCompleted;
+
+            void push (size_t index)
+            {
+                boost::lock_guard<boost::mutex> lock(mMutex);
+                mCompleted.push_back(index);
+                mCondition.notify_one();
+            }
+
+            size_t pop (void)
+            {
+                boost::unique_lock<boost::mutex> lock(mMutex);
+                while (mCompleted.empty())
+                    mCondition.wait(lock);
+
+                size_t index = mCompleted.front();
+                mCompleted.pop_front();
+                return index;
+            }
+        };
+    }
+
+    //---------------------------------------------------------------------------//
+
+    void
+    ResourceBatch::add (std::string name, std::function<void()> load, std::function<void()> complete)
+    {
+        Resource res;
+        res.name       = name;
+        res.load       = load;
+        res.complete   = complete;
+        res.bFailed    = false;
+        res.durationMs = 0;
+        res.latencyMs  = 0;
+        mResources.push_back(res);
+    }
+
+    //---------------------------------------------------------------------------//
+    /*!
+        Loads all resources in the batch and then calls the complete functions
+        in order.  Blocks until done.
+
+        If any load fails, the remaining loads still run to completion, no 
+        complete functions are called, and an exception is thrown for the
+        first failed resource.
+     */
+    void
+    ResourceBatch::run (void)
+    {
+        const size_t count = mResources.size();
+        if (count == 0)
+            return;
+
+        const lx0::uint32 startMs = lx0::lx_milliseconds();
+        std::shared_ptr<Completion> spCompletion(new Completion);
+
+        //
+        // Dispatch the loads
+        //
+        boost::thread_group threads;
+        auto spEngine = Engine::acquire();
+        if (spEngine->hasWorkerThreads())
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                spEngine->sendWorkerTask([this, i, startMs, spCompletion]() {
+                    _load(i, startMs);
+                    spCompletion->push(i);
+                });
+            }
+        }
+        else
+        {
+            std::shared_ptr<volatile boost::uint32_t> spNext(new boost::uint32_t(0));
+            const size_t threadCount = std::min<size_t>(count, std::max(1u, boost::thread::hardware_concurrency()));
+            
+            for (size_t t = 0; t < threadCount; ++t)
+            {
+                threads.create_thread([this, count, startMs, spCompletion, spNext]() {
+                    for (size_t i = boost::interprocess::detail::atomic_inc32(spNext.get()); 
+                         i < count; 
+                         i = boost::interprocess::detail::atomic_inc32(spNext.get()))
+                    {
+                        _load(i, startMs);
+                        spCompletion->push(i);
+                    }
+                });
+            }
+        }
+
+        //
+        // Report progress as each resource completes
+        //
+        lx0::uint32 totalMs = 0;
+        for (size_t done = 1; done <= count; ++done)
+        {
+            const Resource& res = mResources[ spCompletion->pop() ];
+            totalMs += res.durationMs;
+
+            if (res.bFailed)
+                lx_warn("Failed to load '%1%' (%2%/%3%): %4%", res.name, done, count, res.error);
+            else
+                lx_log("Loaded '%1%' (%2%/%3%) in %4% ms, %5% ms after start", res.name, done, count, res.durationMs, res.latencyMs);
+        }
+        threads.join_all();
+
+        lx_log("Loaded %1% resources in %2% ms (%3% ms if loaded serially)", count, lx0::lx_milliseconds() - startMs, totalMs);
+
+        //
+        // Assemble the results on this thread, in order
+        //
+        for (auto it = mResources.begin(); it != mResources.end(); ++it)
+        {
+            if (it->bFailed)
+                throw lx_error_exception("Could not load resource '%s'.  %s", it->name.c_str(), it->error.c_str());
+        }
+        for (auto it = mResources.begin(); it != mResources.end(); ++it)
+        {
+            if (it->complete)
+                it->complete();
+        }
+    }
+
+    //---------------------------------------------------------------------------//
+
+    void
+    ResourceBatch::_load (size_t index, lx0::uint32 startMs)
+    {
+        Resource& res = mResources[index];
+        
+        const lx0::uint32 loadStartMs = lx0::lx_milliseconds();
+        try
+        {
+            res.load();
+        }
+        catch (std::exception& e)
+        {
+            res.bFailed = true;
+            res.error = e.what();
+        }
+        catch (...)
+        {
+            res.bFailed = true;
+            res.error = "Unknown exception.";
+        }
+        
+        const lx0::uint32 endMs = lx0::lx_milliseconds();
+        res.durationMs = endMs - loadStartMs;
+        res.latencyMs = endMs - startMs;
+    }
+
+}}}
@@ -0,0 +1,478 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+    * MIT License (http://www.opensource.org/licenses/mit-license.php)
+
+    Copyright (c) 2010-2012 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a
+    copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+
+//===========================================================================//
+//   H E A D E R S
+//===========================================================================//
+
+#include <cstring>
+#include <algorithm>
+
+#include <lx0/lxengine.hpp>
+#include <lx0/util/misc/util.hpp>
+#include <lx0/engine/detail/xmlreader.hpp>
+
+namespace {
+
+    inline bool is_space (char c)
+    {
+        return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+    }
+
+    inline bool is_name_start (char c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == ':' || (unsigned char)c >= 0x80;
+    }
+
+    inline bool is_name_char (char c)
+    {
+        return is_name_start(c) || (c >= '0' && c <= '9') || c == '-' || c == '.';
+    }
+
+    void append_utf8 (std::string& out, unsigned long cp)
+    {
+        if (cp < 0x80)
+            out.push_back(char(cp));
+        else if (cp < 0x800)
+        {
+            out.push_back(char(0xC0 | (cp >> 6)));
+            out.push_back(char(0x80 | (cp & 0x3F)));
+        }
+        else if (cp < 0x10000)
+        {
+            out.push_back(char(0xE0 | (cp >> 12)));
+            out.push_back(char(0x80 | ((cp >> 6) & 0x3F)));
+            out.push_back(char(0x80 | (cp & 0x3F)));
+        }
+        else
+        {
+            out.push_back(char(0xF0 | (cp >> 18)));
+            out.push_back(char(0x80 | ((cp >> 12) & 0x3F)));
+            out.push_back(char(0x80 | ((cp >> 6) & 0x3F)));
+            out.push_back(char(0x80 | (cp & 0x3F)));
+        }
+    }
+}
+
+//===========================================================================//
+//   I M P L E M E N T A T I O N
+//===========================================================================//
+
+namespace lx0 { namespace engine_ns { namespace detail { 
+
+    /*!
+        Returns the unique, reader-owned copy of the given name.  Looking up a
+        name that has already been seen does not allocate.
+     */
+    const std::string&
+    XmlReader::intern (const char* p, size_t length)
+    {
+        const size_t hash = size_t( lx_fnv1a(p, length) );
+
+        auto range = mNames.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            const std::string& name = *it->second;
+            if (name.size() == length && memcmp(name.data(), p, length) == 0)
+                return name;
+        }
+
+        mNameStorage.push_back(std::string(p, length));
+        const std::string* pName = &mNameStorage.back();
+        mNames.insert(std::make_pair(hash, pName));
+        return *pName;
+    }
+
+    void
+    XmlReader::parse (const char* pBegin, const char* pEnd, Handler& handler, const std::string& filename)
+    {
+        mp          = pBegin;
+        mpEnd       = pEnd;
+        mLine       = 1;
+        mTextLine   = 1;
+        mpHandler   = &handler;
+        mpFilename  = &filename;
+        mbRootClosed = false;
+        mOpen.clear();
+        mText.clear();
+
+        // Skip the UTF-8 byte order mark
+        if (mpEnd - mp >= 3 && memcmp(mp, "\xEF\xBB\xBF", 3) == 0)
+            mp += 3;
+
+        while (mp < mpEnd)
+        {
+            if (*mp != '<')
+            {
+                _readCharData();
+            }
+            else if (_startsWith("<!--"))
+            {
+                _flushText();
+
+                const int   line   = mLine;
+                const char* pClose = _find("-->", "comment");
+                
+                // Comments outside the root element are not part of any Element
+                if (!mOpen.empty())
+                {
+                    mComment.assign(mp + 4, pClose);
+                    mpHandler->comment(mComment, line);
+                }
+                _advance(pClose + 3);
+            }
+            else if (_startsWith("<![CDATA["))
+            {
+                if (mOpen.empty())
+                    _error("CDATA section outside of the root element");
+
+                const char* pClose = _find("]]>", "CDATA section");
+                if (mText.empty())
+                    mTextLine = mLine;
+                mText.append(mp + 9, pClose);
+                _advance(pClose + 3);
+            }
+            else if (_startsWith("<?"))
+            {
+                _advance(_find("?>", "processing instruction") + 2);
+            }
+            else if (_startsWith("<!"))
+            {
+                //
+                // DOCTYPE or another declaration: skip it, including any 
+                // internal subset in brackets
+                //
+                int depth = 0;
+                const char* p = mp + 2;
+                for (; p < mpEnd && (*p != '>' || depth > 0); ++p)
+                {
+                    if (*p == '[')
+                        ++depth;
+                    else if (*p == ']')
+                        --depth;
+                }
+                if (p == mpEnd)
+                    _error("unterminated declaration");
+                _advance(p + 1);
+            }
+            else if (_startsWith("</"))
+            {
+                _flushText();
+                _readEndTag();
+            }
+            else
+            {
+                _flushText();
+                _readStartTag();
+            }
+        }
+
+        if (!mOpen.empty())
+            throw lx_error_exception("XML format error in '%s': unexpected end of file.  Element '%s' is not closed.", filename, *mOpen.back());
+        if (!mbRootClosed)
+            throw lx_error_exception("The file '%s' appears to contain no data.", filename);
+    }
+
+    void
+    XmlReader::_error (const std::string& message)
+    {
+        throw lx_error_exception("XML format error in '%s' at line %d: %s", *mpFilename, mLine, message);
+    }
+
+    bool
+    XmlReader::_startsWith (const char* s) const
+    {
+        const size_t len = strlen(s);
+        return size_t(mpEnd - mp) >= len && memcmp(mp, s, len) == 0;
+    }
+
+    //! Moves the read position forward to p, keeping the line count current
+    void
+    XmlReader::_advance (const char* p)
+    {
+        mLine += int( std::count(mp, p, '\n') );
+        mp = p;
+    }
+
+    //! Returns the next occurrence of s; it is an error if there is none
+    const char*
+    XmlReader::_find (const char* s, const char* context)
+    {
+        const char* p = std::search(mp, mpEnd, s, s + strlen(s));
+        if (p == mpEnd)
+            _error(std::string("unterminated ") + context);
+        return p;
+    }
+
+    void
+    XmlReader::_skipSpace (void)
+    {
+        for (; mp < mpEnd && is_space(*mp); ++mp)
+        {
+            if (*mp == '\n')
+                ++mLine;
+        }
+    }
+
+    const std::string&
+    XmlReader::_readName (void)
+    {
+        const char* pStart = mp;
+        if (mp >= mpEnd || !is_name_start(*mp))
+            _error("expected a name");
+        
+        while (mp < mpEnd && is_name_char(*mp))
+            ++mp;
+        return intern(pStart, mp - pStart);
+    }
+
+    void
+    XmlReader::_readStartTag (void)
+    {
+        if (mbRootClosed)
+            _error("the document has more than one root element");
+
+        const int line = mLine;
+        ++mp;
+        const std::string& name = _readName();
+
+        mAttributes.clear();
+        bool bEmpty = false;
+        for (;;)
+        {
+            _skipSpace();
+            if (mp >= mpEnd)
+                _error("unexpected end of file in start tag '" + name + "'");
+
+            if (*mp == '>')
+            {
+                ++mp;
+                break;
+            }
+            else if (*mp == '/')
+            {
+                if (mp + 1 == mpEnd || mp[1] != '>')
+                    _error("expected '/>' in start tag '" + name + "'");
+                mp += 2;
+                bEmpty = true;
+                break;
+            }
+
+            mAttributes.push_back(Attribute());
+            Attribute& attr = mAttributes.back();
+            attr.pName = &_readName();
+
+            _skipSpace();
+            if (mp >= mpEnd || *mp != '=')
+                _error("expected '=' after attribute '" + *attr.pName + "'");
+            ++mp;
+            _skipSpace();
+            if (mp >= mpEnd || (*mp != '"' && *mp != '\''))
+                _error("expected a quoted value for attribute '" + *attr.pName + "'");
+
+            const char quote = *mp++;
+            while (mp < mpEnd && *mp != quote)
+            {
+                if (*mp == '&')
+                    _readReference(attr.value);
+                else
+                {
+                    const char* pStart = mp;
+                    while (mp < mpEnd && *mp != quote && *mp != '&')
+                        ++mp;
+                    attr.value.append(pStart, mp);
+                    mLine += int( std::count(pStart, mp, '\n') );
+                }
+            }
+            if (mp >= mpEnd)
+                _error("unterminated value for attribute '" + *attr.pName + "'");
+            ++mp;
+        }
+
+        mOpen.push_back(&name);
+        mpHandler->startElement(name, mAttributes, line);
+
+        if (bEmpty)
+        {
+            mOpen.pop_back();
+            mpHandler->endElement(name);
+            mbRootClosed = mOpen.empty();
+        }
+    }
+
+    void
+    XmlReader::_readEndTag (void)
+    {
+        mp += 2;
+        const std::string& name = _readName();
+        _skipSpace();
+        if (mp >= mpEnd || *mp != '>')
+            _error("expected '>' in end tag '" + name + "'");
+        ++mp;
+
+        // Names are interned, so comparing the pointers is sufficient
+        if (mOpen.empty())
+            _error("unexpected end tag '" + name + "'");
+        else if (mOpen.back() != &name)
+            _error("end tag '" + name + "' does not match start tag '" + *mOpen.back() + "'");
+
+        mOpen.pop_back();
+        mpHandler->endElement(name);
+        mbRootClosed = mOpen.empty();
+    }
+
+    /*!
+        Reads text up to the next markup, condensing whitespace as it goes.
+        The text is accumulated until the next element or comment so that
+        text split by a CDATA section is reported as a single event.
+     */
+    void
+    XmlReader::_readCharData (void)
+    {
+        if (mOpen.empty())
+        {
+            for (; mp < mpEnd && *mp != '<'; ++mp)
+            {
+                if (*mp == '\n')
+                    ++mLine;
+                else if (!is_space(*mp))
+                    _error("text outside of the root element");
+            }
+            return;
+        }
+
+        bool bStarted = false;
+        bool bSpace = false;
+        while (mp < mpEnd && *mp != '<')
+        {
+            const char c = *mp;
+            if (is_space(c))
+            {
+                if (c == '\n')
+                    ++mLine;
+                bSpace = true;
+                ++mp;
+                continue;
+            }
+
+            if (!bStarted)
+            {
+                bStarted = true;
+                if (mText.empty())
+                    mTextLine = mLine;
+            }
+            else if (bSpace)
+                mText.push_back(' ');
+            bSpace = false;
+
+            if (c == '&')
+                _readReference(mText);
+            else
+            {
+                mText.push_back(c);
+                ++mp;
+            }
+        }
+    }
+
+    /*!
+        Decodes the character reference at the read position.  As with 
+        TinyXML, an unrecognized reference is passed through literally.
+     */
+    void
+    XmlReader::_readReference (std::string& out)
+    {
+        const char* pLimit = std::min(mp + 12, mpEnd);
+        const char* pSemi = std::find(mp, pLimit, ';');
+        
+        const char*  s = mp + 1;
+        const size_t n = pSemi - s;
+        bool bDecoded = true;
+
+        if (pSemi == pLimit)
+            bDecoded = false;
+        else if (n >= 2 && s[0] == '#')
+        {
+            const bool  bHex    = (s[1] == 'x' || s[1] == 'X');
+            const char* pDigits = s + (bHex ? 2 : 1);
+            
+            unsigned long cp = 0;
+            bDecoded = (pDigits < pSemi);
+            for (const char* p = pDigits; p < pSemi && bDecoded; ++p)
+            {
+                int digit;
+                if (*p >= '0' && *p <= '9')
+                    digit = *p - '0';
+                else if (bHex && *p >= 'a' && *p <= 'f')
+                    digit = *p - 'a' + 10;
+                else if (bHex && *p >= 'A' && *p <= 'F')
+                    digit = *p - 'A' + 10;
+                else
+                    digit = -1;
+                
+                if (digit < 0)
+                    bDecoded = false;
+                else
+                {
+                    cp = cp * (bHex ? 16 : 10) + digit;
+                    bDecoded = (cp <= 0x10FFFF);
+                }
+            }
+            if (bDecoded)
+                append_utf8(out, cp);
+        }
+        else if (n == 2 && memcmp(s, "lt", 2) == 0)     out.push_back('<');
+        else if (n == 2 && memcmp(s, "gt", 2) == 0)     out.push_back('>');
+        else if (n == 3 && memcmp(s, "amp", 3) == 0)    out.push_back('&');
+        else if (n == 4 && memcmp(s, "quot", 4) == 0)   out.push_back('"');
+        else if (n == 4 && memcmp(s, "apos", 4) == 0)   out.push_back('\'');
+        else
+            bDecoded = false;
+
+        if (bDecoded)
+            mp = pSemi + 1;
+        else
+        {
+            out.push_back('&');
+            ++mp;
+        }
+    }
+
+    void
+    XmlReader::_flushText (void)
+    {
+        if (!mText.empty())
+        {
+            mpHandler->text(mText, mTextLine);
+            mText.clear();
+        }
+    }
+
+}}}
@@ -33,8 +33,11 @@
 
 #include <cassert>
 #include <string>
+#include <algorithm>
 
 #include <lx0/lxengine.hpp>
+#include <lx0/engine/snapshot.hpp>
+#include <lx0/engine/detail/elementpool.hpp>
 
 namespace {
 
@@ -55,17 +58,22 @@ namespace {
             }
         }
     } profile;
+
+    lx0::ObjectTracker s_documentCount("Document");
 }
 
 namespace lx0 { namespace engine_ns {
 
     Document::Document()
-        : m_spRoot     ( new Element )
-        , m_documentId (0)
+        : mspElementPool ( new detail::ElementPool )
+        , m_documentId   (0)
+        , mVersion       (1)
     {
+        m_spRoot = mspElementPool->create();
+
         auto spEngine = Engine::acquire();
         profile.initialize();
-        spEngine->incObjectCount("Document");
+        s_documentCount.inc();
         m_documentId = spEngine->generateId();
 
         lx_log("Constructed Document %1%", m_documentId);
@@ -91,10 +99,10 @@ namespace lx0 { namespace engine_ns {
 
         lx_log("Destructed Document %1%", m_documentId);
 
-        Engine::acquire()->decObjectCount("Document");
+        s_documentCount.dec();
     }
 
-    //! Reserved for future use.  Do not use.
+    //! Create a new Transaction for batching modifications to the Document
     /*!
      */
     TransactionPtr 
@@ -102,11 +110,40 @@ namespace lx0 { namespace engine_ns {
     {
         assert(this);
 
-        TransactionPtr sp(new Transaction);
+        // Prune any transactions that have since been released
+        m_openTransactions.erase(
+            std::remove_if(m_openTransactions.begin(), m_openTransactions.end(), [](TransactionWPtr& wp) { return wp.expired(); }),
+            m_openTransactions.end()
+        );
+
+        TransactionPtr sp(new Transaction(this));
         m_openTransactions.push_back(sp);
         return sp;
     }
 
+    //---------------------------------------------------------------------------//
+    //! Create an immutable snapshot of the Document for reading on other threads
+    /*!
+        Must be called on the main thread.  The cost is proportional to the
+        number of Elements modified since the last snapshot: unchanged sub-trees
+        are shared with the prior snapshot.
+
+        The returned snapshot may then be passed to a worker thread and read 
+        while the main thread continues to modify the Document.
+     */
+    DocumentSnapshotPtr
+    Document::snapshot (void)
+    {
+        return snapshot(m_spRoot);
+    }
+
+    DocumentSnapshotPtr
+    Document::snapshot (ElementPtr spSubtree)
+    {
+        lx_check_error(spSubtree.get() != nullptr);
+        return DocumentSnapshotPtr( new DocumentSnapshot(mVersion, spSubtree->_snapshot()) );
+    }
+
     ViewPtr
     Document::createView (std::string type, std::string name)
     {
@@ -174,9 +211,24 @@ namespace lx0 { namespace engine_ns {
         m_spRoot = spRoot; 
 
         spOldRoot->notifyRemoved(this);
+        m_spRoot->_touchTree();
         m_spRoot->notifyAdded(this);
     }
 
+    //---------------------------------------------------------------------------//
+    //! Returns the Element referred to by the handle, or nullptr if it has been destroyed
+    /*!
+        Only Elements created by this Document (via createElement(), by 
+        cloning such an Element, or by cloneDeep() with this Document) can be
+        resolved.  The returned pointer is 
+        non-owning.
+     */
+    Element*
+    Document::resolve (ElementHandle handle) const
+    {
+        return mspElementPool->resolve(handle);
+    }
+
     //---------------------------------------------------------------------------//
     //! Create a new Element that can be added to the Document
     /*!
@@ -184,10 +236,7 @@ namespace lx0 { namespace engine_ns {
     ElementPtr     
     Document::createElement (std::string tagName)
     {
-        // At the moment, there's no need for this to be a method on Document - 
-        // but eventually Document may want to track the elements it creates.
-        
-        ElementPtr spElem(new Element);
+        ElementPtr spElem = mspElementPool->create();
         spElem->tagName(tagName);
 
         slotElementCreated(spElem);
@@ -324,6 +373,9 @@ namespace lx0 { namespace engine_ns {
     {
         lx0::ProfileSection section(profile.update);
 
+        mVersion++;
+        mJournal.trim();
+
         _foreach ([&](ComponentPtr it) {                        
             it->onUpdate(shared_from_this());
         });          
@@ -354,35 +406,84 @@ namespace lx0 { namespace engine_ns {
 
     void 
     Document::notifyElementAdded (ElementPtr spElem)
+    {
+        std::vector<ElementPtr> elements(1, spElem);
+        _notifyElementsAdded(elements);
+    }
+
+    /*!
+        Sends out the notifications for a batch of Elements, in order, that 
+        have just been added to the Document (see Element::notifyAdded()).
+
+        The registered Element components are first instantiated by tag for 
+        the whole batch.  The Document components, slotElementAdded, and the
+        Element components are then notified per Element.
+
+        A callback may modify the tree: an Element of the batch that has been
+        removed from the Document by the time its turn comes is skipped.
+     */
+    void
+    Document::_notifyElementsAdded (const std::vector<ElementPtr>& elements)
     {
         // Automatically attach all registered Element components for the given tag
         //
-        auto comps = Engine::acquire()->elementComponents();
+        auto spEngine = Engine::acquire();
+        const auto& comps = spEngine->elementComponents();
 
-        auto jt = comps.find( spElem->tagName() );
-        if (jt != comps.end())
+        if (!comps.empty())
         {
-            for (auto it = jt->second.begin(); it != jt->second.end(); ++it)
+            for (auto kt = elements.begin(); kt != elements.end(); ++kt)
             {
-                // Don't add it twice.  This theoretically could happen if the element is added
-                // to the document, then removed, and re-added.  
-                const auto& name = it->first;
-                auto& ctor = it->second;
-                if (spElem->getComponent<Element::Component>(name).get() == nullptr)
+                const ElementPtr& spElem = *kt;
+                if (spElem->mpDocument != this)
+                    continue;
+
+                auto jt = comps.find( spElem->mTagName );
+                if (jt != comps.end())
                 {
-                    spElem->attachComponent((ctor)(spElem));
+                    for (auto it = jt->second.begin(); it != jt->second.end(); ++it)
+                    {
+                        // Don't add it twice.  This theoretically could happen if the element is added
+                        // to the document, then removed, and re-added.  
+                        const auto& name = it->first;
+                        auto& ctor = it->second;
+                        if (spElem->getComponent<Element::Component>(name).get() == nullptr)
+                        {
+                            spElem->attachComponent((ctor)(spElem));
+                        }
+                    }
                 }
             }
         }
 
-        // Pass on notification to attached components and slots
+        // Pass on notification to attached components and slots.  The Document
+        // pointer is acquired lazily as the root Element is added from within 
+        // the Document constructor.
         //
-        _foreach ([&](ComponentPtr it) {
-            it->onElementAdded(shared_from_this(), spElem);
-        });   
-        slotElementAdded(spElem);
+        DocumentPtr spThis;
+        for (auto kt = elements.begin(); kt != elements.end(); ++kt)
+        {
+            const ElementPtr& spElem = *kt;
+            Element* pElem = spElem.get();
+            if (pElem->mpDocument != this)
+                continue;
 
-        notifyFlagsModified(spElem.get());
+            if (!mComponents.empty())
+            {
+                if (!spThis)
+                    spThis = shared_from_this();
+                _foreach ([&](ComponentPtr it) {
+                    it->onElementAdded(spThis, spElem);
+                });   
+            }
+            slotElementAdded(spElem);
+
+            pElem->foreachComponent([](Element::ComponentPtr it) {
+                it->onAdded();
+            });
+
+            notifyFlagsModified(pElem);
+        }
     }
 
     void 
@@ -37,19 +37,28 @@
 #include <lx0/engine/element.hpp>
 #include <lx0/engine/object.hpp>
 #include <lx0/engine/document.hpp>
+#include <lx0/engine/detail/elementpool.hpp>
 
 namespace lx0 { namespace engine_ns {
 
     //===========================================================================//
 
     Element::FunctionMap Element::s_funcMap;
+    lx0::uint64          Element::s_changeStamp = 0;
+
+    static ObjectTracker s_elementCount("Element");
     
     //---------------------------------------------------------------------------//
 
     Element::Element (void)
         : mpDocument (nullptr)
         , mFlags     (0)
+        , mpParent   (nullptr)
+        , mpPool     (nullptr)
+        , mDataVersion (0)
+        , mTreeVersion (0)
     {
+        s_elementCount.inc();
     }
 
     //---------------------------------------------------------------------------//
@@ -58,7 +67,13 @@ namespace lx0 { namespace engine_ns {
     {
         lx_assert(mpDocument == nullptr, "Element being deleted whilst actively in a Document");
 
+        // Children may outlive this Element if referenced elsewhere
+        for (auto it = mChildren.begin(); it != mChildren.end(); ++it)
+            (*it)->mpParent = nullptr;
+
         mComponents.clear();
+
+        s_elementCount.dec();
     }
 
     //---------------------------------------------------------------------------//
@@ -67,10 +82,11 @@ namespace lx0 { namespace engine_ns {
     Element::prepend (ElementPtr spElem)
     {
         lx_check_error(this != nullptr);
-        lx_check_error(spElem->parent().get() == nullptr);
+        lx_check_error(spElem->mpParent == nullptr);
        
-        spElem->mspParent = shared_from_this();
+        spElem->mpParent = this;
         mChildren.push_front(spElem);
+        _touchTree();
 
         if (mpDocument)
             spElem->notifyAdded(mpDocument);
@@ -82,10 +98,11 @@ namespace lx0 { namespace engine_ns {
     Element::append (ElementPtr spElem)
     {
         lx_check_error(this != nullptr);
-        lx_check_error(spElem->parent().get() == nullptr);
+        lx_check_error(spElem->mpParent == nullptr);
        
-        spElem->mspParent = shared_from_this();
+        spElem->mpParent = this;
         mChildren.push_back(spElem);
+        _touchTree();
 
         if (mpDocument)
             spElem->notifyAdded(mpDocument);
@@ -103,7 +120,7 @@ namespace lx0 { namespace engine_ns {
     ElementCPtr     
     Element::parent() const
     {
-        return mspParent;
+        return mpParent ? ElementCPtr(mpParent->shared_from_this()) : ElementCPtr();
     }
 
     //---------------------------------------------------------------------------//
@@ -111,7 +128,7 @@ namespace lx0 { namespace engine_ns {
     ElementPtr     
     Element::parent()
     {
-        return mspParent;
+        return mpParent ? mpParent->shared_from_this() : ElementPtr();
     }
 
     //---------------------------------------------------------------------------//
@@ -159,13 +176,14 @@ namespace lx0 { namespace engine_ns {
     void
     Element::removeChild (ElementPtr spElem)
     {
-        lx_check_error(spElem->parent().get() == this);
+        lx_check_error(spElem->mpParent == this);
 
         auto it = std::find(mChildren.begin(), mChildren.end(), spElem);
         if (it != mChildren.end())
         {
             mChildren.erase(it);
-            spElem->mspParent.reset();
+            spElem->mpParent = nullptr;
+            _touchTree();
 
             if (mpDocument)
                 spElem->notifyRemoved(mpDocument);
@@ -179,13 +197,16 @@ namespace lx0 { namespace engine_ns {
     void
     Element::removeAll (void)
     {
+        if (!mChildren.empty())
+            _touchTree();
+
         while (!mChildren.empty())
         {
             auto spChild = mChildren.back();
             spChild->removeAll();
          
             mChildren.pop_back();
-            spChild->mspParent.reset();
+            spChild->mpParent = nullptr;
 
             if (mpDocument)
                 spChild->notifyRemoved(mpDocument);
@@ -196,54 +217,47 @@ namespace lx0 { namespace engine_ns {
     //---------------------------------------------------------------------------//
 
     /*!
-        Creates a shallow clone of the Element.
-
-        WARNING: This method is a bit dangerous as the "shallow" clone actually
-        contains a shared reference to the same attributes, parent, and children
-        as the original object.  This could easily be used to create a corrupt
-        tree structure as the shared reference modified in one object affects the
-        other.  A shallow clone does not necessarily make a lot of sense in the
-        Element class.
-     */ 
-    ElementPtr      
-    Element::_clone () const
-    {
-        if (this == 0)
-        {
-            throw lx_error_exception("Cloning a null pointer!");
-            return ElementPtr();
-        }
-
-        Element* pClone = new Element;
-        pClone->mpDocument = nullptr;           // mpDocument is NOT copied!  The clone is not part of the document
-        pClone->mAttributes = mAttributes;
-        pClone->mspParent = mspParent;
-        pClone->mChildren = mChildren;
-        pClone->mValue = mValue.clone();
-        return ElementPtr(pClone);
+        Creates a detached, deep copy of the Element and its sub-tree.  The 
+        clone is allocated from the same ElementPool as the original (if any),
+        so it can only be resolved by handle via the original's Document.  Use
+        cloneDeep(pDocument) for a clone that will be added to another 
+        Document.
+     */
+    ElementPtr
+    Element::cloneDeep (void) const
+    {
+        return cloneDeep(nullptr);
     }
 
-    //---------------------------------------------------------------------------//
-
+    /*!
+        Creates a detached, deep copy of the Element and its sub-tree, with 
+        every Element of the copy created by pDocument.  The copy can then be
+        added to pDocument and resolved by handle via it, and does not keep 
+        the original's Document alive.
+     */
     ElementPtr
-    Element::cloneDeep (void) const
+    Element::cloneDeep (Document* pDocument) const
     {
-        Element* pClone = new Element;
-        ElementPtr spClone(pClone);
+        ElementPtr spClone;
+        if (pDocument)
+            spClone = pDocument->createElement(mTagName);
+        else
+            spClone = mpPool ? mpPool->create() : ElementPtr(new Element);
+        Element* pClone = spClone.get();
         
         pClone->mTagName = mTagName;
         pClone->mpDocument = nullptr;
-        pClone->mspParent = nullptr;    // Create a detached clone
+        pClone->mpParent = nullptr;     // Create a detached clone
         
         for (auto it = mAttributes.begin(); it != mAttributes.end(); ++it)
             pClone->mAttributes.insert( std::make_pair(it->first, it->second.clone()) );
         
-        pClone->mValue = mValue.clone();
+        pClone->mValue = value().clone();
         
         for (auto it = mChildren.begin(); it != mChildren.end(); ++it)
         {
-            auto spChild = (*it)->cloneDeep();
-            spChild->mspParent = spClone;
+            auto spChild = (*it)->cloneDeep(pDocument);
+            spChild->mpParent = pClone;
             pClone->mChildren.push_back(spChild);
         }
         
@@ -255,11 +269,40 @@ namespace lx0 { namespace engine_ns {
     {
         lx_check_error( this != nullptr );
 
-        _foreach([&](ComponentPtr it) {
-            it->onAttributeChange(shared_from_this(), name, value);
-        });
+        if (!mComponents.empty())
+        {
+            ElementPtr spThis = shared_from_this();
+            _foreach([&](ComponentPtr it) {
+                it->onAttributeChange(spThis, name, value);
+            });
+        }
 
         mAttributes[name] = value;
+        _touchData(ChangeEntry::eAttribute, name.c_str());
+    }
+
+    /*!
+        Components are notified as if the attribute were set to an undefined
+        value.  Does nothing if the Element has no such attribute.
+     */
+    void
+    Element::removeAttr (std::string name)
+    {
+        lx_check_error( this != nullptr );
+
+        if (mAttributes.find(name) == mAttributes.end())
+            return;
+
+        if (!mComponents.empty())
+        {
+            ElementPtr spThis = shared_from_this();
+            _foreach([&](ComponentPtr it) {
+                it->onAttributeChange(spThis, name, lxvar());
+            });
+        }
+
+        mAttributes.erase(name);
+        _touchData(ChangeEntry::eAttribute, name.c_str());
     }
 
     lxvar     
@@ -279,15 +322,54 @@ namespace lx0 { namespace engine_ns {
     {
         notifyValueChanged();
 
+        mDeferredValue = nullptr;
         mValue = value;
     }
 
+    /*!
+        Sets the value to be the result of f(), but does not call f() until
+        the value is first accessed.  Used by the document loader so that 
+        inline values which are never read are never parsed.
+
+        f() must be safe to call at any later time.  Any exception it throws
+        is raised from the value() accessor, and f() is kept so that each 
+        later access retries it until it succeeds.
+     */
+    void
+    Element::deferValue (std::function<lxvar ()> f)
+    {
+        notifyValueChanged();
+
+        mValue = lxvar();
+        mDeferredValue = f;
+    }
+
+    /*!
+        Computing the deferred value is not a modification: the Element 
+        already reported the change when deferValue() was called.
+
+        The function is cleared only after it returns so that a parse error
+        does not discard the unparsed text.
+     */
+    void
+    Element::_resolveDeferred (void) const
+    {
+        mValue = mDeferredValue();
+        mDeferredValue = nullptr;
+    }
+
     void
     Element::notifyValueChanged (void)
     {
-        _foreach([&](ComponentPtr it) {
-            it->onValueChange(shared_from_this());
-        });
+        _touchData(ChangeEntry::eValue);
+
+        if (!mComponents.empty())
+        {
+            ElementPtr spThis = shared_from_this();
+            _foreach([&](ComponentPtr it) {
+                it->onValueChange(spThis);
+            });
+        }
     }
     
     void
@@ -307,6 +389,51 @@ namespace lx0 { namespace engine_ns {
         throw lx_error_exception("Not implemented");
     }
 
+    /*!
+        Marks the Element's own data (tag name, attributes, or value) as modified.
+        This invalidates the cached snapshot data for this Element and records
+        the change in the Document's ChangeJournal.
+     */
+    void
+    Element::_touchData (ChangeEntry::Field field, const char* name)
+    {
+        mDataVersion = ++s_changeStamp;
+        _stampTree(mDataVersion);
+
+        if (mpDocument)
+            mpDocument->_recordChange(this, field, mDataVersion, name);
+    }
+
+    /*!
+        Marks the set of children of this Element as modified.
+     */
+    void
+    Element::_touchTree (void)
+    {
+        const lx0::uint64 stamp = ++s_changeStamp;
+        _stampTree(stamp);
+
+        if (mpDocument)
+            mpDocument->_recordChange(this, ChangeEntry::eChildren, stamp);
+    }
+
+    /*!
+        Marks the sub-tree rooted at this Element, and therefore every ancestor's
+        sub-tree, as modified as of the given stamp.  The walk is O(depth) and 
+        provides a hierarchical dirty flag: any sub-tree whose tree version is
+        not newer than a consumer's last processed stamp can be skipped, and 
+        Document::snapshot() can share it unchanged.
+
+        Change stamps are issued from a single counter and must only be issued
+        on the thread that owns the Documents.
+     */
+    void
+    Element::_stampTree (lx0::uint64 stamp)
+    {
+        for (Element* pElem = this; pElem; pElem = pElem->mpParent)
+            pElem->mTreeVersion = stamp;
+    }
+
     void
     Element::_setHostDocument (Document* pDocument)
     {
@@ -322,6 +449,21 @@ namespace lx0 { namespace engine_ns {
         }
     }
 
+    /*!
+        Adds the Element and its entire sub-tree to the Document.
+
+        The sub-tree is attached in batched passes rather than by notifying
+        one Element at a time as the tree is walked: first every Element is
+        bound to the Document, then Document::_notifyElementsAdded() 
+        instantiates the registered Element components by tag in a single
+        sweep and sends out the notifications in document order.  Therefore
+        building a large tree detached (as the document loader does) and 
+        attaching it once is much cheaper than appending into a live Document
+        Element by Element.
+
+        By the time any notification is sent, the whole sub-tree is already
+        part of the Document.
+     */
     void
     Element::notifyAdded (Document* pDocument)
     {        
@@ -330,16 +472,36 @@ namespace lx0 { namespace engine_ns {
         lx_check_error(mpDocument == nullptr, 
             "Element notified that it being added to a Document, but already belongs to a Document");
 
-        _setHostDocument(pDocument);
+        std::vector<ElementPtr> elements;
+        _collectTree(elements);
+
+        // The newly added sub-tree is dirty as of the stamp at which it was 
+        // attached to its parent
+        const lx0::uint64 stamp = s_changeStamp;
+        for (auto it = elements.begin(); it != elements.end(); ++it)
+        {
+            Element* pElem = it->get();
+            lx_check_error(pElem->mpDocument == nullptr, "Element in the added sub-tree already belongs to a Document");
 
-        pDocument->notifyElementAdded(shared_from_this());
+            pElem->_setHostDocument(pDocument);
+            pElem->mTreeVersion = stamp;
+            pDocument->_recordChange(pElem, ChangeEntry::eAdded, stamp);
+        }
 
-        _foreach([](ComponentPtr it) {
-            it->onAdded();
-        });
+        pDocument->_notifyElementsAdded(elements);
+    }
 
+    /*!
+        Appends the Element and all its descendants in depth-first, document 
+        order.  The references keep the batch valid even if a notification 
+        removes an Element from the tree.
+     */
+    void
+    Element::_collectTree (std::vector<ElementPtr>& elements)
+    {
+        elements.push_back(shared_from_this());
         for (auto it = mChildren.begin(); it != mChildren.end(); ++it)
-            (*it)->notifyAdded(pDocument);
+            (*it)->_collectTree(elements);
     }
 
     /*!
@@ -356,6 +518,7 @@ namespace lx0 { namespace engine_ns {
 
         _setHostDocument(nullptr);
 
+        pDocument->_recordChange(this, ChangeEntry::eRemoved, s_changeStamp);
         pDocument->notifyElementRemoved(shared_from_this());
 
         for (auto it = mComponents.begin(); it != mComponents.end(); ++it)
@@ -381,7 +544,7 @@ namespace lx0 { namespace engine_ns {
         if (mFlags & eCallUpdate)
         {
             _foreach([&](ComponentPtr it) {
-                it->onUpdate(this->shared_from_this());
+                it->onUpdate(this);
             });
         }
     }
@@ -413,7 +576,8 @@ namespace lx0 { namespace engine_ns {
 
         mFlags = elemFlags;
 
-        document()->notifyFlagsModified(this);
+        if (mpDocument)
+            mpDocument->notifyFlagsModified(this);
     }
 
     void
@@ -431,9 +595,9 @@ namespace lx0 { namespace engine_ns {
 #ifdef _DEBUG
         // If there's a parent node, it should be in the same document unless somehow the
         // data structure has been corrupted.
-        if (mspParent)
+        if (mpParent)
         {
-            lx_check_error(mspParent->mpDocument == mpDocument);
+            lx_check_error(mpParent->mpDocument == mpDocument);
         }
 #endif
         if (mpDocument)
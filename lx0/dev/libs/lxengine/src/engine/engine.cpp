@@ -35,6 +35,7 @@
 #include <boost/program_options.hpp>
 #include <boost/format.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/interprocess/detail/atomic.hpp>
 
 #include <lx0/lxengine.hpp>
 #include <lx0/engine/engine.hpp>
@@ -83,22 +84,101 @@ namespace lx0 { namespace engine_ns {
         }
 
         ObjectCount::ObjectCount (size_t current)
-            : mCurrent (current)
-            , mTotal   (current)
+            : mCurrent (boost::uint32_t(current))
+            , mTotal   (boost::uint32_t(current))
         {
         }
 
         void   
         ObjectCount::inc (void)
         {
-            mCurrent++;
-            mTotal++;
+            boost::interprocess::detail::atomic_inc32(&mCurrent);
+            boost::interprocess::detail::atomic_inc32(&mTotal);
         }
 
-        void   
+        /*!
+            Returns false, leaving the count at zero, if the count was already
+            zero.  The check and the decrement are a single atomic operation.
+         */
+        bool   
         ObjectCount::dec (void)
         {
-            mCurrent--;
+            boost::uint32_t current = mCurrent;
+            for (;;)
+            {
+                if (current == 0)
+                    return false;
+
+                const boost::uint32_t prior = boost::interprocess::detail::atomic_cas32(&mCurrent, current - 1, current);
+                if (prior == current)
+                    return true;
+                current = prior;
+            }
+        }
+
+        //
+        // The registry is a function-level static so that trackers declared 
+        // at namespace scope in any translation unit can register during 
+        // static initialization.  Entries are never removed, so the 
+        // ObjectCount references handed out remain valid.
+        //
+        namespace 
+        {
+            struct ObjectCountRegistry
+            {
+                enum { kMaxTypes = 256 };
+
+                ObjectCountRegistry() : size (0) {}
+
+                boost::mutex    mutex;
+                int             size;
+                std::string     names[kMaxTypes];
+                ObjectCount     counts[kMaxTypes];
+            };
+
+            ObjectCountRegistry& _objectCountRegistry (void)
+            {
+                static ObjectCountRegistry registry;
+                return registry;
+            }
+        }
+
+        //! Returns the id for the named type, registering it if necessary
+        int
+        ObjectCount::registerType (const char* name)
+        {
+            ObjectCountRegistry& registry = _objectCountRegistry();
+            boost::lock_guard<boost::mutex> lock(registry.mutex);
+
+            for (int i = 0; i < registry.size; ++i)
+            {
+                if (registry.names[i] == name)
+                    return i;
+            }
+
+            if (registry.size == ObjectCountRegistry::kMaxTypes)
+                throw lx_error_exception("Too many object count types registered.  Cannot register '%s'.", name);
+
+            registry.names[registry.size] = name;
+            return registry.size++;
+        }
+
+        int
+        ObjectCount::typeCount (void)
+        {
+            return _objectCountRegistry().size;
+        }
+
+        const char*
+        ObjectCount::typeName (int id)
+        {
+            return _objectCountRegistry().names[id].c_str();
+        }
+
+        ObjectCount&
+        ObjectCount::type (int id)
+        {
+            return _objectCountRegistry().counts[id];
         }
 
         struct WTProfile
@@ -143,11 +223,20 @@ namespace lx0 { namespace engine_ns {
             mQueue.push_back(f);
             mCondition.notify_one();
         }
+
+        size_t
+        WorkerThread::queueLength (void)
+        {
+            boost::lock_guard<boost::mutex> lock(mMutex);
+            return mQueue.size();
+        }
     
         void
         WorkerThread::_run (void)
         {
             wtprofile.registerCounters();
+            Engine::acquire()->profileMonitor().nameThread("WorkerThread");
+            MetricCounter& tasksExecuted = Engine::acquire()->metrics().counter("engine.worker_tasks");
 
             lx_current_thread_priority_below_normal();
             
@@ -164,12 +253,19 @@ namespace lx0 { namespace engine_ns {
                 
                 ProfileSection _section(wtprofile.tasks);
                 f();
+                tasksExecuted.inc();
             }
         }  
     }
 
     using namespace detail;
 
+    ObjectTracker::ObjectTracker (const char* name)
+        : mId     (ObjectCount::registerType(name))
+        , mpCount (&ObjectCount::type(mId))
+    {
+    }
+
     Engine::Environment::Environment ()
         : mTimeScale (1.0f)
     {
@@ -210,10 +306,21 @@ namespace lx0 { namespace engine_ns {
         , mFrameDuration      (1000 / 60)
         , mFrameStart         (0)
         , mFrameTime          (0)
+        , mpMetricsExporter   (nullptr)
+        , mpFrameTimeMetric   (nullptr)
+        , mpFrameMetric       (nullptr)
+        , mpEventQueueMetric  (nullptr)
     {
         lx_init();
         lx_log("lx::core::Engine ctor");
 
+        // The object counts are process-wide: leaks are reported relative to this point
+        for (int id = 0; id < ObjectCount::typeCount(); ++id)
+        {
+            const ObjectCount& count = ObjectCount::type(id);
+            mObjectCountsAtStart.push_back( std::make_pair(count.current(), count.total()) );
+        }
+
         //
         // This seems like a reasonable idea - eventually.  A configuration file should be
         // able to determine what subsystems are loaded (and their order) and the globals
@@ -225,6 +332,22 @@ namespace lx0 { namespace engine_ns {
         mGlobals["load_builtins"].add("Canvas",     0, validate_bool(), true);
         mGlobals["load_builtins"].add("Ogre",       0, validate_bool(), false);
 
+        // If set, the ProfileMonitor records a timeline and writes it to this file on shutdown
+        mGlobals.add("profile_trace", eAcceptsString, validate_string(), lxvar::undefined());
+
+        // The profile tree is kept for this many recent frames; frames longer than the hitch time are logged
+        mGlobals.add("profile_frames", eAcceptsInt, validate_int_range(0, 100000), 120);
+        mGlobals.add("profile_hitch_ms", eAcceptsInt, validate_int_range(0, 100000), 100);
+
+        // If true, ProfileSections also count instructions, cycles, cache and branch misses (Linux only)
+        mGlobals.add("profile_hardware", 0, validate_bool(), false);
+
+        // Converted meshes are cached in this directory and reloaded on later runs; empty to disable
+        mGlobals.add("mesh_cache", eAcceptsString, validate_string(), "cache/meshes");
+
+        // If set, a snapshot of the metrics is exported every frame to this file or "udp://host:port"
+        mGlobals.add("metrics_export", eAcceptsString, validate_string(), lxvar::undefined());
+
         lxvar info = getSystemInfo();
         lx_debug("%s", lx0::format_tabbed(info).c_str());       
     }
@@ -308,6 +431,11 @@ namespace lx0 { namespace engine_ns {
         lx_log("Engine::shutdown()");
 
         mProfileMonitor.logCounters();
+        if (mProfileMonitor.traceEnabled())
+        {
+            lxvar filename = mGlobals["profile_trace"];
+            mProfileMonitor.writeTrace( filename.is_defined() ? filename.as<std::string>().c_str() : "lxprofile_trace.json" );
+        }
             
         // Explicitly free all references to shared objects so that memory leak checks will work
         mDocuments.clear();
@@ -321,22 +449,33 @@ namespace lx0 { namespace engine_ns {
     {
        lx_log("lx::core::Engine dtor");
 
+       delete mpMetricsExporter;
+
        // Don't throw exceptions in a destructor!
        if (!mDocuments.empty())
            lx_log("Engine.Shutdown: Documents not cleaned up correctly.");
 
-       // Check for memory leaks of Engine-related objects
+       //
+       // Check for memory leaks of Engine-related objects.  Only objects 
+       // created during the lifetime of this Engine are counted.
+       //
        bool bLeaksFound = false;
-       for (auto it = mObjectCounts.begin(); it != mObjectCounts.end(); ++it)
+       for (int id = 0; id < ObjectCount::typeCount(); ++id)
        {
-           if (it->second.current() != 0)
+           const ObjectCount& count = ObjectCount::type(id);
+           const size_t startCurrent = (size_t(id) < mObjectCountsAtStart.size()) ? mObjectCountsAtStart[id].first : 0;
+           const size_t startTotal   = (size_t(id) < mObjectCountsAtStart.size()) ? mObjectCountsAtStart[id].second : 0;
+           const size_t leaked       = (count.current() > startCurrent) ? count.current() - startCurrent : 0;
+           const size_t allocated    = count.total() - startTotal;
+
+           if (leaked != 0)
            {
-               lx_warn("Leaked %u %s objects (%.1f%%)", it->second.current(), it->first.c_str(),
-                   100.0f * float(it->second.current()) / float(it->second.total()));
+               lx_warn("Leaked %u %s objects (%.1f%%)", leaked, ObjectCount::typeName(id),
+                   100.0f * float(leaked) / float(allocated));
                bLeaksFound = true;   
            }
-           else
-               lx_debug("Allocated %u %s objects.  0 leaked.", it->second.total(), it->first.c_str()); 
+           else if (allocated != 0)
+               lx_debug("Allocated %u %s objects.  0 leaked.", allocated, ObjectCount::typeName(id)); 
         }
         if (bLeaksFound)
         {
@@ -358,33 +497,28 @@ namespace lx0 { namespace engine_ns {
 
 
     /*!
-        @todo This method is inefficient; but it is simple.  Until 1.0 is complete, simplicity
-            is favored over efficiency.
+        Looks up the type by name on every call.  Prefer a static ObjectTracker 
+        for objects that are created frequently.
      */
     void
     Engine::incObjectCount  (std::string name)
     {
-        auto it = mObjectCounts.find(name);
-        if (it == mObjectCounts.end())
-            mObjectCounts.insert(std::make_pair(name, ObjectCount(1)));
-        else
-            it->second.inc();
+        ObjectCount::type( ObjectCount::registerType(name.c_str()) ).inc();
     }
 
     void 
     Engine::decObjectCount (std::string name)
     {
-        auto it = mObjectCounts.find(name);
+        ObjectCount& count = ObjectCount::type( ObjectCount::registerType(name.c_str()) );
         
-        if (it != mObjectCounts.end())
-        {
-            if (!(it->second.current() >= 1))
-                lx_warn("Object count for '%s' is unexpectedly less than 1!", name.c_str());
+        if (!count.dec())
+            lx_warn("Object count for '%s' is unexpectedly less than 1!", name.c_str());
+    }
 
-            it->second.dec();
-        }
-        else
-            lx_warn("Decrementing object count on '%s' but no entry for that name.", name.c_str());
+    const detail::ObjectCount& 
+    Engine::objectCount (std::string name)
+    {
+        return ObjectCount::type( ObjectCount::registerType(name.c_str()) );
     }
 
     lxvar
@@ -554,22 +688,73 @@ namespace lx0 { namespace engine_ns {
     {
         lx_log("Creating new document.");
 
-        return _loadDocument(true, std::string());
+        DocumentPtr spDocument = _createDocument();
+        spDocument->root( spDocument->createElement("Document") );
+        return spDocument;
     }
 
     DocumentPtr
-    Engine::loadDocument (std::string filename_)
+    Engine::loadDocument (std::string filename)
+    {
+        std::vector<std::string> filenames(1, filename);
+        return loadDocuments(filenames)[0];
+    }
+
+    /*!
+        Loads several Documents at once.  The XML files, and then all the 
+        external resources referenced by any of the Documents (e.g. src= 
+        meshes), are loaded in parallel.  Each Document is assembled once all 
+        its resources have been loaded.
+
+        If any Document fails to load, none of the Documents are kept open.
+     */
+    std::vector<DocumentPtr>
+    Engine::loadDocuments (const std::vector<std::string>& filenames_)
     {
-        lx_log("Loading document '%s'", filename_.c_str());
+        std::vector<std::string> filenames;
+        filenames.reserve(filenames_.size());
+        for (auto it = filenames_.begin(); it != filenames_.end(); ++it)
+        {
+            lx_log("Loading document '%s'", it->c_str());
+
+            //@todo Can we remove this check in the current working directory and
+            // force all resources to always come from an explicitly specified
+            // resource path?
+            std::string filename (*it);
+            if (!lx0::file_exists(filename))
+                filename = findResource(filename);
+            filenames.push_back(filename);
+        }
 
-        //@todo Can we remove this check in the current working directory and
-        // force all resources to always come from an explicitly specified
-        // resource path?
-        std::string filename (filename_);
-        if (!lx0::file_exists(filename))
-            filename = findResource(filename);
+        std::vector<DocumentPtr> documents;
+        for (size_t i = 0; i < filenames.size(); ++i)
+            documents.push_back( _createDocument() );
 
-        return _loadDocument(false, filename);
+        //
+        // Load the document data
+        //
+        std::vector<ElementPtr> roots;
+        try 
+        {
+            _loadDocumentRoots(documents, filenames, roots);
+        } 
+        catch (lx0::error_exception& e)
+        {
+            // Clean-up the local changes, then pass the exception along
+            for (auto it = documents.begin(); it != documents.end(); ++it)
+                mDocuments.erase( std::find(mDocuments.begin(), mDocuments.end(), *it) );
+            throw e;
+        }
+
+        for (size_t i = 0; i < documents.size(); ++i)
+        {
+            if (!roots[i])
+                throw lx_error_exception("Could not load document.  Does file '%s' exist?", filenames[i].c_str());
+
+            documents[i]->root(roots[i]);
+        }
+
+        return documents;
     }
 
     /*!
@@ -599,7 +784,7 @@ namespace lx0 { namespace engine_ns {
     }
 
     DocumentPtr
-    Engine::_loadDocument (bool bCreate, std::string filename)
+    Engine::_createDocument (void)
     {
         //
         // Create the empty document and send out notification to all Engine Components
@@ -620,34 +805,6 @@ namespace lx0 { namespace engine_ns {
             spDocument->attachComponent(pComponent);
         }
 
-        //
-        // Load the document data
-        //
-        ElementPtr spRoot;
-        if (!bCreate)
-        {
-            try 
-            {
-                spRoot = _loadDocumentRoot(spDocument, filename);
-            } 
-            catch (lx0::error_exception& e)
-            {
-                // Clean-up the local changes, then pass the exception along
-                mDocuments.erase( std::find(mDocuments.begin(), mDocuments.end(), spDocument) );
-                spDocument.reset();
-                throw e;
-            }
-
-            if (!spRoot)
-            {
-                throw lx_error_exception("Could not load document.  Does file '%s' exist?", filename.c_str());
-            }
-        }
-        else
-            spRoot = spDocument->createElement("Document");
-
-        spDocument->root(spRoot);
-
         return spDocument;
     }
 
@@ -747,6 +904,20 @@ namespace lx0 { namespace engine_ns {
         mUpdateNum = 0;
         mFrameNum = 0;
 
+        mProfileMonitor.nameThread("Main");
+        if (mGlobals["profile_trace"].is_defined())
+            mProfileMonitor.enableTrace(true);
+        mProfileMonitor.enableFrames( mGlobals["profile_frames"].as<int>(), mGlobals["profile_hitch_ms"].as<int>() );
+        mProfileMonitor.enableHardware( mGlobals["profile_hardware"].as<bool>() );
+
+        if (mGlobals["metrics_export"].is_defined())
+        {
+            mpMetricsExporter = new MetricsExporter;
+            mpMetricsExporter->open( mGlobals["metrics_export"].as<std::string>() );
+        }
+        MetricCounter& eventsProcessed = mMetrics.counter("engine.events");
+        lx0::int64 frameTicks = lx0::lx_ticks();
+
         _lx_reposition_console();
 
         //
@@ -779,13 +950,18 @@ namespace lx0 { namespace engine_ns {
                 mFrameStart = mUpdateStartMs;
                 mFrameTime += mFrameDuration;
                 mFrameNum++;
+
+                mProfileMonitor.beginFrame(mFrameNum);
             }
 
             int ret = mEventQueue.run(mUpdateStartMs, mFrameTime);
             if (ret < 0)
                 bDone = true;
             else if (ret > 0)
+            {
                 bIdle = false;
+                eventsProcessed.add(ret);
+            }
 
             {
                 lx0::ProfileSection section(mpProfile->runPlatformMessages);
@@ -802,6 +978,10 @@ namespace lx0 { namespace engine_ns {
             {
                 for (auto it = mDocuments.begin(); it != mDocuments.end(); ++it)
                     (*it)->updateFrame();
+
+                auto now = lx0::lx_ticks();
+                _updateMetrics(now - frameTicks);
+                frameTicks = now;
             }
 
             ///@todo Devise a better way to hand time-slices from the main loop to the individual documents
@@ -823,6 +1003,7 @@ namespace lx0 { namespace engine_ns {
         } while (!bDone);
 
         mbShutdownRequested = true;
+        mProfileMonitor.endFrame();
 
         for(auto it = mDocuments.begin(); it != mDocuments.end(); ++it)
             (*it)->endRun();
@@ -835,10 +1016,95 @@ namespace lx0 { namespace engine_ns {
         //
         for (auto it = mWorkerThreads.begin(); it != mWorkerThreads.end(); ++it)
             delete (*it);
+        mWorkerThreads.clear();
+
+        delete mpMetricsExporter;
+        mpMetricsExporter = nullptr;
 
 		return 0;
 	}
 
+    /*!
+        Looks up the Engine's own metrics by name the first time they are
+        needed, and again only when a worker thread or ObjectCount type has
+        been added since.  The registry keeps every metric alive for its own
+        lifetime, so the pointers stay valid.
+     */
+    void
+    Engine::_resolveMetrics (void)
+    {
+        if (!mpFrameTimeMetric)
+        {
+            mpFrameTimeMetric  = &mMetrics.histogram("engine.frame_time_us");
+            mpFrameMetric      = &mMetrics.gauge("engine.frame");
+            mpEventQueueMetric = &mMetrics.gauge("engine.event_queue");
+        }
+
+        while (mWorkerQueueMetrics.size() < mWorkerThreads.size())
+            mWorkerQueueMetrics.push_back( &mMetrics.gauge( _lx_format("engine.worker_queue.%1%", mWorkerQueueMetrics.size()).c_str() ) );
+
+        while (int(mObjectMetrics.size()) < ObjectCount::typeCount())
+        {
+            const std::string name = ObjectCount::typeName(int(mObjectMetrics.size()));
+            ObjectMetrics metrics;
+            metrics.pCurrent = &mMetrics.gauge( ("objects." + name + ".current").c_str() );
+            metrics.pTotal   = &mMetrics.gauge( ("objects." + name + ".total").c_str() );
+            mObjectMetrics.push_back(metrics);
+        }
+
+        while (mMemoryMetrics.size() < eMemoryTagCount)
+        {
+            const std::string name = lx_memory_tag_name(MemoryTag(mMemoryMetrics.size()));
+            MemoryMetrics metrics;
+            metrics.pLive       = &mMetrics.gauge( ("memory." + name + ".live_kb").c_str() );
+            metrics.pPeak       = &mMetrics.gauge( ("memory." + name + ".peak_kb").c_str() );
+            metrics.pAllocs     = &mMetrics.gauge( ("memory." + name + ".allocs").c_str() );
+            metrics.allocations = 0;
+            mMemoryMetrics.push_back(metrics);
+        }
+    }
+
+    /*!
+        Records the Engine's own metrics for the frame that just ended, takes
+        the per-frame snapshot of all metrics, and exports it if requested.
+     */
+    void
+    Engine::_updateMetrics (lx0::int64 frameTicks)
+    {
+        _resolveMetrics();
+
+        const double ticksPerUs = double(lx0::lx_ticks_per_second()) / 1e6;
+        mpFrameTimeMetric->record( lx0::uint64(double(frameTicks) / ticksPerUs) );
+        mpFrameMetric->set(int(mFrameNum));
+        mpEventQueueMetric->set(int(mEventQueue.size()));
+
+        for (size_t i = 0; i < mWorkerThreads.size(); ++i)
+            mWorkerQueueMetrics[i]->set( int(mWorkerThreads[i]->queueLength()) );
+
+        for (size_t id = 0; id < mObjectMetrics.size(); ++id)
+        {
+            const ObjectCount& count = ObjectCount::type(int(id));
+            mObjectMetrics[id].pCurrent->set( int(count.current()) );
+            mObjectMetrics[id].pTotal->set( int(count.total()) );
+        }
+
+        for (size_t i = 0; i < mMemoryMetrics.size(); ++i)
+        {
+            MemoryStats stats;
+            lx_memory_stats(MemoryTag(i), stats);
+
+            MemoryMetrics& metrics = mMemoryMetrics[i];
+            metrics.pLive->set( int(stats.live / 1024) );
+            metrics.pPeak->set( int(stats.peak / 1024) );
+            metrics.pAllocs->set( int(stats.allocations - metrics.allocations) );
+            metrics.allocations = stats.allocations;
+        }
+
+        mMetrics.snapshot(mFrameNum, mMetricsSnapshot);
+        if (mpMetricsExporter)
+            mpMetricsExporter->write(mMetricsSnapshot);
+    }
+
 
     void
     Engine::addViewPlugin (std::string name, std::function<ViewImp*(View*)> ctor)
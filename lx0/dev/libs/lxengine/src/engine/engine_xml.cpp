@@ -33,14 +33,15 @@
 #include <iostream>
 #include <string>
 
-#include "../src/extern/tinyxml/tinyxml.h"
-
 #include <lx0/lxengine.hpp>
 #include <lx0/engine/engine.hpp>
 #include <lx0/engine/document.hpp>
 #include <lx0/engine/element.hpp>
 #include <lx0/engine/mesh.hpp>
+#include <lx0/engine/detail/resourcebatch.hpp>
+#include <lx0/engine/detail/xmlreader.hpp>
 #include <lx0/util/misc/util.hpp>
+#include <lx0/util/cookedmesh.hpp>
 
 using namespace lx0::util;
 
@@ -62,162 +63,249 @@ namespace {
 
 namespace lx0 { namespace engine_ns {
 
-    
-    ElementPtr  
-    Engine::_loadDocumentRoot (DocumentPtr spDocument, std::string filename)
+    namespace {
+
+    //
+    // Builds the Element tree directly from the XmlReader events.
+    //
+    // The tree is built fully detached from the Document: no Element 
+    // components exist yet, so attr() and append() do not send any 
+    // notifications.  The caller then attaches the whole tree at once via
+    // Document::root(), which instantiates the Element components by tag
+    // and notifies in a single batched pass (see Element::notifyAdded()).
+    //
+    // External values (src= attributes) are not loaded here but added to 
+    // the batch, which loads them in parallel once every document tree has 
+    // been built and then assigns the values.
+    //
+    class ElementBuilder : public detail::XmlReader::Handler
     {
-        //
-        // Check prerequisites
-        //
-        if (!lx0::file_exists(filename))
-            throw lx_error_exception("Document file does not exist.  Can't find file '%s'", filename);
+    public:
+        ElementBuilder (Engine* pEngine, DocumentPtr spDocument, detail::ResourceBatch& batch, const std::string& meshCache)
+            : mpEngine    (pEngine)
+            , mspDocument (spDocument)
+            , mBatch      (batch)
+            , mMeshCache  (meshCache)
+        {
+        }
 
-        //
-        // Define a local structure within which the recursive loading function can be set
-        //
-        struct L
+        ElementPtr  root (void) const { return mspRoot; }
+
+        virtual void startElement (const std::string& name, const std::vector<detail::XmlReader::Attribute>& attributes, int line)
         {
-            static ElementPtr build (DocumentPtr spDocument, TiXmlElement* pTiElement, int depth)
+            ElementPtr spElem ( mspDocument->createElement(name) );
+
+            //
+            // Parse all attributes and assign them to the Element
+            //
+            for (auto it = attributes.begin(); it != attributes.end(); ++it)
             {
-                ElementPtr spElem ( spDocument->createElement() );
-         
-                std::string tagName = pTiElement->Value();
-                spElem->tagName(tagName);
+                lxvar parsedValue = mpEngine->parseAttribute(*it->pName, it->value);
+                spElem->attr(*it->pName, parsedValue);
+            }
 
-                //
-                // Parse all attributes and assign them to the Element
-                //
-                for (TiXmlAttribute* pAttrib= pTiElement->FirstAttribute(); pAttrib; pAttrib = pAttrib->Next())
-                {
-                    std::string name = pAttrib->Name();
-                    std::string value = pAttrib->Value();
+            if (mStack.empty())
+                mspRoot = spElem;
+            else
+                mStack.back().spElem->append(spElem);
 
-                    lxvar parsedValue = Engine::acquire()->parseAttribute(name, value);
-                    spElem->attr(name, parsedValue);
-                }
+            mStack.push_back(Frame());
+            mStack.back().spElem = spElem;
+            mStack.back().pTagName = &name;
+        }
 
-                //
-                // Collect the children and inlined value
-                //
-                std::string elemText;
-                std::string elemComment;
-                for (TiXmlNode* pChild = pTiElement->FirstChild(); pChild != 0; pChild = pChild->NextSibling())
-                {
-                    if (TiXmlElement* pElement = pChild->ToElement())
-                    {
-                        ElementPtr spLxElem = build(spDocument, pElement, depth + 1);
-                        spElem->append(spLxElem);
-                    }
-                    else if (TiXmlText* pText = pChild->ToText())
-                    {
-                        elemText.append( pText->Value() );
-                    }
-                    else if (TiXmlComment* pComment = pChild->ToComment())
-                    {
-                        elemComment.append( pComment->Value() );
-                    }
-                }
+        virtual void text (const std::string& text, int line)
+        {
+            mStack.back().text.append(text);
+        }
 
-                //
-                // Check so far if this is a well-formed element
-                //
-                {
-                    if (!elemText.empty() && !elemComment.empty())
-                        throw lx_error_exception("Unexpected Element '%s' found with both inner text and comments. "
-                                 "Elements are expected to have their values defined by either "
-                                 "a single block of text or a single block of comment, not both.", tagName);
-                }
+        virtual void comment (const std::string& text, int line)
+        {
+            mStack.back().comment.append(text);
+        }
 
+        virtual void endElement (const std::string& name)
+        {
+            _assignValue(mStack.back());
+            mStack.pop_back();
+        }
+
+    protected:
+        struct Frame
+        {
+            ElementPtr          spElem;
+            const std::string*  pTagName;
+            std::string         text;
+            std::string         comment;
+        };
+
+        void _assignValue (Frame& frame)
+        {
+            const std::string& tagName = *frame.pTagName;
+            ElementPtr         spElem  = frame.spElem;
+
+            //
+            // Check so far if this is a well-formed element
+            //
+            {
+                if (!frame.text.empty() && !frame.comment.empty())
+                    throw lx_error_exception("Unexpected Element '%s' found with both inner text and comments. "
+                             "Elements are expected to have their values defined by either "
+                             "a single block of text or a single block of comment, not both.", tagName);
+            }
+
+            //
+            // The Element's value is defined by one of three possibilities:
+            // (1) It is loaded 'externally' via a "src" tag
+            // (2) It is inlined as the text within the element in the XML
+            //     document and parsed into an lxvar
+            // (3) It is inlined as the a comment within the element in the XML
+            //     document and is copied directly as an unparsed string 
+            //
+            lxvar srcAttr = spElem->attr("src");
+            if (srcAttr.is_defined() && (tagName == "Mesh" || tagName == "Camera"))
+            {
+                ///@todo should the src tag always be assigned a special proxy lxvar that, on first use
+                /// invokes the Element-specific loader to get the data?
+                if (!frame.text.empty())
+                    lx_warn("Element has both a 'src' attribute and an inline value!  "
+                            "The src attribute overrides the value.");
+
+                const std::string src = srcAttr.as<std::string>();
+                const std::string ext = get_extension(src);
+                const std::string tag = tagName;
+                const std::string meshCache = mMeshCache;
 
                 //
-                // The Element's value is defined by one of three possibilities:
-                // (1) It is loaded 'externally' via a "src" tag
-                // (2) It is inlined as the text within the element in the XML
-                //     document and parsed into an lxvar
-                // (3) It is inlined as the a comment within the element in the XML
-                //     document and is copied directly as an unparsed string 
+                // The loaded value is only ever touched by one thread at a time: 
+                // the worker thread while loading, then this thread once the batch
+                // completes.
                 //
-                bool bSet = false;
-                lxvar elemValue;
-                lxvar srcAttr = spElem->attr("src");
-                if (srcAttr.is_defined() && (tagName == "Mesh" || tagName == "Camera"))
-                {
-                    ///@todo should the src tag always be assigned a special proxy lxvar that, on first use
-                    /// invokes the Element-specific loader to get the data?
-                    if (!elemText.empty())
-                        lx_warn("Element has both a 'src' attribute and an inline value!  "
-                                "The src attribute overrides the value.");
-
-                    std::string ext = get_extension(srcAttr.as<std::string>());
-
-                    if (ext == "blend" && tagName == "Mesh")
+                std::shared_ptr<lxvar> spValue(new lxvar);
+                mBatch.add(src, [=]() {
+                    if (ext == "blend" && tag == "Mesh")
+                        *spValue = lx0::load_blend(src, meshCache);
+                    else
                     {
-                        spElem->value( lx0::load_blend( srcAttr.as<std::string>() ) );
-                        bSet = true;
+                        lxvar fileValue = lx0::lxvar_from_file(src.c_str());
+                    
+                        //
+                        // This should be controlled in a more dynamic, pluggable fashion
+                        //
+                        if (tag == "Mesh") 
+                            *spValue = lx0::load_lxson(fileValue);
+                        else
+                            *spValue = fileValue;
                     }
-                    else
-                        elemValue = lx0::lxvar_from_file(srcAttr.as<std::string>().c_str());
-                }
-                else if (!elemText.empty())
-                {
-                    elemValue = lxvar::parse(elemText.c_str());
-                }
-                else if (!elemComment.empty())
-                {
-                    elemValue = lxvar( elemComment );
-                }
-                
+                }, [=]() {
+                    spElem->value(*spValue);
+                });
+            }
+            else if (!frame.text.empty())
+            {
                 //
-                // This should be controlled in a more dynamic, pluggable fashion
+                // Inline text is kept as-is and only parsed if and when the 
+                // value is first accessed.
                 //
-                if (!bSet)
-                {
-                    if (tagName == "Mesh") 
-                        spElem->value(lx0::load_lxson(elemValue));
-                    else
-                        spElem->value(elemValue);
-                }
+                std::shared_ptr<std::string> spText(new std::string);
+                spText->swap(frame.text);
+                const bool bMesh = (tagName == "Mesh");
 
-                return spElem;
+                spElem->deferValue([=]() -> lxvar {
+                    lxvar value = lxvar::parse(spText->c_str());
+                    
+                    //
+                    // This should be controlled in a more dynamic, pluggable fashion
+                    //
+                    if (bMesh)
+                        return lx0::load_lxson(value);
+                    else
+                        return value;
+                });
             }
-        };
+            else
+            {
+                lxvar elemValue;
+                if (!frame.comment.empty())
+                    elemValue = lxvar( frame.comment );
+        
+                if (tagName == "Mesh") 
+                    spElem->value(lx0::load_lxson(elemValue));
+                else
+                    spElem->value(elemValue);
+            }
+        }
+
+        Engine*                 mpEngine;
+        DocumentPtr             mspDocument;
+        detail::ResourceBatch&  mBatch;
+        std::string             mMeshCache;
+        std::vector<Frame>      mStack;
+        ElementPtr              mspRoot;
+    };
+
+    }
 
-        ElementPtr spRoot = spDocument->createElement();
+    /*!
+        Builds the root Element for each of the Documents from the 
+        corresponding file.  Loading happens in three phases:
 
-        TiXmlDocument doc(filename.c_str());
-        if (doc.LoadFile())
+        (1) The XML files are read into memory in parallel
+        (2) Each file is parsed with a streaming reader that builds the 
+            Element tree directly, on this thread, and the external 
+            resources the tree references are collected
+        (3) All the external resources are loaded in parallel, after which
+            the values are assigned to the Elements
+
+        No intermediate XML DOM is built.  Inline text values are parsed 
+        on first access (see Element::deferValue()).
+     */
+    void
+    Engine::_loadDocumentRoots (const std::vector<DocumentPtr>& documents, const std::vector<std::string>& filenames, std::vector<ElementPtr>& roots)
+    {
+        //
+        // Check prerequisites
+        //
+        for (auto it = filenames.begin(); it != filenames.end(); ++it)
         {
-            spRoot = L::build(spDocument, doc.RootElement(), 0);
+            if (!lx0::file_exists(*it))
+                throw lx_error_exception("Document file does not exist.  Can't find file '%s'", *it);
         }
-        else
-        {
-            spRoot.reset();
 
-            lx_warn("Failed to load XML document '%s'", filename.c_str());
-            switch (doc.ErrorId())
+        std::vector<std::string> contents (filenames.size());
+        {
+            detail::ResourceBatch batch;
+            for (size_t i = 0; i < filenames.size(); ++i)
             {
-            default:
-                throw lx_error_exception("Unknown error loading document '%s'", filename.c_str());
-            
-            case TiXmlDocument::TIXML_ERROR_DOCUMENT_EMPTY: 
-                throw lx_error_exception("The file '%s' appears to contain no data.", filename.c_str());
-                break;
-
-            case TiXmlDocument::TIXML_ERROR_PARSING_ELEMENT:
-            case TiXmlDocument::TIXML_ERROR_FAILED_TO_READ_ELEMENT_NAME:
-            case TiXmlDocument::TIXML_ERROR_READING_ELEMENT_VALUE:
-            case TiXmlDocument::TIXML_ERROR_READING_ATTRIBUTES:
-            case TiXmlDocument::TIXML_ERROR_PARSING_EMPTY:
-            case TiXmlDocument::TIXML_ERROR_READING_END_TAG:
-            case TiXmlDocument::TIXML_ERROR_PARSING_UNKNOWN:
-            case TiXmlDocument::TIXML_ERROR_PARSING_COMMENT:
-            case TiXmlDocument::TIXML_ERROR_PARSING_DECLARATION:
-                throw lx_error_exception("XML format error when loading document '%s'.", filename.c_str());
-                break;
+                std::string* pContents = &contents[i];
+                std::string  filename  = filenames[i];
+                batch.add(filename, [pContents, filename]() { *pContents = lx0::string_from_file(filename); });
             }
+            batch.run();
+        }
+
+        //
+        // The reader is shared so that tag and attribute names common to 
+        // all the documents are only interned once.  
+        //
+        // The globals are read here, rather than by the loaders, since the 
+        // loaders run on worker threads.
+        //
+        const std::string     meshCache = lx0::cooked_mesh_directory();
+        detail::XmlReader     reader;
+        detail::ResourceBatch batch;
+        for (size_t i = 0; i < documents.size(); ++i)
+        {
+            std::string& text = contents[i];
+
+            ElementBuilder builder(this, documents[i], batch, meshCache);
+            reader.parse(text.data(), text.data() + text.size(), builder, filenames[i]);
+            roots.push_back( builder.root() );
+
+            std::string().swap(text);
         }
-        return spRoot;
+
+        batch.run();
     }
  
 }}
-
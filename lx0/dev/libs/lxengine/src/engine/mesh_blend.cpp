@@ -37,6 +37,7 @@
 #include <lx0/engine/mesh.hpp>
 #include <lx0/subsystem/blendreader.hpp>
 #include <lx0/util/blendload.hpp>
+#include <lx0/util/cookedmesh.hpp>
 
 using namespace lx0;
 using namespace lx0::core;
@@ -45,9 +46,19 @@ namespace lx0 { namespace engine_ns {
 
     Mesh*
     load_blend (std::string filename)
+    {
+        return load_blend(filename, lx0::cooked_mesh_directory());
+    }
+
+    /*!
+        Does not access the Engine, so it can be called from a worker thread
+        given the cache directory (see cooked_mesh_directory()).
+     */
+    Mesh*
+    load_blend (std::string filename, const std::string& cacheDirectory)
     {
         glgeom::primitive_buffer primitive;
-        lx0::primitive_buffer_from_blendfile(primitive, filename.c_str());
+        lx0::primitive_buffer_from_blendfile_cached(primitive, cacheDirectory, filename.c_str());
 
         Mesh* pMesh = new Mesh;
         pMesh->mFlags.mVertexNormals = true;
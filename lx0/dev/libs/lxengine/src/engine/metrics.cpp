@@ -0,0 +1,436 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+    * MIT License (http://www.opensource.org/licenses/mit-license.php)
+
+    Copyright (c) 2010-2012 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a
+    copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+
+//===========================================================================//
+//   H E A D E R S
+//===========================================================================//
+
+#include <ctime>
+#include <sstream>
+#include <algorithm>
+#include <boost/asio.hpp>
+#include <boost/interprocess/detail/atomic.hpp>
+
+#include <lx0/lxengine.hpp>
+#include <lx0/engine/metrics.hpp>
+#include <lx0/util/misc/util.hpp>
+
+namespace lx0 { namespace engine_ns {
+
+    //===========================================================================//
+
+    void
+    MetricCounter::inc (void)
+    {
+        boost::interprocess::detail::atomic_inc32(&mValue);
+    }
+
+    void
+    MetricCounter::add (lx0::uint32 n)
+    {
+        boost::interprocess::detail::atomic_add32(&mValue, n);
+    }
+
+    void
+    MetricGauge::set (int value)
+    {
+        boost::interprocess::detail::atomic_write32(&mValue, boost::uint32_t(value));
+    }
+
+    //===========================================================================//
+
+    MetricHistogram::MetricHistogram (void)
+    {
+        reset();
+    }
+
+    void
+    MetricHistogram::reset (void)
+    {
+        for (int i = 0; i < kBucketCount; ++i)
+            mCounts[i] = 0;
+    }
+
+    static inline int 
+    _highestBit (lx0::uint64 v)
+    {
+        int n = 0;
+        if (v >> 32) { v >>= 32; n += 32; }
+        if (v >> 16) { v >>= 16; n += 16; }
+        if (v >> 8)  { v >>= 8;  n += 8; }
+        if (v >> 4)  { v >>= 4;  n += 4; }
+        if (v >> 2)  { v >>= 2;  n += 2; }
+        if (v >> 1)  { n += 1; }
+        return n;
+    }
+
+    int
+    MetricHistogram::bucketIndex (lx0::uint64 value)
+    {
+        if (value < kLinearBuckets)
+            return int(value);
+
+        // Above the linear range, keep the kSubBucketBits most significant bits
+        const int shift = _highestBit(value) - (kSubBucketBits - 1);
+        const int sub   = int(value >> shift) - kHalfBuckets;
+        return kLinearBuckets + (shift - 1) * kHalfBuckets + sub;
+    }
+
+    lx0::uint64
+    MetricHistogram::bucketLowest (int index)
+    {
+        if (index < kLinearBuckets)
+            return lx0::uint64(index);
+
+        const int shift = (index - kLinearBuckets) / kHalfBuckets + 1;
+        const int sub   = (index - kLinearBuckets) % kHalfBuckets + kHalfBuckets;
+        return lx0::uint64(sub) << shift;
+    }
+
+    lx0::uint64
+    MetricHistogram::bucketHighest (int index)
+    {
+        if (index < kLinearBuckets)
+            return lx0::uint64(index);
+
+        const int shift = (index - kLinearBuckets) / kHalfBuckets + 1;
+        const int sub   = (index - kLinearBuckets) % kHalfBuckets + kHalfBuckets;
+        return (lx0::uint64(sub + 1) << shift) - 1;
+    }
+
+    void
+    MetricHistogram::record (lx0::uint64 value)
+    {
+        boost::interprocess::detail::atomic_inc32(&mCounts[bucketIndex(value)]);
+    }
+
+    void
+    MetricHistogram::summarize (Summary& summary) const
+    {
+        summary = Summary();
+
+        //
+        // Copy the counts first so the statistics are consistent with each
+        // other even while other threads continue to record
+        //
+        std::vector<boost::uint32_t> counts(kBucketCount);
+        for (int i = 0; i < kBucketCount; ++i)
+        {
+            counts[i] = mCounts[i];
+            summary.count += counts[i];
+        }
+        if (summary.count == 0)
+            return;
+
+        const lx0::uint64 t50 = (summary.count * 50 + 99) / 100;
+        const lx0::uint64 t90 = (summary.count * 90 + 99) / 100;
+        const lx0::uint64 t99 = (summary.count * 99 + 99) / 100;
+
+        double      sum = 0.0;
+        lx0::uint64 seen = 0;
+        bool        bFirst = true;
+        for (int i = 0; i < kBucketCount; ++i)
+        {
+            if (!counts[i])
+                continue;
+
+            const lx0::uint64 lowest  = bucketLowest(i);
+            const lx0::uint64 highest = bucketHighest(i);
+
+            if (bFirst)
+            {
+                summary.min = lowest;
+                bFirst = false;
+            }
+            summary.max = highest;
+            sum += (double(lowest) + double(highest)) * 0.5 * double(counts[i]);
+
+            const lx0::uint64 before = seen;
+            seen += counts[i];
+            if (before < t50 && seen >= t50) summary.p50 = highest;
+            if (before < t90 && seen >= t90) summary.p90 = highest;
+            if (before < t99 && seen >= t99) summary.p99 = highest;
+        }
+        summary.mean = sum / double(summary.count);
+    }
+
+    //===========================================================================//
+
+    const MetricsSnapshot::Entry*
+    MetricsSnapshot::find (const std::string& name) const
+    {
+        auto it = std::lower_bound(entries.begin(), entries.end(), name, [](const Entry& e, const std::string& name) {
+            return e.name < name;
+        });
+        if (it != entries.end() && it->name == name)
+            return &*it;
+        else
+            return nullptr;
+    }
+
+    //===========================================================================//
+
+    template <typename T>
+    static T&
+    _acquireMetric (std::map<std::string, std::shared_ptr<T>>& map, const char* name)
+    {
+        auto it = map.find(name);
+        if (it == map.end())
+            it = map.insert( std::make_pair(std::string(name), std::shared_ptr<T>(new T)) ).first;
+        return *it->second;
+    }
+
+    MetricCounter&
+    MetricsRegistry::counter (const char* name)
+    {
+        boost::lock_guard<boost::mutex> lock(mMutex);
+        return _acquireMetric(mCounters, name);
+    }
+
+    MetricGauge&
+    MetricsRegistry::gauge (const char* name)
+    {
+        boost::lock_guard<boost::mutex> lock(mMutex);
+        return _acquireMetric(mGauges, name);
+    }
+
+    MetricHistogram&
+    MetricsRegistry::histogram (const char* name)
+    {
+        boost::lock_guard<boost::mutex> lock(mMutex);
+        return _acquireMetric(mHistograms, name);
+    }
+
+    /*!
+        Microseconds since the Unix epoch.  The wall clock is only read once;
+        later times are offset from it using the high resolution timer.
+     */
+    static lx0::uint64
+    _timestampUs (void)
+    {
+        static lx0::uint64 s_epochUs = 0;
+        static lx0::int64  s_epochTicks = 0;
+        if (!s_epochUs)
+        {
+            s_epochTicks = lx0::lx_ticks();
+            s_epochUs = lx0::uint64(std::time(nullptr)) * 1000000;
+        }
+        return s_epochUs + lx0::uint64( double(lx0::lx_ticks() - s_epochTicks) * 1e6 / double(lx0::lx_ticks_per_second()) );
+    }
+
+    void
+    MetricsRegistry::snapshot (lx0::uint32 frame, MetricsSnapshot& snapshot) const
+    {
+        snapshot.frame = frame;
+        snapshot.timestampUs = _timestampUs();
+        snapshot.entries.clear();
+
+        boost::lock_guard<boost::mutex> lock(mMutex);
+        snapshot.entries.reserve(mCounters.size() + mGauges.size() + mHistograms.size());
+
+        for (auto it = mCounters.begin(); it != mCounters.end(); ++it)
+        {
+            MetricsSnapshot::Entry entry;
+            entry.name  = it->first;
+            entry.type  = 'c';
+            entry.value = it->second->value();
+            snapshot.entries.push_back(entry);
+        }
+        for (auto it = mGauges.begin(); it != mGauges.end(); ++it)
+        {
+            MetricsSnapshot::Entry entry;
+            entry.name  = it->first;
+            entry.type  = 'g';
+            entry.value = it->second->value();
+            snapshot.entries.push_back(entry);
+        }
+        for (auto it = mHistograms.begin(); it != mHistograms.end(); ++it)
+        {
+            MetricsSnapshot::Entry entry;
+            entry.name  = it->first;
+            entry.type  = 'h';
+            entry.value = 0;
+            it->second->summarize(entry.histogram);
+            snapshot.entries.push_back(entry);
+        }
+
+        std::sort(snapshot.entries.begin(), snapshot.entries.end(), [](const MetricsSnapshot::Entry& a, const MetricsSnapshot::Entry& b) {
+            return a.name < b.name;
+        });
+    }
+
+    //===========================================================================//
+
+    struct MetricsExporter::Socket
+    {
+        Socket() : socket (service) {}
+
+        boost::asio::io_service         service;
+        boost::asio::ip::udp::socket    socket;
+        boost::asio::ip::udp::endpoint  endpoint;
+    };
+
+    MetricsExporter::MetricsExporter (void)
+        : mpSocket (nullptr)
+    {
+    }
+
+    MetricsExporter::~MetricsExporter (void)
+    {
+        close();
+    }
+
+    void
+    MetricsExporter::open (const std::string& target)
+    {
+        close();
+
+        if (target.compare(0, 6, "udp://") == 0)
+        {
+            const std::string address = target.substr(6);
+            const size_t colon = address.rfind(':');
+            if (colon == std::string::npos)
+                throw lx_error_exception("Metrics export target '%s' does not specify a port.", target.c_str());
+
+            mpSocket = new Socket;
+            try
+            {
+                boost::asio::ip::udp::resolver resolver(mpSocket->service);
+                boost::asio::ip::udp::resolver::query query(boost::asio::ip::udp::v4(), address.substr(0, colon), address.substr(colon + 1));
+                mpSocket->endpoint = *resolver.resolve(query);
+                mpSocket->socket.open(boost::asio::ip::udp::v4());
+            }
+            catch (std::exception& e)
+            {
+                close();
+                throw lx_error_exception("Could not open metrics export target '%s': %s", target.c_str(), e.what());
+            }
+        }
+        else
+        {
+            mFile.open(target.c_str(), std::ios::out | std::ios::app);
+            if (!mFile.is_open())
+                throw lx_error_exception("Could not open metrics export file '%s'.", target.c_str());
+        }
+        lx_log("Exporting metrics to '%1%'", target);
+    }
+
+    void
+    MetricsExporter::close (void)
+    {
+        if (mFile.is_open())
+            mFile.close();
+
+        delete mpSocket;
+        mpSocket = nullptr;
+    }
+
+    bool
+    MetricsExporter::isOpen (void) const
+    {
+        return mpSocket || mFile.is_open();
+    }
+
+    std::string
+    MetricsExporter::format (const MetricsSnapshot& snapshot)
+    {
+        std::ostringstream out;
+        const lx0::uint64 timestampNs = snapshot.timestampUs * 1000;
+
+        for (auto it = snapshot.entries.begin(); it != snapshot.entries.end(); ++it)
+        {
+            // Metric names are generated by the engine; only the tag delimiters need escaping
+            std::string name = it->name;
+            for (size_t i = 0; i < name.size(); ++i)
+            {
+                if (name[i] == ' ' || name[i] == ',' || name[i] == '=')
+                    name[i] = '_';
+            }
+
+            out << "lxengine,metric=" << name << ' ';
+            if (it->type == 'h')
+            {
+                const MetricHistogram::Summary& h = it->histogram;
+                out << "count=" << h.count << "i"
+                    << ",min="  << h.min   << "i"
+                    << ",mean=" << h.mean
+                    << ",p50="  << h.p50   << "i"
+                    << ",p90="  << h.p90   << "i"
+                    << ",p99="  << h.p99   << "i"
+                    << ",max="  << h.max   << "i";
+            }
+            else
+                out << "value=" << it->value << "i";
+
+            out << ",frame=" << snapshot.frame << "i " << timestampNs << '\n';
+        }
+        return out.str();
+    }
+
+    void
+    MetricsExporter::write (const MetricsSnapshot& snapshot)
+    {
+        if (snapshot.entries.empty())
+            return;
+
+        const std::string lines = format(snapshot);
+        if (mFile.is_open())
+        {
+            mFile << lines;
+            mFile.flush();
+        }
+        else if (mpSocket)
+        {
+            //
+            // Split the lines into datagrams small enough to avoid fragmentation.
+            // Send errors are ignored: if nothing is listening, the engine
+            // should carry on regardless.
+            //
+            const size_t kMaxDatagram = 1400;
+            size_t start = 0;
+            while (start < lines.size())
+            {
+                size_t end = start;
+                while (end < lines.size())
+                {
+                    size_t next = lines.find('\n', end) + 1;
+                    if (next - start > kMaxDatagram && end > start)
+                        break;
+                    end = next;
+                }
+
+                boost::system::error_code error;
+                mpSocket->socket.send_to(boost::asio::buffer(&lines[start], end - start), mpSocket->endpoint, 0, error);
+                start = end;
+            }
+        }
+    }
+
+}}
@@ -33,10 +33,28 @@
 
 #include <cassert>
 #include <fstream>
+#include <algorithm>
+#include <functional>
 
 #include <lx0/lxengine.hpp>
 #include <lx0/engine/profilemonitor.hpp>
 
+//
+// The live counters are read lock-free from other threads using a sequence
+// lock per counter: the owning thread makes the sequence odd while it 
+// modifies the totals and even again afterwards, and a reader retries until
+// it sees the same even sequence before and after copying.  This relies only
+// on the compiler not reordering the accesses; the supported x86/x64 targets
+// do not reorder stores with other stores or loads with other loads.
+//
+#ifdef _MSC_VER
+#   include <intrin.h>
+#   pragma intrinsic(_ReadWriteBarrier)
+#   define _lx_compiler_barrier()   _ReadWriteBarrier()
+#else
+#   define _lx_compiler_barrier()   __asm__ __volatile__ ("" ::: "memory")
+#endif
+
 namespace lx0 { namespace engine { namespace profilemonitor_ns {
 
     //===========================================================================//
@@ -46,17 +64,82 @@ namespace lx0 { namespace engine { namespace profilemonitor_ns {
         ::memset(this, 0, sizeof(*this));
     }
 
+    static inline void _beginWrite (ProfileCounter* pCounter)
+    {
+        pCounter->sequence++;
+        _lx_compiler_barrier();
+    }
+
+    static inline void _endWrite (ProfileCounter* pCounter)
+    {
+        _lx_compiler_barrier();
+        pCounter->sequence++;
+    }
+
+    //===========================================================================//
+
+    ProfileThread::ProfileThread (lx0::uint32 id)
+        : threadId  (id)
+        , pTrace    (nullptr)
+        , pPerf     (nullptr)
+        , pNext     (nullptr)
+    {
+        for (int i = 0; i < kMaxChunks; ++i)
+            chunks[i] = nullptr;
+    }
+
+    ProfileThread::~ProfileThread ()
+    {
+        for (int i = 0; i < kMaxChunks; ++i)
+            delete [] chunks[i];
+        delete pTrace;
+        delete pPerf;
+    }
+
     //===========================================================================//
 
-    __declspec(thread) ProfileCounter* _profileCounterTable;
+    //
+    // The thread-local table is tagged with the serial number of the monitor
+    // that owns it, so that a thread never uses a table belonging to a monitor
+    // that has since been destroyed (e.g. when the Engine is recreated).
+    //
+    __declspec(thread) ProfileThread*  _profileThread = nullptr;
+    __declspec(thread) lx0::uint32     _profileThreadSerial = 0;
     __declspec(thread) ProfileCounter* _activeCounter = nullptr;
 
+    static lx0::uint32 s_monitorSerial = 0;
+
     ProfileMonitor::ProfileMonitor() 
-        : mSize          (0)
+        : mSerial        (++s_monitorSerial)
+        , mStartTicks    (lx0::lx_ticks())
+        , mpThreads      (nullptr)
+        , mSize          (0)
+        , mbTrace        (false)
+        , mTraceCapacity (256 * 1024)
+        , mbHardware     (false)
+        , mpFrameThread  (nullptr)
+        , mFrameCount    (0)
+        , mpCurrentFrame (nullptr)
+        , mFrameNode     (0)
+        , mHitchTicks    (0)
     {
         mNameMap.push_back("<invalid id>");
     }
 
+    ProfileMonitor::~ProfileMonitor()
+    {
+        if (ProfileSection::pMonitor == this)
+            ProfileSection::pMonitor = nullptr;
+
+        ProfileThread* pThread = mpThreads;
+        while (pThread)
+        {
+            ProfileThread* pNext = pThread->pNext;
+            delete pThread;
+            pThread = pNext;
+        }
+    }
+
     void 
     ProfileMonitor::registerCounter (const char* name, int* id)
     {
@@ -73,6 +156,9 @@ namespace lx0 { namespace engine { namespace profilemonitor_ns {
         auto it = mNameMap2.find(name);
         if (it == mNameMap2.end())
         {
+            if (mSize + 1 >= ProfileThread::kMaxCounters)
+                throw lx_error_exception("Too many profile counters registered.  Cannot register '%s'.", name);
+
             *id = ++mSize;
             mNameMap.push_back(name);
             mNameMap2.insert(std::make_pair(std::string(name), *id));
@@ -88,37 +174,81 @@ namespace lx0 { namespace engine { namespace profilemonitor_ns {
         mRelations.push_back( std::make_pair(std::string(parentName), std::string(childName)) );
     }
 
+    //---------------------------------------------------------------------------//
+
+    /*!
+        Registers the calling thread's table.  Registration is rare, so it is
+        serialized with the mutex; the table is then published to readers by
+        prepending it to the thread list only once fully initialized.
+     */
+    ProfileThread*
+    ProfileMonitor::_acquireThread (void)
+    {
+        boost::lock_guard<boost::mutex> lock(mMutex);
+
+        ProfileThread* pThread = new ProfileThread(lx0::lx_current_thread_id());
+        pThread->pNext = mpThreads;
+        _lx_compiler_barrier();
+        mpThreads = pThread;
+
+        _profileThread = pThread;
+        _profileThreadSerial = mSerial;
+        return pThread;
+    }
+
+    ProfileCounter*
+    ProfileMonitor::_allocateChunk (ProfileThread* pThread, int chunk)
+    {
+        ProfileCounter* pChunk = new ProfileCounter[ProfileThread::kChunkSize];
+        for (int i = 0; i < ProfileThread::kChunkSize; ++i)
+            pChunk[i].id = chunk * ProfileThread::kChunkSize + i;
+        
+        _lx_compiler_barrier();
+        pThread->chunks[chunk] = pChunk;
+        return pChunk;
+    }
+
     ProfileCounter* 
     ProfileMonitor::enter (int counterId)
     {
-        if (!_profileCounterTable)
-        {
-            auto it = mThreadMap.find(lx0::lx_current_thread_id());
-            if (it != mThreadMap.end())
-            {
-                _profileCounterTable = it->second;
-            }
-            else
-            {
-                _profileCounterTable = new ProfileCounter[2048];
-                mThreadMap.insert( std::make_pair(lx0::lx_current_thread_id(), _profileCounterTable) );
-            }
-        }
-        ProfileCounter* pCounter = &_profileCounterTable[counterId];
+        ProfileThread* pThread = (_profileThreadSerial == mSerial) ? _profileThread : _acquireThread();
+
+        const int chunk = counterId / ProfileThread::kChunkSize;
+        ProfileCounter* pChunk = pThread->chunks[chunk];
+        if (!pChunk)
+            pChunk = _allocateChunk(pThread, chunk);
+
+        ProfileCounter* pCounter = &pChunk[counterId % ProfileThread::kChunkSize];
                
         auto now = lx0::lx_ticks();
 
+        _beginWrite(pCounter);
         pCounter->calls++;
+        _endWrite(pCounter);
 
         if (++pCounter->depth == 1)
+        {
             pCounter->inclusiveStart = now;
+            pCounter->bEvents = mbHardware;
+            if (pCounter->bEvents)
+                _readHardware(pThread, pCounter->eventsStart);
+        }
         
         if (_activeCounter)
+        {
+            _beginWrite(_activeCounter);
             _activeCounter->exclusive += (now - _activeCounter->exclusiveStart);
+            _endWrite(_activeCounter);
+        }
         pCounter->pPrevious = _activeCounter;
 
         pCounter->exclusiveStart = now;        
         _activeCounter = pCounter;
+
+        if (mbTrace)
+            _traceEvent(counterId, 'B', now);
+        if (pThread == mpFrameThread)
+            _frameEnter(counterId, now);
         
         return pCounter;
     }
@@ -128,13 +258,492 @@ namespace lx0 { namespace engine { namespace profilemonitor_ns {
     {
         auto now = lx0::lx_ticks();
 
+        // Read before the write section, since reading is a system call
+        lx0::PerfCounters::Values events;
+        const bool bEvents = (pCounter->depth == 1 && pCounter->bEvents);
+        if (bEvents)
+            _readHardware(_profileThread, events);
+
+        _beginWrite(pCounter);
         pCounter->exclusive += (now - pCounter->exclusiveStart);
         if (--pCounter->depth == 0)
+        {
             pCounter->inclusive += (now - pCounter->inclusiveStart);
+            if (bEvents)
+            {
+                for (int i = 0; i < lx0::PerfCounters::eEventCount; ++i)
+                    pCounter->events.count[i] += events.count[i] - pCounter->eventsStart.count[i];
+            }
+        }
+        _endWrite(pCounter);
 
         _activeCounter = pCounter->pPrevious;
         if (_activeCounter)
             _activeCounter->exclusiveStart = now;
+
+        if (mbTrace)
+            _traceEvent(pCounter->id, 'E', now);
+        if (mpFrameThread && _profileThread == mpFrameThread && _profileThreadSerial == mSerial)
+            _frameLeave(pCounter->id, now);
+    }
+
+    //===========================================================================//
+
+    bool
+    ProfileMonitor::_read (const ProfileThread* pThread, int counterId, ProfileSample& sample) const
+    {
+        const ProfileCounter* pChunk = pThread->chunks[counterId / ProfileThread::kChunkSize];
+        if (!pChunk)
+            return false;
+
+        const ProfileCounter& counter = pChunk[counterId % ProfileThread::kChunkSize];
+        lx0::uint32 before, after;
+        do
+        {
+            before = counter.sequence;
+            _lx_compiler_barrier();
+
+            sample.calls     = counter.calls;
+            sample.inclusive = counter.inclusive;
+            sample.exclusive = counter.exclusive;
+            sample.events    = counter.events;
+
+            _lx_compiler_barrier();
+            after = counter.sequence;
+        } while ((before & 1) || before != after);
+
+        return sample.calls > 0;
+    }
+
+    /*!
+        Returns the totals of the counter summed over all threads.  Safe to 
+        call from any thread at any time (e.g. to draw an in-game overlay)
+        and never blocks the threads being profiled.
+     */
+    ProfileSample
+    ProfileMonitor::sample (int counterId) const
+    {
+        ProfileSample total;
+        if (counterId <= 0 || counterId >= ProfileThread::kMaxCounters)
+            return total;
+
+        for (const ProfileThread* pThread = mpThreads; pThread; pThread = pThread->pNext)
+        {
+            ProfileSample sample;
+            if (_read(pThread, counterId, sample))
+            {
+                total.calls     += sample.calls;
+                total.inclusive += sample.inclusive;
+                total.exclusive += sample.exclusive;
+                for (int i = 0; i < lx0::PerfCounters::eEventCount; ++i)
+                    total.events.count[i] += sample.events.count[i];
+            }
+        }
+        return total;
+    }
+
+    //! Returns the totals of the counter for each thread that has entered it
+    void
+    ProfileMonitor::sample (int counterId, std::vector<std::pair<lx0::uint32, ProfileSample>>& perThread) const
+    {
+        if (counterId <= 0 || counterId >= ProfileThread::kMaxCounters)
+            return;
+
+        for (const ProfileThread* pThread = mpThreads; pThread; pThread = pThread->pNext)
+        {
+            ProfileSample sample;
+            if (_read(pThread, counterId, sample))
+                perThread.push_back( std::make_pair(pThread->threadId, sample) );
+        }
+    }
+
+    //===========================================================================//
+
+    //! Assign a display name to the calling thread for the profile output
+    void
+    ProfileMonitor::nameThread (const char* name)
+    {
+        boost::lock_guard<boost::mutex> lock(mMutex);
+        mThreadNames[lx0::lx_current_thread_id()] = name;
+    }
+
+    /*!
+        When enabled, every ProfileSection enter and leave is also recorded,
+        with a timestamp, into a ring buffer owned by the calling thread.  The
+        timeline can then be exported via writeTrace().
+
+        Enabling the trace discards any previously recorded events.
+     */
+    void
+    ProfileMonitor::enableTrace (bool bEnable)
+    {
+        boost::lock_guard<boost::mutex> lock(mMutex);
+        
+        if (bEnable && !mbTrace)
+        {
+            for (ProfileThread* pThread = mpThreads; pThread; pThread = pThread->pNext)
+            {
+                if (pThread->pTrace)
+                    pThread->pTrace->start = pThread->pTrace->count;
+            }
+        }
+        mbTrace = bEnable;
+    }
+
+    /*!
+        When enabled, the hardware performance counters of the thread (see
+        PerfCounters) are also read on the outermost enter and leave of each
+        ProfileSection and accumulated per counter.  Each read is a system 
+        call, so enable this only when looking at cache or branch behavior.
+        
+        Has no effect where the counters are unavailable.
+     */
+    void
+    ProfileMonitor::enableHardware (bool bEnable)
+    {
+        mbHardware = bEnable;
+    }
+
+    void
+    ProfileMonitor::_readHardware (ProfileThread* pThread, lx0::PerfCounters::Values& values)
+    {
+        if (!pThread->pPerf)
+            pThread->pPerf = new lx0::PerfCounters;
+        pThread->pPerf->read(values);
+    }
+
+    void
+    ProfileMonitor::_traceEvent (int id, char phase, lx0::int64 ticks)
+    {
+        // enter() has always registered the thread by the time this is called
+        ProfileThread* pThread = _profileThread;
+        if (!pThread->pTrace)
+        {
+            boost::lock_guard<boost::mutex> lock(mMutex);
+
+            TraceBuffer* pBuffer = new TraceBuffer;
+            pBuffer->events.resize( std::max<size_t>(mTraceCapacity, 2) );
+            pBuffer->count = 0;
+            pBuffer->start = 0;
+            pThread->pTrace = pBuffer;
+        }
+        TraceBuffer* pBuffer = pThread->pTrace;
+        
+        TraceEvent& evt = pBuffer->events[size_t(pBuffer->count % pBuffer->events.size())];
+        evt.ticks = ticks;
+        evt.id    = id;
+        evt.phase = phase;
+        pBuffer->count++;
+    }
+
+    //! Index of the oldest event of the current trace still in the buffer
+    static lx0::uint64
+    _traceFirst (const TraceBuffer& buffer)
+    {
+        const lx0::uint64 size  = buffer.events.size();
+        const lx0::uint64 count = buffer.count;
+        const lx0::uint64 start = buffer.start;
+        return std::max<lx0::uint64>( start, (count > size) ? count - size : 0 );
+    }
+
+    /*!
+        Writes the recorded events as Chrome trace event JSON, which can be 
+        opened in chrome://tracing or the Perfetto UI.
+
+        This should be called while the traced threads are idle (e.g. at 
+        shutdown): events written concurrently with the export may be 
+        partially recorded.
+     */
+    void
+    ProfileMonitor::writeTrace (const char* filename)
+    {
+        boost::lock_guard<boost::mutex> lock(mMutex);
+
+        std::ofstream file(filename);
+        if (!file.is_open())
+        {
+            lx_warn("Could not open '%1%' to write the profile trace", filename);
+            return;
+        }
+
+        //
+        // Timestamps are written in microseconds relative to the earliest 
+        // event still in any of the buffers
+        //
+        lx0::int64 base = 0;
+        bool bFirst = true;
+        for (ProfileThread* pThread = mpThreads; pThread; pThread = pThread->pNext)
+        {
+            if (!pThread->pTrace)
+                continue;
+
+            TraceBuffer& buffer = *pThread->pTrace;
+            const lx0::uint64 first = _traceFirst(buffer);
+            if (buffer.count > first)
+            {
+                lx0::int64 ticks = buffer.events[ size_t(first % buffer.events.size()) ].ticks;
+                if (bFirst || ticks < base)
+                    base = ticks;
+                bFirst = false;
+            }
+        }
+        const double toUs = 1e6 / double( lx0::lx_ticks_per_second() );
+
+        file << "{\"traceEvents\":[" << std::endl;
+
+        const char* separator = "";
+        for (ProfileThread* pThread = mpThreads; pThread; pThread = pThread->pNext)
+        {
+            if (!pThread->pTrace)
+                continue;
+
+            TraceBuffer& buffer = *pThread->pTrace;
+            const lx0::uint32 threadId = pThread->threadId;
+
+            auto jt = mThreadNames.find(threadId);
+            std::string threadName = (jt != mThreadNames.end()) ? jt->second : _lx_format("Thread %1%", threadId);
+
+            file << separator << _lx_format("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%1%,\"args\":{\"name\":\"%2%\"}}", threadId, lx0::lx_json_escape(threadName));
+            separator = ",\n";
+
+            const lx0::uint64 size  = buffer.events.size();
+            const lx0::uint64 count = buffer.count;
+            const lx0::uint64 first = _traceFirst(buffer);
+            
+            //
+            // Leaves whose matching enter was overwritten in the ring buffer 
+            // are dropped so that the output is well-nested
+            //
+            int depth = 0;
+            for (lx0::uint64 i = first; i < count; ++i)
+            {
+                const TraceEvent& evt = buffer.events[size_t(i % size)];
+                if (evt.phase == 'E' && depth == 0)
+                    continue;
+                depth += (evt.phase == 'B') ? 1 : -1;
+
+                const char* name = (evt.id > 0 && evt.id <= mSize) ? mNameMap[evt.id].c_str() : "<invalid id>";
+                file << separator << _lx_format("{\"name\":\"%1%\",\"cat\":\"lx\",\"ph\":\"%2%\",\"ts\":%3$.3f,\"pid\":1,\"tid\":%4%}", 
+                    lx0::lx_json_escape(name), evt.phase, double(evt.ticks - base) * toUs, threadId);
+            }
+        }
+
+        file << std::endl << "],\"displayTimeUnit\":\"ms\"}" << std::endl;
+        file.close();
+
+        lx_log("Wrote profile trace to '%1%'", filename);
+    }
+
+    //===========================================================================//
+
+    /*!
+        Keeps the profile tree of each of the last window frames and, for any
+        frame longer than hitchMs, a copy of its tree that is logged and kept
+        until shutdown.  A hitchMs of 0 disables hitch capture; a window of 0
+        disables per-frame capture entirely.
+
+        Frames are delimited by beginFrame() and only the sections entered on
+        the thread calling beginFrame() are captured.  The captured frames 
+        should only be read from that thread.
+     */
+    void
+    ProfileMonitor::enableFrames (size_t window, double hitchMs)
+    {
+        endFrame();
+
+        mFrames.clear();
+        if (window > 0)
+            mFrames.resize(window + 1);
+        mFrameCount = 0;
+        mHitchTicks = lx0::int64( hitchMs * double(lx0::lx_ticks_per_second()) / 1000.0 );
+    }
+
+    //! Ends the current frame (if any) and starts capturing the next
+    void
+    ProfileMonitor::beginFrame (lx0::uint32 frame)
+    {
+        if (mFrames.empty())
+            return;
+
+        ProfileThread* pThread = (_profileThreadSerial == mSerial) ? _profileThread : _acquireThread();
+        auto now = lx0::lx_ticks();
+
+        if (mpCurrentFrame)
+            _closeFrame(now);
+
+        //
+        // Slots in the ring are reused, so after the first pass over the 
+        // window the node vectors no longer allocate
+        //
+        FrameProfile& profile = mFrames[mFrameCount % mFrames.size()];
+        profile.frame      = frame;
+        profile.startTicks = now;
+        profile.duration   = 0;
+        profile.nodes.clear();
+
+        FrameNode root;
+        root.id          = 0;
+        root.parent      = -1;
+        root.firstChild  = -1;
+        root.lastChild   = -1;
+        root.nextSibling = -1;
+        root.calls       = 1;
+        root.inclusive   = 0;
+        root.start       = now;
+        profile.nodes.push_back(root);
+
+        mpCurrentFrame = &profile;
+        mFrameNode = 0;
+        mpFrameThread = pThread;
+    }
+
+    void
+    ProfileMonitor::endFrame (void)
+    {
+        if (mpCurrentFrame)
+            _closeFrame(lx0::lx_ticks());
+        mpFrameThread = nullptr;
+    }
+
+    //! Number of completed frames available via frame()
+    size_t
+    ProfileMonitor::frameCount (void) const
+    {
+        return mFrames.empty() ? 0 : std::min(mFrameCount, mFrames.size() - 1);
+    }
+
+    //! Returns a completed frame: 0 is the most recent
+    const FrameProfile&
+    ProfileMonitor::frame (size_t i) const
+    {
+        lx_check_error(i < frameCount());
+        return mFrames[(mFrameCount - 1 - i) % mFrames.size()];
+    }
+
+    void
+    ProfileMonitor::_frameEnter (int id, lx0::int64 ticks)
+    {
+        std::vector<FrameNode>& nodes = mpCurrentFrame->nodes;
+
+        int child = nodes[mFrameNode].firstChild;
+        while (child >= 0 && nodes[child].id != id)
+            child = nodes[child].nextSibling;
+
+        if (child < 0)
+        {
+            FrameNode node;
+            node.id          = id;
+            node.parent      = mFrameNode;
+            node.firstChild  = -1;
+            node.lastChild   = -1;
+            node.nextSibling = -1;
+            node.calls       = 0;
+            node.inclusive   = 0;
+
+            child = int(nodes.size());
+            nodes.push_back(node);
+
+            FrameNode& parent = nodes[mFrameNode];
+            if (parent.lastChild >= 0)
+                nodes[parent.lastChild].nextSibling = child;
+            else
+                parent.firstChild = child;
+            parent.lastChild = child;
+        }
+
+        FrameNode& node = nodes[child];
+        node.calls++;
+        node.start = ticks;
+        mFrameNode = child;
+    }
+
+    /*!
+        Sections that were already open when the frame began (e.g. the main
+        loop section) have no node in this frame and their leave is ignored.
+     */
+    void
+    ProfileMonitor::_frameLeave (int id, lx0::int64 ticks)
+    {
+        FrameNode& node = mpCurrentFrame->nodes[mFrameNode];
+        if (mFrameNode > 0 && node.id == id)
+        {
+            node.inclusive += ticks - node.start;
+            mFrameNode = node.parent;
+        }
+    }
+
+    void
+    ProfileMonitor::_closeFrame (lx0::int64 ticks)
+    {
+        FrameProfile& profile = *mpCurrentFrame;
+        std::vector<FrameNode>& nodes = profile.nodes;
+
+        // Sections still open at the frame boundary are cut off at the boundary
+        for (int i = mFrameNode; i > 0; i = nodes[i].parent)
+            nodes[i].inclusive += ticks - nodes[i].start;
+
+        profile.duration = ticks - profile.startTicks;
+        nodes[0].inclusive = profile.duration;
+
+        mpCurrentFrame = nullptr;
+        mFrameNode = 0;
+        mFrameCount++;
+
+        {
+            boost::lock_guard<boost::mutex> lock(mMutex);
+            for (size_t i = 1; i < nodes.size(); ++i)
+            {
+                if (nodes[i].parent > 0)
+                    mNesting.insert( std::make_pair(nodes[nodes[i].parent].id, nodes[i].id) );
+            }
+        }
+
+        if (mHitchTicks > 0 && profile.duration > mHitchTicks)
+        {
+            mHitches.push_back(profile);
+            if (mHitches.size() > kMaxHitches)
+                mHitches.pop_front();
+
+            lx_log("%1%", formatFrame(profile));
+        }
+    }
+
+    //! Formats the frame's profile tree as indented text, one line per node
+    std::string
+    ProfileMonitor::formatFrame (const FrameProfile& profile) const
+    {
+        const double div = double( lx0::lx_ticks_per_second() ) / 1000.0;
+        const std::vector<FrameNode>& nodes = profile.nodes;
+
+        std::string text = _lx_format("Frame %1% : %2$.3fms\n", profile.frame, double(profile.duration) / div);
+
+        std::function<void (int, int)> visit = [&](int index, int depth) {
+            const FrameNode& node = nodes[index];
+            
+            lx0::int64 exclusive = node.inclusive;
+            for (int child = node.firstChild; child >= 0; child = nodes[child].nextSibling)
+                exclusive -= nodes[child].inclusive;
+
+            if (index > 0)
+            {
+                const char* name = (node.id > 0 && node.id <= mSize) ? mNameMap[node.id].c_str() : "<invalid id>";
+                text += _lx_format("%1%%2$-30s :: %3$4d calls %4$9.3fms inc %5$9.3fms ex %6$6.1f%%\n",
+                    std::string(2 * depth, ' '),
+                    name,
+                    node.calls,
+                    double(node.inclusive) / div,
+                    double(exclusive) / div,
+                    profile.duration ? 100.0 * double(node.inclusive) / double(profile.duration) : 0.0
+                );
+            }
+
+            for (int child = node.firstChild; child >= 0; child = nodes[child].nextSibling)
+                visit(child, depth + 1);
+        };
+        if (!nodes.empty())
+            visit(0, 0);
+
+        return text;
     }
 
     void 
@@ -143,7 +752,7 @@ namespace lx0 { namespace engine { namespace profilemonitor_ns {
         std::ofstream file;
         file.open("lxprofile.log");
         auto out = [&](std::string& s) {
-            lx_log(s.c_str());
+            lx_log("%1%", s);
             file << s << std::endl;            
         };
 
@@ -153,20 +762,31 @@ namespace lx0 { namespace engine { namespace profilemonitor_ns {
         auto toMs = [div](lx0::int64 ticks) {
             return int(double(ticks) / div);
         };
+
+        //
+        // Relationships observed in the captured frames are reported along
+        // with those added explicitly
+        //
+        std::set<std::pair<std::string,std::string>> relations(mRelations.begin(), mRelations.end());
+        {
+            boost::lock_guard<boost::mutex> lock(mMutex);
+            for (auto it = mNesting.begin(); it != mNesting.end(); ++it)
+                relations.insert( std::make_pair(mNameMap[it->first], mNameMap[it->second]) );
+        }
         
-        for (auto jt = mThreadMap.begin(); jt != mThreadMap.end(); ++jt)
+        for (ProfileThread* pThread = mpThreads; pThread; pThread = pThread->pNext)
         {           
-            out( _lx_format("Thread %1% -----------------------", jt->first) );
+            out( _lx_format("Thread %1% -----------------------", pThread->threadId) );
 
             std::map<std::string,int> nameMap2;
-            auto pTable = jt->second;
+            std::vector<ProfileSample> table(mSize + 1);
 
             for (auto i = 1; i <= mSize; ++i)
             {
                 auto& name = mNameMap[i];
-                auto& prof = pTable[i];
+                auto& prof = table[i];
 
-                if (prof.calls)
+                if (_read(pThread, i, prof))
                 {
                     nameMap2.insert(std::make_pair(name, i));
 
@@ -180,12 +800,25 @@ namespace lx0 { namespace engine { namespace profilemonitor_ns {
                         toMs(prof.exclusive),
                         avgMs
                     ));
+
+                    const lx0::uint64* events = prof.events.count;
+                    if (events[lx0::PerfCounters::eCycles] > 0)
+                    {
+                        out( _lx_format("  %-30s    %14d instr %14d cycles %6.2f IPC %12d cache-miss %12d branch-miss",
+                            "",
+                            events[lx0::PerfCounters::eInstructions],
+                            events[lx0::PerfCounters::eCycles],
+                            double(events[lx0::PerfCounters::eInstructions]) / double(events[lx0::PerfCounters::eCycles]),
+                            events[lx0::PerfCounters::eCacheMisses],
+                            events[lx0::PerfCounters::eBranchMisses]
+                        ));
+                    }
                 }
             }
 
-            for (auto it = mRelations.begin(); it != mRelations.end(); ++it)
+            for (auto it = relations.begin(); it != relations.end(); ++it)
             {
-                auto getId = [&](std::string& name) -> int {
+                auto getId = [&](const std::string& name) -> int {
                     auto it = nameMap2.find(name);
                     if (it != nameMap2.end())
                         return it->second;
@@ -200,8 +833,8 @@ namespace lx0 { namespace engine { namespace profilemonitor_ns {
                 {
                     auto& parentName = mNameMap[parentId];
                     auto& childName = mNameMap[childId];
-                    auto& parent = pTable[parentId];
-                    auto& child = pTable[childId];
+                    auto& parent = table[parentId];
+                    auto& child = table[childId];
 
                     double percent = 100.0 * double(child.inclusive) / double(parent.inclusive);
 
@@ -210,6 +843,36 @@ namespace lx0 { namespace engine { namespace profilemonitor_ns {
             }
         }
 
+        if (!mHitches.empty())
+        {
+            out( _lx_format("Hitches ----------------------") );
+            for (auto it = mHitches.begin(); it != mHitches.end(); ++it)
+                out( formatFrame(*it) );
+        }
+
+        //
+        // Allocation rates are averaged over the lifetime of the monitor
+        //
+        const double seconds = std::max(double(lx0::lx_ticks() - mStartTicks) / double(lx0::lx_ticks_per_second()), 0.001);
+
+        out( _lx_format("Memory -----------------------") );
+        for (int i = 0; i < eMemoryTagCount; ++i)
+        {
+            MemoryStats stats;
+            lx_memory_stats(MemoryTag(i), stats);
+            if (stats.allocations == 0)
+                continue;
+
+            out( _lx_format("  %-30s :: %10d KB live %10d KB peak %10d allocs %10.1f allocs/s %10.1f KB/s",
+                lx_memory_tag_name(MemoryTag(i)),
+                int(stats.live / 1024),
+                int(stats.peak / 1024),
+                stats.allocations,
+                double(stats.allocations) / seconds,
+                double(stats.total) / 1024.0 / seconds
+            ));
+        }
+
         file.close();
     }
 
@@ -0,0 +1,126 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+    * MIT License (http://www.opensource.org/licenses/mit-license.php)
+
+    Copyright (c) 2010-2012 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a
+    copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+//===========================================================================//
+//   H E A D E R S
+//===========================================================================//
+
+#include <lx0/engine/snapshot.hpp>
+#include <lx0/engine/element.hpp>
+
+namespace lx0 { namespace engine_ns {
+
+    //===========================================================================//
+
+    /*!
+        Returns a pointer to the attribute value or nullptr if the attribute
+        is not set.  A pointer is returned (rather than an lxvar by value) so
+        that reading a snapshot never touches a reference count.
+     */
+    const lxvar*
+    ElementSnapshot::attr (const std::string& name) const
+    {
+        auto it = mspData->attributes.find(name);
+        if (it != mspData->attributes.end())
+            return &it->second;
+        else
+            return nullptr;
+    }
+
+    /*!
+        Depth-first traversal of the snapshot.  The traversal stops early if
+        f() returns true.
+     */
+    bool
+    ElementSnapshot::walk (std::function<bool (const ElementSnapshot&)> f) const
+    {
+        if (f(*this))
+            return true;
+
+        for (auto it = mChildren.begin(); it != mChildren.end(); ++it)
+        {
+            if ((*it)->walk(f))
+                return true;
+        }
+        return false;
+    }
+
+    //===========================================================================//
+
+    DocumentSnapshot::DocumentSnapshot (lx0::uint32 version, ElementSnapshotCPtr spRoot)
+        : mVersion (version)
+        , mspRoot  (spRoot)
+    {
+    }
+
+    //===========================================================================//
+
+    /*!
+        Returns the snapshot of this Element's sub-tree, reusing the previously
+        built snapshot node (or its data) wherever nothing has changed.
+
+        Must be called on the thread that modifies the Document.
+     */
+    ElementSnapshotCPtr
+    Element::_snapshot (void) const
+    {
+        if (mspSnapshot && mspSnapshot->mTreeVersion == mTreeVersion)
+            return mspSnapshot;
+
+        std::shared_ptr<ElementSnapshot> spNode(new ElementSnapshot);
+        spNode->mTreeVersion = mTreeVersion;
+
+        //
+        // Copy-on-write of the Element data: only clone the attributes and
+        // value if the Element itself has been modified since the last
+        // snapshot.  Otherwise the new node shares the prior immutable data.
+        //
+        if (mspSnapshot && mspSnapshot->mspData->version == mDataVersion)
+            spNode->mspData = mspSnapshot->mspData;
+        else
+        {
+            std::shared_ptr<ElementSnapshot::Data> spData(new ElementSnapshot::Data);
+            spData->version = mDataVersion;
+            spData->tagName = mTagName;
+            for (auto it = mAttributes.begin(); it != mAttributes.end(); ++it)
+                spData->attributes.insert( std::make_pair(it->first, it->second.clone()) );
+            spData->value = value().clone();
+
+            spNode->mspData = spData;
+        }
+
+        spNode->mChildren.reserve(mChildren.size());
+        for (auto it = mChildren.begin(); it != mChildren.end(); ++it)
+            spNode->mChildren.push_back( (*it)->_snapshot() );
+
+        mspSnapshot = spNode;
+        return mspSnapshot;
+    }
+
+}}
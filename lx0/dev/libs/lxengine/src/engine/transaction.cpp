@@ -28,54 +28,107 @@
 
 #include <cassert>
 
+#include <lx0/lxengine.hpp>
 #include <lx0/engine/transaction.hpp>
 #include <lx0/engine/element.hpp>
+#include <lx0/engine/document.hpp>
 
 namespace lx0 { namespace engine_ns {
 
+    Transaction::Transaction (Document* pDocument)
+        : m_pDocument (pDocument)
+    {
+    }
+
+    /*!
+        Queues spChild to be appended to spParent on submit.
+     */
+    void
+    Transaction::add (ElementPtr spParent, ElementPtr spChild)
+    {
+        assert(spParent.get() && spChild.get());
+
+        m_validations.push_back([spChild]() -> bool {
+            return spChild->parent().get() == nullptr;
+        });
+        m_operations.push_back([spParent, spChild]() -> bool {
+            spParent->append(spChild);
+            return true;
+        });
+    }
+
+    /*!
+        Returns a detached, writable copy of the Element's data.  The children
+        of the Element are not copied: use add() to modify the tree structure.
+     */
     ElementPtr  
     Transaction::write (ElementCPtr spElement)
     {
-        // clone it
-        // on submit, each element time-stamped
-        // swap each written item with the new clone
-        // mark each swapped out item as out-of-date (shared_ptr will discard
-        // when no one else is using the old item, but the flag will indicate
-        // that open for write / submit operation will succeed on the stale
-        /// object).
-
         assert(spElement.get());
 
-        ElementPtr spWritable = spElement->_clone();
-
-        m_validations.push_back([spElement]() -> bool {
-            // if submit time > spElement time, ok : else fail
-            return true;
+        //
+        // The Element is only ever modified by the submit operation, so 
+        // casting away the const-ness here is safe.
+        //
+        ElementPtr spTarget = std::const_pointer_cast<Element>(spElement);
+
+        ElementPtr spWritable(new Element);
+        spWritable->mTagName = spTarget->mTagName;
+        for (auto it = spTarget->mAttributes.begin(); it != spTarget->mAttributes.end(); ++it)
+            spWritable->mAttributes.insert( std::make_pair(it->first, it->second.clone()) );
+        spWritable->mValue = spTarget->value().clone();
+
+        //
+        // Time-stamp the Element at the time it was opened for write.  If the
+        // Element has been modified by the time of the submit, the writable copy
+        // is stale and the transaction fails.
+        //
+        const lx0::uint64 version = spTarget->dataVersion();
+
+        m_validations.push_back([spTarget, version]() -> bool {
+            return spTarget->dataVersion() == version;
         });
-        m_operations.push_back([spElement, spWritable]() -> bool {
-            // spElement->_swap(spWriteable);
+        m_operations.push_back([spTarget, spWritable]() -> bool {
+            
+            // Go through the public methods so that Components are notified
+            // and the Element versions are updated.
+            if (spTarget->tagName() != spWritable->tagName())
+                spTarget->tagName(spWritable->tagName());
+
+            for (auto it = spWritable->mAttributes.begin(); it != spWritable->mAttributes.end(); ++it)
+                spTarget->attr(it->first, it->second);
+
+            // Attributes removed from the writable copy are removed from the target
+            std::vector<std::string> removed;
+            for (auto it = spTarget->mAttributes.begin(); it != spTarget->mAttributes.end(); ++it)
+            {
+                if (spWritable->mAttributes.find(it->first) == spWritable->mAttributes.end())
+                    removed.push_back(it->first);
+            }
+            for (auto it = removed.begin(); it != removed.end(); ++it)
+                spTarget->removeAttr(*it);
+
+            spTarget->value(spWritable->mValue);
             return true;
         });
 
         return spWritable;
     }
 
+    /*!
+        Validates and then applies all queued operations.  Returns false, without
+        modifying the Document, if any validation fails.  The Transaction is 
+        empty after submit() regardless of the result.
+     */
     bool 
     Transaction::submit()
     {
-        // document.lock();
         bool bValid = true;
         for (auto it = m_validations.begin(); it != m_validations.end(); ++it)
         {
             bValid &= (*it)();
         }
 
-        // TODO: Need to check that there aren't any open references to the object
-        // after the submit?  Otherwise, the Element opened for write could simply
-        // be used again after the submit - but this would be directly modifying
-        // the contents of the document outside the transaction mechanism.
-        // This might have to be handled via a run-time flag "open" on the Element.
-
         if (bValid)
         {
             for (auto it = m_operations.begin(); it != m_operations.end(); ++it)
@@ -83,16 +136,26 @@ namespace lx0 { namespace engine_ns {
                 bool bOk = (*it)();
 
                 if (!bOk)
-                {
-                    // stop loop
-                    // attempt rollback if possible
-                    // throw exception
-                }
+                    throw lx_error_exception("Transaction operation failed after validation.  Document may be partially modified.");
             }
+
+            if (m_pDocument)
+                m_pDocument->_incrementVersion();
         }
         
-        
-        // document.unlock();
+        m_validations.clear();
+        m_operations.clear();
         return bValid;
     }
+
+    /*!
+        Discards all queued operations.  Writable copies returned by write()
+        are left untouched, but are no longer connected to the Document.
+     */
+    void
+    Transaction::revert()
+    {
+        m_validations.clear();
+        m_operations.clear();
+    }
 }}
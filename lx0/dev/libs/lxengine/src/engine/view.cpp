@@ -46,12 +46,13 @@
 
 namespace lx0 { namespace engine_ns {
 
+    static ObjectTracker s_viewCount("View");
 
     View::View (std::string impType, Document* pDocument)
         : mpDocument (pDocument)
         , mpDocForwarder (nullptr)
     {
-        Engine::acquire()->incObjectCount("View");
+        s_viewCount.inc();
 
         lx_check_error(pDocument != nullptr, "Views must have a valid host Document");
 
@@ -82,7 +83,7 @@ namespace lx0 { namespace engine_ns {
             (it->second)->shutdown(this);
 
         mspImp->destroyWindow();
-        Engine::acquire()->decObjectCount("View");
+        s_viewCount.dec();
     }
 
     
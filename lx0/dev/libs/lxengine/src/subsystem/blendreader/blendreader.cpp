@@ -41,6 +41,11 @@
 #include <map>
 #include <deque>
 #include <iomanip>
+#include <algorithm>
+
+// Boost headers
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 
 // Lx0 headers
 #include <lx0/lxengine.hpp>
@@ -77,85 +82,125 @@ namespace {
 
 namespace lx0 { namespace subsystem { namespace blendreader_ns { 
 
+    //===========================================================================//
+    //! Read-only memory mapping of a .blend file
+    /*!
+        Shared between the BlendReader and all Objects read from it.
+     */
+    struct MappedFile
+    {
+        MappedFile (const std::string& filename)
+            : mapping (filename.c_str(), boost::interprocess::read_only)
+            , region  (mapping, boost::interprocess::read_only)
+        {
+        }
+
+        const char* data (void) const { return static_cast<const char*>(region.get_address()); }
+        size_t      size (void) const { return region.get_size(); }
+
+        boost::interprocess::file_mapping   mapping;
+        boost::interprocess::mapped_region  region;
+    };
+
     namespace io_util
     {
         /*!
-            Aligns the file pointer to the next position that is evenly divisble
-            by "align".
+            Bounds-checked read position within the mapped file.  All multi-byte
+            reads are byte-swapped if the file endianness differs from the host.
          */
-        void file_align (std::ifstream& file, int align)
+        struct Cursor
+        {
+            Cursor (const char* pData, size_t size)
+                : pBegin (pData)
+                , p      (pData)
+                , pEnd   (pData + size)
+                , bSwap  (false)
+            {
+            }
+
+            size_t  pos     (void) const    { return size_t(p - pBegin); }
+            size_t  size    (void) const    { return size_t(pEnd - pBegin); }
+
+            void seek (size_t offset)
+            {
+                lx_check_error(offset <= size(), "Unexpected end of .blend file");
+                p = pBegin + offset;
+            }
+
+            const char* advance (size_t len)
+            {
+                lx_check_error(size_t(pEnd - p) >= len, "Unexpected end of .blend file");
+                const char* pData = p;
+                p += len;
+                return pData;
+            }
+
+            const char* pBegin;
+            const char* p;
+            const char* pEnd;
+            bool        bSwap;
+        };
+
+        template <typename T>
+        inline T read_value (Cursor& cursor)
         {
-            int pos = (int)file.tellg();
-            int offset = (align - (pos % align)) % align;
-            file.seekg(pos + offset);
+            T value;
+            ::memcpy(&value, cursor.advance(sizeof(T)), sizeof(T));
+            if (cursor.bSwap)
+                swap_bytes(&value, sizeof(T));
+            return value;
         }
 
         /*!
-            Read a 32-bit little endian pointer and return it as a
-            native unsigned 64 bit address.
+            Aligns the cursor to the next position that is evenly divisble
+            by "align".
          */
-        inline unsigned __int64 read_addr_32L (std::ifstream& file)
+        void file_align (Cursor& cursor, size_t align)
         {
-            __int32 i;
-            file.read((char*)&i, 4);
-            return __int64(i);
+            size_t pos = cursor.pos();
+            cursor.seek(pos + (align - (pos % align)) % align);
         }
 
-        inline unsigned __int64 read_addr_64L (std::ifstream& file)
+        /*!
+            Read a 32 or 64-bit pointer and return it as a native unsigned 64 
+            bit address.
+         */
+        inline lx0::uint64 read_address (Cursor& cursor, size_t pointerSize)
         {
-            __int64 i;
-            file.read((char*)&i, 8);
-            return i;
+            if (pointerSize == 4)
+                return lx0::uint64( read_value<lx0::uint32>(cursor) );
+            else
+                return read_value<lx0::uint64>(cursor);
         }
 
-        inline unsigned short read_u16 (std::ifstream& file)
+        inline lx0::uint16 read_u16 (Cursor& cursor)
         {
-            unsigned short i;
-            file.read((char*)&i, 2);
-            return i;
+            return read_value<lx0::uint16>(cursor);
         }
 
-        inline __int32 read_int (std::ifstream& file)
+        inline lx0::uint32 read_int (Cursor& cursor)
         {
-            __int32 i;
-            file.read((char*)&i, 4);
-            return i;
+            return read_value<lx0::uint32>(cursor);
         }
 
-        std::string read_str (std::ifstream& file, size_t len)
+        std::string read_str (Cursor& cursor, size_t len)
         {
-            std::vector<char> buffer(len + 1);
-            file.read(&buffer[0], len);
-            buffer[len] = 0;
-            return std::string(&buffer[0]);
+            const char* p = cursor.advance(len);
+            return std::string(p, std::find(p, p + len, '\0'));
         }
 
-        void read_string_array(std::ifstream& file, std::vector<std::string>& names)
+        void read_string_array (Cursor& cursor, std::vector<std::string>& names)
         {
-            unsigned int nameCount = read_int(file);
+            lx0::uint32 nameCount = read_int(cursor);
             names.reserve(nameCount);
 
-            for (unsigned int i = 0; i < nameCount; ++i)
+            for (lx0::uint32 i = 0; i < nameCount; ++i)
             {
-                std::string t;
-                char buffer[257];
-                int  j = 0;
-
-                char c;
-                while ((c = (char)file.get()))
-                {
-                    buffer[j++] = c;
-                    if (j == 256)
-                    {
-                        buffer[j] = '\0';
-                        j = 0;
-                        t += buffer;
-                    }
-                }
-                buffer[j] = '\0';
-                t += buffer;
-
-                names.push_back(t);
+                const char* pEnd = std::find(cursor.p, cursor.pEnd, '\0');
+                lx_check_error(pEnd != cursor.pEnd, "Unterminated string in .blend DNA");
+                
+                names.push_back( std::string(cursor.p, pEnd) );
+                cursor.p = pEnd + 1;
             }
         }
 
@@ -165,20 +210,17 @@ namespace lx0 { namespace subsystem { namespace blendreader_ns {
 
 
     static void 
-    readHeader (std::ifstream& file, Header& header)
+    readHeader (Cursor& cursor, Header& header)
     {
         lx0::ProfileSection section(counters.readHeader);
 
-        // The header is always 12-bytes long.  Read it all
-        // as a single chunk, then process that data
+        // The header is always 12-bytes long
         //
-        char buffer[12];
-        file.read(buffer, 12);
+        const char* buffer = cursor.advance(12);
     
         // First 7 characters are the BLENDER id
         //
-        header.identifier.resize(7);
-        ::memcpy(&header.identifier[0], &buffer[0], 7);
+        header.identifier.assign(buffer, 7);
         lx_check_error(header.identifier == "BLENDER");
 
         // Next character indicates the pointer size on the
@@ -208,57 +250,55 @@ namespace lx0 { namespace subsystem { namespace blendreader_ns {
     }
 
     static void
-    readBlockDNA1 (std::ifstream& file, const Header& header, DNA& dna)
+    readBlockDNA1 (Cursor& cursor, const Header& header, DNA& dna)
     {
         lx0::Timer timer;       
         timer.start();
         
-        std::string sdna = read_str(file, 4);
+        std::string sdna = read_str(cursor, 4);
                     
         std::vector<std::string> names;
-        std::string name = read_str(file, 4);
-        read_string_array(file, names);
+        std::string name = read_str(cursor, 4);
+        read_string_array(cursor, names);
 
-        file_align(file, 4);
+        file_align(cursor, 4);
 
         std::vector<std::string> types;            
-        std::string type = read_str(file, 4);
-        read_string_array(file, types);
+        std::string type = read_str(cursor, 4);
+        read_string_array(cursor, types);
 
-        file_align(file, 4);
+        file_align(cursor, 4);
 
-        std::string tlen = read_str(file, 4);
+        std::string tlen = read_str(cursor, 4);
         std::vector<unsigned short> typeSizes(types.size());
         for (size_t i = 0; i < types.size(); ++i)
-        {
-            file.read((char*)&typeSizes[i], 2);
-        }
+            typeSizes[i] = read_u16(cursor);
 
-        file_align(file, 4);
+        file_align(cursor, 4);
 
-        std::string strc = read_str(file, 4);
-        unsigned int count = read_int(file);
+        std::string strc = read_str(cursor, 4);
+        lx0::uint32 count = read_int(cursor);
         dna.structIndex.resize(count);
 
-        for (unsigned int i = 0; i < count; ++i)
+        for (lx0::uint32 i = 0; i < count; ++i)
         {
             Structure* pStruct = new Structure;
 
-            unsigned short type;
-            file.read((char*)&type, 2);
+            unsigned short type = read_u16(cursor);
+            lx_check_error(type < types.size());
 
             pStruct->name = types[type];
             pStruct->size = typeSizes[type];
 
-            unsigned short fields;
-            file.read((char*)&fields, 2);
+            unsigned short fields = read_u16(cursor);
 
             size_t currentOffset = 0;
             pStruct->fields.reserve(fields);            
             for (unsigned short j = 0; j < fields; j++)
             {
-                auto typeIndex = read_u16(file);
-                auto nameIndex = read_u16(file);
+                auto typeIndex = read_u16(cursor);
+                auto nameIndex = read_u16(cursor);
+                lx_check_error(typeIndex < types.size() && nameIndex < names.size());
                             
                 Structure::Field f;
                 f.ref = "";
@@ -271,25 +311,23 @@ namespace lx0 { namespace subsystem { namespace blendreader_ns {
                 while (*p == '*') p++;
                 while (*p != '[' && *p != '\0') f.ref += *p++;
 
-                if (*p == '[')
+                // Multi-dimensional arrays (e.g. "obmat[4][4]") are treated as
+                // a flat array of the total element count
+                f.dim = 1;
+                while (*p == '[')
                 {
-                    f.dim = 0;
+                    size_t n = 0;
+                    for (p++; *p >= '0' && *p <= '9'; ++p)
+                        n = n * 10 + size_t(*p - '0');
+                    f.dim *= n;
 
-                    p++;
-                    do
-                    {
-                        f.dim += int(*p - '0');
+                    if (*p == ']')
                         p++;
-                        if (*p == ']')
-                            break;
-                        else
-                            f.dim *= 10;
-                    } while (*p != ']');
                 }
-                else
-                    f.dim = 1;
 
-                if (f.name[0] == '*')
+                // Both data pointers ("*next") and function pointers ("(*func)()")
+                // are stored at the pointer size of the saving system
+                if (f.name[0] == '*' || f.name[0] == '(')
                     f.size = header.pointerSize;
                 else
                     f.size = typeSizes[typeIndex];
@@ -308,36 +346,54 @@ namespace lx0 { namespace subsystem { namespace blendreader_ns {
         lx_log("readBlockDNA1 time %1%ms", timer.totalMs());
     }
 
+    void 
+    swap_bytes (void* pData, size_t size)
+    {
+        char* p = static_cast<char*>(pData);
+        std::reverse(p, p + size);
+    }
+
     //===========================================================================//
-    //   BlendReader
+    //   BlendReader::Object
     //===========================================================================//
 
-    std::pair<char*,size_t>
-    BlendReader::Object::fieldImp (std::string ref, int index, size_t expectedSize)
+    BlendReader::Object::Object (void)
+        : pBegin   (nullptr)
+        , pEnd     (nullptr)
+        , pCurrent (nullptr)
+        , bSwap    (false)
     {
-        auto it = spStruct->fieldMap.find(ref);
-        if (it != spStruct->fieldMap.end())
-        {
-            auto spField = it->second;
-
-            lx_check_error(expectedSize == 0 || spField->size == expectedSize * spField->dim, 
-                "Size mismatch in loading .blend field '%s'.  Is an 32/64-bit address being loaded?", ref.c_str());
+    }
 
-            char* pBase = &pCurrent[ spField->offset ];
-            if (index != 0)
-                pBase += (spField->size / spField->dim) * index;
-            
-            lx_check_error(size_t(pBase - &chunk[0]) < chunk.size());
-        
-            return std::make_pair(pBase, spField->size);
-        }
-        else
+    const Structure::Field*
+    BlendReader::Object::_field (const std::string& ref, size_t expectedSize) const
+    {
+        auto it = spStruct->fieldMap.find(ref);
+        if (it == spStruct->fieldMap.end())
         {
             throw lx_error_exception("Field '%s' does not exist in object of type '%s'",
                 ref.c_str(),
                 spStruct->name.c_str());
-            return std::make_pair(nullptr, 0);
         }
+
+        const Structure::Field* pField = it->second;
+        lx_check_error(expectedSize == 0 || pField->size == expectedSize * pField->dim, 
+            "Size mismatch in loading .blend field '%s'.  Is an 32/64-bit address being loaded?", ref.c_str());
+        
+        return pField;
+    }
+
+    std::pair<const char*,size_t>
+    BlendReader::Object::fieldImp (std::string ref, int index, size_t expectedSize)
+    {
+        const Structure::Field* pField = _field(ref, expectedSize);
+
+        const size_t elementSize = pField->size / pField->dim;
+        const char* pBase = pCurrent + pField->offset + elementSize * index;
+            
+        lx_check_error(pBase >= pBegin && pBase + elementSize <= pEnd);
+        
+        return std::make_pair(pBase, pField->size);
     }
 
     lx0::uint64
@@ -345,9 +401,21 @@ namespace lx0 { namespace subsystem { namespace blendreader_ns {
     {
         auto v = fieldImp(ref, index, 0);
         if (v.second == 4)
-            return lx0::uint64( *reinterpret_cast<lx0::uint32*>(v.first) );
+        {
+            lx0::uint32 addr;
+            ::memcpy(&addr, v.first, 4);
+            if (bSwap) 
+                swap_bytes(&addr, 4);
+            return lx0::uint64(addr);
+        }
         else
-            return lx0::uint64( *reinterpret_cast<lx0::uint64*>(v.first) );
+        {
+            lx0::uint64 addr;
+            ::memcpy(&addr, v.first, 8);
+            if (bSwap) 
+                swap_bytes(&addr, 8);
+            return addr;
+        }
     }
 
     void    
@@ -356,6 +424,45 @@ namespace lx0 { namespace subsystem { namespace blendreader_ns {
         pCurrent += spStruct->size;
     }
 
+    /*!
+        Number of structures stored in the object's block.
+     */
+    size_t
+    BlendReader::Object::count (void) const
+    {
+        return spBlock ? spBlock->count : 0;
+    }
+
+    const std::string&
+    BlendReader::Object::typeName (void) const
+    {
+        return spStruct->name;
+    }
+
+    /*!
+        Byte offset of the field within the structure.  Useful for fields
+        that are themselves structures (e.g. the "id" field of an Object).
+     */
+    size_t
+    BlendReader::Object::offset (std::string ref) const
+    {
+        return _field(ref, 0)->offset;
+    }
+
+    /*!
+        Size in bytes of each structure in the block: i.e. the offset from one 
+        element to the next when walking data() directly.
+     */
+    size_t
+    BlendReader::Object::stride (void) const
+    {
+        return spStruct->size;
+    }
+
+    //===========================================================================//
+    //   BlendReader
+    //===========================================================================//
+
     bool    
     BlendReader::open (std::string filename)
     {
@@ -363,24 +470,29 @@ namespace lx0 { namespace subsystem { namespace blendreader_ns {
 
         lx0::ProfileSection section(counters.open);
 
-        mFile.open (filename, std::ios::in | std::ios::binary);
-        if (mFile.is_open())
+        try
         {
-            readHeader(mFile, mHeader);
+            mspFile.reset( new MappedFile(filename) );
+        }
+        catch (boost::interprocess::interprocess_exception&)
+        {
+            mspFile.reset();
+            return false;
+        }
 
-            switch (mHeader.pointerSize)
-            {
-            case 8: mIO.read_address = read_addr_64L; break;
-            case 4: mIO.read_address = read_addr_32L; break;
-            default: 
-                throw lx_error_exception("Unexpected pointer size read from .blend file");
-            }            
+        Cursor cursor(mspFile->data(), mspFile->size());
+        readHeader(cursor, mHeader);
+
+        if (mHeader.pointerSize != 4 && mHeader.pointerSize != 8)
+            throw lx_error_exception("Unexpected pointer size read from .blend file");
+
+        // Only swap if the file was not saved on a host of the same endianness
+        mbSwap = (mHeader.littleEndian != lx_little_endian());
             
-            _readBlocks();
-            _indexBlocks();            
-        }
+        _readBlocks();
+        _indexBlocks();            
 
-        return mFile.is_open();
+        return true;
     }
 
 
@@ -393,30 +505,36 @@ namespace lx0 { namespace subsystem { namespace blendreader_ns {
     {
         lx0::ProfileSection section(counters.readBlocks);
 
+        Cursor cursor(mspFile->data(), mspFile->size());
+        cursor.bSwap = mbSwap;
+        cursor.seek(12);
+
         //
-        // Loop over the blocks in the file
+        // Loop over the blocks in the file.  Only the block headers and the
+        // DNA are parsed; the block data is left in place in the mapping.
         //
         bool bDone = false;
         while (!bDone)
         {
             std::shared_ptr<Block> spBlock(new Block);         
-            spBlock->id = read_str(mFile, 4);
-            spBlock->size = read_int(mFile);
-            spBlock->address = mIO.read_address(mFile);
-            spBlock->sdnaIndex = read_int(mFile);
-            spBlock->count = read_int(mFile);
+            spBlock->id = read_str(cursor, 4);
+            spBlock->size = read_int(cursor);
+            spBlock->address = read_address(cursor, mHeader.pointerSize);
+            spBlock->sdnaIndex = read_int(cursor);
+            spBlock->count = read_int(cursor);
 
-            spBlock->filePos = (int)mFile.tellg();
-            int nextBlock = spBlock->filePos + int(spBlock->size);
+            spBlock->filePos = cursor.pos();
+            size_t nextBlock = spBlock->filePos + spBlock->size;
+            lx_check_error(nextBlock <= cursor.size(), "Truncated block '%s' in .blend file", spBlock->id.c_str());
 
             mDNA.blockIndex.push_back(spBlock);
 
             if (spBlock->id == "ENDB")
                 bDone = true;
             else if (spBlock->id == "DNA1")
-                readBlockDNA1(mFile, mHeader, mDNA);
+                readBlockDNA1(cursor, mHeader, mDNA);
 
-            mFile.seekg(nextBlock);
+            cursor.seek(nextBlock);
         }
     }
 
@@ -432,30 +550,45 @@ namespace lx0 { namespace subsystem { namespace blendreader_ns {
 
         for (auto it = mDNA.blockIndex.begin(); it != mDNA.blockIndex.end(); ++it)
         {
+            lx_check_error((*it)->sdnaIndex < mDNA.structIndex.size());
+
             (*it)->spStruct = mDNA.structIndex[(*it)->sdnaIndex];
             mDNA.blockMap[(*it)->spStruct->name].push_back(*it);
             mDNA.blockAddr[(*it)->address] = *it;
         }
     }
 
-    std::shared_ptr<BlendReader::Object> 
-    BlendReader::readObject (unsigned __int64 address)
+    /*!
+        Returns an Object pointing directly at the block data within the 
+        mapped file.  No data is copied.
+     */
+    BlendReader::Object
+    BlendReader::object (lx0::uint64 address)
     {
         lx_check_error(address != 0);
-        lx_check_error(mFile.is_open());
-
-        std::shared_ptr<Object> spObj (new Object);
-        
-        spObj->spBlock = mDNA.blockAddr[address];
-        spObj->spStruct = spObj->spBlock->spStruct;
-
-        spObj->chunk.resize( spObj->spBlock->size );
-        mFile.seekg( spObj->spBlock->filePos );
-        mFile.read(&spObj->chunk[0], spObj->chunk.size());
-
-        spObj->pCurrent = &spObj->chunk[0];
+        lx_check_error(mspFile);
+
+        auto it = mDNA.blockAddr.find(address);
+        lx_check_error(it != mDNA.blockAddr.end(), "No block at address 0x%llx in .blend file", address);
+
+        Object obj;
+        obj.spBlock  = it->second;
+        obj.spStruct = obj.spBlock->spStruct;
+        lx_check_error(size_t(obj.spBlock->count) * obj.spStruct->size <= obj.spBlock->size,
+            "Block at address 0x%llx is smaller than its structure count implies", address);
+
+        obj.spFile   = mspFile;
+        obj.pBegin   = mspFile->data() + obj.spBlock->filePos;
+        obj.pEnd     = obj.pBegin + obj.spBlock->size;
+        obj.pCurrent = obj.pBegin;
+        obj.bSwap    = mbSwap;
+        return obj;
+    }
 
-        return spObj;
+    BlendReader::ObjectPtr
+    BlendReader::readObject (lx0::uint64 address)
+    {
+        return ObjectPtr( new Object(object(address)) );
     }
 
     StructurePtr
@@ -471,4 +604,3 @@ namespace lx0 { namespace subsystem { namespace blendreader_ns {
     }
 
 }}}
-
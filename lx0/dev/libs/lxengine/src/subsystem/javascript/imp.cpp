@@ -170,7 +170,7 @@ namespace {
 
         virtual lx0::uint32 flags() const;
 
-        virtual void    onUpdate            (ElementPtr spElem);
+        virtual void    onUpdate            (Element* pElem);
 
         Persistent<Function>            mOnUpdate;
 
@@ -280,12 +280,12 @@ namespace {
     }
 
     void
-    JavascriptElem::onUpdate (ElementPtr spElem) 
+    JavascriptElem::onUpdate (Element* pElem) 
     {
         // Call the onUpdate() JS function if one has been attached to that event
         if (!mOnUpdate.IsEmpty())
         {
-            auto spJsDoc = spElem->document()->getComponent<JavascriptDoc>("javascript");
+            auto spJsDoc = pElem->document()->getComponent<JavascriptDoc>("javascript");
             Context::Scope context_scope(spJsDoc->mContext);
 
             //\todo Need to set the "this" ponter to the JS Element wrapper
@@ -33,7 +33,17 @@
 
 #include <glm/gtc/matrix_inverse.hpp>
 
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#   define LX_BLENDLOAD_SSE2
+#   include <emmintrin.h>
+#endif
+
+#include <map>
+#include <set>
+#include <algorithm>
+
 #include <lx0/lxengine.hpp>
+#include <lx0/engine/detail/resourcebatch.hpp>
 #include <lx0/subsystem/blendreader.hpp>
 #include <lx0/util/blendload.hpp>
 
@@ -47,62 +57,123 @@ static
 void
 _primitive_buffer_from_block (glgeom::primitive_buffer& primitive, lx0::BlendReader& reader, lx0::BlockPtr spBlock, const glm::mat4& pretransform)
 {
-    auto spMesh = reader.readObject( spBlock->address );
-    const auto totalVertices = spMesh->field<int>("totvert");
-    const auto totalFaces = spMesh->field<int>("totface");
+    auto mesh = reader.object( spBlock->address );
+    const auto totalVertices = mesh.field<int>("totvert");
+    const auto totalFaces = mesh.field<int>("totface");
 
     primitive.type = "quads";
 
     //
-    // Reserve the memory needed in advance for efficiency
+    // Size the buffers in advance so the loops below write directly into
+    // contiguous memory
     //
-    primitive.indices.reserve(totalFaces * 4);
-    primitive.vertex.positions.reserve(totalVertices);
-    primitive.vertex.normals.reserve(totalVertices);
-    primitive.vertex.colors.reserve(totalVertices);
-    primitive.face.flags.reserve(totalFaces);
-
-    glm::mat3 normalMatrix = glm::mat3(glm::inverseTranspose(pretransform));
+    primitive.indices.resize(totalFaces * 4);
+    primitive.vertex.positions.resize(totalVertices);
+    primitive.vertex.normals.resize(totalVertices);
+    primitive.vertex.colors.assign(totalVertices, glgeom::color3f(1, 1, 1));
+    primitive.face.flags.resize(totalFaces);
 
     //
     // Walk the vertices
     //
-    auto spVerts = reader.readObject( spMesh->address("mvert") );
-    for (int i = 0; i < totalVertices; ++i)
+    // Field offsets are resolved once for the MVert structure so that the 
+    // per-vertex work is pointer arithmetic on the mapped file data.  The
+    // normals are stored as shorts normalized to the short range, so the
+    // scale is folded into the normal matrix.
+    //
+    auto verts = reader.object( mesh.address("mvert") );
+    lx_check_error( verts.count() >= size_t(totalVertices) );
+
+    const auto  co       = verts.accessor<float>("co");
+    const auto  no       = verts.accessor<short>("no");
+    const char* pVert    = verts.data();
+    const size_t stride  = verts.stride();
+
+    const glm::mat4 m = pretransform;
+    const glm::mat3 nm = glm::mat3(glm::inverseTranspose(pretransform)) * (1.0f / float(std::numeric_limits<short>::max()));
+
+    glgeom::point3f*  pPositions = primitive.vertex.positions.data();
+    glgeom::vector3f* pNormals   = primitive.vertex.normals.data();
+
+#ifdef LX_BLENDLOAD_SSE2
+    if (!verts.swapped())
+    {
+        const __m128 m0 = _mm_setr_ps(m[0][0], m[0][1], m[0][2], 0.0f);
+        const __m128 m1 = _mm_setr_ps(m[1][0], m[1][1], m[1][2], 0.0f);
+        const __m128 m2 = _mm_setr_ps(m[2][0], m[2][1], m[2][2], 0.0f);
+        const __m128 m3 = _mm_setr_ps(m[3][0], m[3][1], m[3][2], 0.0f);
+        const __m128 n0 = _mm_setr_ps(nm[0][0], nm[0][1], nm[0][2], 0.0f);
+        const __m128 n1 = _mm_setr_ps(nm[1][0], nm[1][1], nm[1][2], 0.0f);
+        const __m128 n2 = _mm_setr_ps(nm[2][0], nm[2][1], nm[2][2], 0.0f);
+
+        __m128 bmin = _mm_set1_ps( std::numeric_limits<float>::max());
+        __m128 bmax = _mm_set1_ps(-std::numeric_limits<float>::max());
+
+        for (int i = 0; i < totalVertices; ++i, pVert += stride)
+        {
+            const float* pc = reinterpret_cast<const float*>(pVert + co.offset());
+            const short* pn = reinterpret_cast<const short*>(pVert + no.offset());
+
+            __m128 p = m3;
+            p = _mm_add_ps(p, _mm_mul_ps(m0, _mm_load1_ps(pc + 0)));
+            p = _mm_add_ps(p, _mm_mul_ps(m1, _mm_load1_ps(pc + 1)));
+            p = _mm_add_ps(p, _mm_mul_ps(m2, _mm_load1_ps(pc + 2)));
+            bmin = _mm_min_ps(bmin, p);
+            bmax = _mm_max_ps(bmax, p);
+
+            __m128 n = _mm_mul_ps(n0, _mm_set1_ps(float(pn[0])));
+            n = _mm_add_ps(n, _mm_mul_ps(n1, _mm_set1_ps(float(pn[1]))));
+            n = _mm_add_ps(n, _mm_mul_ps(n2, _mm_set1_ps(float(pn[2]))));
+
+            float* pp = &pPositions[i].x;
+            _mm_storel_pi(reinterpret_cast<__m64*>(pp), p);
+            _mm_store_ss(pp + 2, _mm_movehl_ps(p, p));
+
+            float* pnn = &pNormals[i].x;
+            _mm_storel_pi(reinterpret_cast<__m64*>(pnn), n);
+            _mm_store_ss(pnn + 2, _mm_movehl_ps(n, n));
+        }
+
+        float lo[4], hi[4];
+        _mm_storeu_ps(lo, bmin);
+        _mm_storeu_ps(hi, bmax);
+        primitive.bbox.merge(glgeom::point3f(lo[0], lo[1], lo[2]));
+        primitive.bbox.merge(glgeom::point3f(hi[0], hi[1], hi[2]));
+    }
+    else
+#endif
     {
-        glm::vec4 p;
-        p.x = spVerts->field<float>("co", 0);
-        p.y = spVerts->field<float>("co", 1);
-        p.z = spVerts->field<float>("co", 2);
-        p.w = 1.0f;
-        p = pretransform * p;
-        glgeom::point3f p2(p.x, p.y, p.z);
-        primitive.vertex.positions.push_back(p2);
-        primitive.bbox.merge(p2);
-
-        glgeom::vector3f n;
-        n.x = spVerts->field<short>("no", 0) / float(std::numeric_limits<short>::max());
-        n.y = spVerts->field<short>("no", 1) / float(std::numeric_limits<short>::max());
-        n.z = spVerts->field<short>("no", 2) / float(std::numeric_limits<short>::max());
-        n.vec = normalMatrix * n.vec;
-        primitive.vertex.normals.push_back(n);
-
-        primitive.vertex.colors.push_back( glgeom::color3f(1, 1, 1) );
-
-        spVerts->next();
+        for (int i = 0; i < totalVertices; ++i, pVert += stride)
+        {
+            glm::vec4 p = m * glm::vec4(co(pVert, 0), co(pVert, 1), co(pVert, 2), 1.0f);
+            pPositions[i] = glgeom::point3f(p.x, p.y, p.z);
+            primitive.bbox.merge(pPositions[i]);
+
+            pNormals[i].vec = nm * glm::vec3(no(pVert, 0), no(pVert, 1), no(pVert, 2));
+        }
     }
 
     //
     // Walk the faces
     //
-    auto spFaces = reader.readObject( spMesh->address("mface") );
-    for (int i = 0; i < totalFaces; ++i)
+    auto faces = reader.object( mesh.address("mface") );
+    lx_check_error( faces.count() >= size_t(totalFaces) );
+
+    const auto  v1      = faces.accessor<int>("v1");
+    const auto  v2      = faces.accessor<int>("v2");
+    const auto  v3      = faces.accessor<int>("v3");
+    const auto  v4      = faces.accessor<int>("v4");
+    const auto  flag    = faces.accessor<lx0::uint8>("flag");
+    const char* pFace   = faces.data();
+    const size_t faceStride = faces.stride();
+
+    for (int i = 0; i < totalFaces; ++i, pFace += faceStride)
     {
         int vi[4];
-        vi[0] = spFaces->field<int>("v1");
-        vi[1] = spFaces->field<int>("v2");
-        vi[2] = spFaces->field<int>("v3");
-        vi[3] = spFaces->field<int>("v4");
+        vi[0] = v1(pFace);
+        vi[1] = v2(pFace);
+        vi[2] = v3(pFace);
+        vi[3] = v4(pFace);
             
         // Convert tris into degenerate quads
         // Is there a better way to handle meshes which can potentially contain tri/quad mixes?
@@ -114,17 +185,15 @@ _primitive_buffer_from_block (glgeom::primitive_buffer& primitive, lx0::BlendRea
             // Add the face index to the 16-bit primitive index array.  
             // Check for overflow.
             //
-            primitive.indices.push_back(vi[j]);
-            lx_check_error( primitive.indices.back() == vi[j] );
+            auto& index = primitive.indices[i * 4 + j];
+            index = vi[j];
+            lx_check_error( index == vi[j] );
         }
 
         // The blender source code implies that
         // 1 = ME_SMOOTH
         // 2 = ME_FACE_SEL
-        lx0::uint8 flag = spFaces->field<lx0::uint8>("flag");
-        primitive.face.flags.push_back(flag);
-
-        spFaces->next();
+        primitive.face.flags[i] = flag(pFace);
     }
 
     //
@@ -152,6 +221,8 @@ lx0::util::blendload_ns::primitive_buffer_from_blendfile (glgeom::primitive_buff
 {
     lx_check_error( lx0::file_exists(filename) );
 
+    lx0::MemoryScope memoryScope(lx0::eMemoryMesh);
+
     //
     // Use the BlendReader to iterate over the .blend data
     //
@@ -159,7 +230,8 @@ lx0::util::blendload_ns::primitive_buffer_from_blendfile (glgeom::primitive_buff
     reader.open(filename);
             
     //
-    // Currently, the function only support files with a single "Mesh" entry.  I
+    // This function reads a single "Mesh" entry.  Use 
+    // primitive_buffers_from_blendfile() for files with multiple meshes.
     //
     auto meshBlocks = reader.getBlocksByType("Mesh");
     switch (meshBlocks.size())
@@ -170,10 +242,108 @@ lx0::util::blendload_ns::primitive_buffer_from_blendfile (glgeom::primitive_buff
         // A-OK
         break;
     default:
-        lx_warn("More than one mesh block detected.  Only the first will be read!");
+        lx_warn("More than one mesh block detected.  Only the first will be read!  Use primitive_buffers_from_blendfile() to read all meshes.");
     }
 
     _primitive_buffer_from_block(primitive, reader, meshBlocks.front(), pretransform);
 
     lx_debug("Loaded '%s'.  %u vertices, %u faces.", filename, primitive.vertex.positions.size(), primitive.indices.size() / 4);
 }
+
+/*!
+    Returns the name stored in the ID structure at the start of a Blender
+    datablock, without the two character type prefix (e.g. "OB" or "ME").
+ */
+static std::string
+_id_name (lx0::BlendReader& reader, const lx0::BlendReader::Object& obj)
+{
+    auto spID = reader.getStructureByName("ID");
+    lx_check_error(spID, "No ID structure in .blend DNA");
+
+    auto it = spID->fieldMap.find("name");
+    lx_check_error(it != spID->fieldMap.end());
+
+    const char* pName = obj.data() + obj.offset("id") + it->second->offset;
+    const char* pEnd  = std::find(pName, pName + it->second->size, '\0');
+    return (pEnd - pName > 2) ? std::string(pName + 2, pEnd) : std::string();
+}
+
+/*!
+    Loads every mesh in the .blend file.  Each distinct Mesh is converted
+    once, in parallel on the engine worker threads (or a temporary set of 
+    threads if there are none).  Each Blender Object referencing a Mesh adds 
+    an entry with the Object's world transform; Meshes not referenced by any 
+    Object are added with an identity transform.
+
+    \param pretransform 
+        Applies a transform to each vertex as the file is read.  The Object 
+        transforms are not applied to the vertices.
+ */
+void 
+lx0::util::blendload_ns::primitive_buffers_from_blendfile (std::vector<blend_mesh>& meshes, const char* filename, const glm::mat4& pretransform)
+{
+    lx_check_error( lx0::file_exists(filename) );
+
+    lx0::BlendReader reader;
+    lx_check_error( reader.open(filename) );
+
+    auto meshBlocks = reader.getBlocksByType("Mesh");
+    if (meshBlocks.empty())
+        throw lx_error_exception("Loaded .blend file but no mesh block were found");
+
+    //
+    // Queue the conversion of each Mesh.  The BlendReader is safe to read 
+    // from concurrently once opened.
+    //
+    std::map<lx0::uint64, std::shared_ptr<glgeom::primitive_buffer>> primitives;
+    lx0::engine_ns::detail::ResourceBatch batch;
+
+    for (auto it = meshBlocks.begin(); it != meshBlocks.end(); ++it)
+    {
+        lx0::BlockPtr spBlock = *it;
+        std::shared_ptr<glgeom::primitive_buffer> spPrimitive(new glgeom::primitive_buffer);
+        primitives.insert(std::make_pair(spBlock->address, spPrimitive));
+
+        batch.add(_id_name(reader, reader.object(spBlock->address)), [&reader, spBlock, spPrimitive, &pretransform]() {
+            lx0::MemoryScope memoryScope(lx0::eMemoryMesh);
+            _primitive_buffer_from_block(*spPrimitive, reader, spBlock, pretransform);
+        });
+    }
+    batch.run();
+
+    //
+    // Instance the Meshes via the Objects that reference them
+    //
+    std::set<lx0::uint64> referenced;
+    auto objectBlocks = reader.getBlocksByType("Object");
+    for (auto it = objectBlocks.begin(); it != objectBlocks.end(); ++it)
+    {
+        auto object = reader.object((*it)->address);
+        auto data   = object.address("data");
+        auto jt     = primitives.find(data);
+        if (data == 0 || jt == primitives.end())
+            continue;
+
+        const auto obmat = object.accessor<float>("obmat");
+        blend_mesh mesh;
+        mesh.name = _id_name(reader, object);
+        for (int i = 0; i < 16; ++i)
+            mesh.transform[i / 4][i % 4] = obmat(object.data(), i);
+        mesh.primitive = jt->second;
+        meshes.push_back(mesh);
+
+        referenced.insert(data);
+    }
+    for (auto it = meshBlocks.begin(); it != meshBlocks.end(); ++it)
+    {
+        if (referenced.count((*it)->address) == 0)
+        {
+            blend_mesh mesh;
+            mesh.name = _id_name(reader, reader.object((*it)->address));
+            mesh.primitive = primitives[(*it)->address];
+            meshes.push_back(mesh);
+        }
+    }
+
+    lx_debug("Loaded '%s'.  %u meshes, %u instances.", filename, primitives.size(), meshes.size());
+}
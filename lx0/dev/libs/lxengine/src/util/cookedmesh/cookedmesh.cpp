@@ -0,0 +1,215 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+    * MIT License (http://www.opensource.org/licenses/mit-license.php)
+
+    Copyright (c) 2010-2012 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a
+    copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+
+//===========================================================================//
+//   H E A D E R S   &   D E C L A R A T I O N S 
+//===========================================================================//
+
+#include <cstring>
+#include <boost/filesystem.hpp>
+
+#include <lx0/lxengine.hpp>
+#include <lx0/util/blendload.hpp>
+#include <lx0/util/cookedmesh.hpp>
+#include <lx0/util/misc/cookedfile.hpp>
+
+using namespace lx0;
+
+namespace 
+{
+    //
+    // Cooked mesh file layout, following the common cooked file header 
+    // (see CookedFileReader).
+    //
+    //  CookedHeader
+    //  char        type[typeLength]        (padded to 4 bytes)
+    //  float       positions[vertexCount * 3]
+    //  float       normals[vertexCount * 3]    (if eStreamNormals)
+    //  float       colors[vertexCount * 3]     (if eStreamColors)
+    //  uint32      indices[indexCount]
+    //  uint32      flags[faceCount]
+    //
+    const lx0::uint32 kMagic     = 0x4d43584c;      // "LXCM"
+    const lx0::uint32 kVersion   = 2;
+
+    struct CookedHeader
+    {
+        lx0::uint32 typeLength;
+        lx0::uint32 vertexCount;
+        lx0::uint32 indexCount;
+        lx0::uint32 faceCount;
+        lx0::uint32 streams;        //!< Bitmask of eStreamNormals, eStreamColors
+        float       bboxMin[3];
+        float       bboxMax[3];
+        float       bsphereCenter[3];
+        float       bsphereRadius;
+    };
+
+    enum
+    {
+        eStreamNormals  = 1 << 0,
+        eStreamColors   = 1 << 1,
+    };
+}
+
+//===========================================================================//
+//   I M P L E M E N T A T I O N 
+//===========================================================================//
+
+/*!
+    Computes the cache key for a source file: the cooked copy is valid only
+    if the source path, modification time, size, and pretransform all match.
+ */
+lx0::uint64
+lx0::util::cookedmesh_ns::cooked_mesh_key (const char* source, const glm::mat4& pretransform)
+{
+    namespace bfs = boost::filesystem;
+
+    const std::string  path  = bfs::system_complete(source).string();
+    const lx0::int64   mtime = lx0::int64( bfs::last_write_time(source) );
+    const lx0::uint64  size  = lx0::uint64( bfs::file_size(source) );
+
+    lx0::uint64 h = lx_fnv1a(&kVersion, sizeof(kVersion));
+    h = lx_fnv1a(path.c_str(), path.size(), h);
+    h = lx_fnv1a(&mtime, sizeof(mtime), h);
+    h = lx_fnv1a(&size, sizeof(size), h);
+    for (int i = 0; i < 4; ++i)
+        for (int j = 0; j < 4; ++j)
+            h = lx_fnv1a(&pretransform[i][j], sizeof(float), h);
+    return h;
+}
+
+std::string
+lx0::util::cookedmesh_ns::cooked_mesh_path (const std::string& cacheDirectory, const char* source, lx0::uint64 key)
+{
+    return cooked_file_path(cacheDirectory, source, key, "lxmesh");
+}
+
+/*!
+    Reads a cooked mesh by memory-mapping the file and copying each stream
+    into the primitive buffer.  Returns false if the file does not exist, 
+    was written by a different format version, does not match the key, or
+    is corrupt.
+ */
+bool
+lx0::util::cookedmesh_ns::cooked_mesh_read (glgeom::primitive_buffer& primitive, const std::string& filename, lx0::uint64 key)
+{
+    return cooked_file_read(filename, kMagic, kVersion, key, [&](CookedFileReader& reader) {
+        CookedHeader header;
+        reader.read(header);
+        reader.readString(primitive.type, header.typeLength);
+        
+        reader.readStream(primitive.vertex.positions, header.vertexCount);
+        if (header.streams & eStreamNormals)
+            reader.readStream(primitive.vertex.normals, header.vertexCount);
+        if (header.streams & eStreamColors)
+            reader.readStream(primitive.vertex.colors, header.vertexCount);
+
+        reader.readUint32Array(primitive.indices, header.indexCount);
+        reader.readUint32Array(primitive.face.flags, header.faceCount);
+
+        primitive.bbox.merge( glgeom::point3f(header.bboxMin[0], header.bboxMin[1], header.bboxMin[2]) );
+        primitive.bbox.merge( glgeom::point3f(header.bboxMax[0], header.bboxMax[1], header.bboxMax[2]) );
+        primitive.bsphere.center = glgeom::point3f(header.bsphereCenter[0], header.bsphereCenter[1], header.bsphereCenter[2]);
+        primitive.bsphere.radius = header.bsphereRadius;
+    });
+}
+
+/*!
+    Writes the cooked mesh (see CookedFileWriter::save()).  A failure to 
+    write is logged but is not an error.
+ */
+void
+lx0::util::cookedmesh_ns::cooked_mesh_write (const glgeom::primitive_buffer& primitive, const std::string& filename, lx0::uint64 key)
+{
+    const size_t vertexCount = primitive.vertex.positions.size();
+
+    CookedHeader header;
+    ::memset(&header, 0, sizeof(header));
+    header.typeLength   = lx0::uint32(primitive.type.size());
+    header.vertexCount  = lx0::uint32(vertexCount);
+    header.indexCount   = lx0::uint32(primitive.indices.size());
+    header.faceCount    = lx0::uint32(primitive.face.flags.size());
+    header.streams      = (primitive.vertex.normals.size() == vertexCount && vertexCount ? eStreamNormals : 0)
+                        | (primitive.vertex.colors.size() == vertexCount && vertexCount ? eStreamColors : 0);
+    const float bbox[]    = { primitive.bbox.min.x, primitive.bbox.min.y, primitive.bbox.min.z, 
+                              primitive.bbox.max.x, primitive.bbox.max.y, primitive.bbox.max.z };
+    const float bsphere[] = { primitive.bsphere.center.x, primitive.bsphere.center.y, primitive.bsphere.center.z, 
+                              primitive.bsphere.radius };
+    ::memcpy(header.bboxMin, &bbox[0], sizeof(header.bboxMin));
+    ::memcpy(header.bboxMax, &bbox[3], sizeof(header.bboxMax));
+    ::memcpy(header.bsphereCenter, &bsphere[0], sizeof(header.bsphereCenter));
+    header.bsphereRadius = bsphere[3];
+
+    CookedFileWriter writer (kMagic, kVersion, key);
+    writer.write(header);
+    writer.writeString(primitive.type);
+
+    writer.writeStream(primitive.vertex.positions);
+    if (header.streams & eStreamNormals)
+        writer.writeStream(primitive.vertex.normals);
+    if (header.streams & eStreamColors)
+        writer.writeStream(primitive.vertex.colors);
+
+    writer.writeUint32Array(primitive.indices);
+    writer.writeUint32Array(primitive.face.flags);
+
+    writer.save(filename);
+}
+
+/*!
+    Returns the cooked mesh directory set by the Engine "mesh_cache" global,
+    or an empty string if caching is disabled.
+
+    Must be called on the main thread: the Engine globals are not safe to 
+    read from worker threads.  Loaders that run on worker threads should be
+    passed the directory instead.
+ */
+std::string
+lx0::util::cookedmesh_ns::cooked_mesh_directory (void)
+{
+    lxvar dir = Engine::acquire()->globals().find("mesh_cache");
+    return dir.is_string() ? dir.as<std::string>() : std::string();
+}
+
+/*!
+    Equivalent to primitive_buffer_from_blendfile() but goes through the 
+    cooked mesh cache in cacheDirectory (usually cooked_mesh_directory()).
+    Safe to call from a worker thread.
+ */
+void
+lx0::util::cookedmesh_ns::primitive_buffer_from_blendfile_cached (glgeom::primitive_buffer& primitive, const std::string& cacheDirectory, const char* filename, const glm::mat4& pretransform)
+{
+    lx_check_error( lx0::file_exists(filename) );
+
+    primitive_buffer_from_cache(primitive, cacheDirectory, filename, pretransform, [&](glgeom::primitive_buffer& p) {
+        lx0::primitive_buffer_from_blendfile(p, filename, pretransform);
+    });
+}
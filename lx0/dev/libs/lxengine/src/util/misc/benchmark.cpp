@@ -0,0 +1,388 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+    * MIT License (http://www.opensource.org/licenses/mit-license.php)
+
+    Copyright (c) 2010-2012 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a
+    copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+
+//===========================================================================//
+//   H E A D E R S
+//===========================================================================//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+
+#include <lx0/lxengine.hpp>
+#include <lx0/util/misc/benchmark.hpp>
+
+namespace lx0 { namespace util { namespace misc {
+
+    namespace
+    {
+        double
+        _number (const lxvar& v)
+        {
+            if (v.is_int())
+                return double(v.as<int>());
+            else if (v.is_float())
+                return double(v.as<float>());
+            else
+                return 0.0;
+        }
+
+        //
+        // The lxvar parser does not handle exponents or integers beyond 32
+        // bits, so values are always written in fixed notation and the 
+        // hardware counts are written in thousands.
+        //
+        std::string
+        _fixed (double value)
+        {
+            return _lx_format("%1$.4f", value);
+        }
+
+        //
+        // Case names are arbitrary, but the lxvar parser does not handle 
+        // escapes, so quotes and backslashes are replaced rather than escaped
+        // to keep the output both valid JSON and readable as a baseline.
+        //
+        std::string
+        _quoted (const std::string& s)
+        {
+            std::string t (s);
+            std::replace(t.begin(), t.end(), '\"', '\'');
+            std::replace(t.begin(), t.end(), '\\', '/');
+            return "\"" + lx0::lx_json_escape(t) + "\"";
+        }
+    }
+
+    //===========================================================================//
+
+    BenchmarkRunner::BenchmarkRunner (const char* suite)
+        : mSuite        (suite)
+        , mWarmup       (1)
+#ifdef NDEBUG
+        , mRepetitions  (10)
+#else
+        , mRepetitions  (3)
+#endif
+        , mThreshold    (10.0)
+    {
+    }
+
+    void
+    BenchmarkRunner::parseArguments (int argc, char** argv)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string arg = argv[i];
+            const bool bValue = (i + 1 < argc);
+
+            if (arg == "--warmup" && bValue)
+                mWarmup = std::max(0, atoi(argv[++i]));
+            else if (arg == "--repetitions" && bValue)
+                mRepetitions = std::max(1, atoi(argv[++i]));
+            else if (arg == "--threshold" && bValue)
+                mThreshold = atof(argv[++i]);
+            else if (arg == "--filter" && bValue)
+                mFilter = argv[++i];
+            else if (arg == "--json" && bValue)
+                mJsonFile = argv[++i];
+            else if (arg == "--baseline" && bValue)
+                mBaselineFile = argv[++i];
+            else
+                lx_warn("Unrecognized benchmark argument '%1%'", arg);
+        }
+    }
+
+    void
+    BenchmarkRunner::add (std::string name, std::function<void()> run)
+    {
+        add(name, std::function<void()>(), run, std::function<void()>());
+    }
+
+    void
+    BenchmarkRunner::add (std::string name, std::function<void()> setup, std::function<void()> run, std::function<void()> teardown)
+    {
+        Case c;
+        c.name      = name;
+        c.setup     = setup;
+        c.run       = run;
+        c.teardown  = teardown;
+        mCases.push_back(c);
+    }
+
+    //===========================================================================//
+
+    BenchmarkRunner::Result
+    BenchmarkRunner::_runCase (Case& c)
+    {
+        for (int i = 0; i < mWarmup; ++i)
+        {
+            if (c.setup) c.setup();
+            c.run();
+            if (c.teardown) c.teardown();
+        }
+
+        const double ticksPerMs = double(lx0::lx_ticks_per_second()) / 1000.0;
+        std::vector<double> samples;
+        samples.reserve(mRepetitions);
+
+        PerfCounters counters;
+        for (int i = 0; i < mRepetitions; ++i)
+        {
+            if (c.setup) c.setup();
+
+            const lx0::int64 start = lx0::lx_ticks();
+            counters.start();
+            c.run();
+            counters.stop();
+            samples.push_back( double(lx0::lx_ticks() - start) / ticksPerMs );
+
+            if (c.teardown) c.teardown();
+        }
+
+        Result result;
+        result.name = c.name;
+        summarize(samples, result);
+
+        result.bEvents = counters.available();
+        for (int i = 0; i < PerfCounters::eEventCount; ++i)
+            result.events.count[i] = counters.total(PerfCounters::Event(i)) / lx0::uint64(mRepetitions);
+        
+        return result;
+    }
+
+    /*!
+        Runs all cases (matching the filter), prints a summary line per case,
+        and writes and compares the results as requested on the command line.
+
+        Returns the number of regressions against the baseline.
+     */
+    int
+    BenchmarkRunner::run (void)
+    {
+        lx_message("=== %1% : %2% warmup, %3% repetitions ===", mSuite, mWarmup, mRepetitions);
+        lx_message("  %-40s    %9s %9s %9s %9s", "", "median", "p95", "stddev", "min");
+
+        mResults.clear();
+        for (auto it = mCases.begin(); it != mCases.end(); ++it)
+        {
+            if (!mFilter.empty() && it->name.find(mFilter) == std::string::npos)
+                continue;
+
+            Result result = _runCase(*it);
+            mResults.push_back(result);
+
+            lx_message("  %-40s :: %9.3f %9.3f %9.3f %9.3f ms", 
+                result.name, result.medianMs, result.p95Ms, result.stddevMs, result.minMs);
+            if (result.bEvents)
+            {
+                const lx0::uint64* events = result.events.count;
+                lx_message("  %-40s    %12d instr %12d cycles %10d cache-miss %10d branch-miss", "",
+                    events[PerfCounters::eInstructions],
+                    events[PerfCounters::eCycles],
+                    events[PerfCounters::eCacheMisses],
+                    events[PerfCounters::eBranchMisses]);
+            }
+        }
+
+        if (!mJsonFile.empty())
+            writeJson(mJsonFile.c_str(), mSuite, mResults);
+
+        int regressions = 0;
+        if (!mBaselineFile.empty())
+        {
+            if (lx0::file_exists(mBaselineFile))
+            {
+                //
+                // Compare via the same JSON representation as a saved baseline
+                // so that the in-process and standalone comparisons agree
+                //
+                const std::string filename = mJsonFile.empty() ? (mSuite + "_current.json") : mJsonFile;
+                if (mJsonFile.empty())
+                    writeJson(filename.c_str(), mSuite, mResults);
+
+                regressions = compare(lx0::lxvar_from_file(filename), lx0::lxvar_from_file(mBaselineFile), mThreshold);
+            }
+            else
+                lx_warn("Benchmark baseline '%1%' not found", mBaselineFile);
+        }
+        return regressions;
+    }
+
+    //===========================================================================//
+
+    /*!
+        The percentiles use the nearest-rank method, which with the small
+        number of repetitions typical of these benchmarks is preferable to
+        interpolating between samples.
+     */
+    void
+    BenchmarkRunner::summarize (std::vector<double>& samples, Result& result)
+    {
+        result.repetitions = int(samples.size());
+        result.minMs = result.maxMs = result.meanMs = result.medianMs = result.p95Ms = result.stddevMs = 0.0;
+        if (samples.empty())
+            return;
+
+        std::sort(samples.begin(), samples.end());
+        const size_t n = samples.size();
+
+        double sum = 0.0;
+        for (size_t i = 0; i < n; ++i)
+            sum += samples[i];
+        const double mean = sum / double(n);
+
+        double variance = 0.0;
+        for (size_t i = 0; i < n; ++i)
+            variance += (samples[i] - mean) * (samples[i] - mean);
+        variance = (n > 1) ? variance / double(n - 1) : 0.0;
+
+        auto rank = [&](double p) -> double {
+            size_t k = size_t( std::ceil(p * double(n)) );
+            return samples[ std::min(std::max<size_t>(k, 1), n) - 1 ];
+        };
+
+        result.minMs    = samples.front();
+        result.maxMs    = samples.back();
+        result.meanMs   = mean;
+        result.medianMs = (n % 2) ? samples[n / 2] : 0.5 * (samples[n / 2 - 1] + samples[n / 2]);
+        result.p95Ms    = rank(0.95);
+        result.stddevMs = std::sqrt(variance);
+    }
+
+    void
+    BenchmarkRunner::writeJson (const char* filename, const std::string& suite, const std::vector<Result>& results)
+    {
+        std::ofstream file(filename);
+        if (!file.is_open())
+        {
+            lx_warn("Could not open '%1%' to write the benchmark results", filename);
+            return;
+        }
+
+        file << "{" << std::endl;
+        file << "    \"suite\" : " << _quoted(suite) << "," << std::endl;
+        file << "    \"date\" : \"" << lx0::lx_ctime() << "\"," << std::endl;
+#ifdef NDEBUG
+        file << "    \"build\" : \"release\"," << std::endl;
+#else
+        file << "    \"build\" : \"debug\"," << std::endl;
+#endif
+        file << "    \"results\" : [" << std::endl;
+
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const Result& r = results[i];
+
+            file << "        {" << std::endl;
+            file << "            \"name\" : " << _quoted(r.name) << "," << std::endl;
+            file << "            \"repetitions\" : " << r.repetitions << "," << std::endl;
+            file << "            \"median_ms\" : " << _fixed(r.medianMs) << "," << std::endl;
+            file << "            \"mean_ms\" : " << _fixed(r.meanMs) << "," << std::endl;
+            file << "            \"p95_ms\" : " << _fixed(r.p95Ms) << "," << std::endl;
+            file << "            \"stddev_ms\" : " << _fixed(r.stddevMs) << "," << std::endl;
+            file << "            \"min_ms\" : " << _fixed(r.minMs) << "," << std::endl;
+            file << "            \"max_ms\" : " << _fixed(r.maxMs);
+            if (r.bEvents)
+            {
+                for (int j = 0; j < PerfCounters::eEventCount; ++j)
+                {
+                    file << "," << std::endl << "            \"" << PerfCounters::eventName(PerfCounters::Event(j)) << "_k\" : " 
+                         << _fixed(double(r.events.count[j]) / 1000.0);
+                }
+            }
+            file << std::endl << "        }" << (i + 1 < results.size() ? "," : "") << std::endl;
+        }
+
+        file << "    ]" << std::endl;
+        file << "}" << std::endl;
+    }
+
+    /*!
+        Compares the median time of each case present in both result sets.
+        A case regresses if its median has grown by more than thresholdPercent
+        and by more than 0.05ms (differences below that are timer noise).
+
+        Returns the number of regressions.
+     */
+    int
+    BenchmarkRunner::compare (lxvar current, lxvar baseline, double thresholdPercent)
+    {
+        std::map<std::string, lxvar> baselineCases;
+        lxvar baselineResults = baseline.find("results");
+        if (baselineResults.is_array())
+        {
+            for (int i = 0; i < baselineResults.size(); ++i)
+                baselineCases[ baselineResults.at(i).find("name").as<std::string>() ] = baselineResults.at(i);
+        }
+
+        lx_message("=== Comparison against baseline (threshold %1%%%) ===", thresholdPercent);
+        lx_message("  %-40s    %9s %9s %8s", "", "baseline", "current", "change");
+
+        int regressions = 0;
+        lxvar currentResults = current.find("results");
+        if (currentResults.is_array())
+        {
+            for (int i = 0; i < currentResults.size(); ++i)
+            {
+                lxvar result = currentResults.at(i);
+                const std::string name = result.find("name").as<std::string>();
+
+                auto jt = baselineCases.find(name);
+                if (jt == baselineCases.end())
+                {
+                    lx_message("  %-40s :: (no baseline)", name);
+                    continue;
+                }
+
+                const double before = _number(jt->second.find("median_ms"));
+                const double after  = _number(result.find("median_ms"));
+                const double change = (before > 0.0) ? 100.0 * (after - before) / before : 0.0;
+
+                const char* status = "";
+                if (change > thresholdPercent && after - before > 0.05)
+                {
+                    status = "REGRESSION";
+                    regressions++;
+                }
+                else if (change < -thresholdPercent && before - after > 0.05)
+                    status = "improved";
+
+                lx_message("  %-40s :: %9.3f %9.3f %+7.1f%% %s", name, before, after, change, status);
+            }
+        }
+
+        if (regressions)
+            lx_warn("%1% benchmark regression(s) beyond %2%%%", regressions, thresholdPercent);
+        return regressions;
+    }
+
+}}}
@@ -0,0 +1,277 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+    * MIT License (http://www.opensource.org/licenses/mit-license.php)
+
+    Copyright (c) 2010-2012 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a
+    copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+
+//===========================================================================//
+//   H E A D E R S
+//===========================================================================//
+
+#include <cstdio>
+#include <boost/format.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <lx0/lxengine.hpp>
+#include <lx0/util/misc/util.hpp>
+#include <lx0/util/misc/cookedfile.hpp>
+
+namespace {
+
+    //
+    // Every cooked file starts with this header.  All values are in host
+    // byte order; a file written on a host of different endianness fails 
+    // the endian check and is re-cooked.
+    //
+    const lx0::uint32 kEndianTag = 0x01020304;
+
+    struct CookedFileHeader
+    {
+        lx0::uint32 magic;
+        lx0::uint32 version;
+        lx0::uint32 endianTag;
+        lx0::uint32 reserved;
+        lx0::uint64 key;
+    };
+
+    inline size_t _pad4 (size_t n) { return (n + 3) & ~size_t(3); }
+
+    inline void _get (const glgeom::point3f& v, float* f)   { f[0] = v.x; f[1] = v.y; f[2] = v.z; }
+    inline void _get (const glgeom::vector3f& v, float* f)  { f[0] = v.x; f[1] = v.y; f[2] = v.z; }
+    inline void _get (const glgeom::color3f& v, float* f)   { f[0] = v.r; f[1] = v.g; f[2] = v.b; }
+    inline void _get (const glgeom::point2f& v, float* f)   { f[0] = v.x; f[1] = v.y; }
+
+    inline void _set (glgeom::point3f& v, const float* f)   { v = glgeom::point3f(f[0], f[1], f[2]); }
+    inline void _set (glgeom::vector3f& v, const float* f)  { v = glgeom::vector3f(f[0], f[1], f[2]); }
+    inline void _set (glgeom::color3f& v, const float* f)   { v = glgeom::color3f(f[0], f[1], f[2]); }
+    inline void _set (glgeom::point2f& v, const float* f)   { v = glgeom::point2f(f[0], f[1]); }
+
+    template <int N, typename T>
+    void _readStream (const float* pf, std::vector<T>& stream, size_t count)
+    {
+        stream.resize(count);
+        for (size_t i = 0; i < count; ++i, pf += N)
+            _set(stream[i], pf);
+    }
+
+    template <int N, typename T>
+    void _writeStream (lx0::CookedFileWriter& writer, std::vector<float>& floats, const std::vector<T>& stream)
+    {
+        floats.resize(stream.size() * N);
+        for (size_t i = 0; i < stream.size(); ++i)
+            _get(stream[i], &floats[i * N]);
+        if (!floats.empty())
+            writer.append(&floats[0], floats.size() * sizeof(float));
+    }
+}
+
+//===========================================================================//
+//   I M P L E M E N T A T I O N
+//===========================================================================//
+
+namespace lx0 { namespace util { namespace misc {
+
+    //===========================================================================//
+    // CookedFileReader
+    //===========================================================================//
+
+    const char*
+    CookedFileReader::take (size_t bytes)
+    {
+        if (bytes > size_t(mpEnd - mp))
+            throw lx_error_exception("Cooked file is truncated");
+        
+        const char* p = mp;
+        mp += bytes;
+        return p;
+    }
+
+    //! Reads a string written by CookedFileWriter::writeString()
+    void
+    CookedFileReader::readString (std::string& s, size_t length)
+    {
+        s.assign(take(_pad4(length)), length);
+    }
+
+    void CookedFileReader::readStream (std::vector<glgeom::point3f>& stream, size_t count)  { _readStream<3>(_floats(count * 3), stream, count); }
+    void CookedFileReader::readStream (std::vector<glgeom::vector3f>& stream, size_t count) { _readStream<3>(_floats(count * 3), stream, count); }
+    void CookedFileReader::readStream (std::vector<glgeom::color3f>& stream, size_t count)  { _readStream<3>(_floats(count * 3), stream, count); }
+    void CookedFileReader::readStream (std::vector<glgeom::point2f>& stream, size_t count)  { _readStream<2>(_floats(count * 2), stream, count); }
+
+    //===========================================================================//
+    // CookedFileWriter
+    //===========================================================================//
+
+    CookedFileWriter::CookedFileWriter (lx0::uint32 magic, lx0::uint32 version, lx0::uint64 key)
+    {
+        CookedFileHeader header;
+        ::memset(&header, 0, sizeof(header));
+        header.magic        = magic;
+        header.version      = version;
+        header.endianTag    = kEndianTag;
+        header.key          = key;
+        write(header);
+    }
+
+    void
+    CookedFileWriter::append (const void* pData, size_t bytes)
+    {
+        const char* p = static_cast<const char*>(pData);
+        mBuffer.insert(mBuffer.end(), p, p + bytes);
+    }
+
+    //! Writes the characters (without the length) padded to 4 bytes
+    void
+    CookedFileWriter::writeString (const std::string& s)
+    {
+        append(s.c_str(), s.size());
+        mBuffer.resize(_pad4(mBuffer.size()), 0);
+    }
+
+    void CookedFileWriter::writeStream (const std::vector<glgeom::point3f>& stream)     { _writeStream<3>(*this, mFloats, stream); }
+    void CookedFileWriter::writeStream (const std::vector<glgeom::vector3f>& stream)    { _writeStream<3>(*this, mFloats, stream); }
+    void CookedFileWriter::writeStream (const std::vector<glgeom::color3f>& stream)     { _writeStream<3>(*this, mFloats, stream); }
+    void CookedFileWriter::writeStream (const std::vector<glgeom::point2f>& stream)     { _writeStream<2>(*this, mFloats, stream); }
+
+    /*!
+        Writes the file to a temporary file and then renames it into place, 
+        so concurrent loaders never see a partially written file.
+
+        A cache is only an optimization, so failures (e.g. a read-only cache
+        directory) are logged and false is returned rather than throwing.
+     */
+    bool
+    CookedFileWriter::save (const std::string& filename) const
+    {
+        namespace bfs = boost::filesystem;
+
+        boost::system::error_code ec;
+        bfs::create_directories( bfs::path(filename).parent_path(), ec );
+        if (ec)
+        {
+            lx_warn("Could not create the cache directory for '%1%': %2%", filename, ec.message());
+            return false;
+        }
+
+        const std::string tempname = boost::str( boost::format("%1%.%2%.tmp") % filename % lx0::lx_current_thread_id() );
+        FILE* fp = fopen(tempname.c_str(), "wb");
+        if (!fp)
+        {
+            lx_warn("Could not write cooked file '%1%'", tempname);
+            return false;
+        }
+        const bool bWritten = (fwrite(&mBuffer[0], 1, mBuffer.size(), fp) == mBuffer.size());
+        fclose(fp);
+
+        if (bWritten)
+            bfs::rename(tempname, filename, ec);
+        if (!bWritten || ec)
+        {
+            lx_warn("Could not write cooked file '%1%'", filename);
+            bfs::remove(tempname, ec);
+            return false;
+        }
+        return true;
+    }
+
+    //===========================================================================//
+
+    /*!
+        Returns the path of the cooked copy of source: the file name of the 
+        source without its extension (either '/' or '\\' separates the 
+        directories, as in a BSA entry name) followed by the key.
+     */
+    std::string
+    cooked_file_path (const std::string& cacheDirectory, const std::string& source, lx0::uint64 key, const char* extension)
+    {
+        const size_t slash = source.find_last_of("\\/");
+        std::string stem = (slash == std::string::npos) ? source : source.substr(slash + 1);
+        
+        const size_t dot = stem.find_last_of('.');
+        if (dot != std::string::npos && dot > 0)
+            stem.resize(dot);
+        
+        return boost::str( boost::format("%1%/%2%-%3$016x.%4%") % cacheDirectory % stem % key % extension );
+    }
+
+    /*!
+        Memory-maps the cooked file and, if its header matches magic, version,
+        and key, calls parse() to read the format-specific data.  
+        
+        Returns false if the file does not exist or does not match.  Also 
+        returns false, with a warning, if the file cannot be mapped, if 
+        parse() reads past the end of the file, or if parse() leaves data 
+        unread; the caller should then re-cook the source.
+     */
+    bool
+    cooked_file_read (const std::string& filename, lx0::uint32 magic, lx0::uint32 version, lx0::uint64 key, std::function<void (CookedFileReader&)> parse)
+    {
+        using namespace boost::interprocess;
+
+        if (!lx0::file_exists(filename))
+            return false;
+
+        try
+        {
+            file_mapping  mapping (filename.c_str(), read_only);
+            mapped_region region  (mapping, read_only);
+
+            const char*  pBegin = static_cast<const char*>(region.get_address());
+            const size_t size   = region.get_size();
+            if (size < sizeof(CookedFileHeader))
+                return false;
+
+            CookedFileHeader header;
+            ::memcpy(&header, pBegin, sizeof(header));
+            if (header.magic != magic 
+                || header.version != version 
+                || header.endianTag != kEndianTag
+                || header.key != key)
+                return false;
+
+            CookedFileReader reader (pBegin + sizeof(header), size - sizeof(header));
+            parse(reader);
+
+            if (!reader.atEnd())
+                throw lx_error_exception("Cooked file has trailing data");
+        }
+        catch (interprocess_exception& e)
+        {
+            lx_warn("Could not map cooked file '%1%': %2%", filename, e.what());
+            return false;
+        }
+        catch (lx0::error_exception& e)
+        {
+            lx_warn("Cooked file '%1%' is corrupt (%2%).  Ignoring it.", filename, e.what());
+            return false;
+        }
+        return true;
+    }
+
+}}}
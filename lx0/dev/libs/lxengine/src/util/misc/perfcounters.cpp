@@ -0,0 +1,205 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+    * MIT License (http://www.opensource.org/licenses/mit-license.php)
+
+    Copyright (c) 2010-2012 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a
+    copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+
+//===========================================================================//
+//   H E A D E R S
+//===========================================================================//
+
+#include <cstring>
+
+#ifdef __linux__
+#   include <unistd.h>
+#   include <sys/ioctl.h>
+#   include <sys/syscall.h>
+#   include <linux/perf_event.h>
+#endif
+
+#include <lx0/util/misc/perfcounters.hpp>
+
+namespace lx0 { namespace util { namespace misc {
+
+#ifdef __linux__
+
+    namespace
+    {
+        const lx0::uint64 s_eventConfig[PerfCounters::eEventCount] =
+        {
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES,
+        };
+
+        int
+        _openEvent (lx0::uint64 config, int groupFd)
+        {
+            perf_event_attr attr;
+            ::memset(&attr, 0, sizeof(attr));
+            attr.size           = sizeof(attr);
+            attr.type           = PERF_TYPE_HARDWARE;
+            attr.config         = config;
+            attr.read_format    = PERF_FORMAT_GROUP | PERF_FORMAT_ID;
+            attr.disabled       = (groupFd < 0) ? 1 : 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv     = 1;
+
+            // pid 0, cpu -1: the calling thread on any CPU
+            return int( ::syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0) );
+        }
+    }
+
+    /*!
+        The events are opened as a single group so that they are scheduled
+        onto the PMU together and can be read with one system call.  Events
+        the CPU does not support (e.g. under some virtual machines) are 
+        left unavailable rather than failing the whole group.
+     */
+    PerfCounters::PerfCounters (void)
+    {
+        ::memset(&mStart, 0, sizeof(mStart));
+        ::memset(&mTotal, 0, sizeof(mTotal));
+
+        mFd[0] = _openEvent(s_eventConfig[0], -1);
+        for (int i = 1; i < eEventCount; ++i)
+            mFd[i] = (mFd[0] >= 0) ? _openEvent(s_eventConfig[i], mFd[0]) : -1;
+
+        for (int i = 0; i < eEventCount; ++i)
+        {
+            mId[i] = lx0::uint64(-1);
+            if (mFd[i] >= 0)
+                ::ioctl(mFd[i], PERF_EVENT_IOC_ID, &mId[i]);
+        }
+
+        if (mFd[0] >= 0)
+        {
+            ::ioctl(mFd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ::ioctl(mFd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+
+    PerfCounters::~PerfCounters (void)
+    {
+        for (int i = eEventCount - 1; i >= 0; --i)
+        {
+            if (mFd[i] >= 0)
+                ::close(mFd[i]);
+        }
+    }
+
+    //! Reads the current (running) counts
+    void
+    PerfCounters::read (Values& values) const
+    {
+        ::memset(&values, 0, sizeof(values));
+        if (mFd[0] < 0)
+            return;
+
+        //
+        // With PERF_FORMAT_GROUP | PERF_FORMAT_ID the leader returns the 
+        // number of events followed by a { value, id } pair for each.  The 
+        // ids identify which of the events opened successfully.
+        //
+        lx0::uint64 buffer[1 + 2 * eEventCount];
+        if (::read(mFd[0], buffer, sizeof(buffer)) <= 0)
+            return;
+
+        const lx0::uint64 n = buffer[0];
+        for (lx0::uint64 j = 0; j < n && j < eEventCount; ++j)
+        {
+            for (int i = 0; i < eEventCount; ++i)
+            {
+                if (mId[i] == buffer[2 + 2 * j])
+                    values.count[i] = buffer[1 + 2 * j];
+            }
+        }
+    }
+
+#else
+
+    PerfCounters::PerfCounters (void)
+    {
+        ::memset(&mStart, 0, sizeof(mStart));
+        ::memset(&mTotal, 0, sizeof(mTotal));
+        for (int i = 0; i < eEventCount; ++i)
+        {
+            mFd[i] = -1;
+            mId[i] = lx0::uint64(-1);
+        }
+    }
+
+    PerfCounters::~PerfCounters (void)
+    {
+    }
+
+    void
+    PerfCounters::read (Values& values) const
+    {
+        ::memset(&values, 0, sizeof(values));
+    }
+
+#endif
+
+    //===========================================================================//
+
+    void
+    PerfCounters::start (void)
+    {
+        read(mStart);
+    }
+
+    void
+    PerfCounters::stop (void)
+    {
+        Values now;
+        read(now);
+        for (int i = 0; i < eEventCount; ++i)
+            mTotal.count[i] += now.count[i] - mStart.count[i];
+    }
+
+    void
+    PerfCounters::reset (void)
+    {
+        ::memset(&mTotal, 0, sizeof(mTotal));
+    }
+
+    const char*
+    PerfCounters::eventName (Event e)
+    {
+        static const char* names[eEventCount] = 
+        {
+            "instructions",
+            "cycles",
+            "cache_misses",
+            "branch_misses",
+        };
+        return names[e];
+    }
+
+}}}
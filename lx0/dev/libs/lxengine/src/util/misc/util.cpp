@@ -201,6 +201,48 @@ namespace lx0 { namespace util { namespace misc {
         return (*(short*)bytes == 1) ? true  : false; 
     }
 
+    /*!
+        64-bit FNV-1a hash of the data.  To hash several values as one, pass
+        the result of hashing the previous value as the initial hash.
+     */
+    lx0::uint64
+    lx_fnv1a (const void* pData, size_t size, lx0::uint64 hash)
+    {
+        const lx0::uint8* p = static_cast<const lx0::uint8*>(pData);
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= p[i];
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    /*!
+        Escapes the string for use between the quotes of a JSON string: 
+        quotes and backslashes are prefixed with a backslash and control 
+        characters are written as \u00XX.
+     */
+    std::string
+    lx_json_escape (const std::string& s)
+    {
+        std::string t;
+        t.reserve(s.size());
+        for (auto it = s.begin(); it != s.end(); ++it)
+        {
+            const unsigned char c = static_cast<unsigned char>(*it);
+            if (c == '"' || c == '\\')
+            {
+                t += '\\';
+                t += char(c);
+            }
+            else if (c < 0x20)
+                t += _lx_format("\\u%1$04x", int(c));
+            else
+                t += char(c);
+        }
+        return t;
+    }
+
     namespace 
     {
         class RandomUnit
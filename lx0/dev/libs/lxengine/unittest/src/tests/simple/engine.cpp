@@ -1,5 +1,8 @@
 #include"main.hpp"
+#include <fstream>
 #include <lx0/lxengine.hpp>
+#include <lx0/engine/detail/resourcebatch.hpp>
+#include <lx0/engine/detail/xmlreader.hpp>
 
 using namespace lx0;
 
@@ -14,7 +17,7 @@ void element_flags (TestRun& r)
     struct UpdateComp : public Element::Component
     {
         virtual lx0::uint32 flags               (void) const { return eCallUpdate; }
-        virtual void onUpdate (ElementPtr spElem)
+        virtual void onUpdate (Element* pElem)
         {
         }
     };
@@ -49,6 +52,590 @@ void element_flags (TestRun& r)
     spEngine->shutdown();
 }
 
+static
+void document_snapshot (TestRun& r)
+{
+    EnginePtr spEngine = Engine::acquire();
+    {
+        auto spDoc = spEngine->createDocument();
+        auto spA = spDoc->createElement("A");
+        auto spB = spDoc->createElement("B");
+        spDoc->root()->append(spA);
+        spDoc->root()->append(spB);
+        spA->attr("id", "a");
+        spA->value(lxvar(1));
+        spB->value(lxvar(2));
+
+        auto spSnap1 = spDoc->snapshot();
+        CHECK(r, spSnap1->root()->childCount() == 2);
+        CHECK(r, spSnap1->root()->child(0)->tagName() == "A");
+        CHECK(r, spSnap1->root()->child(0)->attr("id")->as<std::string>() == "a");
+        CHECK(r, spSnap1->root()->child(0)->attr("missing") == nullptr);
+
+        // Modify the Document after the snapshot: the snapshot must not change
+        spA->value(lxvar(10));
+        CHECK(r, spSnap1->root()->child(0)->value().as<int>() == 1);
+
+        // The unmodified sub-tree is shared between snapshots
+        auto spSnap2 = spDoc->snapshot();
+        CHECK(r, spSnap2->root()->child(0)->value().as<int>() == 10);
+        CHECK(r, spSnap2->root()->child(0).get() != spSnap1->root()->child(0).get());
+        CHECK(r, spSnap2->root()->child(1).get() == spSnap1->root()->child(1).get());
+
+        // No changes: the whole tree is shared
+        auto spSnap3 = spDoc->snapshot();
+        CHECK(r, spSnap3->root().get() == spSnap2->root().get());
+    }
+    spEngine->shutdown();
+}
+
+static
+void document_transaction (TestRun& r)
+{
+    EnginePtr spEngine = Engine::acquire();
+    {
+        auto spDoc = spEngine->createDocument();
+        auto spA = spDoc->createElement("A");
+        spDoc->root()->append(spA);
+        spA->value(lxvar(1));
+
+        auto version = spDoc->version();
+        auto spTr = spDoc->transaction();
+        auto spW = spTr->write(spA);
+        spW->value(lxvar(2));
+        spTr->add(spDoc->root(), spDoc->createElement("B"));
+        CHECK(r, spA->value().as<int>() == 1);
+        CHECK(r, spDoc->root()->childCount() == 1);
+
+        CHECK(r, spTr->submit() == true);
+        CHECK(r, spA->value().as<int>() == 2);
+        CHECK(r, spDoc->root()->childCount() == 2);
+        CHECK(r, spDoc->version() > version);
+
+        // A modification outside the transaction invalidates the write
+        spW = spTr->write(spA);
+        spW->value(lxvar(3));
+        spA->value(lxvar(4));
+        CHECK(r, spTr->submit() == false);
+        CHECK(r, spA->value().as<int>() == 4);
+
+        // Attributes removed from the writable copy are removed on submit
+        spA->attr("color", "red");
+        spA->attr("size", 2);
+        spW = spTr->write(spA);
+        spW->removeAttr("color");
+        CHECK(r, spA->attr("color").is_defined());
+        CHECK(r, spTr->submit() == true);
+        CHECK(r, spA->attr("color").is_undefined());
+        CHECK(r, spA->attr("size").as<int>() == 2);
+    }
+    spEngine->shutdown();
+}
+
+static
+void document_journal (TestRun& r)
+{
+    EnginePtr spEngine = Engine::acquire();
+    {
+        auto spDoc = spEngine->createDocument();
+        auto spA = spDoc->createElement("A");
+        auto spB = spDoc->createElement("B");
+        spDoc->root()->append(spA);
+        spDoc->root()->append(spB);
+
+        spDoc->changeJournal().enable(true);
+        lx0::uint64 cursor = spDoc->changeJournal().head();
+        lx0::uint64 stamp = Element::changeStamp();
+
+        spA->attr("color", "red");
+        spA->value(lxvar(1));
+        spA->value(lxvar(2));
+
+        std::vector<ChangeEntry> changes;
+        CHECK(r, spDoc->changeJournal().read(cursor, changes) == true);
+        CHECK(r, changes.size() == 2);
+        CHECK(r, changes[0].field == ChangeEntry::eAttribute && changes[0].name == "color");
+        CHECK(r, changes[1].field == ChangeEntry::eValue);
+        CHECK(r, changes[1].wpElement.lock() == spA);
+
+        // Hierarchical dirty stamps: only the modified sub-tree is newer
+        CHECK(r, spDoc->root()->treeVersion() > stamp);
+        CHECK(r, spA->treeVersion() > stamp);
+        CHECK(r, spB->treeVersion() <= stamp);
+
+        changes.clear();
+        CHECK(r, spDoc->changeJournal().read(cursor, changes) == true);
+        CHECK(r, changes.empty());
+
+        // A consumer that falls behind a trimmed journal must rebuild
+        lx0::uint64 staleCursor = cursor;
+        spDoc->changeJournal().capacity(1);
+        spA->value(lxvar(3));
+        spB->value(lxvar(4));
+        spDoc->update();
+        CHECK(r, spDoc->changeJournal().read(staleCursor, changes) == false);
+    }
+    spEngine->shutdown();
+}
+
+static
+void element_handles (TestRun& r)
+{
+    EnginePtr spEngine = Engine::acquire();
+    {
+        auto spDoc = spEngine->createDocument();
+        auto spA = spDoc->createElement("A");
+        auto spB = spDoc->createElement("B");
+        spDoc->root()->append(spA);
+        spA->append(spB);
+
+        ElementHandle hA = spA->handle();
+        ElementHandle hB = spB->handle();
+        CHECK(r, hA.valid() && hB.valid());
+        CHECK(r, hA != hB);
+        CHECK(r, spDoc->resolve(hA) == spA.get());
+        CHECK(r, spDoc->resolve(hB) == spB.get());
+        CHECK(r, spDoc->resolve(ElementHandle()) == nullptr);
+
+        // The parent link is non-owning
+        CHECK(r, spB->parent() == spA);
+        spDoc->root()->removeChild(spA);
+        spA.reset();
+        CHECK(r, spDoc->resolve(hA) == nullptr);
+        CHECK(r, spB->parent().get() == nullptr);
+
+        // A reused slot does not resolve a stale handle
+        auto spC = spDoc->createElement("C");
+        CHECK(r, spDoc->resolve(hA) == nullptr);
+        CHECK(r, spDoc->resolve(spC->handle()) == spC.get());
+
+        // Handles do not resolve across Documents
+        auto spDoc2 = spEngine->createDocument();
+        CHECK(r, spDoc2->resolve(spC->handle()) == nullptr);
+    }
+    spEngine->shutdown();
+}
+
+static
+void include_document_handles (TestRun& r)
+{
+    const char* filename = "unittest_include.xml";
+    {
+        std::ofstream file(filename);
+        file << "<Document><Item><Child/></Item></Document>" << std::endl;
+    }
+
+    EnginePtr spEngine = Engine::acquire();
+    {
+        auto spDoc = spEngine->createDocument();
+        auto spLibrary = spDoc->createElement("Library");
+        auto spInclude = spDoc->createElement("IncludeDocument");
+        spInclude->attr("src", filename);
+        spDoc->root()->append(spLibrary);
+        spLibrary->append(spInclude);
+
+        lx0::elements::core_ns::processIncludeDocument(spDoc);
+
+        // Included Elements belong to the including Document
+        int included = 0;
+        spDoc->iterateElements2([&](ElementPtr spElem) {
+            CHECK(r, spDoc->resolve(spElem->handle()) == spElem.get());
+            if (spElem->tagName() == "Child")
+                ++included;
+        });
+        CHECK(r, included > 0);
+    }
+    spEngine->shutdown();
+
+    ::remove(filename);
+}
+
+static
+void document_bulk_attach (TestRun& r)
+{
+    struct CountComp : public Element::Component
+    {
+        CountComp (int* pCount) : mpCount(pCount) {}
+        virtual const char* name                (void) const { return "count"; }
+        virtual lx0::uint32 flags               (void) const { return eSkipUpdate; }
+        virtual void        onAdded             (void) { (*mpCount)++; }
+        int* mpCount;
+    };
+
+    EnginePtr spEngine = Engine::acquire();
+    {
+        int added = 0;
+        spEngine->addElementComponent("Counted", "count", [&added](ElementPtr) { return new CountComp(&added); });
+
+        auto spDoc = spEngine->createDocument();
+        std::vector<ElementPtr> addedElems;
+        spDoc->slotElementAdded += [&](ElementPtr spElem) { 
+            // The whole sub-tree is in the Document before any notification
+            CHECK(r, spElem->document() == spDoc);
+            if (spElem->childCount() > 0)
+                CHECK(r, spElem->child(0)->document() == spDoc);
+            addedElems.push_back(spElem); 
+        };
+
+        // Build a detached tree, then attach it in one pass
+        auto spTop = spDoc->createElement("Group");
+        for (int i = 0; i < 10; ++i)
+        {
+            auto spGroup = spDoc->createElement("Group");
+            for (int j = 0; j < 10; ++j)
+                spGroup->append(spDoc->createElement("Counted"));
+            spTop->append(spGroup);
+        }
+        CHECK(r, added == 0);
+        CHECK(r, spTop->child(0)->child(0)->getComponent<Element::Component>("count").get() == nullptr);
+
+        spDoc->root()->append(spTop);
+        CHECK(r, added == 100);
+        CHECK(r, addedElems.size() == 111);
+        CHECK(r, addedElems[0] == spTop);
+        CHECK(r, addedElems[1] == spTop->child(0));
+        CHECK(r, spTop->child(9)->child(9)->getComponent<Element::Component>("count").get() != nullptr);
+
+        // A notification may remove Elements of the batch not yet notified
+        auto spDoc2 = spEngine->createDocument();
+        std::vector<std::string> notified;
+        spDoc2->slotElementAdded += [&](ElementPtr spElem) {
+            notified.push_back(spElem->tagName());
+            if (spElem->tagName() == "Remover")
+                spElem->parent()->removeChild(spElem->parent()->child(1));
+        };
+        auto spGroup = spDoc2->createElement("Group");
+        spGroup->append(spDoc2->createElement("Remover"));
+        spGroup->append(spDoc2->createElement("Removed"));
+        spDoc2->root()->append(spGroup);
+        CHECK(r, spGroup->childCount() == 1);
+        CHECK(r, notified.size() == 2);
+        CHECK(r, notified.back() == "Remover");
+    }
+    spEngine->shutdown();
+}
+
+static
+void resource_batch (TestRun& r)
+{
+    EnginePtr spEngine = Engine::acquire();
+    {
+        // Loads run in parallel; completions run in order on this thread
+        std::vector<int> results(32, 0);
+        std::vector<int> order;
+        lx0::engine_ns::detail::ResourceBatch batch;
+        for (int i = 0; i < 32; ++i)
+        {
+            int* pResult = &results[i];
+            batch.add(lx0::lx_itoa(i), [pResult, i]() { *pResult = i * i; }, [&order, i]() { order.push_back(i); });
+        }
+        batch.run();
+
+        bool bOk = (order.size() == 32);
+        for (int i = 0; i < 32 && bOk; ++i)
+            bOk = (order[i] == i && results[i] == i * i);
+        CHECK(r, bOk);
+        CHECK(r, batch.resources().size() == 32);
+
+        // A failed load is reported on the calling thread and nothing is assembled
+        bool bCompleted = false;
+        bool bThrown = false;
+        lx0::engine_ns::detail::ResourceBatch batch2;
+        batch2.add("good", []() {}, [&bCompleted]() { bCompleted = true; });
+        batch2.add("bad", []() { throw lx_error_exception("bad resource"); });
+        try { batch2.run(); } catch (lx0::error_exception&) { bThrown = true; }
+        CHECK(r, bThrown);
+        CHECK(r, !bCompleted);
+        CHECK(r, batch2.resources()[1].bFailed);
+    }
+    spEngine->shutdown();
+}
+
+static
+void profile_trace (TestRun& r)
+{
+    EnginePtr spEngine = Engine::acquire();
+    {
+        int outerId, innerId, tabId;
+        spEngine->registerProfileCounter("Test outer", &outerId);
+        spEngine->registerProfileCounter("Test inner", &innerId);
+        spEngine->registerProfileCounter("Test\ttab", &tabId);
+
+        auto& monitor = spEngine->profileMonitor();
+        monitor.enableTrace(true);
+        {
+            ProfileSection outer(outerId);
+            for (int i = 0; i < 3; ++i)
+                ProfileSection inner(innerId);
+            ProfileSection tab(tabId);
+        }
+        monitor.enableTrace(false);
+        monitor.writeTrace("unittest_trace.json");
+
+        std::string trace = lx0::string_from_file("unittest_trace.json");
+        CHECK(r, trace.find("\"traceEvents\"") != std::string::npos);
+        CHECK(r, trace.find("\"name\":\"Test outer\",\"cat\":\"lx\",\"ph\":\"B\"") != std::string::npos);
+        CHECK(r, trace.find("\"name\":\"Test inner\",\"cat\":\"lx\",\"ph\":\"E\"") != std::string::npos);
+        CHECK(r, trace.find("\"name\":\"Test\\u0009tab\"") != std::string::npos);
+
+        // Re-enabling the trace discards the events already recorded
+        monitor.enableTrace(true);
+        {
+            ProfileSection inner(innerId);
+        }
+        monitor.enableTrace(false);
+        monitor.writeTrace("unittest_trace.json");
+
+        trace = lx0::string_from_file("unittest_trace.json");
+        CHECK(r, trace.find("\"name\":\"Test outer\"") == std::string::npos);
+        CHECK(r, trace.find("\"name\":\"Test inner\"") != std::string::npos);
+
+        ::remove("unittest_trace.json");
+    }
+    spEngine->shutdown();
+}
+
+static
+void profile_sample (TestRun& r)
+{
+    EnginePtr spEngine = Engine::acquire();
+    {
+        int id;
+        spEngine->registerProfileCounter("Test sample", &id);
+        auto& monitor = spEngine->profileMonitor();
+
+        for (int i = 0; i < 3; ++i)
+            ProfileSection section(id);
+
+        boost::thread thread([id]() {
+            for (int i = 0; i < 2; ++i)
+                ProfileSection section(id);
+        });
+        thread.join();
+
+        CHECK(r, monitor.sample(id).calls == 5);
+        CHECK(r, monitor.sample(id).inclusive >= 0);
+
+        std::vector<std::pair<lx0::uint32, ProfileSample>> perThread;
+        monitor.sample(id, perThread);
+        CHECK(r, perThread.size() == 2);
+
+        // Counters never entered read as empty rather than out of bounds
+        int unusedId;
+        spEngine->registerProfileCounter("Test sample unused", &unusedId);
+        CHECK(r, monitor.sample(unusedId).calls == 0);
+        CHECK(r, monitor.sample(ProfileThread::kMaxCounters + 1).calls == 0);
+    }
+    spEngine->shutdown();
+}
+
+static
+void profile_frames (TestRun& r)
+{
+    EnginePtr spEngine = Engine::acquire();
+    {
+        int outerId, innerId;
+        spEngine->registerProfileCounter("Test frame outer", &outerId);
+        spEngine->registerProfileCounter("Test frame inner", &innerId);
+
+        auto& monitor = spEngine->profileMonitor();
+        monitor.enableFrames(2, 0.0);
+
+        for (lx0::uint32 frame = 1; frame <= 3; ++frame)
+        {
+            monitor.beginFrame(frame);
+
+            ProfileSection outer(outerId);
+            for (lx0::uint32 i = 0; i < frame; ++i)
+                ProfileSection inner(innerId);
+        }
+        monitor.endFrame();
+
+        // Only the window of the last two frames is kept
+        CHECK(r, monitor.frameCount() == 2);
+        CHECK(r, monitor.frame(0).frame == 3);
+        CHECK(r, monitor.frame(1).frame == 2);
+
+        const FrameProfile& last = monitor.frame(0);
+        CHECK(r, last.nodes.size() == 3);
+        CHECK(r, last.nodes[1].id == outerId && last.nodes[1].parent == 0);
+        CHECK(r, last.nodes[2].id == innerId && last.nodes[2].parent == 1);
+        CHECK(r, last.nodes[2].calls == 3);
+        CHECK(r, last.nodes[1].inclusive >= last.nodes[2].inclusive);
+        CHECK(r, monitor.formatFrame(last).find("Test frame inner") != std::string::npos);
+
+        // Any frame longer than the threshold is kept as a hitch
+        monitor.enableFrames(2, 1.0);
+        monitor.beginFrame(4);
+        boost::this_thread::sleep(boost::posix_time::milliseconds(5));
+        monitor.endFrame();
+        CHECK(r, !monitor.hitches().empty() && monitor.hitches().back().frame == 4);
+
+        monitor.enableFrames(0, 0.0);
+        CHECK(r, monitor.frameCount() == 0);
+    }
+    spEngine->shutdown();
+}
+
+static lx0::ObjectTracker s_unittestCount("Unittest object");
+
+static
+void object_tracker (TestRun& r)
+{
+    EnginePtr spEngine = Engine::acquire();
+    {
+        CHECK(r, &spEngine->objectCount("Unittest object") == &s_unittestCount.count());
+        CHECK(r, lx0::ObjectTracker("Unittest object").id() == s_unittestCount.id());
+
+        const size_t total = s_unittestCount.count().total();
+        s_unittestCount.inc();
+        s_unittestCount.inc();
+        s_unittestCount.dec();
+        CHECK(r, s_unittestCount.count().current() == 1);
+        CHECK(r, s_unittestCount.count().total() == total + 2);
+        
+        // The name-based interface shares the same counts
+        spEngine->decObjectCount("Unittest object");
+        CHECK(r, s_unittestCount.count().current() == 0);
+
+        // The count never drops below zero
+        CHECK(r, s_unittestCount.dec() == false);
+        CHECK(r, s_unittestCount.count().current() == 0);
+
+        const size_t elements = spEngine->objectCount("Element").current();
+        {
+            DocumentPtr spDocument = spEngine->createDocument();
+            ElementPtr spElem = spDocument->createElement("Test");
+            CHECK(r, spEngine->objectCount("Element").current() == elements + 2);
+            spEngine->closeDocument(spDocument);
+        }
+        CHECK(r, spEngine->objectCount("Element").current() == elements);
+    }
+    spEngine->shutdown();
+}
+
+static
+void metrics_registry (TestRun& r)
+{
+    MetricsRegistry metrics;
+
+    MetricCounter& counter = metrics.counter("test.counter");
+    counter.inc();
+    counter.add(4);
+    CHECK(r, &counter == &metrics.counter("test.counter"));
+    CHECK(r, counter.value() == 5);
+
+    metrics.gauge("test.gauge").set(-3);
+    CHECK(r, metrics.gauge("test.gauge").value() == -3);
+
+    // Bucket bounds are exact in the linear range and within ~3% above it
+    for (lx0::uint64 v = 0; v < 100000; v += 7)
+    {
+        int i = MetricHistogram::bucketIndex(v);
+        CHECK(r, MetricHistogram::bucketLowest(i) <= v && v <= MetricHistogram::bucketHighest(i));
+    }
+    CHECK(r, MetricHistogram::bucketIndex(0xFFFFFFFFFFFFFFFFull) == MetricHistogram::kBucketCount - 1);
+
+    MetricHistogram& histogram = metrics.histogram("test.histogram");
+    for (lx0::uint64 v = 1; v <= 1000; ++v)
+        histogram.record(v);
+
+    MetricsSnapshot snapshot;
+    metrics.snapshot(12, snapshot);
+    CHECK(r, snapshot.frame == 12);
+    CHECK(r, snapshot.entries.size() == 3);
+    CHECK(r, snapshot.find("test.missing") == nullptr);
+    CHECK(r, snapshot.find("test.counter")->value == 5);
+    CHECK(r, snapshot.find("test.gauge")->value == -3);
+
+    const MetricHistogram::Summary& h = snapshot.find("test.histogram")->histogram;
+    CHECK(r, h.count == 1000);
+    CHECK(r, h.min == 1);
+    CHECK(r, h.p50 >= 500 && h.p50 <= 515);
+    CHECK(r, h.p99 >= 990 && h.p99 <= 1023);
+    CHECK(r, h.max >= 1000 && h.max <= 1023);
+    CHECK(r, h.mean > 490.0 && h.mean < 510.0);
+
+    std::string lines = MetricsExporter::format(snapshot);
+    CHECK(r, lines.find("lxengine,metric=test.counter value=5i,frame=12i ") != std::string::npos);
+    CHECK(r, lines.find("lxengine,metric=test.histogram count=1000i,min=1i,") != std::string::npos);
+}
+
+static
+void xml_reader (TestRun& r)
+{
+    using lx0::engine_ns::detail::XmlReader;
+
+    struct Handler : public XmlReader::Handler
+    {
+        std::vector<const std::string*>     names;
+        std::string                         inner;
+        std::string                         attr;
+        
+        virtual void startElement (const std::string& name, const std::vector<XmlReader::Attribute>& attributes, int line)
+        {
+            names.push_back(&name);
+            for (auto it = attributes.begin(); it != attributes.end(); ++it)
+                attr += *it->pName + "=" + it->value + ";";
+        }
+        virtual void text (const std::string& s, int line) { inner += s; }
+    };
+
+    const std::string xml = 
+        "<?xml version=\"1.0\"?>\n"
+        "<Document>\n"
+        "  <Item name='a &amp; b'>  { x : 1,\n     y : 2 } </Item>\n"
+        "  <Item/>\n"
+        "</Document>\n";
+    
+    // Repeated names are reported as the same interned string
+    XmlReader reader;
+    Handler handler;
+    reader.parse(xml.data(), xml.data() + xml.size(), handler, "test.xml");
+    CHECK(r, handler.names.size() == 3);
+    CHECK(r, handler.names[1] == handler.names[2]);
+    CHECK(r, reader.internedCount() == 3);
+    CHECK(r, handler.attr == "name=a & b;");
+    CHECK(r, handler.inner == "{ x : 1, y : 2 }");
+
+    bool bThrown = false;
+    const std::string bad = "<Document><Item></Document>";
+    try { reader.parse(bad.data(), bad.data() + bad.size(), handler, "bad.xml"); } catch (lx0::error_exception&) { bThrown = true; }
+    CHECK(r, bThrown);
+
+    // Deferred values are computed once, on first access
+    EnginePtr spEngine = Engine::acquire();
+    {
+        auto spDoc = spEngine->createDocument();
+        ElementPtr spElem = spDoc->createElement("Item");
+
+        int calls = 0;
+        spElem->deferValue([&calls]() -> lxvar { ++calls; return lxvar::parse("{ 'x' : 1 }"); });
+        CHECK(r, calls == 0);
+        CHECK(r, spElem->value()["x"].as<int>() == 1);
+        CHECK(r, spElem->value()["x"].as<int>() == 1);
+        CHECK(r, calls == 1);
+
+        spElem->deferValue([&calls]() -> lxvar { ++calls; return lxvar(); });
+        spElem->value(lxvar(2));
+        CHECK(r, spElem->value().as<int>() == 2);
+        CHECK(r, calls == 1);
+
+        // A failed parse is retried on the next access rather than lost
+        spElem->deferValue([&calls]() -> lxvar { 
+            if (++calls == 2) 
+                throw lx_error_exception("parse failed");
+            return lxvar(3); 
+        });
+        bThrown = false;
+        try { spElem->value(); } catch (lx0::error_exception&) { bThrown = true; }
+        CHECK(r, bThrown);
+        CHECK(r, spElem->value().as<int>() == 3);
+        CHECK(r, calls == 3);
+    }
+    spEngine->shutdown();
+}
+
 void
 testset_engine(TestSet& set)
 {
@@ -104,4 +691,17 @@ testset_engine(TestSet& set)
     });
 
     set.push("Element flags", element_flags);
+    set.push("Document snapshot", document_snapshot);
+    set.push("Document transaction", document_transaction);
+    set.push("Document change journal", document_journal);
+    set.push("Element handles", element_handles);
+    set.push("Include document handles", include_document_handles);
+    set.push("Document bulk attach", document_bulk_attach);
+    set.push("Resource batch", resource_batch);
+    set.push("XML reader", xml_reader);
+    set.push("Profile trace", profile_trace);
+    set.push("Profile live sample", profile_sample);
+    set.push("Profile frames", profile_frames);
+    set.push("Metrics registry", metrics_registry);
+    set.push("Object tracker", object_tracker);
 }
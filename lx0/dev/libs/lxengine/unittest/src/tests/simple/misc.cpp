@@ -1,6 +1,9 @@
 #include"main.hpp"
 #include <lx0/lxengine.hpp>
 #include <lx0/util/math/noise.hpp>
+#include <lx0/util/misc/benchmark.hpp>
+#include <lx0/util/cookedmesh.hpp>
+#include <lx0/util/misc/cookedfile.hpp>
 
 void
 testset_misc(TestSet& set)
@@ -51,4 +54,210 @@ testset_misc(TestSet& set)
         CHECK(r, noiseMax <= 1.0 && noiseMax >= .8);
         CHECK(r, abs(noiseAvg - .5) < 0.05);
     });
+
+    set.push("log backend", [] (TestRun& r) {
+
+        lx0::lx_log_push_sink(lx0::eLogSinkText, "unittest_log.txt");
+
+        boost::thread_group threads;
+        for (int t = 0; t < 4; ++t)
+        {
+            threads.create_thread([t]() {
+                for (int i = 0; i < 2000; ++i)
+                    lx_log("unittest record %d:%d", t, i);
+            });
+        }
+        threads.join_all();
+
+        // Disabled levels do not evaluate the message arguments
+        int evaluated = 0;
+        auto arg = [&evaluated]() -> int { return ++evaluated; };
+        lx0::lx_log_level(lx0::eLogWarn);
+        lx_log("unittest filtered %d", arg());
+        lx0::lx_log_level(lx0::eLogDebug);
+        CHECK(r, evaluated == 0);
+
+        // Deferred arguments are copied: the buffer can be reused immediately
+        char buffer[32] = "unittest buffer";
+        lx_log("%1% %2% %3$.1f", buffer, std::string("string"), 2.5);
+        buffer[0] = 'X';
+
+        // Pointers that boost::format reads through are formatted immediately
+        unsigned char bytes[32] = "unittest bytes";
+        const unsigned char* pBytes = bytes;
+        lx_log("%1%", pBytes);
+        bytes[0] = 'X';
+
+        lx0::lx_log_pop_sink();
+
+        std::string text = lx0::string_from_file("unittest_log.txt");
+        size_t count = 0;
+        for (size_t pos = text.find("unittest record"); pos != std::string::npos; pos = text.find("unittest record", pos + 1))
+            ++count;
+        CHECK(r, count == 4 * 2000);
+        CHECK(r, text.find("unittest filtered") == std::string::npos);
+        CHECK(r, text.find("unittest record 3:1999") != std::string::npos);
+        CHECK(r, text.find("unittest buffer string 2.5") != std::string::npos);
+        CHECK(r, text.find("unittest bytes") != std::string::npos);
+
+        ::remove("unittest_log.txt");
+    });
+
+    set.push("perf counters", [] (TestRun& r) {
+
+        lx0::PerfCounters counters;
+        
+        volatile float sum = 0.0f;
+        counters.start();
+        for (int i = 0; i < 100000; ++i)
+            sum += float(i);
+        counters.stop();
+
+        // Counts are either measured or, if unavailable on this platform, zero
+        if (counters.available())
+        {
+            CHECK(r, counters.total(lx0::PerfCounters::eInstructions) > 100000);
+            CHECK(r, counters.total(lx0::PerfCounters::eCycles) > 0);
+        }
+        else
+            CHECK(r, counters.total(lx0::PerfCounters::eInstructions) == 0);
+
+        counters.reset();
+        CHECK(r, counters.total(lx0::PerfCounters::eCycles) == 0);
+    });
+
+    set.push("benchmark statistics", [] (TestRun& r) {
+
+        std::vector<double> samples;
+        for (int i = 20; i >= 1; --i)
+            samples.push_back(double(i));
+
+        lx0::BenchmarkRunner::Result result;
+        lx0::BenchmarkRunner::summarize(samples, result);
+        CHECK(r, result.repetitions == 20);
+        CHECK(r, result.minMs == 1.0 && result.maxMs == 20.0);
+        CHECK(r, result.medianMs == 10.5);
+        CHECK(r, result.p95Ms == 19.0);
+        CHECK(r, abs(result.stddevMs - 5.916) < 0.01);
+
+        lx0::lxvar baseline = lx0::lxvar::parse("{ \"results\" : [ { \"name\" : \"a\", \"median_ms\" : 10.0 }, { \"name\" : \"b\", \"median_ms\" : 10.0 } ] }");
+        lx0::lxvar slower   = lx0::lxvar::parse("{ \"results\" : [ { \"name\" : \"a\", \"median_ms\" : 10.5 }, { \"name\" : \"b\", \"median_ms\" : 12.0 } ] }");
+        CHECK(r, lx0::BenchmarkRunner::compare(slower, baseline, 10.0) == 1);
+        CHECK(r, lx0::BenchmarkRunner::compare(baseline, slower, 10.0) == 0);
+
+        // Quotes and backslashes in case names are replaced so that the saved results parse back
+        const char* filename = "temp_unittest_benchmark.json";
+        result.name = "quote \" and \\ backslash";
+        result.bEvents = false;
+        lx0::BenchmarkRunner::writeJson(filename, "suite", std::vector<lx0::BenchmarkRunner::Result>(1, result));
+        lx0::lxvar saved = lx0::lxvar_from_file(filename);
+        CHECK(r, saved["results"][0]["name"].as<std::string>() == "quote ' and / backslash");
+        ::remove(filename);
+    });
+
+    set.push("memory tracking", [] (TestRun& r) {
+
+        lx0::MemoryStats before, during, after;
+        lx0::lx_memory_stats(lx0::eMemoryMesh, before);
+        {
+            std::vector<int, lx0::TaggedAllocator<int, lx0::eMemoryMesh>> indices(1000);
+            lx0::lx_memory_stats(lx0::eMemoryMesh, during);
+        }
+        lx0::lx_memory_stats(lx0::eMemoryMesh, after);
+
+        CHECK(r, during.live >= before.live + 1000 * sizeof(int));
+        CHECK(r, during.peak >= during.live);
+        CHECK(r, during.allocations > before.allocations);
+        CHECK(r, after.live == before.live);
+        CHECK(r, after.frees - before.frees == after.allocations - before.allocations);
+
+        lx0::lx_memory_stats(lx0::eMemoryLxvar, before);
+        {
+            lx0::lxvar map = lx0::lxvar::map();
+            map["a"] = 1;
+            lx0::lx_memory_stats(lx0::eMemoryLxvar, during);
+        }
+        lx0::lx_memory_stats(lx0::eMemoryLxvar, after);
+        CHECK(r, during.live > before.live);
+        CHECK(r, after.live == before.live);
+
+        CHECK(r, lx0::lx_memory_tag() == lx0::eMemoryGeneral);
+        {
+            lx0::MemoryScope scope(lx0::eMemoryMesh);
+            CHECK(r, lx0::lx_memory_tag() == lx0::eMemoryMesh);
+        }
+        CHECK(r, lx0::lx_memory_tag() == lx0::eMemoryGeneral);
+    });
+
+    set.push("cooked mesh", [] (TestRun& r) {
+
+        glgeom::primitive_buffer src;
+        src.type = "quads";
+        for (int i = 0; i < 4; ++i)
+        {
+            src.vertex.positions.push_back( glgeom::point3f(float(i), float(i * 2), -1.0f) );
+            src.vertex.normals.push_back( glgeom::vector3f(0, 0, 1) );
+            src.vertex.colors.push_back( glgeom::color3f(1, 0.5f, 0) );
+            src.bbox.merge(src.vertex.positions.back());
+            src.indices.push_back(3 - i);
+        }
+        src.face.flags.push_back(1);
+        src.bsphere = bsphere3_from(src.bbox);
+
+        const std::string filename = "temp_unittest_cooked.lxmesh";
+        lx0::cooked_mesh_write(src, filename, 1234);
+
+        glgeom::primitive_buffer dst;
+        CHECK(r, lx0::cooked_mesh_read(dst, filename, 1234));
+        CHECK(r, dst.type == src.type);
+        CHECK(r, dst.vertex.positions.size() == 4);
+        CHECK(r, dst.vertex.normals.size() == 4);
+        CHECK(r, dst.vertex.colors.size() == 4);
+        CHECK(r, dst.vertex.positions[3].y == 6.0f);
+        CHECK(r, dst.vertex.colors[2].g == 0.5f);
+        CHECK(r, dst.indices.size() == 4 && dst.indices[0] == 3);
+        CHECK(r, dst.face.flags.size() == 1 && dst.face.flags[0] == 1);
+        CHECK(r, dst.bbox.max.x == 3.0f);
+        CHECK(r, dst.bsphere.radius == src.bsphere.radius);
+
+        // A stale key (e.g. the source file was modified) is a cache miss
+        glgeom::primitive_buffer stale;
+        CHECK(r, !lx0::cooked_mesh_read(stale, filename, 4321));
+
+        ::remove(filename.c_str());
+    });
+
+    set.push("cooked file", [] (TestRun& r) {
+
+        CHECK(r, lx0::lx_fnv1a("", 0) == 14695981039346656037ULL);
+        CHECK(r, lx0::lx_fnv1a("a", 1) == 0xaf63dc4c8601ec8cULL);
+        CHECK(r, lx0::cooked_file_path("cache", "meshes\\x\\door.nif", 0x1f, "lxnif") == "cache/door-000000000000001f.lxnif");
+
+        std::vector<glgeom::point2f> uv;
+        uv.push_back( glgeom::point2f(0.25f, 0.75f) );
+        
+        const std::string filename = "temp_unittest_cooked.bin";
+        lx0::CookedFileWriter writer (0x1234, 1, 99);
+        writer.writeString("abc");
+        writer.writeStream(uv);
+        CHECK(r, writer.save(filename));
+
+        std::string s;
+        std::vector<glgeom::point2f> uv2;
+        CHECK(r, lx0::cooked_file_read(filename, 0x1234, 1, 99, [&](lx0::CookedFileReader& reader) {
+            reader.readString(s, 3);
+            reader.readStream(uv2, 1);
+        }));
+        CHECK(r, s == "abc");
+        CHECK(r, uv2.size() == 1 && uv2[0].y == 0.75f);
+
+        // A different version or key is a miss; a read past the end, or data 
+        // left unread, is rejected as corrupt
+        CHECK(r, !lx0::cooked_file_read(filename, 0x1234, 2, 99, [](lx0::CookedFileReader&) {}));
+        CHECK(r, !lx0::cooked_file_read(filename, 0x1234, 1, 98, [](lx0::CookedFileReader&) {}));
+        CHECK(r, !lx0::cooked_file_read(filename, 0x1234, 1, 99, [](lx0::CookedFileReader& reader) { reader.take(1024); }));
+        CHECK(r, !lx0::cooked_file_read(filename, 0x1234, 1, 99, [](lx0::CookedFileReader&) {}));
+
+        ::remove(filename.c_str());
+    });
 }
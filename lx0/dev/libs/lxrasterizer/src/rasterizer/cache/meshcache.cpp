@@ -27,6 +27,7 @@
 //===========================================================================//
 
 #include <lx0/util/blendload.hpp>
+#include <lx0/util/cookedmesh.hpp>
 #include <lx0/extensions/rasterizer.hpp>
 
 using namespace lx0::subsystem::rasterizer_ns;
@@ -48,7 +49,7 @@ _createGeometry (RasterizerGL* spRasterizer, const char* filename, float scale)
 
     glgeom::primitive_buffer primitive;
     glm::mat4 scaleMat = glm::scale(glm::mat4(), glm::vec3(scale, scale, scale));
-    lx0::primitive_buffer_from_blendfile(primitive, filename, scaleMat);
+    lx0::primitive_buffer_from_blendfile_cached(primitive, lx0::cooked_mesh_directory(), filename, scaleMat);
             
     auto spGeometry = spRasterizer->createQuadList(primitive.indices, primitive.face.flags, primitive.vertex.positions, primitive.vertex.normals, primitive.vertex.colors);
     spGeometry->mBBox = primitive.bbox;
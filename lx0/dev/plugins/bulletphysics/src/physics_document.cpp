@@ -35,6 +35,8 @@
 using namespace lx0::subsystem::physics_ns::detail;
 using namespace lx0;
 
+static lx0::ObjectTracker s_physicsCount("Physics");
+
 //===========================================================================//
 //
 //===========================================================================//
@@ -44,7 +46,7 @@ PhysicsDoc::PhysicsDoc()
     , mfWindVelocity    (0.0f)
     , mWindDirection    (-1, 0, 0)
 {
-    Engine::acquire()->incObjectCount("Physics");
+    s_physicsCount.inc();
 
     mspBroadphase.reset( new btDbvtBroadphase );
 
@@ -88,7 +90,7 @@ PhysicsDoc::~PhysicsDoc()
     mspDynamicsWorld.reset();
     mspBroadphase.reset();
 
-    Engine::acquire()->decObjectCount("Physics");
+    s_physicsCount.dec();
 }
 
 void 
@@ -36,6 +36,7 @@
 #include <lx0/util/misc.hpp>
 #include <lx0/plugins/bulletphysics.hpp>
 #include "physics/mwphysics.hpp"
+#include "tes3loader.hpp"
 
 #include <bullet/btBulletDynamicsCommon.h>
 
@@ -67,6 +68,9 @@ public:
 
             _handleMove(spElem, evt, step, position, target);
             spElem->notifyValueChanged();
+
+            // Let the loader prefetch the cells the camera is moving toward
+            Engine::acquire()->getComponent<ITES3Loader>()->updateStreaming(position);
         }
         else if (evt == "toggle_gravity")
         {
@@ -85,6 +85,12 @@ main (int argc, char** argv)
 
         spEngine->globals().add("startingCell", lx0::eAcceptsString, lx0::validate_string());
 
+        // Exterior cells within this many cells of the camera are loaded in the background (0 disables)
+        spEngine->globals().add("streamRadius", lx0::eAcceptsInt, lx0::validate_int_range(0, 8), 1);
+        
+        // Least recently used streamed cells are released once their total estimated size exceeds this
+        spEngine->globals().add("streamBudgetMB", lx0::eAcceptsInt, lx0::validate_int_range(16, 4096), 256);
+
         if (spEngine->parseCommandLine(argc, argv, "startingCell"))
         {
             spEngine->loadPlugin("BulletPhysics");
@@ -160,6 +166,7 @@ main (int argc, char** argv)
             spPlayer->value()["target"] = lxvar::wrap(sceneBounds.center());
             spPlayer->value()["position"] = lxvar::wrap( sceneBounds.center() + .6f * (sceneBounds.max - sceneBounds.min) );
             spPlayer->notifyValueChanged();
+            spEngine->getComponent<ITES3Loader>()->updateStreaming( spPlayer->value()["position"].unwrap2<glgeom::point3f>() );
         
             //
             // Create a view of the Document now that it has data
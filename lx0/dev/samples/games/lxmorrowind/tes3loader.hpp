@@ -50,4 +50,7 @@ public:
     virtual void    initialize      (const char* path) = 0;
     virtual void    cell            (const char* id, scene_group& group) = 0;
 
+    //! Call as the camera moves so exterior cells nearby are prefetched
+    virtual void    updateStreaming (const glgeom::point3f& position) = 0;
+
 };
@@ -0,0 +1,598 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+    * MIT License (http://www.opensource.org/licenses/mit-license.php)
+
+    Copyright (c) 2011 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a 
+    copy of this software and associated documentation files (the "Software"), 
+    to deal in the Software without restriction, including without limitation 
+    the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+    and/or sell copies of the Software, and to permit persons to whom the 
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+//===========================================================================//
+//   H E A D E R S   &   D E C L A R A T I O N S 
+//===========================================================================//
+
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <boost/thread.hpp>
+#include <boost/format.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/algorithm/string.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <lx0/lxengine.hpp>
+#include <lx0/util/misc.hpp>
+#include <lx0/util/misc/cookedfile.hpp>
+
+#include "nif.hpp"
+#include "bsa.hpp"
+
+//===========================================================================//
+// BsaMapping
+//===========================================================================//
+
+struct BsaMapping
+{
+    BsaMapping (const std::string& filename)
+        : mapping (filename.c_str(), boost::interprocess::read_only)
+        , region  (mapping, boost::interprocess::read_only)
+    {
+    }
+
+    const char* data (void) const { return static_cast<const char*>(region.get_address()); }
+    size_t      size (void) const { return region.get_size(); }
+
+    boost::interprocess::file_mapping   mapping;
+    boost::interprocess::mapped_region  region;
+};
+
+namespace
+{
+    /*
+        Read-only std::streambuf directly over a span of the mapping.  Holds
+        a reference to the mapping so the stream stays valid even if the 
+        BsaFile is destroyed first.
+     */
+    class SpanStreamBuf : public std::streambuf
+    {
+    public:
+        SpanStreamBuf (std::shared_ptr<BsaMapping> spMapping, const char* pData, size_t size)
+            : mspMapping (spMapping)
+        {
+            // The get area is never written through
+            char* p = const_cast<char*>(pData);
+            setg(p, p, p + size);
+        }
+
+    protected:
+        virtual pos_type seekoff (off_type off, std::ios_base::seekdir dir, std::ios_base::openmode)
+        {
+            char* pBase = (dir == std::ios_base::beg) ? eback() 
+                        : (dir == std::ios_base::cur) ? gptr() 
+                        : egptr();
+            char* p = pBase + off;
+            if (p < eback() || p > egptr())
+                return pos_type(off_type(-1));
+
+            setg(eback(), p, egptr());
+            return pos_type(off_type(p - eback()));
+        }
+
+        virtual pos_type seekpos (pos_type pos, std::ios_base::openmode which)
+        {
+            return seekoff(off_type(pos), std::ios_base::beg, which);
+        }
+
+        std::shared_ptr<BsaMapping> mspMapping;
+    };
+
+    class SpanStream : public std::istream
+    {
+    public:
+        SpanStream (std::shared_ptr<BsaMapping> spMapping, const char* pData, size_t size)
+            : std::istream  (nullptr)
+            , mBuffer       (spMapping, pData, size)
+        {
+            rdbuf(&mBuffer);
+        }
+
+    protected:
+        SpanStreamBuf mBuffer;
+    };
+
+    template <typename T>
+    inline T read_value (const char* p)
+    {
+        T value;
+        ::memcpy(&value, p, sizeof(T));
+        return value;
+    }
+}
+
+//===========================================================================//
+// BsaFile
+//===========================================================================//
+
+/*
+    Computes the hash Morrowind uses for BSA entry names.  The name is 
+    expected to already be lower-case with backslash separators.
+
+    The low 32-bits are a XOR of the bytes of the first half of the name;
+    the high 32-bits are a XOR-and-rotate of the bytes of the second half.
+ */
+lx0::uint64
+BsaFile::hash (const std::string& name)
+{
+    const size_t length = name.length();
+    const size_t half   = length / 2;
+
+    lx0::uint32 sum = 0;
+    lx0::uint32 off = 0;
+    size_t      i   = 0;
+    for (; i < half; ++i)
+    {
+        sum ^= lx0::uint32(lx0::uint8(name[i])) << (off & 0x1F);
+        off += 8;
+    }
+    const lx0::uint32 low = sum;
+
+    sum = 0;
+    off = 0;
+    for (; i < length; ++i)
+    {
+        lx0::uint32 temp = lx0::uint32(lx0::uint8(name[i])) << (off & 0x1F);
+        sum ^= temp;
+        
+        lx0::uint32 n = temp & 0x1F;
+        if (n)
+            sum = (sum >> n) | (sum << (32 - n));
+        off += 8;
+    }
+    const lx0::uint32 high = sum;
+
+    return lx0::uint64(low) | (lx0::uint64(high) << 32);
+}
+
+bool
+BsaFile::open (const std::string& filename)
+{
+    std::cout << boost::format("Loading file '%s'...\n") % filename;
+    mFilename = filename;
+    mStamp = 0;
+
+    try
+    {
+        mspMapping.reset( new BsaMapping(filename) );
+    }
+    catch (boost::interprocess::interprocess_exception&)
+    {
+        lx_warn("Could not open BSA file '%s'", filename.c_str());
+        mspMapping.reset();
+        return false;
+    }
+
+    {
+        namespace bfs = boost::filesystem;
+        boost::system::error_code ec;
+        const lx0::uint64 mtime = lx0::uint64( bfs::last_write_time(filename, ec) );
+        mStamp = (mtime << 20) ^ lx0::uint64( mspMapping->size() );
+    }
+
+    //
+    // Header: version, directory size, file count.  The directory follows
+    // (file offsets, name offsets, name table) then the hash table, then 
+    // the file data.
+    //
+    const char*  pBase = mspMapping->data();
+    const size_t size  = mspMapping->size();
+    lx_check_error(size >= 12, "BSA file '%s' is truncated", filename.c_str());
+
+    const lx0::uint32 directorySize = read_value<lx0::uint32>(pBase + 4);
+    const lx0::uint32 fileCount     = read_value<lx0::uint32>(pBase + 8);
+
+    const char* pFileOffsets = pBase + 12;
+    const char* pNameOffsets = pFileOffsets + 8 * size_t(fileCount);
+    const char* pNameTable   = pNameOffsets + 4 * size_t(fileCount);
+    const char* pHashTable   = pBase + 12 + size_t(directorySize);
+    const lx0::uint64 dataOffset = 12 + lx0::uint64(directorySize) + 8 * lx0::uint64(fileCount);
+
+    lx_check_error(directorySize >= 12 * fileCount && dataOffset <= size, 
+        "BSA file '%s' has an invalid directory", filename.c_str());
+    
+    const size_t nameTableSize = size_t(pHashTable - pNameTable);
+
+    mEntries.resize(fileCount);
+    for (lx0::uint32 i = 0; i < fileCount; ++i)
+    {
+        // The names are used in place, so each must be terminated within the table
+        const lx0::uint32 nameOffset = read_value<lx0::uint32>(pNameOffsets + 4 * i);
+        lx_check_error(nameOffset < nameTableSize 
+            && ::memchr(pNameTable + nameOffset, '\0', nameTableSize - nameOffset) != nullptr,
+            "BSA file '%s' has an invalid name table", filename.c_str());
+
+        Entry& entry = mEntries[i];
+        entry.name   = pNameTable + nameOffset;
+        entry.size   = read_value<lx0::uint32>(pFileOffsets + 8 * i);
+        entry.offset = dataOffset + read_value<lx0::uint32>(pFileOffsets + 8 * i + 4);
+
+        lx_check_error(entry.offset + entry.size <= size, 
+            "BSA entry '%s' extends past the end of '%s'", entry.name, filename.c_str());
+    }
+
+    //
+    // Index the entries by the archive's own hash table.  If the stored hash
+    // does not match the computed hash (e.g. an archive written by a tool 
+    // that does not fill in the table), fall back to hashing the names.
+    //
+    bool bUseStored = (fileCount == 0) || (read_value<lx0::uint64>(pHashTable) == hash(mEntries[0].name));
+    if (!bUseStored)
+        lx_warn("BSA '%s' hash table does not match entry names.  Rebuilding.", filename.c_str());
+
+    mHashIndex.rehash(fileCount);
+    for (lx0::uint32 i = 0; i < fileCount; ++i)
+    {
+        const lx0::uint64 key = bUseStored 
+            ? read_value<lx0::uint64>(pHashTable + 8 * i)
+            : hash(mEntries[i].name);
+        mHashIndex.insert(std::make_pair(key, i));
+    }
+
+    return true;
+}
+
+/*
+    The name must be lower-case.  Entries with colliding hashes are 
+    disambiguated by comparing the name in the archive.
+ */
+const BsaFile::Entry* 
+BsaFile::find (const std::string& name) const
+{
+    auto range = mHashIndex.equal_range( hash(name) );
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        const Entry& entry = mEntries[it->second];
+        if (name == entry.name)
+            return &entry;
+    }
+    return nullptr;
+}
+
+BsaFile::Span
+BsaFile::data (const Entry& entry) const
+{
+    Span span;
+    span.data = mspMapping->data() + entry.offset;
+    span.size = entry.size;
+    return span;
+}
+
+/*
+    Returns a stream reading directly from the entry's data in the mapping.
+ */
+std::shared_ptr<std::istream>
+BsaFile::stream (const Entry& entry) const
+{
+    Span span = data(entry);
+    return std::shared_ptr<std::istream>( new SpanStream(mspMapping, span.data, span.size) );
+}
+
+void
+BsaFile::_dumpIndex () const
+{
+    //
+    // Debugging tool: create an index of all the named entries
+    //
+    std::ofstream out(boost::str(boost::format("%s_index.txt") % boost::filesystem::path(mFilename).filename()));
+    lx_check_error(out.good());
+    for (auto it = mEntries.begin(); it != mEntries.end(); ++it)
+        out << it->name << std::endl;
+    out.close();
+}
+
+//===========================================================================//
+// BsaCollection
+//===========================================================================//
+
+std::pair<const BsaFile*, const BsaFile::Entry*>
+BsaCollection::_find (std::string name)
+{
+    boost::to_lower(name);
+    for (auto jt = mBsas.begin(); jt != mBsas.end(); ++jt)
+    {
+        auto pEntry = jt->find(name);
+        if (pEntry)
+            return std::make_pair(&*jt, pEntry);
+    }
+    return std::make_pair((const BsaFile*)nullptr, (const BsaFile::Entry*)nullptr);
+}
+
+namespace
+{
+    //! Cooked model format version: bump to invalidate existing cooked files
+    const lx0::uint32 kCookedModelVersion = 1;
+
+    /*
+        The cooked copy is valid only while the archive it came from is 
+        unchanged and the entry is at the same location within it.
+     */
+    lx0::uint64 _cookedModelKey (const BsaFile& bsa, const BsaFile::Entry& entry)
+    {
+        const lx0::uint64 stamp = bsa.stamp();
+        
+        lx0::uint64 h = lx0::lx_fnv1a(&kCookedModelVersion, sizeof(kCookedModelVersion));
+        h = lx0::lx_fnv1a(bsa.mFilename.c_str(), bsa.mFilename.size(), h);
+        h = lx0::lx_fnv1a(&stamp, sizeof(stamp), h);
+        h = lx0::lx_fnv1a(entry.name, strlen(entry.name), h);
+        h = lx0::lx_fnv1a(&entry.offset, sizeof(entry.offset), h);
+        h = lx0::lx_fnv1a(&entry.size, sizeof(entry.size), h);
+        return h;
+    }
+}
+
+/*
+    Returns the model from the in-memory cache, the cooked copy on disk, or
+    by parsing the NIF (in that order of preference).  Safe to call from 
+    multiple threads: the parse happens outside the lock and, if two threads
+    race to load the same model, the first result inserted is kept.
+ */
+std::shared_ptr<nif_model>
+BsaCollection::_loadModel (const std::string& fullname)
+{
+    {
+        boost::lock_guard<boost::mutex> lock(mModelMutex);
+        auto it = mModelCache.find(fullname);
+        if (it != mModelCache.end())
+        {
+            it->second.lastUsed = ++mModelClock;
+            return it->second.spModel;
+        }
+    }
+
+    auto found = _find(fullname);
+    if (!found.second)
+        return std::shared_ptr<nif_model>();
+
+    std::shared_ptr<nif_model> spModel;
+    
+    std::string cooked;
+    lx0::uint64 key = 0;
+    if (!mCacheDirectory.empty())
+    {
+        key = _cookedModelKey(*found.first, *found.second);
+        cooked = lx0::cooked_file_path(mCacheDirectory, fullname, key, "lxnif");
+
+        spModel.reset(new nif_model);
+        if (!nif_model_read(*spModel, cooked, key))
+            spModel.reset();
+    }
+
+    if (!spModel)
+    {
+        auto spStream = found.first->stream(*found.second);
+        spModel = readNifModel(*spStream);
+
+        if (!cooked.empty())
+            nif_model_write(*spModel, cooked, key);
+    }
+
+    CachedModel entry;
+    entry.spModel = spModel;
+    entry.bytes   = nifModelBytes(*spModel);
+
+    boost::lock_guard<boost::mutex> lock(mModelMutex);
+    entry.lastUsed = ++mModelClock;
+    return mModelCache.insert(std::make_pair(fullname, entry)).first->second.spModel;
+}
+
+std::shared_ptr<scene_group>
+BsaCollection::getModel (std::string type, std::string name)
+{
+    auto fullname = type + name;
+    boost::to_lower(fullname);
+
+    //
+    // Models are frequently reused in the cells (for example, a latern fixture).
+    // Therefore, the parsed model is cached and only the materials are created
+    // per use.
+    //
+    auto spModel = _loadModel(fullname);
+    if (spModel)
+        return instantiateNifModel(*spModel, _resolveTextureName);
+    else
+        return std::shared_ptr<scene_group>();
+}
+
+/*
+    Loads all the given models that are not already cached, spreading the
+    cooked model reads across threadCount threads.  The names are full 
+    names, e.g. "meshes\\x\\ex_common_door.nif".
+
+    Parsing a NIF with Niflib is serialized (see readNifModel()), so the 
+    threads only help once the models have been cooked to disk.
+ */
+void
+BsaCollection::loadModels (std::vector<std::string> names, size_t threadCount)
+{
+    for (auto it = names.begin(); it != names.end(); ++it)
+        boost::to_lower(*it);
+    std::sort(names.begin(), names.end());
+    names.erase( std::unique(names.begin(), names.end()), names.end() );
+
+    {
+        boost::lock_guard<boost::mutex> lock(mModelMutex);
+        auto end = std::remove_if(names.begin(), names.end(), [this](const std::string& s) {
+            return mModelCache.find(s) != mModelCache.end();
+        });
+        names.erase(end, names.end());
+    }
+
+    threadCount = std::min(threadCount, names.size());
+    if (threadCount <= 1)
+    {
+        for (auto it = names.begin(); it != names.end(); ++it)
+            _loadModel(*it);
+        return;
+    }
+
+    //
+    // Each thread takes the next unloaded name until none are left
+    //
+    boost::mutex                mutex;
+    size_t                      next = 0;
+    std::vector<std::string>    errors;
+    boost::thread_group         threads;
+
+    for (size_t i = 0; i < threadCount; ++i)
+    {
+        threads.create_thread([&]() {
+            while (true)
+            {
+                size_t index;
+                {
+                    boost::lock_guard<boost::mutex> lock(mutex);
+                    if (next == names.size())
+                        return;
+                    index = next++;
+                }
+
+                try
+                {
+                    _loadModel(names[index]);
+                }
+                catch (std::exception& e)
+                {
+                    boost::lock_guard<boost::mutex> lock(mutex);
+                    errors.push_back(e.what());
+                }
+            }
+        });
+    }
+    threads.join_all();
+
+    for (auto it = errors.begin(); it != errors.end(); ++it)
+        lx_warn("Failed to load model: %s", it->c_str());
+}
+
+/*
+    Evicts the cached models that no instance uses, least recently used 
+    first, until the memory those idle models hold is within budgetBytes.
+    Models that are in use are not counted: their memory is accounted for 
+    by whoever holds the instances (e.g. the CellStreamer).  An evicted 
+    model is re-read from the cooked copy on disk if it is needed again.
+
+    A model is idle if only the cache references it and its primitives.
+    Instances can only be created from a model reference, which is taken 
+    under the lock, so the counts cannot increase during the check.
+ */
+void
+BsaCollection::trimModelCache (size_t budgetBytes)
+{
+    boost::lock_guard<boost::mutex> lock(mModelMutex);
+
+    std::vector<ModelCache::iterator> idle;
+    size_t idleBytes = 0;
+    for (auto it = mModelCache.begin(); it != mModelCache.end(); ++it)
+    {
+        const CachedModel& entry = it->second;
+        if (entry.spModel.use_count() != 1)
+            continue;
+
+        bool bUsed = false;
+        for (auto jt = entry.spModel->begin(); jt != entry.spModel->end() && !bUsed; ++jt)
+            bUsed = (jt->spPrimitive.use_count() > 1);
+        
+        if (!bUsed)
+        {
+            idle.push_back(it);
+            idleBytes += entry.bytes;
+        }
+    }
+
+    if (idleBytes <= budgetBytes)
+        return;
+
+    std::sort(idle.begin(), idle.end(), [](const ModelCache::iterator& a, const ModelCache::iterator& b) {
+        return a->second.lastUsed < b->second.lastUsed;
+    });
+    for (auto it = idle.begin(); it != idle.end() && idleBytes > budgetBytes; ++it)
+    {
+        idleBytes -= (*it)->second.bytes;
+        mModelCache.erase(*it);
+    }
+}
+
+std::pair<bool,const BsaFile::Entry*>
+BsaCollection::getEntry (std::string name)
+{
+    auto found = _find(name);
+    return std::make_pair(found.second != nullptr, found.second);
+}
+
+std::shared_ptr<std::istream>   
+BsaCollection::getTextureStream (std::string name)
+{
+    auto found = _find(name);
+    if (found.second)
+        return found.first->stream(*found.second);
+
+    lx_warn("Texture stream for '%s' not found", name.c_str());
+    return std::shared_ptr<std::istream>();
+}
+
+/*
+    Touches every page of the entry's data so that a later read on the
+    main thread does not stall on disk I/O.  Returns false if the entry
+    is not in any of the archives.
+ */
+bool
+BsaCollection::prefetch (std::string name)
+{
+    auto found = _find(name);
+    if (!found.second)
+        return false;
+
+    auto span = found.first->data(*found.second);
+    
+    volatile char sum = 0;
+    for (size_t i = 0; i < span.size; i += 4096)
+        sum ^= span.data[i];
+    return true;
+}
+
+void BsaCollection::initialize (const char* path)
+{
+    //
+    // Cooked models go in a sub-directory of the engine mesh cache.  An empty
+    // "mesh_cache" disables the on-disk cache.
+    //
+    lx0::lxvar dir = lx0::Engine::acquire()->globals().find("mesh_cache");
+    if (dir.is_string() && !dir.as<std::string>().empty())
+        mCacheDirectory = dir.as<std::string>() + "/nif";
+
+    lx0::for_files_in_directory(path, "bsa", [&](std::string file) {
+        mBsas.push_back(BsaFile());
+        if (!mBsas.back().open(file))
+            mBsas.pop_back();
+    });
+}
@@ -0,0 +1,151 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+    * MIT License (http://www.opensource.org/licenses/mit-license.php)
+
+    Copyright (c) 2011 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a 
+    copy of this software and associated documentation files (the "Software"), 
+    to deal in the Software without restriction, including without limitation 
+    the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+    and/or sell copies of the Software, and to permit persons to whom the 
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <iostream>
+#include <unordered_map>
+#include <boost/thread/mutex.hpp>
+#include <lx0/_detail/forward_decls.hpp>
+
+#include "../lxextensions/material_handle.hpp"
+#include "nif.hpp"
+
+std::string _resolveTextureName (std::string texture);
+
+struct BsaMapping;
+
+//===========================================================================//
+// BsaFile
+//===========================================================================//
+
+/*
+    A single Morrowind BSA archive.  The archive is memory-mapped once on 
+    open() and entries are returned as pointers into that mapping: neither 
+    the directory nor the entry data is copied.
+
+    Look-ups use the hash table stored in the archive, so no per-entry 
+    strings are allocated when the archive is indexed.
+ */
+class BsaFile
+{
+public:
+    struct Entry
+    {
+        const char*     name;           //!< Null-terminated, within the mapping
+        lx0::uint32     size;
+        lx0::uint64     offset;
+    };
+
+    //! A read-only view of an entry's data within the mapping
+    struct Span
+    {
+        const char*     data;
+        size_t          size;
+    };
+
+    bool                            open        (const std::string& filename);
+    const Entry*                    find        (const std::string& name) const;
+
+    Span                            data        (const Entry& entry) const;
+    std::shared_ptr<std::istream>   stream      (const Entry& entry) const;
+
+    static lx0::uint64              hash        (const std::string& name);
+
+    //! Changes whenever the archive file is modified (from its time stamp and size)
+    lx0::uint64                     stamp       () const { return mStamp; }
+
+    void                            _dumpIndex  () const;
+
+    std::string     mFilename;
+
+protected:
+    typedef std::unordered_multimap<lx0::uint64, lx0::uint32> HashIndex;
+
+    std::shared_ptr<BsaMapping>     mspMapping;
+    lx0::uint64                     mStamp;
+    std::vector<Entry>              mEntries;
+    HashIndex                       mHashIndex;
+};
+
+//===========================================================================//
+// BsaCollection
+//===========================================================================//
+
+/*
+    Represents a set of loaded BSA files.  Morrowind MODs include new BSA
+    files, so a particular resource could be coming from any of a set of 
+    BSA files.
+
+    Models are cached in memory as immutable nif_model objects and on disk
+    in a cooked binary form (under the Engine "mesh_cache" directory), so
+    Niflib only parses a given NIF once.  Each getModel() call instantiates
+    a new scene_group from the shared model.
+
+    Models no longer used by any instance are kept until trimModelCache()
+    evicts them.
+ */
+class BsaCollection
+{
+public:
+    BsaCollection() : mModelClock (0) {}
+
+    void initialize(const char* path);
+
+    std::pair<bool,const BsaFile::Entry*> getEntry    (std::string name);
+
+    std::shared_ptr<scene_group>    getModel            (std::string type, std::string name);
+    void                            loadModels          (std::vector<std::string> names, size_t threadCount);
+    std::shared_ptr<std::istream>   getTextureStream    (std::string name);
+    bool                            prefetch            (std::string name);
+
+    void                            trimModelCache      (size_t budgetBytes);
+
+protected:
+    struct CachedModel
+    {
+        std::shared_ptr<nif_model>  spModel;
+        size_t                      bytes;
+        lx0::uint64                 lastUsed;
+    };
+    typedef std::map<std::string, CachedModel> ModelCache;
+
+    std::pair<const BsaFile*, const BsaFile::Entry*> _find (std::string name);
+    std::shared_ptr<nif_model>      _loadModel          (const std::string& fullname);
+
+    std::string                                         mCacheDirectory;
+    boost::mutex                                        mModelMutex;
+    ModelCache                                          mModelCache;
+    lx0::uint64                                         mModelClock;
+    std::vector<BsaFile> mBsas;
+};
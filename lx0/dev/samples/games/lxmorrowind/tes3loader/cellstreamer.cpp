@@ -0,0 +1,340 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+    * MIT License (http://www.opensource.org/licenses/mit-license.php)
+
+    Copyright (c) 2011 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a 
+    copy of this software and associated documentation files (the "Software"), 
+    to deal in the Software without restriction, including without limitation 
+    the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+    and/or sell copies of the Software, and to permit persons to whom the 
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+//===========================================================================//
+//   H E A D E R S   &   D E C L A R A T I O N S 
+//===========================================================================//
+
+#include <set>
+#include <cmath>
+#include <algorithm>
+
+#include <lx0/lxengine.hpp>
+
+#include "cellstreamer.hpp"
+#include "nif.hpp"
+
+//===========================================================================//
+// CellStreamer
+//===========================================================================//
+
+//! Width of an exterior cell in world units
+const float CellStreamer::kCellSize = 8192.0f;
+
+CellStreamer::CellStreamer (void)
+    : mbStop    (false)
+    , mBudget   (0)
+    , mResident (0)
+    , mRadius   (0)
+    , mPosition (0, 0, 0)
+    , mClock    (0)
+{
+}
+
+CellStreamer::~CellStreamer (void)
+{
+    stop();
+}
+
+void
+CellStreamer::start (LoadFunction load, size_t threadCount, size_t budgetBytes, int radius)
+{
+    lx_check_error(mThreads.size() == 0, "CellStreamer already started");
+    lx_check_error(threadCount > 0);
+
+    mLoad   = load;
+    mBudget = budgetBytes;
+    mRadius = radius;
+    mbStop  = false;
+
+    for (size_t i = 0; i < threadCount; ++i)
+        mThreads.create_thread([this]() { _worker(); });
+}
+
+/*
+    Stops the worker threads, waiting for any in-progress loads to 
+    complete.  Resident cells are released.
+ */
+void
+CellStreamer::stop (void)
+{
+    {
+        boost::lock_guard<boost::mutex> lock(mMutex);
+        mbStop = true;
+    }
+    mCondition.notify_all();
+    mThreads.join_all();
+
+    mCells.clear();
+    mQueue.clear();
+    mResident = 0;
+}
+
+CellStreamer::Grid
+CellStreamer::gridFromPosition (const glgeom::point3f& position)
+{
+    return Grid( int(std::floor(position.x / kCellSize)), int(std::floor(position.y / kCellSize)) );
+}
+
+/*
+    Approximate memory held by the cell: the primitive data dominates, so 
+    materials and the texture handles are ignored.  A primitive shared by 
+    several instances (i.e. the same model placed repeatedly) is counted
+    only once.
+ */
+size_t
+CellStreamer::estimateBytes (const scene_group& group)
+{
+    size_t bytes = sizeof(scene_group);
+    bytes += group.instances.size() * (sizeof(instance) + sizeof(glgeom::mat4f));
+    bytes += group.lights.size() * sizeof(glgeom::point_light_f);
+
+    std::set<const glgeom::primitive_buffer*> counted;
+    for (auto it = group.instances.begin(); it != group.instances.end(); ++it)
+    {
+        const glgeom::primitive_buffer* pPrim = it->spPrimitive.get();
+        if (pPrim && counted.insert(pPrim).second)
+            bytes += primitiveBytes(*pPrim);
+    }
+    return bytes;
+}
+
+/*
+    Called on the main thread as the camera moves.  Also evicts cells if 
+    loads completed since the last call have put the streamer over budget.
+ */
+void
+CellStreamer::update (const glgeom::point3f& position)
+{
+    if (mThreads.size() == 0)
+        return;
+
+    const Grid center = gridFromPosition(position);
+    bool bQueued = false;
+
+    {
+        boost::lock_guard<boost::mutex> lock(mMutex);
+        mPosition = position;
+        mClock++;
+
+        //
+        // Drop queued cells the camera has moved away from before they 
+        // are loaded.  Cells that are loading or loaded are left alone.
+        //
+        for (size_t i = 0; i < mQueue.size(); )
+        {
+            if (!_inRange(mQueue[i], center))
+            {
+                mCells.erase(mQueue[i]);
+                mQueue[i] = mQueue.back();
+                mQueue.pop_back();
+            }
+            else
+                ++i;
+        }
+
+        for (int y = center.second - mRadius; y <= center.second + mRadius; ++y)
+        {
+            for (int x = center.first - mRadius; x <= center.first + mRadius; ++x)
+            {
+                Grid grid(x, y);
+                auto it = mCells.find(grid);
+                if (it == mCells.end())
+                {
+                    Cell& cell = mCells[grid];
+                    cell.state    = Cell::eQueued;
+                    cell.bytes    = 0;
+                    cell.lastUsed = mClock;
+                    mQueue.push_back(grid);
+                    bQueued = true;
+                }
+                else
+                    it->second.lastUsed = mClock;
+            }
+        }
+
+        _evict(center);
+    }
+
+    if (bQueued)
+        mCondition.notify_all();
+}
+
+/*
+    Returns the loaded cell or a null pointer if the cell has not been
+    prefetched (or has not finished loading).  The returned group must
+    not be modified: it stays in the streamer's cache.
+ */
+std::shared_ptr<scene_group>
+CellStreamer::acquire (Grid grid)
+{
+    boost::lock_guard<boost::mutex> lock(mMutex);
+
+    auto it = mCells.find(grid);
+    if (it != mCells.end() && it->second.state == Cell::eReady)
+    {
+        it->second.lastUsed = ++mClock;
+        return it->second.spGroup;
+    }
+    return std::shared_ptr<scene_group>();
+}
+
+size_t
+CellStreamer::residentBytes (void) const
+{
+    boost::lock_guard<boost::mutex> lock(mMutex);
+    return mResident;
+}
+
+size_t
+CellStreamer::queuedCount (void) const
+{
+    boost::lock_guard<boost::mutex> lock(mMutex);
+    return mQueue.size();
+}
+
+bool
+CellStreamer::_inRange (Grid grid, Grid center) const
+{
+    return std::abs(grid.first - center.first) <= mRadius 
+        && std::abs(grid.second - center.second) <= mRadius;
+}
+
+//! Distance from the camera to the center of the cell. Requires mMutex.
+float
+CellStreamer::_distance (Grid grid) const
+{
+    const float dx = (grid.first + 0.5f) * kCellSize - mPosition.x;
+    const float dy = (grid.second + 0.5f) * kCellSize - mPosition.y;
+    return std::sqrt(dx * dx + dy * dy);
+}
+
+/*
+    Removes the queued cell nearest the camera. Requires mMutex.
+
+    The queue is small (a handful of cells around the camera) and the
+    camera position changes between calls, so a linear scan is simpler
+    than maintaining a heap keyed on a moving target.
+ */
+bool
+CellStreamer::_popNearest (Grid& grid)
+{
+    if (mQueue.empty())
+        return false;
+
+    size_t best = 0;
+    float bestDist = _distance(mQueue[0]);
+    for (size_t i = 1; i < mQueue.size(); ++i)
+    {
+        const float d = _distance(mQueue[i]);
+        if (d < bestDist)
+        {
+            best = i;
+            bestDist = d;
+        }
+    }
+
+    grid = mQueue[best];
+    mQueue[best] = mQueue.back();
+    mQueue.pop_back();
+    return true;
+}
+
+/*
+    Evicts the least recently used loaded cells until the resident size
+    is within budget. Requires mMutex and must be called on the main thread.
+    Cells within the radius of center are never evicted: they would only
+    be queued again on the next update().
+ */
+void
+CellStreamer::_evict (Grid center)
+{
+    while (mResident > mBudget)
+    {
+        auto victim = mCells.end();
+        for (auto it = mCells.begin(); it != mCells.end(); ++it)
+        {
+            if (it->second.state != Cell::eReady || _inRange(it->first, center))
+                continue;
+            if (victim == mCells.end() || it->second.lastUsed < victim->second.lastUsed)
+                victim = it;
+        }
+
+        if (victim == mCells.end())
+            break;
+
+        lx_debug("Evicting cell (%d, %d)", victim->first.first, victim->first.second);
+        mResident -= victim->second.bytes;
+        mCells.erase(victim);
+    }
+}
+
+void
+CellStreamer::_worker (void)
+{
+    while (true)
+    {
+        Grid grid;
+        {
+            boost::unique_lock<boost::mutex> lock(mMutex);
+            while (!mbStop && mQueue.empty())
+                mCondition.wait(lock);
+            if (mbStop)
+                return;
+
+            _popNearest(grid);
+            mCells[grid].state = Cell::eLoading;
+        }
+
+        std::shared_ptr<scene_group> spGroup;
+        try
+        {
+            spGroup = mLoad(grid);
+        }
+        catch (std::exception& e)
+        {
+            lx_warn("Failed to stream cell (%d, %d): %s", grid.first, grid.second, e.what());
+        }
+        if (!spGroup)
+            spGroup.reset(new scene_group);
+
+        const size_t bytes = estimateBytes(*spGroup);
+
+        //
+        // Hand the only reference over to the cache, so the group is never
+        // destroyed on this thread (see _evict())
+        //
+        boost::lock_guard<boost::mutex> lock(mMutex);
+        Cell& cell = mCells[grid];
+        cell.state   = Cell::eReady;
+        cell.spGroup.swap(spGroup);
+        cell.bytes   = bytes;
+        mResident += bytes;
+    }
+}
@@ -0,0 +1,122 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+    * MIT License (http://www.opensource.org/licenses/mit-license.php)
+
+    Copyright (c) 2011 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a 
+    copy of this software and associated documentation files (the "Software"), 
+    to deal in the Software without restriction, including without limitation 
+    the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+    and/or sell copies of the Software, and to permit persons to whom the 
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+#pragma once
+
+#include <map>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <boost/thread.hpp>
+#include <glgeom/glgeom.hpp>
+#include <lx0/_detail/forward_decls.hpp>
+
+#include "../lxextensions/material_handle.hpp"
+
+//===========================================================================//
+// CellStreamer
+//===========================================================================//
+
+/*
+    Loads the exterior cells around the camera in advance on background 
+    threads.
+
+    update() is called with the camera position as it moves.  Every cell 
+    within the streaming radius of the camera's cell that is not yet 
+    resident is queued; the worker threads always take the queued cell 
+    nearest the most recent camera position, and queued cells that fall 
+    outside the radius are dropped.
+
+    Loaded cells are kept until the estimated size of all resident cells
+    exceeds the memory budget, at which point the least recently used cells
+    are evicted.  Cells within the radius of the camera are never evicted,
+    so the budget may be exceeded if the radius alone does not fit in it.
+
+    Eviction happens in update(), on the main thread, and the workers do 
+    not keep a reference to a cell once it is loaded.  The cells therefore 
+    are always destroyed on the main thread, which also copies their 
+    instances (and their non-thread-safe lxvar materials) in acquire().
+ */
+class CellStreamer
+{
+public:
+    typedef std::pair<int,int>                                  Grid;
+    typedef std::function<std::shared_ptr<scene_group> (Grid)>  LoadFunction;
+
+    static const float kCellSize;
+
+                    CellStreamer    (void);
+                    ~CellStreamer   (void);
+
+    void            start           (LoadFunction load, size_t threadCount, size_t budgetBytes, int radius);
+    void            stop            (void);
+
+    void            update          (const glgeom::point3f& position);
+    std::shared_ptr<scene_group> acquire (Grid grid);
+
+    bool            running         (void) const    { return mThreads.size() != 0; }
+    size_t          budget          (void) const    { return mBudget; }
+    size_t          residentBytes   (void) const;
+    size_t          queuedCount     (void) const;
+
+    static Grid     gridFromPosition (const glgeom::point3f& position);
+    static size_t   estimateBytes   (const scene_group& group);
+
+protected:
+    struct Cell
+    {
+        enum State { eQueued, eLoading, eReady };
+
+        State                           state;
+        std::shared_ptr<scene_group>    spGroup;
+        size_t                          bytes;
+        lx0::uint64                     lastUsed;
+    };
+
+    void            _worker         (void);
+    bool            _popNearest     (Grid& grid);
+    void            _evict          (Grid center);
+    bool            _inRange        (Grid grid, Grid center) const;
+    float           _distance       (Grid grid) const;
+
+    mutable boost::mutex        mMutex;
+    boost::condition_variable   mCondition;
+    boost::thread_group         mThreads;
+    bool                        mbStop;
+
+    LoadFunction                mLoad;
+    size_t                      mBudget;
+    size_t                      mResident;
+    int                         mRadius;
+    glgeom::point3f             mPosition;
+    lx0::uint64                 mClock;
+
+    std::map<Grid, Cell>        mCells;
+    std::vector<Grid>           mQueue;
+};
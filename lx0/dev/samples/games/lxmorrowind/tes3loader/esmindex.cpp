@@ -0,0 +1,397 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+    * MIT License (http://www.opensource.org/licenses/mit-license.php)
+
+    Copyright (c) 2011 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a 
+    copy of this software and associated documentation files (the "Software"), 
+    to deal in the Software without restriction, including without limitation 
+    the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+    and/or sell copies of the Software, and to permit persons to whom the 
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+//===========================================================================//
+//   H E A D E R S   &   D E C L A R A T I O N S 
+//===========================================================================//
+
+#include <iostream>
+#include <algorithm>
+#include <boost/format.hpp>
+#include <boost/thread.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <lx0/lxengine.hpp>
+#include <lx0/util/misc.hpp>
+
+#include "esmindex.hpp"
+#include "esm_ids.hpp"
+
+//===========================================================================//
+// EsmMapping
+//===========================================================================//
+
+struct EsmMapping
+{
+    EsmMapping (const std::string& filename)
+        : mapping (filename.c_str(), boost::interprocess::read_only)
+        , region  (mapping, boost::interprocess::read_only)
+    {
+    }
+
+    const char* data (void) const { return static_cast<const char*>(region.get_address()); }
+    size_t      size (void) const { return region.get_size(); }
+
+    boost::interprocess::file_mapping   mapping;
+    boost::interprocess::mapped_region  region;
+};
+
+namespace
+{
+    //! Size of a record header and of a sub-record header in bytes
+    const size_t kRecordHeaderSize = 16;
+    const size_t kSubHeaderSize    = 8;
+
+    inline lx0::uint32
+    read_u32 (const char* p)
+    {
+        lx0::uint32 v;
+        memcpy(&v, p, 4);
+        return v;
+    }
+
+    /*
+        Walks the sub-records of a single record in memory.
+     */
+    struct SubRecordCursor
+    {
+        SubRecordCursor (const char* pBase, const RecordHeader& header)
+            : p    (pBase + header.offset + kRecordHeaderSize)
+            , pEnd (p + header.size)
+        {
+        }
+
+        bool        done    (void) const    { return p + kSubHeaderSize > pEnd; }
+        lx0::uint32 id      (void) const    { return read_u32(p); }
+        lx0::uint32 size    (void) const    { return read_u32(p + 4); }
+        const char* data    (void) const    { return p + kSubHeaderSize; }
+        void        next    (void)          { p += kSubHeaderSize + size(); }
+
+        //! The sub-record as a string (the stored null terminator is excluded)
+        std::pair<const char*, size_t> str (void) const
+        {
+            const lx0::uint32 n = std::min<lx0::uint32>(size(), lx0::uint32(pEnd - data()));
+            return std::make_pair(data(), n > 0 ? n - 1 : 0);
+        }
+
+        const char* p;
+        const char* pEnd;
+    };
+}
+
+//===========================================================================//
+// NameTable
+//===========================================================================//
+
+lx0::uint64
+NameTable::hash (const char* name, size_t length)
+{
+    return lx0::lx_fnv1a(name, length);
+}
+
+void
+NameTable::insert (const char* name, size_t length, RecordHeader* pHeader)
+{
+    Entry e;
+    e.hash    = hash(name, length);
+    e.name    = name;
+    e.length  = lx0::uint32(length);
+    e.pHeader = pHeader;
+    mEntries.push_back(e);
+}
+
+/*
+    Must be called after the last insert() and before any find().  The
+    sort is stable so the first entry inserted for a name stays first.
+ */
+void
+NameTable::sort (void)
+{
+    std::stable_sort(mEntries.begin(), mEntries.end(), [](const Entry& a, const Entry& b) {
+        return a.hash < b.hash;
+    });
+}
+
+RecordHeader*
+NameTable::find (const std::string& name) const
+{
+    Entry key;
+    key.hash = hash(name.c_str(), name.size());
+
+    auto it = std::lower_bound(mEntries.begin(), mEntries.end(), key, [](const Entry& a, const Entry& b) {
+        return a.hash < b.hash;
+    });
+    for (; it != mEntries.end() && it->hash == key.hash; ++it)
+    {
+        if (it->length == name.size() && memcmp(it->name, name.c_str(), name.size()) == 0)
+            return it->pHeader;
+    }
+    return nullptr;
+}
+
+//===========================================================================//
+// Index
+//===========================================================================//
+
+/*
+    Scans the record headers of a single file directly from the mapping.  
+    Only the first sub-record or two of the indexed record types is looked
+    at; the record contents are otherwise skipped.
+ */
+void 
+Index::_indexFile (File& file, lx0::uint32 fileIndex)
+{
+    const char*  pBase = file.spMapping->data();
+    const size_t size  = file.spMapping->size();
+
+    lx_check_error(size >= kRecordHeaderSize && read_u32(pBase) == kId_TES3, 
+        "'%s' is not an ESM/ESP file", file.filename.c_str());
+
+    //
+    // Count the records first so the header array is allocated once: the
+    // tables hold pointers into it.
+    //
+    size_t recordCount = 0;
+    for (size_t pos = 0; pos + kRecordHeaderSize <= size; pos += kRecordHeaderSize + read_u32(pBase + pos + 4))
+        recordCount++;
+    file.headers.reserve(recordCount);
+    file.names.reserve(recordCount);
+
+    for (size_t pos = 0; pos + kRecordHeaderSize <= size; )
+    {
+        file.headers.push_back( RecordHeader(pBase, pos, fileIndex) );
+        RecordHeader* pHeader = &file.headers.back();
+        pos += kRecordHeaderSize + pHeader->size;
+        
+        lx_check_error(pos <= size, "Truncated '%s' record in '%s'", pHeader->name, file.filename.c_str());
+
+        SubRecordCursor sub(pBase, *pHeader);
+
+        switch (pHeader->name_id)
+        {
+        case kId_TES3:
+            break;
+
+        //
+        // Index the record types that start with a name field
+        //
+        case kId_ACTI:
+        case kId_APPA:
+        case kId_ARMO:
+        case kId_BOOK:
+        case kId_CLOT:
+        case kId_CONT:
+        case kId_CREA:
+        case kId_DOOR:
+        case kId_INGR:
+        case kId_LEVC:
+        case kId_LEVI:      
+        case kId_LIGH:
+        case kId_LOCK:
+        case kId_MISC:
+        case kId_NPC_:
+        case kId_PROB:
+        case kId_REGN:
+        case kId_REPA:
+        case kId_SOUN:
+        case kId_STAT:
+        case kId_WEAP:
+            if (!sub.done())
+                file.names.push_back( std::make_pair(sub.str(), pHeader) );
+            break;
+
+        //
+        // Cells are indexed by name.  Exterior cells are also indexed by grid
+        // location: most exterior cells share an empty name, and the cell 
+        // streamer needs to find the cells neighbouring the camera.
+        //
+        case kId_CELL:
+            if (!sub.done())
+            {
+                file.names.push_back( std::make_pair(sub.str(), pHeader) );
+                
+                sub.next();
+                if (!sub.done() && sub.id() == kId_DATA && sub.size() >= 12)
+                {
+                    const lx0::uint32 flags = read_u32(sub.data());
+                    const int gridX = int(read_u32(sub.data() + 4));
+                    const int gridY = int(read_u32(sub.data() + 8));
+                    if (!(flags & 0x01))
+                        file.exteriors.push_back( GridEntry(std::make_pair(gridX, gridY), pHeader) );
+                }
+            }
+            break;
+
+        //
+        // The LTEX name is not necessarily the first sub-record
+        //
+        case kId_LTEX:
+            for (; !sub.done(); sub.next())
+            {
+                if (sub.id() == kId_NAME)
+                {
+                    file.names.push_back( std::make_pair(sub.str(), pHeader) );
+                    break;
+                }
+            }
+            file.landscapeTextures.push_back(pHeader);
+            break;
+
+        //
+        // Indexed by location, not name
+        //
+        case kId_LAND:
+            if (!sub.done() && sub.size() >= 8)
+            {
+                const int gridX = int(read_u32(sub.data()));
+                const int gridY = int(read_u32(sub.data() + 4));
+                file.landscapes.push_back( GridEntry(std::make_pair(gridX, gridY), pHeader) );
+            }
+            break;
+
+        //
+        // Known but not indexed
+        //
+        case kId_ALCH:      // Alchemy?
+        case kId_BODY:      // Body-part?
+        case kId_BSGN:      // Birthsign
+        case kId_CLAS:      // Class definition
+        case kId_DIAL:      // Dialogue
+        case kId_ENCH:      // Enchantment
+        case kId_FACT:      // Faction
+        case kId_GLOB:      // ?
+        case kId_GMST:      // ?
+        case kId_INFO:      // Dialogue-related data?
+        case kId_MGEF:      // Magic Effect
+        case kId_PGRD:      // Path Grid?
+        case kId_RACE:      // Race
+        case kId_SCPT:      // Script
+        case kId_SKIL:      // Skill
+        case kId_SNDG:      // Sound Generator?
+        case kId_SPEL:      // Spell
+            break;
+
+        //
+        // Unknown
+        //
+        default:
+            throw lx_error_exception("Unrecognized record id '%s'", pHeader->name); 
+            break;
+        }
+    }
+}
+
+/*
+    Files are given in load order: masters first, then plugins.
+ */
+void 
+Index::read (const std::vector<std::string>& filenames)
+{
+    lx0::Timer timer;
+    timer.start();
+
+    //
+    // Map and index each file on its own thread
+    //
+    std::vector<std::string> errors (filenames.size());
+    boost::thread_group threads;
+    
+    for (size_t i = 0; i < filenames.size(); ++i)
+    {
+        std::shared_ptr<File> spFile(new File);
+        spFile->filename = boost::filesystem::path(filenames[i]).normalize().string();
+        mFiles.push_back(spFile);
+        std::cout << boost::format("Loading '%s'...\n") % spFile->filename;
+
+        const lx0::uint32 fileIndex = lx0::uint32(mFiles.size() - 1);
+        std::string* pError = &errors[i];
+
+        threads.create_thread([spFile, fileIndex, pError]() {
+            try
+            {
+                spFile->spMapping.reset( new EsmMapping(spFile->filename) );
+                _indexFile(*spFile, fileIndex);
+            }
+            catch (boost::interprocess::interprocess_exception& e)
+            {
+                *pError = boost::str( boost::format("Could not open '%s': %s") % spFile->filename % e.what() );
+            }
+            catch (std::exception& e)
+            {
+                *pError = e.what();
+            }
+        });
+    }
+    threads.join_all();
+
+    for (auto it = errors.begin(); it != errors.end(); ++it)
+    {
+        if (!it->empty())
+            throw lx_error_exception("%s", it->c_str());
+    }
+
+    //
+    // Merge the per-file tables.  The later files are merged first so that,
+    // since the first entry for a name or location wins, plugins override
+    // the masters.
+    //
+    size_t nameCount = 0;
+    size_t recordCount = 0;
+    for (auto it = mFiles.begin(); it != mFiles.end(); ++it)
+    {
+        nameCount += (*it)->names.size();
+        recordCount += (*it)->headers.size();
+    }
+    names.reserve(names.size() + nameCount);
+
+    for (auto it = mFiles.rbegin(); it != mFiles.rend(); ++it)
+    {
+        File& file = **it;
+        for (auto jt = file.names.begin(); jt != file.names.end(); ++jt)
+            names.insert(jt->first.first, jt->first.second, jt->second);
+        landscapes.insert(file.landscapes.begin(), file.landscapes.end());
+        exteriors.insert(file.exteriors.begin(), file.exteriors.end());
+
+        // The per-file name list is no longer needed once merged
+        std::vector<std::pair<NameRef, RecordHeader*>>().swap(file.names);
+    }
+    names.sort();
+
+    //
+    // Landscape textures are referenced by position, so keep them in 
+    // load order
+    //
+    for (auto it = mFiles.begin(); it != mFiles.end(); ++it)
+        landscapeTextures.insert(landscapeTextures.end(), (*it)->landscapeTextures.begin(), (*it)->landscapeTextures.end());
+
+    timer.stop();
+    std::cout << boost::format("Indexed %u records in %u file(s) [%u ms]\n") % recordCount % mFiles.size() % timer.totalMs();
+}
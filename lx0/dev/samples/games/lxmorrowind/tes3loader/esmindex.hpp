@@ -0,0 +1,121 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+    * MIT License (http://www.opensource.org/licenses/mit-license.php)
+
+    Copyright (c) 2011 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a 
+    copy of this software and associated documentation files (the "Software"), 
+    to deal in the Software without restriction, including without limitation 
+    the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+    and/or sell copies of the Software, and to permit persons to whom the 
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <lx0/_detail/forward_decls.hpp>
+
+#include "esmiterator.hpp"
+
+struct EsmMapping;
+
+//===========================================================================//
+// NameTable
+//===========================================================================//
+
+/*
+    Compact name to record look-up.  The names are not copied: each entry
+    points at the NAME sub-record within the memory-mapped ESM, so the
+    table is a single flat array sorted by name hash.
+
+    If a name is inserted more than once, find() returns the first one 
+    inserted.
+ */
+class NameTable
+{
+public:
+    void                    reserve     (size_t count)  { mEntries.reserve(count); }
+    void                    insert      (const char* name, size_t length, RecordHeader* pHeader);
+    void                    sort        (void);
+
+    RecordHeader*           find        (const std::string& name) const;
+    size_t                  size        (void) const    { return mEntries.size(); }
+
+    static lx0::uint64      hash        (const char* name, size_t length);
+
+protected:
+    struct Entry
+    {
+        lx0::uint64     hash;
+        const char*     name;
+        lx0::uint32     length;
+        RecordHeader*   pHeader;
+    };
+    std::vector<Entry>      mEntries;
+};
+
+//===========================================================================//
+// Index
+//===========================================================================//
+
+/*
+    The "table of contents" of a set of ESM/ESP files: the header of every 
+    record plus look-up tables by name and grid location.  Once built, the 
+    files can be accessed randomly to pull in records as they are needed.
+
+    The files are memory-mapped and scanned directly from memory, each on
+    its own thread.  The per-file tables are then merged in load order so
+    that a record in a later plugin overrides a master record of the same
+    name.  RecordHeader::file identifies which file a record came from.
+ */
+class Index
+{
+public:
+    void    read        (const std::vector<std::string>& filenames);
+
+    const std::string&  filename    (const RecordHeader& header) const { return mFiles[header.file]->filename; }
+
+    NameTable                                   names;
+    std::vector<RecordHeader*>                  landscapeTextures;
+    std::map<std::pair<int,int>, RecordHeader*> landscapes;
+    std::map<std::pair<int,int>, RecordHeader*> exteriors;
+
+protected:
+    typedef std::pair<std::pair<int,int>, RecordHeader*> GridEntry;
+    typedef std::pair<const char*, size_t>               NameRef;
+
+    struct File
+    {
+        std::string                             filename;
+        std::shared_ptr<EsmMapping>             spMapping;
+        std::vector<RecordHeader>               headers;
+        std::vector<std::pair<NameRef, RecordHeader*>> names;
+        std::vector<RecordHeader*>              landscapeTextures;
+        std::vector<GridEntry>                  landscapes;
+        std::vector<GridEntry>                  exteriors;
+    };
+
+    static void _indexFile (File& file, lx0::uint32 fileIndex);
+
+    std::vector<std::shared_ptr<File>>  mFiles;
+};
@@ -28,10 +28,19 @@
 
 #pragma once
 
+#include <cstring>
 #include "stream.hpp"
 
 struct SubRecordHeader
 {
+    SubRecordHeader () 
+        : offset  (0)
+        , size    (0)
+    {
+        name_id = 0;
+        name[4] = '\0';
+    }
+
     SubRecordHeader (Stream& stream)
     {
         offset = stream.tellg();
@@ -39,6 +48,15 @@ struct SubRecordHeader
         stream.read(&size);
     }
 
+    //! Reads the header directly from memory (e.g. a memory-mapped ESM)
+    SubRecordHeader (const char* pBase, lx0::uint64 offset_)
+        : offset (offset_)
+    {
+        memcpy(name, pBase + offset, 4);
+        name[4] = '\0';
+        memcpy(&size, pBase + offset + 4, 4);
+    }
+
     lx0::uint64 offset;
     union 
     {
@@ -52,13 +70,23 @@ struct RecordHeader : public SubRecordHeader
 {
     RecordHeader(Stream& stream)
         : SubRecordHeader (stream)
+        , file            (0)
     {
         stream.read(&header);
         stream.read(&flags);
     }
 
+    RecordHeader(const char* pBase, lx0::uint64 offset, lx0::uint32 fileIndex)
+        : SubRecordHeader (pBase, offset)
+        , file            (fileIndex)
+    {
+        memcpy(&header, pBase + offset + 8, 4);
+        memcpy(&flags, pBase + offset + 12, 4);
+    }
+
     lx0::uint32 header;
     lx0::uint32 flags;
+    lx0::uint32 file;       //!< Index of the file in the Index the record belongs to
 };
 
 struct ESMIterator
@@ -72,14 +100,14 @@ struct ESMIterator
 
     ESMIterator (Stream& stream, const RecordHeader& recordHeader)
         : mCurrentRecordHeader      (recordHeader)
-        , mCurrentSubRecordHeader   (stream)
         , mStream                   (stream)
     {
         mStream.seekg( recordHeader.offset );
         lx_check_error(mStream.good());
 
-        new (&mCurrentRecordHeader) RecordHeader(mStream);
-        new (&mCurrentSubRecordHeader) SubRecordHeader(mStream);
+        mCurrentRecordHeader = RecordHeader(mStream);
+        mCurrentRecordHeader.file = recordHeader.file;
+        _read_sub();
     }
 
     lx0::uint32 record_id() { return mCurrentRecordHeader.name_id; }
@@ -98,8 +126,8 @@ struct ESMIterator
     {
         lx_check_error(mStream.good());
         mStream.seekg(_offset_next_record());
-        new (&mCurrentRecordHeader) RecordHeader(mStream);
-        new (&mCurrentSubRecordHeader) SubRecordHeader(mStream);
+        mCurrentRecordHeader = RecordHeader(mStream);
+        _read_sub();
     }
 
     const RecordHeader& record_header () const { return mCurrentRecordHeader; }
@@ -110,7 +138,7 @@ struct ESMIterator
     lx0::uint32         sub_id      (void) { return mCurrentSubRecordHeader.name_id; }
     std::string         sub_name    (void) { return mCurrentSubRecordHeader.name; }
     lx0::uint32         sub_size    (void) { return mCurrentSubRecordHeader.size; }
-    void                next_sub    (void) { mStream.seekg(_offset_next_sub()); new (&mCurrentSubRecordHeader) SubRecordHeader(mStream); }
+    void                next_sub    (void) { mStream.seekg(_offset_next_sub()); _read_sub(); }
     bool                sub_done    (void) { return mStream.tellg() >= _offset_next_record(); }
 
     //
@@ -120,6 +148,9 @@ struct ESMIterator
     void                seekg       (lx0::uint64 pos)                       { mStream.seekg(pos); }
     void                skip        (size_t bytes)                          { mStream.skip(bytes); }
     
+    const char*         data        (size_t bytes)                          { return mStream.data(bytes); }
+    template <typename T>
+    void                read_array  (T* data, size_t count)                 { mStream.read_array(data, count); }
     void                read        (char* data, size_t count)              { mStream.read(data, count); }
     void                read5       (char* data)                            { mStream.read5(data); }
     void                read        (float* data, size_t count = 1)         { mStream.read(data, count); }
@@ -132,6 +163,22 @@ struct ESMIterator
     //
 
 protected:
+    /*
+        Reads the header of the sub-record at the current position.  Past the
+        last sub-record, the header is left empty rather than reading into the
+        next record (or past the end of the file).
+     */
+    void _read_sub (void)
+    {
+        if (mStream.tellg() + 8 <= _offset_next_record())
+            mCurrentSubRecordHeader = SubRecordHeader(mStream);
+        else
+        {
+            mCurrentSubRecordHeader = SubRecordHeader();
+            mCurrentSubRecordHeader.offset = mStream.tellg();
+        }
+    }
+
     lx0::uint64         _offset_next_sub() { return mCurrentSubRecordHeader.offset + mCurrentSubRecordHeader.size + 8; }
     lx0::uint64         _offset_next_record() { return mCurrentRecordHeader.offset + mCurrentRecordHeader.size + 16; }
 
@@ -48,6 +48,9 @@
 #include "../tes3loader.hpp"
 #include "esmiterator.hpp"
 #include "esm_ids.hpp"
+#include "esmindex.hpp"
+#include "bsa.hpp"
+#include "cellstreamer.hpp"
 
 namespace bfs = boost::filesystem;
 
@@ -68,209 +71,6 @@ std::string _resolveTextureName (std::string texture)
     return std::string("textures\\") + texture;
 }
 
-//===========================================================================//
-// BsaFile
-//===========================================================================//
-
-struct BsaFile
-{
-    struct Entry
-    {
-        std::string     name;
-        size_t          size;
-        lx0::uint64     offset;
-    };
-
-    typedef std::map<std::string, Entry> EntryMap;
-
-    void            set     (EntryMap& map);
-    Entry*          find    (const std::string& name);
-
-    void            _dumpIndex ();
-
-    std::string     mFilename;
-
-protected:
-    EntryMap        mEntries;
-};
-
-void
-BsaFile::set (EntryMap& map)
-{
-    mEntries.swap(map);
-}
-
-BsaFile::Entry* 
-BsaFile::find (const std::string& name)
-{
-    auto it = mEntries.find(name);
-    return (it != mEntries.end()) ? &it->second : nullptr;
-}
-
-void
-BsaFile::_dumpIndex ()
-{
-    //
-    // Debugging tool: create an index of all the named entries
-    //
-    std::ofstream out(boost::str(boost::format("%s_index.txt") % boost::filesystem::path(mFilename).filename()));
-    lx_check_error(out.good());
-    for (auto it = mEntries.begin(); it != mEntries.end(); ++it)
-        out << it->first << std::endl;
-    out.close();
-}
-
-//===========================================================================//
-// BsaCollection
-//===========================================================================//
-
-/*
-    Represents a set of loaded BSA files.  Morrowind MODs include new BSA
-    files, so a particular resource could be coming from any of a set of 
-    BSA files.
- */
-class BsaCollection
-{
-public:
-    void initialize(const char* path);
-
-    std::pair<bool,BsaFile::Entry*> getEntry    (std::string name);
-
-    std::shared_ptr<scene_group>    getModel            (std::string type, std::string name);
-    std::shared_ptr<std::istream>   getTextureStream    (std::string name);
-
-protected:
-    std::map< std::string, std::shared_ptr<scene_group> > mModelCache;
-    std::vector<BsaFile> mBsas;
-};
-
-std::shared_ptr<scene_group>
-BsaCollection::getModel (std::string type, std::string name)
-{
-    auto fullname = type + name;
-    boost::to_lower(fullname);
-
-    //
-    // Models are frequently reused in the cells (for example, a latern fixture).
-    // Therefore, cache the loaded results and return the cache if possible.
-    //
-    auto it = mModelCache.find(fullname);
-    if (it == mModelCache.end())
-    {
-        for (auto jt = mBsas.begin(); jt != mBsas.end(); ++jt)
-        {
-            auto pEntry = jt->find(fullname);
-            if (pEntry)
-            {
-                Stream stream;
-                stream.open(jt->mFilename);
-                stream.seekg(pEntry->offset);
-                auto spSceneFragment = readNifObject(stream.stream(), _resolveTextureName);
-                stream.close();
-
-                mModelCache.insert(std::make_pair(fullname, spSceneFragment));
-                return spSceneFragment;
-            }
-        }
-
-        return std::shared_ptr<scene_group>();
-    }
-    else
-        return it->second;
-}
-
-
-std::pair<bool,BsaFile::Entry*>
-BsaCollection::getEntry (std::string name)
-{
-    for (auto jt = mBsas.begin(); jt != mBsas.end(); ++jt)
-    {
-        boost::to_lower(name);
-        auto pEntry = jt->find(name);
-        if (pEntry)
-            return std::make_pair(true, pEntry);
-    }
-    return std::make_pair(false, nullptr);
-}
-
-std::shared_ptr<std::istream>   
-BsaCollection::getTextureStream (std::string name)
-{
-    for (auto jt = mBsas.begin(); jt != mBsas.end(); ++jt)
-    {
-        boost::to_lower(name);
-        auto pEntry = jt->find(name);
-        if (pEntry)
-        {
-            std::shared_ptr<std::ifstream> spStream(new std::ifstream);
-            spStream->open(jt->mFilename, std::ios::binary);
-            spStream->seekg(pEntry->offset);
-            return spStream;
-        }
-    }
-    lx_warn("Texture stream for '%s' not found", name.c_str());
-    return std::shared_ptr<std::istream>();
-}
-
-
-void loadBsaFile (BsaFile& bsa, const std::string& filename)
-{
-    std::cout << boost::format("Loading file '%s'...\n") % filename;
-    bsa.mFilename = filename;
-
-    Stream stream;
-    stream.open(filename);
-    if (stream.good())
-    {
-        stream.skip(4);
-        lx0::uint32 directorySize = stream.read();
-        lx0::uint32 fileCount = stream.read();
-
-        struct FileOffset
-        {
-            lx0::uint32 size;
-            lx0::uint32 offset;
-        };
-        std::vector<FileOffset> fileOffsets;
-        fileOffsets.resize(fileCount);
-        stream.read((char *)&fileOffsets[0], fileOffsets.size() * 8);
-
-        std::vector<lx0::uint32> nameOffsets;
-        nameOffsets.resize(fileCount);
-        stream.read(&nameOffsets[0], nameOffsets.size());
-
-        std::vector<char> nameTable;
-        nameTable.resize(directorySize - fileCount * 12);
-        stream.read(&nameTable[0], nameTable.size());
-
-        // Skip the hash table
-        stream.skip(8 * fileCount);
-
-        lx0::uint64 dataOffset = stream.tellg();
-
-        BsaFile::EntryMap map;
-        for (lx0::uint32 i = 0; i < fileCount; ++i)
-        {
-            BsaFile::Entry entry;
-            entry.name = &nameTable[ nameOffsets[i] ];
-            entry.size = fileOffsets[i].size; 
-            entry.offset = dataOffset + fileOffsets[i].offset; 
-
-            map.insert(std::make_pair(entry.name, entry));
-        }
-        bsa.set(map);
-        stream.close();
-    }
-}
-
-void BsaCollection::initialize (const char* path)
-{
-    lx0::for_files_in_directory(path, "bsa", [&](std::string file) {
-        mBsas.push_back(BsaFile());
-        loadBsaFile(mBsas.back(), file);
-    });
-}
-
 //===========================================================================//
 //===========================================================================//
 
@@ -306,151 +106,6 @@ struct LandscapeTexture
     int         value;      //?
 };
 
-struct Index
-{
-public:
-
-    void read (Stream& stream)
-    {
-        //
-        // Read the initial header
-        //
-        // Use this to pre-allocate and prepare for reading the 
-        // full index.
-        //
-        lx0::uint32 recordCount;
-
-        ESMIterator iter (stream);
-        assert(iter.is_record(kId_TES3));
-
-        if (iter.is_sub(kId_HEDR))
-        {
-            float version = stream.read();
-            iter.skip(4 + 32 + 256);
-            recordCount = iter.read();
-            headers.reserve(recordCount);
-            recordCount--;
-        }
-        headers.push_back(iter.record_header());
-        iter.next_record();
-
-        while (recordCount-- > 0)
-        {
-            headers.push_back(iter.record_header());
-
-            switch (iter.record_id())
-            {
-            //
-            // Index the record types that start with a name field
-            //
-            case kId_ACTI:
-            case kId_APPA:
-            case kId_ARMO:
-            case kId_BOOK:
-            case kId_CELL:
-            case kId_CLOT:
-            case kId_CONT:
-            case kId_CREA:
-            case kId_DOOR:
-            case kId_INGR:
-            case kId_LEVC:
-            case kId_LEVI:      
-            case kId_LIGH:
-            case kId_LOCK:
-            //case kId_LTEX:
-            case kId_MISC:
-            case kId_NPC_:
-            case kId_PROB:
-            case kId_REGN:
-            case kId_REPA:
-            case kId_SOUN:
-            case kId_STAT:
-            case kId_WEAP:
-                names.insert(std::make_pair(iter.read_string(), &headers.back()));
-                break;
-
-            //
-            // Special case LTEX while the landscape texturing is still being figured out...
-            //
-            case kId_LTEX:
-                {
-                    LandscapeTexture tex(iter);
-                    auto name = tex.name;
-                    names.insert(std::make_pair(name, &headers.back()));
-                    landscapeTextures.push_back(&headers.back());
-                }
-                break;
-
-            //
-            // Indexed by location, not name
-            //
-            case kId_LAND:
-                {
-                    int gridX = iter.read();
-                    int gridY = iter.read();
-                    landscapes.insert( std::make_pair(std::make_pair(gridX, gridY), &headers.back()) );
-                }
-                break;
-
-            //
-            // Keep this code for debugging all the fields in a sub-record.  Swap 0xFFFFFFFF
-            // with a real record id.
-            //
-            case 0xFFFFFFFF:
-                {
-                    while (!iter.sub_done())
-                    {
-                        std::cout << boost::format("%s %d bytes\n") % iter.sub_name() % iter.sub_size();
-                        size_t size = iter.sub_size();
-                        std::string name = iter.sub_name();
-                        std::vector<char> buffer;
-                        buffer.resize(iter.sub_size());
-                        iter.read(&buffer[0], buffer.size());
-                        char* data = &buffer[0];
-                        iter.next_sub();
-                    }
-                }
-                break;
-
-            //
-            // Known but not indexed
-            //
-            case kId_ALCH:      // Alchemy?
-            case kId_BODY:      // Body-part?
-            case kId_BSGN:      // Birthsign
-            case kId_CLAS:      // Class definition
-            case kId_DIAL:      // Dialogue
-            case kId_ENCH:      // Enchantment
-            case kId_FACT:      // Faction
-            case kId_GLOB:      // ?
-            case kId_GMST:      // ?
-            case kId_INFO:      // Dialogue-related data?
-            case kId_MGEF:      // Magic Effect
-            case kId_PGRD:      // Path Grid?
-            case kId_RACE:      // Race
-            case kId_SCPT:      // Script
-            case kId_SKIL:      // Skill
-            case kId_SNDG:      // Sound Generator?
-            case kId_SPEL:      // Spell
-                break;
-
-            //
-            // Unknown
-            //
-            default:
-                throw lx_error_exception("Unrecognized record id '%s'", iter.record_name().c_str()); 
-                break;
-            }
-            iter.next_record();
-        }
-    } 
-
-    std::vector<RecordHeader>                   headers;
-    std::map<std::string, RecordHeader*>        names;
-    std::vector<RecordHeader*>                  landscapeTextures;
-    std::map<std::pair<int,int>, RecordHeader*> landscapes;
-};
-
 struct StaticModel
 {
     StaticModel (ESMIterator& iter)
@@ -495,8 +150,7 @@ struct Landscape
                     // The heights are signed chars (-128 to 127).
                     //
                     float offset = iter.read();
-                    std::vector<lx0::int8> buffer(65 * 65);
-                    iter.read(&buffer[0], 65 * 65);
+                    const lx0::int8* buffer = reinterpret_cast<const lx0::int8*>( iter.data(65 * 65) );
                     vertexHeight.reserve(65 * 65);
 
                     //
@@ -538,14 +192,13 @@ struct Landscape
                     // normals.  Dividing by 127 and normalizing gives a "standard" 3-tuple float
                     // representation for the normal.
                     //
+                    // The normals are read in place from the mapped file.  The 1/127 
+                    // scale is dropped since the vector is normalized anyway.
+                    //
+                    const lx0::int8* p = reinterpret_cast<const lx0::int8*>( iter.data(65 * 65 * 3) );
                     vertexNormal.resize(65 * 65);
-                    for (auto it = vertexNormal.begin(); it != vertexNormal.end(); ++it)
-                    {
-                        lx0::int8 x = iter.read();
-                        lx0::int8 y = iter.read();
-                        lx0::int8 z = iter.read();
-                        *it = glgeom::normalize( glgeom::vector3f( x / 127.0f, y / 127.0f, z / 127.0f ) );
-                    }
+                    for (auto it = vertexNormal.begin(); it != vertexNormal.end(); ++it, p += 3)
+                        *it = glgeom::normalize( glgeom::vector3f( float(p[0]), float(p[1]), float(p[2]) ) );
                 }
                 break;
 
@@ -566,7 +219,7 @@ struct Landscape
                     // referencing??
                     //
                     textureId.resize(16 * 16);
-                    iter.read(&textureId[0], textureId.size());
+                    iter.read_array(&textureId[0], textureId.size());
                 }
                 break;
 
@@ -831,40 +484,14 @@ Cell::Cell (ESMIterator& iter)
 std::shared_ptr<Cell> 
 loadCell (Stream& stream, Index& index, const char* name)
 {
-    auto it = index.names.find(name);
-    if (it != index.names.end())
-        return std::shared_ptr<Cell>(new Cell( ESMIterator(stream, *it->second) ) );
+    auto pHeader = index.names.find(name);
+    if (pHeader)
+        return std::shared_ptr<Cell>(new Cell( ESMIterator(stream, *pHeader) ) );
     else
         return std::shared_ptr<Cell>();
 }
 
 
-/*
-    The general strategy is to read through the entire file, building a 
-    "table of contents" via the array of record headers and their offsets.
-
-    Once that's built, the file can be accessed randomly to pull in pieces
-    as they are needed.  A caching layer can pull in chunks of records in
-    advance.
-
-    Background thread prioritizes loading of elements
- */
-void loadEsmFile (std::string filenameStr, Index& index)
-{
-    bfs::path filename (filenameStr);
-    filename.normalize();
-
-    Stream stream;
-    stream.open(filename.string());
-
-    if (stream.good())
-    {
-        std::cout << boost::format("Loading '%s'...\n") % filename.filename();
-        index.read (stream);
-        stream.close();
-    }
-}
-
 glm::mat4 _transform(Reference& ref)
 {
     glm::mat4 mrot  = glm::gtx::euler_angles::eulerAngleYXZ(-ref.rotation.y, -ref.rotation.x, -ref.rotation.z);
@@ -881,8 +508,38 @@ public:
     {
         mEsmFilename = std::string(path) + "/Morrowind.esm";
 
-        loadEsmFile(mEsmFilename, mEsmIndex);
+        mEsmIndex.read( std::vector<std::string>(1, mEsmFilename) );
         mBsaSet.initialize(path);
+
+        //
+        // Start prefetching the exterior cells around the camera in the background.
+        // Leave a core free for the main thread.
+        //
+        auto& globals = lx0::Engine::acquire()->globals();
+        const int    radius = globals["streamRadius"].as<int>();
+        const size_t budget = size_t(globals["streamBudgetMB"].as<int>()) * 1024 * 1024;
+        const unsigned cores = boost::thread::hardware_concurrency();
+        const size_t threads = (cores > 2) ? (cores - 1) : 1;
+
+        if (radius > 0)
+            mStreamer.start([this](CellStreamer::Grid grid) { return _streamCell(grid); }, threads, budget, radius);
+    }
+
+    virtual void    updateStreaming (const glgeom::point3f& position)
+    {
+        if (!mStreamer.running())
+            return;
+
+        mStreamer.update(position);
+
+        //
+        // The models referenced by the streamed cells are held by the BSA 
+        // model cache.  Keep the models no cell uses any longer within 
+        // what remains of the same budget.
+        //
+        const size_t resident = mStreamer.residentBytes();
+        const size_t budget   = mStreamer.budget();
+        mBsaSet.trimModelCache(budget > resident ? budget - resident : 0);
     }
 
     void _resolveTexture (texture_handle& handle)
@@ -905,10 +562,13 @@ public:
 
     std::shared_ptr<scene_group> _getModel(Reference& ref, std::string modelName)
     {
-        auto group = mBsaSet.getModel("meshes\\", modelName);
-        
-        std::shared_ptr<scene_group> subgroup(new scene_group);
-        subgroup->merge(*group);
+        // getModel() returns a new group each call, so it can be modified in place
+        auto subgroup = mBsaSet.getModel("meshes\\", modelName);
+        if (!subgroup)
+        {
+            lx_warn("Model '%s' not found", modelName.c_str());
+            return std::shared_ptr<scene_group>(new scene_group);
+        }
 
         auto transform = _transform(ref);
         for (auto kt = subgroup->instances.begin(); kt != subgroup->instances.end(); ++kt)
@@ -942,7 +602,36 @@ public:
         std::cout << boost::format("Grid = %d, %d\n") % spCell->grid[0] % spCell->grid[1];
         std::cout << "References = " << spCell->references.size() << std::endl;
 
+        //
+        // Use the prefetched copy of an exterior cell if the streamer already has it
+        //
+        std::shared_ptr<scene_group> spStreamed;
         if (!spCell->isInterior())
+            spStreamed = mStreamer.acquire( CellStreamer::Grid(spCell->grid[0], spCell->grid[1]) );
+
+        if (spStreamed)
+        {
+            group.merge(*spStreamed);
+            std::cout << "Cell found in stream cache\n";
+        }
+        else
+            _loadCell(stream, *spCell, group, std::cout, boost::thread::hardware_concurrency());
+
+        stream.close();
+        timer.stop();
+
+        std::cout << boost::format("Cell loaded [%u ms]\n") % timer.totalMs();
+    }
+
+    /*
+        Builds the landscape and the referenced objects for the cell.  Called 
+        on the main thread from cell() and on the streamer's worker threads 
+        from _streamCell(), so it must not touch any state other than the
+        read-only index and the (internally locked) BSA collection.
+     */
+    void _loadCell (Stream& stream, Cell& cell, scene_group& group, std::ostream& out, size_t threadCount)
+    {
+        if (!cell.isInterior())
         {
             //
             // Each CELL has a specific grid x,y: this corresponds to the same grid x,y as the
@@ -950,7 +639,7 @@ public:
             // x,y is used for in the case of an interior cell.)  So grab the LAND record based
             // on the grid location.
             //
-            auto it = mEsmIndex.landscapes.find(std::make_pair(spCell->grid[0], spCell->grid[1]));
+            auto it = mEsmIndex.landscapes.find(std::make_pair(cell.grid[0], cell.grid[1]));
             
             if (it != mEsmIndex.landscapes.end())
             {
@@ -958,7 +647,7 @@ public:
                 // Read the Landscape object out of the ESM
                 //
                 Landscape landscape(ESMIterator(stream, *it->second));
-                std::cout << "Landscape found at grid location\n";
+                out << "Landscape found at grid location\n";
 
                 //
                 // The landscape is composed of 4x4 blocks that share the same texture.
@@ -1196,57 +885,62 @@ public:
                 }
             }
             else
-                std::cout << "Could not find landscape at grid location\n";
+                out << "Could not find landscape at grid location\n";
         }
 
         //
-        // Create instances for all the objects referenced in the cell
+        // Create instances for all the objects referenced in the cell.  The 
+        // models are gathered first and then loaded together so that the
+        // NIF parsing can be spread across threads.
         //
-        for (auto it = spCell->references.begin(); it != spCell->references.end(); ++it)
+        std::vector<std::pair<Reference*, std::string>> models;
+        models.reserve(cell.references.size());
+
+        for (auto it = cell.references.begin(); it != cell.references.end(); ++it)
         {
             lx0::Timer tmLoad;
             tmLoad.start();
 
-            auto jt = mEsmIndex.names.find(it->name);
-            if (jt != mEsmIndex.names.end())
+            auto pHeader = mEsmIndex.names.find(it->name);
+            if (pHeader)
             {
-                ESMIterator iter(stream, *jt->second);
+                ESMIterator iter(stream, *pHeader);
 
-                switch (jt->second->name_id)
+                switch (pHeader->name_id)
                 {
                     default:
-                        std::cout << "- " << jt->second->name << "  " << it->name << " (type not handled)";
+                        out << "- " << pHeader->name << "  " << it->name << " (type not handled)";
                     break;
 
                     case kId_STAT:
                     {
                         StaticModel model (iter);
-                        group.merge( *_getModel(*it, model.model) );
-                        std::cout << "+ model " << model.model;
+                        models.push_back( std::make_pair(&*it, model.model) );
+                        out << "+ model " << model.model;
                     }
                     break;
 
                     case kId_ARMO:
                     {
                         Armor armor(iter);
-                        group.merge( *_getModel(*it, armor.model) );
-                        std::cout << "+ armor " << armor.model;
+                        models.push_back( std::make_pair(&*it, armor.model) );
+                        out << "+ armor " << armor.model;
                     }
                     break;
 
                     case kId_CONT:
                     {
                         Container container(iter);
-                        group.merge( *_getModel(*it, container.model) );
-                        std::cout << "+ container " << container.model;
+                        models.push_back( std::make_pair(&*it, container.model) );
+                        out << "+ container " << container.model;
                     }
                     break;
 
                     case kId_DOOR:
                     {
                         Door door (iter);
-                        group.merge( *_getModel(*it, door.model) );
-                        std::cout << "+ door " << door.model;
+                        models.push_back( std::make_pair(&*it, door.model) );
+                        out << "+ door " << door.model;
                     }
                     break;
                 
@@ -1274,38 +968,72 @@ public:
                         group.lights.push_back(esmLight.light);
 
                         if (!esmLight.model.empty())
-                            group.merge( *_getModel(*it, esmLight.model) );
+                            models.push_back( std::make_pair(&*it, esmLight.model) );
 
-                        std::cout << "+ light " << esmLight.name;
+                        out << "+ light " << esmLight.name;
                     }
                     break;
 
                     case kId_MISC:
                     {
                         Miscellaneous misc(iter);
-                        group.merge( *_getModel(*it, misc.model) );
-                        std::cout << "+ misc " << misc.model;
+                        models.push_back( std::make_pair(&*it, misc.model) );
+                        out << "+ misc " << misc.model;
                     }
                     break;
 
                 }
             }
             else
-                std::cout << "- " << it->name << " (not indexed)" << std::endl;
+                out << "- " << it->name << " (not indexed)" << std::endl;
 
             tmLoad.stop();
-            std::cout << boost::format(" [%u ms]\n") % tmLoad.totalMs();
+            out << boost::format(" [%u ms]\n") % tmLoad.totalMs();
         }
-        
-        stream.close();
-        timer.stop();
 
-        std::cout << boost::format("Cell loaded [%u ms]\n") % timer.totalMs();
+        std::vector<std::string> modelNames;
+        modelNames.reserve(models.size());
+        for (auto it = models.begin(); it != models.end(); ++it)
+            modelNames.push_back("meshes\\" + it->second);
+        mBsaSet.loadModels(modelNames, threadCount);
+
+        for (auto it = models.begin(); it != models.end(); ++it)
+            group.merge( *_getModel(*it->first, it->second) );
+    }
+
+    /*
+        Runs on a CellStreamer worker thread.  Each call opens its own stream
+        on the ESM so that concurrent loads do not share a file position.
+     */
+    std::shared_ptr<scene_group> _streamCell (CellStreamer::Grid grid)
+    {
+        std::shared_ptr<scene_group> spGroup(new scene_group);
+
+        auto it = mEsmIndex.exteriors.find(grid);
+        if (it != mEsmIndex.exteriors.end())
+        {
+            Stream stream;
+            stream.open(mEsmFilename);
+            Cell cell( ESMIterator(stream, *it->second) );
+
+            std::ostream quiet(nullptr);
+            _loadCell(stream, cell, *spGroup, quiet, 1);
+            stream.close();
+
+            //
+            // The textures are created on the main thread once the cell is used,
+            // but the data can be paged in from the BSA now.
+            //
+            for (auto jt = spGroup->textures.begin(); jt != spGroup->textures.end(); ++jt)
+                mBsaSet.prefetch(jt->name);
+        }
+        return spGroup;
     }
 
     std::string     mEsmFilename;
     Index           mEsmIndex;
     BsaCollection   mBsaSet;
+    CellStreamer    mStreamer;          //!< Declared last so the workers stop before the rest is destroyed
 };
 
 ITES3Loader* ITES3Loader::create()
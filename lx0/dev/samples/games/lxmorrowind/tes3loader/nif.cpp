@@ -32,6 +32,9 @@
 //   H E A D E R S   &   D E C L A R A T I O N S 
 //===========================================================================//
 
+#include <map>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
 #include <lx0/lxengine.hpp>
 #include <lx0/util/misc.hpp>
 
@@ -60,14 +63,13 @@
 //===========================================================================//
 
 /*
-    Process the Niflib object and covnert it into a generic scene_group
-    structure.
+    Process the Niflib object and convert it into a nif_model.
  */
 static
-std::shared_ptr<scene_group>
-processNifObject (Niflib::NiObjectRef spObject, std::function<std::string (std::string)> textureNameToId)
+std::shared_ptr<nif_model>
+processNifObject (Niflib::NiObjectRef spObject)
 {
-    std::shared_ptr<scene_group> spGroup( new scene_group );
+    std::shared_ptr<nif_model> spModel( new nif_model );
 
     if (Niflib::NiNodeRef spNode = Niflib::DynamicCast<Niflib::NiNode>(spObject))
     {
@@ -124,25 +126,19 @@ processNifObject (Niflib::NiObjectRef spObject, std::function<std::string (std::
                 
                 if (Niflib::NiTriBasedGeomDataRef spData = Niflib::DynamicCast<Niflib::NiTriBasedGeomData>(spTriShape->GetData()))
                 {
-                    spGroup->instances.resize( spGroup->instances.size() + 1 );
-                    auto& primitive = *spGroup->instances.back().spPrimitive;
-                    auto& transform = *spGroup->instances.back().spTransform;
+                    spModel->resize( spModel->size() + 1 );
+                    nif_mesh& mesh = spModel->back();
+                    mesh.spPrimitive.reset( new glgeom::primitive_buffer );
+                    
+                    auto& primitive = *mesh.spPrimitive;
+                    auto& transform = mesh.transform;
 
                     primitive.type = "triangles";
 
                     //
                     // A mesh is being processed, so record the texture filename found earlier.
                     //
-                    texture_handle texture;
-                    texture.name = textureFilename;
-                    spGroup->textures.push_back(texture);
-
-                    lx0::lxvar graph;
-                    graph["_type"] = "phong";
-                    graph["diffuse"]["_type"] = "texture2d";
-                    graph["diffuse"]["texture"] = textureNameToId(textureFilename);
-                    graph["diffuse"]["uv"] = "fragUV";
-                    spGroup->instances.back().material["graph"] = graph;
+                    mesh.texture = textureFilename;
                 
                     //
                     // Let NifLib compute the full transform up to the parent
@@ -202,13 +198,25 @@ processNifObject (Niflib::NiObjectRef spObject, std::function<std::string (std::
             }
         }
     }
-    return spGroup;
+    return spModel;
 }
 
+/*
+    Niflib is not thread-safe: object types are registered lazily on the
+    first read, and NiObject::objectsInMemory and the Ref<> counts are
+    plain integers.  Every Niflib call, including the release of the 
+    parsed tree, is therefore serialized.  Callers on multiple threads
+    (see BsaCollection::loadModels()) still overlap the BSA reads and the 
+    cooked model cache with the parsing.
+ */
+static boost::mutex s_niflibMutex;
 
-std::shared_ptr<scene_group> 
-readNifObject (std::istream& in, std::function<std::string (std::string)> textureNameToId)
+std::shared_ptr<nif_model> 
+readNifModel (std::istream& in)
 {
+    // Declared first so the Niflib tree is released while still locked
+    boost::lock_guard<boost::mutex> lock(s_niflibMutex);
+
     //
     // Use Niflib to read the stream into a Niflib data structure
     //
@@ -216,9 +224,81 @@ readNifObject (std::istream& in, std::function<std::string (std::string)> textur
     auto spNifRoot = Niflib::ReadNifTree(in, &info);
     
     //
-    // Now convert the Niflib object into a scene_group object
+    // Now convert the Niflib object into the engine-native form
     //
-    auto spGroup = processNifObject(spNifRoot, textureNameToId);
-    
+    return processNifObject(spNifRoot);
+}
+
+/*
+    Creates a scene_group referencing the model's primitives.  Meshes that 
+    use the same texture share a single material, and each texture is
+    listed once.
+ */
+std::shared_ptr<scene_group> 
+instantiateNifModel (const nif_model& model, std::function<std::string (std::string)> textureNameToId)
+{
+    std::shared_ptr<scene_group> spGroup( new scene_group );
+    spGroup->instances.reserve(model.size());
+
+    std::map<std::string, lx0::lxvar> materials;
+
+    for (auto it = model.begin(); it != model.end(); ++it)
+    {
+        auto jt = materials.find(it->texture);
+        if (jt == materials.end())
+        {
+            texture_handle texture;
+            texture.name = it->texture;
+            spGroup->textures.push_back(texture);
+
+            lx0::lxvar graph;
+            graph["_type"] = "phong";
+            graph["diffuse"]["_type"] = "texture2d";
+            graph["diffuse"]["texture"] = textureNameToId(it->texture);
+            graph["diffuse"]["uv"] = "fragUV";
+            
+            lx0::lxvar material;
+            material["graph"] = graph;
+            jt = materials.insert(std::make_pair(it->texture, material)).first;
+        }
+
+        instance inst;
+        inst.material = jt->second;
+        inst.spPrimitive = it->spPrimitive;
+        *inst.spTransform = it->transform;
+        spGroup->instances.push_back(inst);
+    }
     return spGroup;
 }
+
+//! Approximate memory held by the primitive's vertex and index data
+size_t
+primitiveBytes (const glgeom::primitive_buffer& primitive)
+{
+    size_t bytes = sizeof(glgeom::primitive_buffer);
+    bytes += primitive.vertex.positions.size() * sizeof(primitive.vertex.positions[0]);
+    bytes += primitive.vertex.normals.size()   * sizeof(primitive.vertex.normals[0]);
+    bytes += primitive.vertex.colors.size()    * sizeof(primitive.vertex.colors[0]);
+    for (auto it = primitive.vertex.uv.begin(); it != primitive.vertex.uv.end(); ++it)
+        bytes += it->size() * sizeof((*it)[0]);
+    bytes += primitive.indices.size()          * sizeof(primitive.indices[0]);
+    return bytes;
+}
+
+size_t
+nifModelBytes (const nif_model& model)
+{
+    size_t bytes = sizeof(nif_model) + model.size() * sizeof(nif_mesh);
+    for (auto it = model.begin(); it != model.end(); ++it)
+    {
+        if (it->spPrimitive)
+            bytes += primitiveBytes(*it->spPrimitive);
+    }
+    return bytes;
+}
+
+std::shared_ptr<scene_group> 
+readNifObject (std::istream& in, std::function<std::string (std::string)> textureNameToId)
+{
+    return instantiateNifModel( *readNifModel(in), textureNameToId );
+}
@@ -33,4 +33,26 @@
 #include <iostream>
 #include "../lxextensions/material_handle.hpp"
 
-std::shared_ptr<scene_group> readNifObject (std::istream& in, std::function<std::string (std::string)> textureNameToId);
+/*
+    The geometry of a NIF model, independent of Niflib and of any lxvar 
+    data.  A nif_model is immutable once loaded, so it can be cached and 
+    shared between threads; instantiateNifModel() creates the materials
+    for a particular use of it.
+ */
+struct nif_mesh
+{
+    std::shared_ptr<glgeom::primitive_buffer>   spPrimitive;
+    glgeom::mat4f                               transform;
+    std::string                                 texture;    //!< Texture file name as stored in the NIF
+};
+typedef std::vector<nif_mesh> nif_model;
+
+std::shared_ptr<nif_model>   readNifModel        (std::istream& in);
+std::shared_ptr<scene_group> instantiateNifModel (const nif_model& model, std::function<std::string (std::string)> textureNameToId);
+std::shared_ptr<scene_group> readNifObject       (std::istream& in, std::function<std::string (std::string)> textureNameToId);
+
+size_t  primitiveBytes      (const glgeom::primitive_buffer& primitive);
+size_t  nifModelBytes       (const nif_model& model);
+
+bool    nif_model_read      (nif_model& model, const std::string& filename, lx0::uint64 key);
+void    nif_model_write     (const nif_model& model, const std::string& filename, lx0::uint64 key);
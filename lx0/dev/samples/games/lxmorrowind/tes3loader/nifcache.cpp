@@ -0,0 +1,194 @@
+//===========================================================================//
+/*
+                                   LxEngine
+
+    LICENSE
+    * MIT License (http://www.opensource.org/licenses/mit-license.php)
+
+    Copyright (c) 2011 athile@athile.net (http://www.athile.net)
+
+    Permission is hereby granted, free of charge, to any person obtaining a 
+    copy of this software and associated documentation files (the "Software"), 
+    to deal in the Software without restriction, including without limitation 
+    the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+    and/or sell copies of the Software, and to permit persons to whom the 
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+*/
+//===========================================================================//
+
+//===========================================================================//
+//   H E A D E R S   &   D E C L A R A T I O N S 
+//===========================================================================//
+
+#include <cstring>
+#include <vector>
+
+#include <lx0/lxengine.hpp>
+#include <lx0/util/misc.hpp>
+#include <lx0/util/misc/cookedfile.hpp>
+
+#include "nif.hpp"
+
+namespace 
+{
+    //
+    // Cooked NIF model layout, following the common cooked file header
+    // (see lx0::CookedFileReader).
+    //
+    //  uint32      meshCount
+    //  for each mesh:
+    //      CookedMesh
+    //      char        texture[textureLength]          (padded to 4 bytes)
+    //      float       positions[vertexCount * 3]
+    //      float       normals[vertexCount * 3]        (if eStreamNormals)
+    //      float       colors[vertexCount * 3]         (if eStreamColors)
+    //      float       uv[uvSets][vertexCount * 2]
+    //      uint32      indices[indexCount]
+    //
+    const lx0::uint32 kMagic     = 0x464e584c;      // "LXNF"
+    const lx0::uint32 kVersion   = 2;
+
+    struct CookedMesh
+    {
+        lx0::uint32 vertexCount;
+        lx0::uint32 indexCount;
+        lx0::uint32 uvSets;
+        lx0::uint32 streams;
+        lx0::uint32 textureLength;
+        float       transform[16];
+        float       bboxMin[3];
+        float       bboxMax[3];
+        float       bsphereCenter[3];
+        float       bsphereRadius;
+    };
+
+    enum
+    {
+        eStreamNormals  = 1 << 0,
+        eStreamColors   = 1 << 1,
+    };
+}
+
+//===========================================================================//
+//   I M P L E M E N T A T I O N 
+//===========================================================================//
+
+/*
+    Reads a cooked model by memory-mapping the file.  Returns false if the 
+    file does not exist, was written by a different format version, does 
+    not match the key, or is corrupt.
+ */
+bool
+nif_model_read (nif_model& model, const std::string& filename, lx0::uint64 key)
+{
+    return lx0::cooked_file_read(filename, kMagic, kVersion, key, [&](lx0::CookedFileReader& reader) {
+        lx0::uint32 meshCount;
+        reader.read(meshCount);
+
+        model.clear();
+        model.resize(meshCount);
+        for (auto it = model.begin(); it != model.end(); ++it)
+        {
+            CookedMesh mh;
+            reader.read(mh);
+
+            it->spPrimitive.reset( new glgeom::primitive_buffer );
+            auto& primitive = *it->spPrimitive;
+            primitive.type = "triangles";
+
+            reader.readString(it->texture, mh.textureLength);
+            for (int i = 0; i < 16; ++i)
+                it->transform[i / 4][i % 4] = mh.transform[i];
+
+            reader.readStream(primitive.vertex.positions, mh.vertexCount);
+            if (mh.streams & eStreamNormals)
+                reader.readStream(primitive.vertex.normals, mh.vertexCount);
+            if (mh.streams & eStreamColors)
+                reader.readStream(primitive.vertex.colors, mh.vertexCount);
+
+            primitive.vertex.uv.resize(mh.uvSets);
+            for (lx0::uint32 s = 0; s < mh.uvSets; ++s)
+                reader.readStream(primitive.vertex.uv[s], mh.vertexCount);
+
+            reader.readUint32Array(primitive.indices, mh.indexCount);
+
+            if (mh.vertexCount > 0)
+            {
+                primitive.bbox.merge( glgeom::point3f(mh.bboxMin[0], mh.bboxMin[1], mh.bboxMin[2]) );
+                primitive.bbox.merge( glgeom::point3f(mh.bboxMax[0], mh.bboxMax[1], mh.bboxMax[2]) );
+            }
+            primitive.bsphere.center = glgeom::point3f(mh.bsphereCenter[0], mh.bsphereCenter[1], mh.bsphereCenter[2]);
+            primitive.bsphere.radius = mh.bsphereRadius;
+        }
+    });
+}
+
+/*
+    Writes the cooked model (see lx0::CookedFileWriter::save()).  Models 
+    that cannot be represented (a UV set whose size does not match the 
+    vertex count) are not written.
+ */
+void
+nif_model_write (const nif_model& model, const std::string& filename, lx0::uint64 key)
+{
+    lx0::CookedFileWriter writer (kMagic, kVersion, key);
+    writer.write( lx0::uint32(model.size()) );
+
+    for (auto it = model.begin(); it != model.end(); ++it)
+    {
+        const auto& primitive = *it->spPrimitive;
+        const size_t vertexCount = primitive.vertex.positions.size();
+
+        for (auto jt = primitive.vertex.uv.begin(); jt != primitive.vertex.uv.end(); ++jt)
+        {
+            if (jt->size() != vertexCount)
+            {
+                lx_debug("Not caching model '%s': UV set size does not match the vertex count", filename.c_str());
+                return;
+            }
+        }
+
+        CookedMesh mh;
+        ::memset(&mh, 0, sizeof(mh));
+        mh.vertexCount      = lx0::uint32(vertexCount);
+        mh.indexCount       = lx0::uint32(primitive.indices.size());
+        mh.uvSets           = lx0::uint32(primitive.vertex.uv.size());
+        mh.streams          = (primitive.vertex.normals.size() == vertexCount && vertexCount ? eStreamNormals : 0)
+                            | (primitive.vertex.colors.size() == vertexCount && vertexCount ? eStreamColors : 0);
+        mh.textureLength    = lx0::uint32(it->texture.size());
+        for (int i = 0; i < 16; ++i)
+            mh.transform[i] = it->transform[i / 4][i % 4];
+        const float bbox[]  = { primitive.bbox.min.x, primitive.bbox.min.y, primitive.bbox.min.z, 
+                                primitive.bbox.max.x, primitive.bbox.max.y, primitive.bbox.max.z };
+        ::memcpy(mh.bboxMin, &bbox[0], sizeof(mh.bboxMin));
+        ::memcpy(mh.bboxMax, &bbox[3], sizeof(mh.bboxMax));
+        mh.bsphereCenter[0] = primitive.bsphere.center.x;
+        mh.bsphereCenter[1] = primitive.bsphere.center.y;
+        mh.bsphereCenter[2] = primitive.bsphere.center.z;
+        mh.bsphereRadius    = primitive.bsphere.radius;
+        writer.write(mh);
+
+        writer.writeString(it->texture);
+        writer.writeStream(primitive.vertex.positions);
+        if (mh.streams & eStreamNormals)
+            writer.writeStream(primitive.vertex.normals);
+        if (mh.streams & eStreamColors)
+            writer.writeStream(primitive.vertex.colors);
+        for (auto jt = primitive.vertex.uv.begin(); jt != primitive.vertex.uv.end(); ++jt)
+            writer.writeStream(*jt);
+        writer.writeUint32Array(primitive.indices);
+    }
+
+    writer.save(filename);
+}
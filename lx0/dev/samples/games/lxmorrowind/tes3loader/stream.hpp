@@ -30,13 +30,16 @@
 
 #include <glgeom/glgeom.hpp>
 #include <lx0/_detail/forward_decls.hpp>
-#include <fstream>
+#include <cstring>
+#include <memory>
 #include <string>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 
 //===========================================================================//
 
 /*
-    Convenience wrapper on a std::ifstream.  Mirrors standard tellg(), 
+    Binary reader over a memory-mapped file.  Mirrors the standard tellg(), 
     seekg(), etc. methods but also includes a series of read() overloads
     for convenience.
 
@@ -47,120 +50,124 @@
 
     Both should do what you would expect and read 32-bits and 8-bits
     respectively.
+
+    Reads are copies out of the mapping (or, via data(), pointers directly
+    into it) so there is no per-value I/O call.  Every read is bounds 
+    checked against the end of the file.
  */
 class Stream
 {
 public:
-    Stream () : mFin(*(new std::ifstream)) { mpOwned = &mFin; }
-    Stream (std::ifstream& stream) : mpOwned (nullptr), mFin(stream) {}
-    ~Stream() { delete mpOwned; }
+    Stream () : mpBegin (nullptr), mpEnd (nullptr), mpCurrent (nullptr) {}
 
     void open (const std::string& filename)
     {
-        mFin.open(filename, std::ios::binary | std::ios::in);
-        lx_check_error(mFin.is_open());
+        try
+        {
+            mspMapping.reset( new Mapping(filename) );
+        }
+        catch (boost::interprocess::interprocess_exception&)
+        {
+            throw lx_error_exception("Could not open '%s'", filename.c_str());
+        }
+        mpBegin   = static_cast<const char*>(mspMapping->region.get_address());
+        mpEnd     = mpBegin + mspMapping->region.get_size();
+        mpCurrent = mpBegin;
     }
 
-    std::ifstream&  stream  (void)              { return mFin; }
-
-    void            close   (void)              { mFin.close(); }
-    bool            eof     (void)              { return mFin.eof(); }
-    bool            good    (void) const        { return mFin.good(); }
-    lx0::uint64     tellg   (void)              { return mFin.tellg(); }
-    void            seekg   (lx0::uint64 pos)   { mFin.seekg(pos); assert(!mFin.fail()); }
+    void            close   (void)              { mspMapping.reset(); mpBegin = mpEnd = mpCurrent = nullptr; }
+    bool            eof     (void)              { return mpCurrent >= mpEnd; }
+    bool            good    (void) const        { return mpBegin != nullptr && mpCurrent < mpEnd; }
+    lx0::uint64     tellg   (void)              { return lx0::uint64(mpCurrent - mpBegin); }
+    lx0::uint64     size    (void) const        { return lx0::uint64(mpEnd - mpBegin); }
 
-    void skip (size_t bytes)
+    void seekg (lx0::uint64 pos)
     {
-        mFin.seekg( bytes, std::ios_base::cur);
+        lx_check_error(pos <= size(), "Seek to %u past the end of the stream", (unsigned int)pos);
+        mpCurrent = mpBegin + pos;
     }
 
-    void read (char* data, size_t count)
+    void skip (size_t bytes)
     {
-        mFin.read(data, count);
+        data(bytes);
     }
 
-    void read (lx0::int8* data, size_t count)
+    //! Returns a pointer to the next count bytes in the file and advances past them
+    const char* data (size_t bytes)
     {
-        mFin.read((char*)data, count);
+        lx_check_error(bytes <= size_t(mpEnd - mpCurrent), "Read of %u bytes past the end of the stream", (unsigned int)bytes);
+        const char* p = mpCurrent;
+        mpCurrent += bytes;
+        return p;
     }
-    void read (lx0::int16* data, size_t count) { mFin.read((char*)data, sizeof(data[0]) * count); }
 
-    void read5 (char* data)
+    //! Bulk read of count values (e.g. an array of floats or vec3s)
+    template <typename T>
+    void read_array (T* data, size_t count)
     {
-        mFin.read(data, 4);
-        data[4] = '\0';
+        if (count > 0)
+            memcpy(data, this->data(sizeof(T) * count), sizeof(T) * count);
     }
 
-    void read (float* data, size_t count = 1)
+    template <typename T>
+    T read_value (void)
     {
-        mFin.read((char*)data, sizeof(float) * count);
+        T v;
+        memcpy(&v, data(sizeof(T)), sizeof(T));
+        return v;
     }
 
-    void read (lx0::uint16* data, size_t count = 1)
-    {
-        mFin.read((char*)data, 2 * count);
-    }
+    void read (char* data, size_t count)                    { read_array(data, count); }
+    void read (lx0::int8* data, size_t count)               { read_array(data, count); }
+    void read (lx0::int16* data, size_t count)              { read_array(data, count); }
+    void read (float* data, size_t count = 1)               { read_array(data, count); }
+    void read (lx0::uint16* data, size_t count = 1)         { read_array(data, count); }
+    void read (lx0::uint32* data, size_t count = 1)         { read_array(data, count); }
 
-    void read (lx0::uint32* data, size_t count = 1)
+    void read5 (char* data)
     {
-        mFin.read((char*)data, 4 * count);
+        read_array(data, 4);
+        data[4] = '\0';
     }
 
     std::string read_string(size_t size)
     {
-        std::string s;
-        if (size > 1)
-        {
-            s.resize(size - 1);
-            read(&s[0], s.size());
-        }
-        char terminator = read();
-        return s;
+        // The stored string includes the null terminator
+        const char* p = data(size);
+        return (size > 1) ? std::string(p, size - 1) : std::string();
     }
     
     std::string read_string2(size_t size)
     {
-        std::string s;
-        if (size > 0)
-        {
-            s.resize(size);
-            read(&s[0], s.size());
-        }
-        return s;
+        const char* p = data(size);
+        return std::string(p, size);
     }
 
     struct auto_cast
     {
         auto_cast(Stream& stream) : mStream (stream) {}
         
-        operator int         () { int v; mStream.read((char *)&v, 4); return v; }
-        operator lx0::int8   () { lx0::int8 v; mStream.read((char *)&v, sizeof(v)); return v; }
-        operator lx0::uint8  () { lx0::uint8 v; mStream.read((char *)&v, sizeof(v)); return v; }
-        operator lx0::int16  () { lx0::int16 v; mStream.read((char *)&v, sizeof(v)); return v; }
-        operator lx0::uint16 () { lx0::uint16 v; mStream.read((char *)&v, sizeof(v)); return v; }
-        operator lx0::uint32 () { lx0::uint32 v; mStream.read(&v); return v; }
-        operator float       () { float v; mStream.read(&v); return v; }
-        operator char        () { char c; mStream.read(&c, 1); return c; }
+        operator int         () { return mStream.read_value<int>(); }
+        operator lx0::int8   () { return mStream.read_value<lx0::int8>(); }
+        operator lx0::uint8  () { return mStream.read_value<lx0::uint8>(); }
+        operator lx0::int16  () { return mStream.read_value<lx0::int16>(); }
+        operator lx0::uint16 () { return mStream.read_value<lx0::uint16>(); }
+        operator lx0::uint32 () { return mStream.read_value<lx0::uint32>(); }
+        operator float       () { return mStream.read_value<float>(); }
+        operator char        () { return mStream.read_value<char>(); }
         operator glgeom::point3f () {
-            glgeom::point3f p;
-            p.x = (*this);
-            p.y = (*this);
-            p.z = (*this);
-            return p;
+            float v[3];
+            mStream.read_array(v, 3);
+            return glgeom::point3f(v[0], v[1], v[2]);
         }
         operator glm::vec3 () {
             glm::vec3 p;
-            p.x = (*this);
-            p.y = (*this);
-            p.z = (*this);
+            mStream.read_array(&p.x, 3);
             return p;
         }
         operator glm::vec4 () {
             glm::vec4 p;
-            p.x = (*this);
-            p.y = (*this);
-            p.z = (*this);
-            p.w = (*this);
+            mStream.read_array(&p.x, 4);
             return p;
         }
         operator glm::mat3 () {
@@ -180,7 +187,20 @@ public:
 
 
 protected:
-    std::ifstream* mpOwned;
-    std::ifstream& mFin;
-};
+    struct Mapping
+    {
+        Mapping (const std::string& filename)
+            : mapping (filename.c_str(), boost::interprocess::read_only)
+            , region  (mapping, boost::interprocess::read_only)
+        {
+        }
 
+        boost::interprocess::file_mapping   mapping;
+        boost::interprocess::mapped_region  region;
+    };
+
+    std::shared_ptr<Mapping>    mspMapping;
+    const char*                 mpBegin;
+    const char*                 mpEnd;
+    const char*                 mpCurrent;
+};